@@ -0,0 +1,168 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freetype-gl.h"
+
+
+// ------------------------------------------------------- typedef & struct ---
+// Former glyph storage: a two-stage table of 0x100 glyphs, variants of a
+// codepoint being chained in a realloc'ed array.
+typedef struct {
+	texture_glyph_t glyph;
+	int cont;
+} legacy_glyph_t;
+
+typedef struct {
+	vector_t *pages;
+} legacy_table_t;
+
+#define LOOKUPS 10000000
+
+
+// ------------------------------------------------------- legacy_table_get ---
+texture_glyph_t *
+legacy_table_get( legacy_table_t *self, uint32_t codepoint,
+				  int rendermode, float outline_thickness ) {
+	uint32_t i = codepoint >> 8;
+	legacy_glyph_t **page, *glyph;
+
+	if ( vector_size( self->pages ) <= i ) return NULL;
+	if ( !(page = *(legacy_glyph_t ***) vector_get( self->pages, i )) ) return NULL;
+	if ( !(glyph = page[codepoint & 0xFF]) ) return NULL;
+
+	while ( (int) glyph->glyph.rendermode != rendermode ||
+			glyph->glyph.outline_thickness != outline_thickness ) {
+		if ( !glyph->cont ) return NULL;
+		glyph++;
+	}
+	return &glyph->glyph;
+}
+
+
+// ------------------------------------------------------- legacy_table_set ---
+void
+legacy_table_set( legacy_table_t *self, const texture_glyph_t *glyph ) {
+	uint32_t i = glyph->codepoint >> 8, j = glyph->codepoint & 0xFF;
+	legacy_glyph_t ***page, *chain;
+	size_t n = 0;
+
+	if ( vector_size( self->pages ) <= i ) {
+		vector_resize( self->pages, i + 1 );
+	}
+	page = (legacy_glyph_t ***) vector_get( self->pages, i );
+	if ( !*page ) {
+		*page = calloc( 0x100, sizeof(legacy_glyph_t *) );
+	}
+	if (( chain = (*page)[j] )) {
+		while ( chain[n].cont ) n++;
+		chain[n++].cont = 1;
+	}
+	chain = (*page)[j] = realloc( chain, (n + 1) * sizeof(legacy_glyph_t) );
+	chain[n].glyph = *glyph;
+	chain[n].cont = 0;
+}
+
+
+// ---------------------------------------------------- legacy_table_delete ---
+void
+legacy_table_delete( legacy_table_t *self ) {
+	size_t i, j;
+
+	for ( i = 0; i < vector_size( self->pages ); ++i ) {
+		legacy_glyph_t **page = *(legacy_glyph_t ***) vector_get( self->pages, i );
+		if ( !page ) continue;
+		for ( j = 0; j < 0x100; ++j ) free( page[j] );
+		free( page );
+	}
+	vector_delete( self->pages );
+}
+
+
+// ------------------------------------------------------------------- bench ---
+void
+bench( const char *name, uint32_t first, uint32_t last, int variants ) {
+	size_t count = last - first + 1, i, found = 0;
+	uint32_t *lookups = malloc( LOOKUPS * sizeof(uint32_t) );
+	texture_glyph_t **glyphs = malloc( count * variants * sizeof(texture_glyph_t *) );
+	glyph_table_t *table = glyph_table_new( );
+	legacy_table_t legacy = { vector_new( sizeof(legacy_glyph_t **) ) };
+	uint32_t seed = 12345;
+	float last_thickness = variants - 1;
+	clock_t start;
+	double legacy_time, table_time;
+	int v;
+
+	// Every codepoint in all its variants, lookups ask for the last variant
+	for ( v = 0; v < variants; ++v ) {
+		for ( i = 0; i < count; ++i ) {
+			texture_glyph_t *glyph = texture_glyph_new( );
+			glyph->codepoint = first + i;
+			glyph->rendermode = v ? RENDER_OUTLINE_EDGE : RENDER_NORMAL;
+			glyph->outline_thickness = v;
+			glyphs[v * count + i] = glyph;
+			glyph_table_set( table, glyph->codepoint, glyph->rendermode,
+							 glyph->outline_thickness, glyph );
+			legacy_table_set( &legacy, glyph );
+		}
+	}
+	for ( i = 0; i < LOOKUPS; ++i ) {
+		seed = seed * 1664525u + 1013904223u;
+		lookups[i] = first + (seed >> 8) % count;
+	}
+
+	start = clock( );
+	for ( i = 0; i < LOOKUPS; ++i ) {
+		found += legacy_table_get( &legacy, lookups[i],
+								   variants > 1 ? RENDER_OUTLINE_EDGE : RENDER_NORMAL,
+								   last_thickness ) != NULL;
+	}
+	legacy_time = (clock( ) - start) / (double) CLOCKS_PER_SEC;
+
+	start = clock( );
+	for ( i = 0; i < LOOKUPS; ++i ) {
+		found += glyph_table_get( table, lookups[i],
+								  variants > 1 ? RENDER_OUTLINE_EDGE : RENDER_NORMAL,
+								  last_thickness ) != NULL;
+	}
+	table_time = (clock( ) - start) / (double) CLOCKS_PER_SEC;
+
+	if ( found != 2 * LOOKUPS ) {
+		fprintf( stderr, "%s: lookup failed\n", name );
+		exit( EXIT_FAILURE );
+	}
+	printf( "%-10s %8lu %9d %16.2f %16.2f %12lu\n", name,
+			(unsigned long) count, variants,
+			legacy_time * 1e9 / LOOKUPS, table_time * 1e9 / LOOKUPS,
+			(unsigned long) glyph_table_memory( table ) );
+
+	for ( i = 0; i < count * variants; ++i ) {
+		texture_glyph_delete( glyphs[i] );
+	}
+	free( glyphs );
+	free( lookups );
+	glyph_table_delete( table );
+	legacy_table_delete( &legacy );
+}
+
+
+// ------------------------------------------------------------------- main ---
+int main( void ) {
+	printf( "Glyph lookup time (%d random lookups)\n\n", LOOKUPS );
+	printf( "%-10s %8s %9s %16s %16s %12s\n", "charset", "glyphs", "variants",
+			"two-stage (ns)", "hash table (ns)", "table (B)" );
+	bench( "ASCII", 0x20, 0x7E, 1 );
+	bench( "ASCII", 0x20, 0x7E, 4 );
+	bench( "Latin-1", 0x20, 0xFF, 1 );
+	bench( "Latin-1", 0x20, 0xFF, 4 );
+	bench( "CJK", 0x4E00, 0x9FFF, 1 );
+	bench( "CJK", 0x4E00, 0x9FFF, 4 );
+
+	return EXIT_SUCCESS;
+}
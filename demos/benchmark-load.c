@@ -0,0 +1,178 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include "freetype-gl.h"
+#include "utf8-utils.h"
+
+
+// ---------------------------------------------------------- utf32_to_utf8 ---
+size_t utf32_to_utf8( uint32_t codepoint, char *out ) {
+	if ( codepoint < 0x80 ) {
+		out[0] = codepoint;
+		return 1;
+	}
+	if ( codepoint < 0x800 ) {
+		out[0] = 0xC0 | (codepoint >> 6);
+		out[1] = 0x80 | (codepoint & 0x3F);
+		return 2;
+	}
+	if ( codepoint < 0x10000 ) {
+		out[0] = 0xE0 | (codepoint >> 12);
+		out[1] = 0x80 | ((codepoint >> 6) & 0x3F);
+		out[2] = 0x80 | (codepoint & 0x3F);
+		return 3;
+	}
+	out[0] = 0xF0 | (codepoint >> 18);
+	out[1] = 0x80 | ((codepoint >> 12) & 0x3F);
+	out[2] = 0x80 | ((codepoint >> 6) & 0x3F);
+	out[3] = 0x80 | (codepoint & 0x3F);
+	return 4;
+}
+
+
+// ------------------------------------------------------------ font_charset ---
+// Returns an UTF-8 string holding (at most) the first count characters
+// defined in the font charmap, control characters excepted.
+char * font_charset( const char *filename, size_t count, size_t *found ) {
+	FT_Library library;
+	FT_Face face;
+	FT_ULong charcode;
+	FT_UInt gindex;
+	char *charset = malloc( 4*count + 1 );
+	size_t length = 0;
+
+	*found = 0;
+	if ( FT_Init_FreeType( &library ) ) {
+		free( charset );
+		return NULL;
+	}
+	if ( FT_New_Face( library, filename, 0, &face ) ) {
+		FT_Done_FreeType( library );
+		free( charset );
+		return NULL;
+	}
+	FT_Select_Charmap( face, FT_ENCODING_UNICODE );
+
+	charcode = FT_Get_First_Char( face, &gindex );
+	while ( gindex && *found < count ) {
+		if ( charcode > 0x20 ) {
+			length += utf32_to_utf8( charcode, charset + length );
+			(*found)++;
+		}
+		charcode = FT_Get_Next_Char( face, charcode, &gindex );
+	}
+	charset[length] = 0;
+
+	FT_Done_Face( face );
+	FT_Done_FreeType( library );
+	return charset;
+}
+
+
+// ------------------------------------------------------------------- now ---
+// Wall clock time in seconds, clock() would add up the time of all threads
+double now( void ) {
+	struct timespec ts;
+
+	timespec_get( &ts, TIME_UTC );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+// ------------------------------------------------------------------- time ---
+double load( const char *filename, float size, const char *charset, int batch,
+			 int threads, size_t *pairs, size_t *memory ) {
+	texture_atlas_t * atlas = texture_atlas_new( 4096, 4096, 1 );
+	texture_font_t * font = texture_font_new_from_file( atlas, size, filename );
+	size_t i;
+	double start, elapsed;
+
+	if ( !font ) {
+		texture_atlas_delete( atlas );
+		return -1;
+	}
+
+	font->threads = threads;
+	start = now( );
+	if ( batch ) {
+		texture_font_load_glyphs( font, charset );
+	} else {
+		for ( i = 0; charset[i]; i += utf8_surrogate_len( charset + i ) ) {
+			texture_font_load_glyph( font, charset + i );
+		}
+	}
+	elapsed = now( ) - start;
+	*pairs = font->kerning_table->size;
+	*memory = kerning_table_memory( font->kerning_table );
+
+	texture_font_delete( font );
+	texture_atlas_delete( atlas );
+	return elapsed;
+}
+
+
+// ------------------------------------------------------------------- main ---
+int main( int argc, char **argv ) {
+	const char *filename = "fonts/Vera.ttf";
+	float size = 16;
+	int threads = 4;
+	size_t count, found, pairs, memory;
+
+	if ( argc > 1 ) {
+		filename = argv[1];
+	}
+	if ( argc > 2 ) {
+		size = atof( argv[2] );
+	}
+	if ( argc > 3 ) {
+		threads = atoi( argv[3] );
+	}
+
+	// Keep the face open, we want to measure glyph loading only
+	texture_font_default_mode( MODE_ALWAYS_OPEN );
+
+	printf( "Glyph loading time for %s at %.1fpt, batches on %d threads\n\n",
+			filename, size, threads );
+	printf( "%8s %14s %14s %14s %14s %14s %14s %10s %12s\n", "glyphs",
+			"single (ms)", "us/glyph", "batch (ms)", "us/glyph",
+			"threaded (ms)", "us/glyph", "pairs", "kerning (KB)" );
+	for ( count = 32; ; count *= 2 ) {
+		char *charset = font_charset( filename, count, &found );
+		double single, batch, threaded;
+
+		if ( !charset ) {
+			fprintf( stderr, "Unable to load \"%s\"\n", filename );
+			return EXIT_FAILURE;
+		}
+		single = load( filename, size, charset, 0, 1, &pairs, &memory );
+		batch = load( filename, size, charset, 1, 1, &pairs, &memory );
+		threaded = load( filename, size, charset, 1, threads, &pairs, &memory );
+		free( charset );
+
+		if ( single < 0 || batch < 0 || threaded < 0 ) {
+			fprintf( stderr, "Unable to load \"%s\"\n", filename );
+			return EXIT_FAILURE;
+		}
+		printf( "%8lu %14.2f %14.2f %14.2f %14.2f %14.2f %14.2f %10lu %12.1f\n",
+				(unsigned long) found,
+				single * 1000, single * 1e6 / found,
+				batch * 1000, batch * 1e6 / found,
+				threaded * 1000, threaded * 1e6 / found,
+				(unsigned long) pairs, memory / 1024.0 );
+		if ( found < count ) {
+			break;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,303 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include "freetype-gl.h"
+
+
+// ------------------------------------------------------- typedef & struct ---
+// Former skyline packer: every node is tried with a walk over the nodes
+// the region would rest on, then the whole skyline is swept for merges.
+typedef struct {
+	vector_t *nodes;
+	size_t width;
+	size_t height;
+	size_t used;
+} legacy_atlas_t;
+
+typedef struct {
+	const char *name;
+	const char *filenames[3];
+	float sizes[3];
+	size_t atlas_size;
+	int packers;
+} workload_t;
+
+typedef struct {
+	double time;
+	size_t placed;
+	size_t top;
+	size_t used;
+} result_t;
+
+
+// ------------------------------------------------------------- legacy_fit ---
+int
+legacy_fit( legacy_atlas_t *self, size_t index, size_t width, size_t height ) {
+	ivec3 *node = (ivec3 *) vector_get( self->nodes, index );
+	int y = node->y, width_left = width;
+	size_t i = index;
+
+	if ( (node->x + width) > (self->width-1) ) {
+		return -1;
+	}
+	while ( width_left > 0 ) {
+		node = (ivec3 *) vector_get( self->nodes, i );
+		if ( node->y > y ) {
+			y = node->y;
+		}
+		if ( (y + height) > (self->height-1) ) {
+			return -1;
+		}
+		width_left -= node->z;
+		++i;
+	}
+	return y;
+}
+
+
+// ------------------------------------------------------ legacy_get_region ---
+ivec4
+legacy_get_region( legacy_atlas_t *self, size_t width, size_t height ) {
+	ivec4 region = {{0,0,width,height}};
+	size_t best_height = -1, best_width = -1, i;
+	int y, best_index = -1;
+	ivec3 *node, *prev, added;
+
+	for ( i = 0; i < self->nodes->size; ++i ) {
+		y = legacy_fit( self, i, width, height );
+		if ( y < 0 ) {
+			continue;
+		}
+		node = (ivec3 *) vector_get( self->nodes, i );
+		if ( ( (y + height) < best_height ) ||
+				( ((y + height) == best_height) && (node->z > 0 && (size_t)node->z < best_width)) ) {
+			best_height = y + height;
+			best_index = i;
+			best_width = node->z;
+			region.x = node->x;
+			region.y = y;
+		}
+	}
+	if ( best_index == -1 ) {
+		return (ivec4){{-1,-1,0,0}};
+	}
+
+	added = (ivec3){{region.x, region.y + height, width}};
+	vector_insert( self->nodes, best_index, &added );
+	for ( i = best_index+1; i < self->nodes->size; ++i ) {
+		node = (ivec3 *) vector_get( self->nodes, i );
+		prev = (ivec3 *) vector_get( self->nodes, i-1 );
+		if ( node->x >= (prev->x + prev->z) ) {
+			break;
+		}
+		int shrink = prev->x + prev->z - node->x;
+		node->x += shrink;
+		node->z -= shrink;
+		if ( node->z > 0 ) {
+			break;
+		}
+		vector_erase( self->nodes, i-- );
+	}
+	for ( i = 0; i < self->nodes->size-1; ++i ) {
+		node = (ivec3 *) vector_get( self->nodes, i );
+		prev = (ivec3 *) vector_get( self->nodes, i+1 );
+		if ( node->y == prev->y ) {
+			node->z += prev->z;
+			vector_erase( self->nodes, i+1 );
+			--i;
+		}
+	}
+	self->used += width * height;
+	return region;
+}
+
+
+// ------------------------------------------------------------ glyph_sizes ---
+// Appends the padded bitmap size of every glyph of a font, the way
+// texture_font_load_glyph asks the atlas for them in RENDER_NORMAL mode.
+void
+glyph_sizes( vector_t *sizes, const char *filename, float size ) {
+	FT_Library library;
+	FT_Face face;
+	FT_Long i;
+
+	if ( FT_Init_FreeType( &library ) ) {
+		return;
+	}
+	if ( FT_New_Face( library, filename, 0, &face ) ) {
+		fprintf( stderr, "cannot open %s\n", filename );
+		FT_Done_FreeType( library );
+		return;
+	}
+	FT_Set_Pixel_Sizes( face, 0, size );
+	for ( i = 0; i < face->num_glyphs; ++i ) {
+		if ( FT_Load_Glyph( face, i, FT_LOAD_RENDER | FT_LOAD_FORCE_AUTOHINT ) ) {
+			continue;
+		}
+		ivec2 glyph = {{face->glyph->bitmap.width + 1, face->glyph->bitmap.rows + 1}};
+		vector_push_back( sizes, &glyph );
+	}
+	FT_Done_Face( face );
+	FT_Done_FreeType( library );
+}
+
+
+// -------------------------------------------------------------------- now ---
+double now( void ) {
+	struct timespec ts;
+
+	timespec_get( &ts, TIME_UTC );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+// ------------------------------------------------------------------- pack ---
+// Packs the sizes over and over until the atlas is full, either with the
+// former packer or with texture_atlas_get_region.
+result_t
+pack( vector_t *sizes, size_t atlas_size, int legacy, vector_t *regions ) {
+	legacy_atlas_t old = { vector_new( sizeof(ivec3) ), atlas_size, atlas_size, 0 };
+	texture_atlas_t *atlas = texture_atlas_new( atlas_size, atlas_size, 1 );
+	ivec3 node = {{1, 1, atlas_size-2}};
+	result_t result = { 0, 0, 0, 0 };
+	ivec4 region;
+	ivec2 *size;
+	double start;
+
+	// texture_atlas_new keeps 5x5 pixels for the special glyph
+	vector_push_back( old.nodes, &node );
+	legacy_get_region( &old, 5, 5 );
+	vector_clear( regions );
+	start = now( );
+	for ( ;; ) {
+		size = (ivec2 *) vector_get( sizes, result.placed % vector_size( sizes ) );
+		region = legacy ? legacy_get_region( &old, size->x, size->y )
+			: texture_atlas_get_region( atlas, size->x, size->y );
+		if ( region.x < 0 ) {
+			break;
+		}
+		vector_push_back( regions, &region );
+		if ( (size_t) (region.y + region.height) > result.top ) {
+			result.top = region.y + region.height;
+		}
+		result.placed++;
+	}
+	result.time = now( ) - start;
+	result.used = legacy ? old.used : atlas->used;
+
+	vector_delete( old.nodes );
+	texture_atlas_delete( atlas );
+	return result;
+}
+
+
+// ----------------------------------------------------------------- packer ---
+// Packs the sizes over and over with the given packer until the atlas is
+// full and prints its occupancy.
+void
+packer( vector_t *sizes, size_t atlas_size, packer_t packer, const char *name ) {
+	texture_atlas_t *atlas = texture_atlas_new( atlas_size, atlas_size, 1 );
+	texture_atlas_stats_t stats;
+	size_t placed = 0;
+	ivec2 *size;
+	double start;
+
+	texture_atlas_set_packer( atlas, packer );
+	start = now( );
+	for ( ;; ) {
+		size = (ivec2 *) vector_get( sizes, placed % vector_size( sizes ) );
+		if ( texture_atlas_get_region( atlas, size->x, size->y ).x < 0 ) {
+			break;
+		}
+		placed++;
+	}
+	stats = texture_atlas_get_stats( atlas );
+	printf( "  %-9s %8lu %12.0f %7.2f %9.2f %9.2f\n", name,
+			(unsigned long) placed, (now( ) - start) * 1e6,
+			100.0 * stats.occupancy, 100.0 * stats.wasted / stats.area,
+			100.0 * stats.free / stats.area );
+	texture_atlas_delete( atlas );
+}
+
+
+// ------------------------------------------------------------------- main ---
+int main( void ) {
+	workload_t workloads[] = {
+		{ "terminal", { "fonts/SourceCodePro-Regular.ttf" }, { 16 }, 512, 1 },
+		{ "ui", { "fonts/Vera.ttf", "fonts/SourceSansPro-Regular.ttf",
+				  "fonts/OldStandard-Regular.ttf" }, { 12, 18, 24 }, 1024, 1 },
+		{ "arabic", { "fonts/amiri-regular.ttf" }, { 32 }, 2048, 1 },
+		{ "wide", { "fonts/amiri-regular.ttf" }, { 12 }, 4096, 0 },
+		{ "cartoon", { "fonts/LuckiestGuy.ttf" }, { 128 }, 2048, 1 },
+	};
+	vector_t *sizes = vector_new( sizeof(ivec2) );
+	vector_t *old_regions = vector_new( sizeof(ivec4) );
+	vector_t *new_regions = vector_new( sizeof(ivec4) );
+	size_t i, j;
+
+	printf( "Skyline packing until the atlas is full\n\n" );
+	printf( "%-9s %6s %6s %8s %12s %12s %7s %7s %5s\n", "workload", "glyphs",
+			"atlas", "placed", "legacy (us)", "skyline (us)", "fill %",
+			"top", "same" );
+	for ( i = 0; i < sizeof(workloads) / sizeof(workloads[0]); ++i ) {
+		workload_t *w = &workloads[i];
+		result_t old, new;
+
+		vector_clear( sizes );
+		for ( j = 0; j < 3 && w->filenames[j]; ++j ) {
+			glyph_sizes( sizes, w->filenames[j], w->sizes[j] );
+		}
+		if ( vector_empty( sizes ) ) {
+			continue;
+		}
+		old = pack( sizes, w->atlas_size, 1, old_regions );
+		new = pack( sizes, w->atlas_size, 0, new_regions );
+		printf( "%-9s %6lu %6lu %8lu %12.0f %12.0f %7.2f %7lu %5s\n", w->name,
+				(unsigned long) vector_size( sizes ), (unsigned long) w->atlas_size,
+				(unsigned long) new.placed, old.time * 1e6, new.time * 1e6,
+				100.0 * new.used / (w->atlas_size * w->atlas_size),
+				(unsigned long) new.top,
+				old.placed == new.placed &&
+				!memcmp( old_regions->items, new_regions->items,
+						 new.placed * sizeof(ivec4) ) ? "yes" : "no" );
+	}
+
+	printf( "\nPackers\n\n" );
+	printf( "  %-9s %8s %12s %7s %9s %9s\n", "packer", "placed", "time (us)",
+			"fill %", "wasted %", "free %" );
+	for ( i = 0; i < sizeof(workloads) / sizeof(workloads[0]); ++i ) {
+		workload_t *w = &workloads[i];
+
+		// MaxRects is far too slow for the wide atlas
+		if ( !w->packers ) {
+			continue;
+		}
+		vector_clear( sizes );
+		for ( j = 0; j < 3 && w->filenames[j]; ++j ) {
+			glyph_sizes( sizes, w->filenames[j], w->sizes[j] );
+		}
+		if ( vector_empty( sizes ) ) {
+			continue;
+		}
+		printf( "%s (%lux%lu)\n", w->name,
+				(unsigned long) w->atlas_size, (unsigned long) w->atlas_size );
+		packer( sizes, w->atlas_size, PACKER_SKYLINE, "skyline" );
+		packer( sizes, w->atlas_size, PACKER_MAXRECTS, "maxrects" );
+		packer( sizes, w->atlas_size, PACKER_SHELF, "shelf" );
+	}
+
+	vector_delete( sizes );
+	vector_delete( old_regions );
+	vector_delete( new_regions );
+	return EXIT_SUCCESS;
+}
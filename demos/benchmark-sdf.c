@@ -0,0 +1,217 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_OUTLINE_H
+
+#include "distance-field.h"
+
+
+// -------------------------------------------------------------------- now ---
+double now( void ) {
+	struct timespec ts;
+
+	timespec_get( &ts, TIME_UTC );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+// ------------------------------------------------------------ load_images ---
+// Renders the glyphs of a font with one pixel of padding around them, as
+// texture_font_load_glyph does for distance fields, and keeps their
+// outlines along with the position of the images.
+size_t load_images( FT_Library library, const char *filename, float size,
+					unsigned char **images, unsigned int *widths,
+					unsigned int *heights, FT_Outline *outlines,
+					float *lefts, float *tops, size_t count ) {
+	FT_Face face;
+	FT_ULong charcode;
+	FT_UInt gindex;
+	size_t found = 0;
+	unsigned int y;
+
+	if ( FT_New_Face( library, filename, 0, &face ) ) {
+		return 0;
+	}
+	FT_Set_Char_Size( face, size * 64, 0, 72, 72 );
+
+	charcode = FT_Get_First_Char( face, &gindex );
+	while ( gindex && found < count ) {
+		if ( charcode > 0x20 && !FT_Load_Glyph( face, gindex, FT_LOAD_DEFAULT ) &&
+			 face->glyph->format == FT_GLYPH_FORMAT_OUTLINE &&
+			 !FT_Outline_New( library, face->glyph->outline.n_points,
+							  face->glyph->outline.n_contours, outlines + found ) ) {
+			FT_Bitmap *bitmap = &face->glyph->bitmap;
+
+			FT_Outline_Copy( &face->glyph->outline, outlines + found );
+			FT_Render_Glyph( face->glyph, FT_RENDER_MODE_NORMAL );
+			lefts[found] = face->glyph->bitmap_left - 1;
+			tops[found] = face->glyph->bitmap_top + 1;
+			widths[found] = bitmap->width + 2;
+			heights[found] = bitmap->rows + 2;
+			images[found] = calloc( widths[found] * heights[found], 1 );
+			for ( y = 0; y < bitmap->rows; ++y ) {
+				memcpy( images[found] + (y + 1) * widths[found] + 1,
+						bitmap->buffer + y * bitmap->pitch, bitmap->width );
+			}
+			found++;
+		}
+		charcode = FT_Get_Next_Char( face, charcode, &gindex );
+	}
+
+	FT_Done_Face( face );
+	return found;
+}
+
+
+// ---------------------------------------------------------------- compare ---
+// Computes the distance fields of the glyphs with a context, from their
+// images or outlines as its mode goes, and adds up how much they differ
+// from those of make_distance_mapb.
+double compare( distance_field_t *context, unsigned char **images,
+				unsigned char **expected, unsigned int *widths,
+				unsigned int *heights, FT_Outline *outlines, float *lefts,
+				float *tops, size_t found, double *error, int *max_error ) {
+	size_t i, j, pixels = 0;
+	double start, elapsed = 0;
+	unsigned char *copy;
+
+	*error = 0;
+	*max_error = 0;
+	for ( i = 0; i < found; ++i ) {
+		size_t size = widths[i] * heights[i];
+
+		copy = malloc( size );
+		memcpy( copy, images[i], size );
+		start = now( );
+		if ( context->mode == DISTANCE_FIELD_OUTLINE ) {
+			distance_field_make_outline( context, outlines + i, copy, widths[i],
+										 heights[i], lefts[i], tops[i] );
+		} else {
+			distance_field_make_mapb( context, copy, widths[i], heights[i] );
+		}
+		elapsed += now( ) - start;
+		for ( j = 0; j < size; ++j ) {
+			int e = abs( (int) expected[i][j] - (int) copy[j] );
+
+			*error += e;
+			*max_error = e > *max_error ? e : *max_error;
+		}
+		pixels += size;
+		free( copy );
+	}
+	*error /= pixels;
+	return elapsed;
+}
+
+
+// ------------------------------------------------------------------- main ---
+int main( int argc, char **argv ) {
+	const char *bundled[] = {
+		"fonts/Vera.ttf", "fonts/VeraMono.ttf", "fonts/VeraMoBd.ttf",
+		"fonts/VeraMoIt.ttf", "fonts/VeraMoBI.ttf", "fonts/Liberastika-Regular.ttf",
+		"fonts/Lobster-Regular.ttf", "fonts/LuckiestGuy.ttf",
+		"fonts/OldStandard-Regular.ttf", "fonts/SourceCodePro-Regular.ttf",
+		"fonts/SourceSansPro-Regular.ttf", "fonts/amiri-regular.ttf"
+	};
+	const char **filenames = bundled;
+	size_t files = sizeof(bundled) / sizeof(bundled[0]);
+	float size = 32;
+	size_t count = 256, found, i, f, allocations = 0;
+	unsigned char **images, **expected;
+	unsigned int *widths, *heights;
+	FT_Outline *outlines;
+	float *lefts, *tops;
+	FT_Library library;
+	distance_field_t *context;
+	double start, legacy, edtaa3, linear, outline;
+	double edtaa3_error, linear_error, outline_error;
+	int edtaa3_max, linear_max, outline_max;
+
+	if ( argc > 1 ) {
+		size = atof( argv[1] );
+	}
+	if ( argc > 2 ) {
+		filenames = (const char **) argv + 2;
+		files = argc - 2;
+	}
+
+	images = malloc( count * sizeof(*images) );
+	expected = malloc( count * sizeof(*expected) );
+	widths = malloc( count * sizeof(*widths) );
+	heights = malloc( count * sizeof(*heights) );
+	outlines = malloc( count * sizeof(*outlines) );
+	lefts = malloc( count * sizeof(*lefts) );
+	tops = malloc( count * sizeof(*tops) );
+	context = distance_field_new( );
+	if ( FT_Init_FreeType( &library ) ) {
+		fprintf( stderr, "Unable to initialize FreeType\n" );
+		return EXIT_FAILURE;
+	}
+
+	printf( "Distance fields of the first %lu glyphs at %.1fpt, time per glyph and\n"
+			"mean (max) error against make_distance_mapb, whose precision the\n"
+			"outline fields do not share\n\n", (unsigned long) count, size );
+	printf( "%-32s %6s %12s %12s %12s %12s %14s %14s %14s\n", "", "glyphs", "mapb (us)",
+			"edtaa3 (us)", "linear (us)", "outline (us)", "edtaa3 error",
+			"linear error", "outline error" );
+	for ( f = 0; f < files; ++f ) {
+		found = load_images( library, filenames[f], size, images, widths, heights,
+							 outlines, lefts, tops, count );
+		if ( !found ) {
+			fprintf( stderr, "Unable to load \"%s\"\n", filenames[f] );
+			continue;
+		}
+
+		// make_distance_mapb allocates seven scratch buffers in double
+		// precision and its output for each glyph
+		start = now( );
+		for ( i = 0; i < found; ++i ) {
+			expected[i] = make_distance_mapb( images[i], widths[i], heights[i] );
+		}
+		legacy = now( ) - start;
+		allocations += 8 * found;
+
+		context->mode = DISTANCE_FIELD_EDTAA3;
+		edtaa3 = compare( context, images, expected, widths, heights, outlines,
+						  lefts, tops, found, &edtaa3_error, &edtaa3_max );
+		context->mode = DISTANCE_FIELD_LINEAR;
+		linear = compare( context, images, expected, widths, heights, outlines,
+						  lefts, tops, found, &linear_error, &linear_max );
+		context->mode = DISTANCE_FIELD_OUTLINE;
+		outline = compare( context, images, expected, widths, heights, outlines,
+						   lefts, tops, found, &outline_error, &outline_max );
+
+		printf( "%-32s %6lu %12.1f %12.1f %12.1f %12.1f %8.3f (%3d) %8.3f (%3d) %8.3f (%3d)\n",
+				filenames[f], (unsigned long) found, legacy * 1e6 / found,
+				edtaa3 * 1e6 / found, linear * 1e6 / found, outline * 1e6 / found,
+				edtaa3_error, edtaa3_max, linear_error, linear_max,
+				outline_error, outline_max );
+		for ( i = 0; i < found; ++i ) {
+			free( images[i] );
+			free( expected[i] );
+			FT_Outline_Done( library, outlines + i );
+		}
+	}
+	printf( "\nAllocations: %lu for make_distance_mapb, %lu for the context\n",
+			(unsigned long) allocations, (unsigned long) context->allocations );
+
+	distance_field_delete( context );
+	FT_Done_FreeType( library );
+	free( outlines );
+	free( lefts );
+	free( tops );
+	free( images );
+	free( expected );
+	free( widths );
+	free( heights );
+	return EXIT_SUCCESS;
+}
@@ -211,7 +211,8 @@ console_render( console_t *self ) {
 	int viewport[4];
 	glGetIntegerv( GL_VIEWPORT, viewport );
 
-	size_t i, index;
+	size_t i, index, count;
+	const ivec4 *dirty;
 	self->pen.x = 0;
 	self->pen.y = viewport[3];
 	vertex_buffer_clear( console->buffer );
@@ -285,9 +286,24 @@ console_render( console_t *self ) {
 		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
 		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
 		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
-		glTexImage2D( GL_TEXTURE_2D, 0, GL_RED, self->atlas->width,
-					  self->atlas->height, 0, GL_RED, GL_UNSIGNED_BYTE,
-					  self->atlas->data );
+
+		// Only the rows of the atlas that changed since the last frame are
+		// uploaded, the first frame uploads all of it
+		dirty = texture_atlas_get_dirty( self->atlas, &count );
+		for ( i = 0; i < count; ++i ) {
+			if ( dirty[i].width == (int) self->atlas->width &&
+				 dirty[i].height == (int) self->atlas->height ) {
+				glTexImage2D( GL_TEXTURE_2D, 0, GL_RED, self->atlas->width,
+							  self->atlas->height, 0, GL_RED, GL_UNSIGNED_BYTE,
+							  self->atlas->data );
+				break;
+			}
+			glTexSubImage2D( GL_TEXTURE_2D, 0, 0, dirty[i].y,
+							 self->atlas->width, dirty[i].height,
+							 GL_RED, GL_UNSIGNED_BYTE,
+							 self->atlas->data + dirty[i].y * self->atlas->width );
+		}
+		texture_atlas_clear_dirty( self->atlas );
 	}
 
 	// Cursor (we use the black character (NULL) as texture )
@@ -4,32 +4,20 @@
  * file `LICENSE` for more details.
  */
 #include <math.h>
-
-
-#include <ft2build.h>
-#include FT_FREETYPE_H
+#include <stdio.h>
+#include <string.h>
 
 #include "freetype-gl.h"
 #include <GLFW/glfw3.h>
 
-#include "distance-field.h"
 #include "vertex-buffer.h"
 #include "shader.h"
 #include "mat4.h"
 #include "texture-font.h"
 #include "texture-atlas.h"
 #include "platform.h"
-#include "utf8-utils.h"
 #include "screenshot-util.h"
 
-#ifndef max
-#define max(a,b) ((a) > (b) ? (a) : (b))
-#endif
-
-#ifndef min
-#define min(a,b) ((a) < (b) ? (a) : (b))
-#endif
-
 double total_time = 0.0;
 
 
@@ -50,214 +38,25 @@ texture_atlas_t *atlas;
 mat4  model, view, projection;
 
 
-// ------------------------------------------------------ MitchellNetravali ---
-// Mitchell Netravali reconstruction filter
-float
-MitchellNetravali( float x ) {
-	const float B = 1/3.0, C = 1/3.0; // Recommended
-	// const float B =   1.0, C =   0.0; // Cubic B-spline (smoother results)
-	// const float B =   0.0, C = 1/2.0; // Catmull-Rom spline (sharper results)
-	x = fabs(x);
-	if ( x < 1 )
-		 return ( ( 12 -  9 * B - 6 * C) * x * x * x
-				+ (-18 + 12 * B + 6 * C) * x * x
-				+ (  6 -  2 * B) ) / 6;
-	else
-	if ( x < 2 )
-		return ( (     -B -  6 * C) * x * x * x
-			   + (  6 * B + 30 * C) * x * x
-			   + (-12 * B - 48 * C) * x
-			   + (  8 * B + 24 * C) ) / 6;
-	else
-		return 0;
-}
-
-
-// ------------------------------------------------------------ interpolate ---
-float
-interpolate( float x, float y0, float y1, float y2, float y3 ) {
-	float c0 = MitchellNetravali(x-1);
-	float c1 = MitchellNetravali(x  );
-	float c2 = MitchellNetravali(x+1);
-	float c3 = MitchellNetravali(x+2);
-	float r =  c0*y0 + c1*y1 + c2*y2 + c3*y3;
-	return min( max( r, 0.0 ), 1.0 );
-}
-
-
-// ------------------------------------------------------------------ scale ---
-int
-resize( double *src_data, size_t src_width, size_t src_height,
-		double *dst_data, size_t dst_width, size_t dst_height ) {
-	if ( (src_width == dst_width) && (src_height == dst_height) ) {
-		memcpy( dst_data, src_data, src_width*src_height*sizeof(double));
-		return 0;
-	}
-	size_t i,j;
-	float xscale = src_width / (float) dst_width;
-	float yscale = src_height / (float) dst_height;
-	for ( j=0; j < dst_height; ++j ) {
-		for ( i=0; i < dst_width; ++i ) {
-			int src_i = (int) floor( i * xscale );
-			int src_j = (int) floor( j * yscale );
-			int i0 = min( max( 0, src_i-1 ), src_width-1 );
-			int i1 = min( max( 0, src_i   ), src_width-1 );
-			int i2 = min( max( 0, src_i+1 ), src_width-1 );
-			int i3 = min( max( 0, src_i+2 ), src_width-1 );
-			int j0 = min( max( 0, src_j-1 ), src_height-1 );
-			int j1 = min( max( 0, src_j   ), src_height-1 );
-			int j2 = min( max( 0, src_j+1 ), src_height-1 );
-			int j3 = min( max( 0, src_j+2 ), src_height-1 );
-			float t0 = interpolate( i / (float) dst_width,
-									src_data[j0*src_width+i0],
-									src_data[j0*src_width+i1],
-									src_data[j0*src_width+i2],
-									src_data[j0*src_width+i3] );
-			float t1 = interpolate( i / (float) dst_width,
-									src_data[j1*src_width+i0],
-									src_data[j1*src_width+i1],
-									src_data[j1*src_width+i2],
-									src_data[j1*src_width+i3] );
-			float t2 = interpolate( i / (float) dst_width,
-									src_data[j2*src_width+i0],
-									src_data[j2*src_width+i1],
-									src_data[j2*src_width+i2],
-									src_data[j2*src_width+i3] );
-			float t3 = interpolate( i / (float) dst_width,
-									src_data[j3*src_width+i0],
-									src_data[j3*src_width+i1],
-									src_data[j3*src_width+i2],
-									src_data[j3*src_width+i3] );
-			float y =  interpolate( j / (float) dst_height, t0, t1, t2, t3 );
-			dst_data[j*dst_width+i] = y;
-		}
-	}
-	return 0;
-}
-
-
-// ------------------------------------------------------------- load_glyph ---
-texture_glyph_t *
-load_glyph( const char *  filename,     const char* codepoint,
-			const float   highres_size, const float   lowres_size,
-			const float   padding ) {
-	size_t i, j;
-	FT_Library library;
-	FT_Face face;
-
-	FT_Init_FreeType( &library );
-	FT_New_Face( library, filename, 0, &face );
-	FT_Select_Charmap( face, FT_ENCODING_UNICODE );
-	FT_UInt glyph_index = FT_Get_Char_Index( face, utf8_to_utf32( codepoint ) );
-
-	// Render glyph at high resolution (highres_size points)
-	FT_Set_Char_Size( face, highres_size*64, 0, 72, 72 );
-	FT_Load_Glyph( face, glyph_index,
-				   FT_LOAD_RENDER | FT_LOAD_NO_HINTING | FT_LOAD_NO_AUTOHINT);
-	FT_GlyphSlot slot = face->glyph;
-	FT_Bitmap bitmap = slot->bitmap;
-
-	// Allocate high resolution buffer
-	size_t highres_width  = bitmap.width + 2*padding*highres_size;
-	size_t highres_height = bitmap.rows + 2*padding*highres_size;
-	double * highres_data = (double *) malloc( highres_width*highres_height*sizeof(double) );
-	memset( highres_data, 0, highres_width*highres_height*sizeof(double) );
-
-	// Copy high resolution bitmap with padding and normalize values
-	for ( j=0; j < bitmap.rows; ++j ) {
-		for ( i=0; i < bitmap.width; ++i ) {
-			int x = i + padding;
-			int y = j + padding;
-			highres_data[y*highres_width+x] = bitmap.buffer[j*bitmap.width+i]/255.0;
-		}
-	}
-
-	// Compute distance map
-	glfwSetTime(total_time);
-	highres_data = make_distance_mapd( highres_data, highres_width, highres_height );
-	total_time += glfwGetTime();
-
-	// Allocate low resolution buffer
-	size_t lowres_width  = round(highres_width * lowres_size/highres_size);
-	size_t lowres_height = round(highres_height * lowres_width/(float) highres_width);
-	double * lowres_data = (double *) malloc( lowres_width*lowres_height*sizeof(double) );
-	memset( lowres_data, 0, lowres_width*lowres_height*sizeof(double) );
-
-	// Scale down highres buffer into lowres buffer
-	resize( highres_data, highres_width, highres_height,
-			lowres_data,  lowres_width,  lowres_height );
-
-	// Convert the (double *) lowres buffer into a (unsigned char *) buffer and
-	// rescale values between 0 and 255.
-	unsigned char * data =
-		(unsigned char *) malloc( lowres_width*lowres_height*sizeof(unsigned char) );
-	for ( j=0; j < lowres_height; ++j ) {
-		for ( i=0; i < lowres_width; ++i ) {
-			double v = lowres_data[j*lowres_width+i];
-			data[j*lowres_width+i] = (int) (255*(1-v));
-		}
-	}
-
-	// Compute new glyph information from highres value
-	float ratio = lowres_size / highres_size;
-	size_t pitch  = lowres_width * sizeof( unsigned char );
-
-	// Create glyph
-	texture_glyph_t * glyph = texture_glyph_new( );
-	glyph->offset_x = (slot->bitmap_left + padding*highres_width) * ratio;
-	glyph->offset_y = (slot->bitmap_top + padding*highres_height) * ratio;
-	glyph->width    = lowres_width;
-	glyph->height   = lowres_height;
-	glyph->codepoint = utf8_to_utf32( codepoint );
-	/*
-	printf( "Glyph width:  %ld\n", glyph->width );
-	printf( "Glyph height: %ld\n", glyph->height );
-	printf( "Glyph offset x: %d\n", glyph->offset_x );
-	printf( "Glyph offset y: %d\n", glyph->offset_y );
-	*/
-	ivec4 region = texture_atlas_get_region( atlas, glyph->width, glyph->height );
-	/*
-	printf( "Region x : %d\n", region.x );
-	printf( "Region y : %d\n", region.y );
-	printf( "Region width : %d\n", region.width );
-	printf( "Region height : %d\n", region.height );
-	*/
-	texture_atlas_set_region( atlas, region.x, region.y, glyph->width, glyph->height, data, pitch );
-	glyph->s0       = region.x/(float)atlas->width;
-	glyph->t0       = region.y/(float)atlas->height;
-	glyph->s1       = (region.x + glyph->width)/(float)atlas->width;
-	glyph->t1       = (region.y + glyph->height)/(float)atlas->height;
-
-	FT_Load_Glyph( face, glyph_index,
-				   FT_LOAD_RENDER | FT_LOAD_NO_HINTING | FT_LOAD_NO_AUTOHINT);
-	glyph->advance_x = ratio * face->glyph->advance.x/64.0;
-	glyph->advance_y = ratio * face->glyph->advance.y/64.0;
-	/*
-	printf( "Advance x : %f\n", glyph->advance_x );
-	printf( "Advance y : %f\n", glyph->advance_y );
-	*/
-	free( highres_data );
-	free( lowres_data );
-	free( data );
-
-	return glyph;
-}
-
-
 // ------------------------------------------------------------------- init ---
 void init( void ) {
 	atlas = texture_atlas_new( 512, 512, 1 );
-	font = texture_font_new_from_file( atlas, 32, "fonts/Vera.ttf" );
+	font = texture_font_new_from_file( atlas, 64, "fonts/Vera.ttf" );
 
 	texture_glyph_t *glyph;
 
-	// Generate the glyp at 512 points, compute distance field and scale it
-	// back to 32 points
+	// Render the glyph 8 times larger (at 512 points), compute its distance
+	// field and scale it back to 64 points, with 6 pixels of distance on
+	// each side of the edges
 	// Just load another glyph if you want to see difference (draw render a '@')
-	glyph = load_glyph( "fonts/Vera.ttf", "@", 512, 64, 0.1);
-	texture_font_index_glyph( font, glyph, '@' );
+	font->rendermode = RENDER_SIGNED_DISTANCE_FIELD;
+	font->hinting = 0;
+	font->distance_oversample = 8;
+	font->distance_spread = 6;
 
+	glfwSetTime( 0.0 );
 	glyph = texture_font_get_glyph( font, "@");
+	total_time = glfwGetTime( );
 
 	GLuint indices[6] = {0,1,2, 0,2,3};
 	vertex_t vertices[4] = { { -.5,-.5,0,  glyph->s0,glyph->t1,  0,0,0,1 },
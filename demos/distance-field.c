@@ -59,6 +59,7 @@ void init( void ) {
 	atlas = texture_atlas_new( 512, 512, 1 );
 	font = texture_font_new_from_file( atlas, 72, filename );
 	font->rendermode = RENDER_SIGNED_DISTANCE_FIELD;
+	font->threads = 4; // Glyphs are rasterized on four threads
 
 	glfwSetTime(total_time);
 	texture_font_load_glyphs( font, cache );
@@ -3,11 +3,661 @@
  * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
  * file `LICENSE` for more details.
  */
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_OUTLINE_H
+#include <assert.h>
 #include <math.h>
 #include <float.h>
 #include <stdlib.h>
 #include <string.h>
 #include "edtaa3func.h"
+#include "distance-field.h"
+#include "freetype-gl-err.h"
+#include "platform.h"
+#ifdef FREETYPE_GL_USE_THREADS
+#include <pthread.h>
+#endif
+#if defined(PLATFORM_SIMD_X86)
+#include <immintrin.h>
+#elif defined(PLATFORM_SIMD_ARM)
+#include <arm_neon.h>
+#endif
+
+// Distance standing for "no edge found yet", squared distances stay far
+// below it
+#define DISTANCE_FIELD_FAR 1e20f
+
+// Fewest rows (or columns) of an image part, below which splitting the
+// work costs more than it saves
+#define DISTANCE_FIELD_PART_LINES 16
+
+extern const struct {
+	int          code;
+	const char*  message;
+} FT_Errors[];
+
+// Segment of an outline, in pixels with y down: a line, conic or cubic
+// Bezier curve of degree 1 to 3, the box of its control points, the
+// contour it belongs to and the channels of a multi-channel field it is an
+// edge of
+typedef struct distance_segment_t {
+	int degree;
+	float p[4][2];
+	float box[4];
+	int contour;
+	int color;
+} distance_segment_t;
+
+// Channels of multi-channel fields, and the colors of edges
+#define DISTANCE_RED     1
+#define DISTANCE_GREEN   2
+#define DISTANCE_BLUE    4
+#define DISTANCE_YELLOW  (DISTANCE_RED | DISTANCE_GREEN)
+#define DISTANCE_MAGENTA (DISTANCE_RED | DISTANCE_BLUE)
+#define DISTANCE_CYAN    (DISTANCE_GREEN | DISTANCE_BLUE)
+#define DISTANCE_WHITE   (DISTANCE_RED | DISTANCE_GREEN | DISTANCE_BLUE)
+
+// Sine of the smallest angle between edges making a corner
+#define DISTANCE_CORNER  0.14112f
+
+// Edge of the polygon an outline is flattened into, for the winding
+typedef struct distance_edge_t {
+	float x0, y0, x1, y1;
+} distance_edge_t;
+
+// Crossing of a pixel row with an edge, going up or down
+typedef struct distance_crossing_t {
+	float x;
+	int winding;
+} distance_crossing_t;
+
+// Outline being decomposed into the buffers of a context
+typedef struct distance_outline_t {
+	distance_field_t * self;
+	float left, top;
+	float last[2];
+	int contour;
+} distance_outline_t;
+
+// Steps of the work on an image split into parts
+#define DISTANCE_JOB_ROWS    0
+#define DISTANCE_JOB_COLUMNS 1
+#define DISTANCE_JOB_EDGES   2
+
+// Work on an image split into parts, each with the scratch buffers of
+// distance_field_part
+typedef struct distance_field_job_t {
+	distance_field_t * self;
+	int step;
+	float * dist;
+	unsigned char * img;
+	unsigned int width, height;
+	int even_odd;
+	double orientation;
+	float range;
+} distance_field_job_t;
+
+#ifdef FREETYPE_GL_USE_THREADS
+// Part of the work of distance_field_run on a thread of the context
+typedef struct distance_field_thread_t {
+	distance_field_task_t task;
+	void * data;
+	size_t index, count;
+	pthread_t thread;
+} distance_field_thread_t;
+#endif
+
+
+/*
+ * Vectorized kernels of the conversion and normalization loops below: the
+ * same operations in the same order as the scalar loops, on several items
+ * at once. Each one returns how many of the first items it did, the scalar
+ * loop doing the rest.
+ */
+#if defined(PLATFORM_SIMD_X86)
+PLATFORM_TARGET("sse2") static size_t
+distance_field_range_sse2( const unsigned char * img, size_t count,
+						   unsigned char * min, unsigned char * max ) {
+	__m128i lo = _mm_set1_epi8( (char) *min ), hi = _mm_set1_epi8( (char) *max );
+	unsigned char l[16], h[16];
+	size_t i;
+	int k;
+
+	for ( i = 0; i + 16 <= count; i += 16 ) {
+		__m128i v = _mm_loadu_si128( (const __m128i *) (img + i) );
+		lo = _mm_min_epu8( lo, v );
+		hi = _mm_max_epu8( hi, v );
+	}
+	_mm_storeu_si128( (__m128i *) l, lo );
+	_mm_storeu_si128( (__m128i *) h, hi );
+	for ( k = 0; k < 16; ++k ) {
+		if ( l[k] < *min ) *min = l[k];
+		if ( h[k] > *max ) *max = h[k];
+	}
+	return i;
+}
+
+PLATFORM_TARGET("avx2") static size_t
+distance_field_range_avx2( const unsigned char * img, size_t count,
+						   unsigned char * min, unsigned char * max ) {
+	__m256i lo = _mm256_set1_epi8( (char) *min ), hi = _mm256_set1_epi8( (char) *max );
+	unsigned char l[32], h[32];
+	size_t i;
+	int k;
+
+	for ( i = 0; i + 32 <= count; i += 32 ) {
+		__m256i v = _mm256_loadu_si256( (const __m256i *) (img + i) );
+		lo = _mm256_min_epu8( lo, v );
+		hi = _mm256_max_epu8( hi, v );
+	}
+	_mm256_storeu_si256( (__m256i *) l, lo );
+	_mm256_storeu_si256( (__m256i *) h, hi );
+	for ( k = 0; k < 32; ++k ) {
+		if ( l[k] < *min ) *min = l[k];
+		if ( h[k] > *max ) *max = h[k];
+	}
+	return i;
+}
+
+PLATFORM_TARGET("sse2") static size_t
+distance_field_unpackd_sse2( const unsigned char * img, double * data, size_t count,
+							 double min, double max ) {
+	const __m128i zero = _mm_setzero_si128( );
+	const __m128d lo = _mm_set1_pd( min ), hi = _mm_set1_pd( max );
+	size_t i;
+
+	for ( i = 0; i + 4 <= count; i += 4 ) {
+		int bytes;
+		__m128i v;
+
+		memcpy( &bytes, img + i, 4 );
+		v = _mm_unpacklo_epi16( _mm_unpacklo_epi8( _mm_cvtsi32_si128( bytes ), zero ), zero );
+		_mm_storeu_pd( data + i, _mm_div_pd( _mm_sub_pd( _mm_cvtepi32_pd( v ), lo ), hi ) );
+		v = _mm_shuffle_epi32( v, _MM_SHUFFLE( 1, 0, 3, 2 ) );
+		_mm_storeu_pd( data + i + 2, _mm_div_pd( _mm_sub_pd( _mm_cvtepi32_pd( v ), lo ), hi ) );
+	}
+	return i;
+}
+
+PLATFORM_TARGET("avx2") static size_t
+distance_field_unpackd_avx2( const unsigned char * img, double * data, size_t count,
+							 double min, double max ) {
+	const __m256d lo = _mm256_set1_pd( min ), hi = _mm256_set1_pd( max );
+	size_t i;
+
+	for ( i = 0; i + 4 <= count; i += 4 ) {
+		int bytes;
+		__m256d v;
+
+		memcpy( &bytes, img + i, 4 );
+		v = _mm256_cvtepi32_pd( _mm_cvtepu8_epi32( _mm_cvtsi32_si128( bytes ) ) );
+		_mm256_storeu_pd( data + i, _mm256_div_pd( _mm256_sub_pd( v, lo ), hi ) );
+	}
+	return i;
+}
+
+PLATFORM_TARGET("sse2") static size_t
+distance_field_unpackf_sse2( const unsigned char * img, float * data, size_t count,
+							 float min, float max ) {
+	const __m128i zero = _mm_setzero_si128( );
+	const __m128 lo = _mm_set1_ps( min ), hi = _mm_set1_ps( max );
+	size_t i;
+
+	for ( i = 0; i + 4 <= count; i += 4 ) {
+		int bytes;
+		__m128i v;
+
+		memcpy( &bytes, img + i, 4 );
+		v = _mm_unpacklo_epi16( _mm_unpacklo_epi8( _mm_cvtsi32_si128( bytes ), zero ), zero );
+		_mm_storeu_ps( data + i, _mm_div_ps( _mm_sub_ps( _mm_cvtepi32_ps( v ), lo ), hi ) );
+	}
+	return i;
+}
+
+PLATFORM_TARGET("avx2") static size_t
+distance_field_unpackf_avx2( const unsigned char * img, float * data, size_t count,
+							 float min, float max ) {
+	const __m256 lo = _mm256_set1_ps( min ), hi = _mm256_set1_ps( max );
+	size_t i;
+
+	for ( i = 0; i + 8 <= count; i += 8 ) {
+		__m256 v = _mm256_cvtepi32_ps( _mm256_cvtepu8_epi32(
+			_mm_loadl_epi64( (const __m128i *) (img + i) ) ) );
+		_mm256_storeu_ps( data + i, _mm256_div_ps( _mm256_sub_ps( v, lo ), hi ) );
+	}
+	return i;
+}
+
+PLATFORM_TARGET("sse2") static size_t
+distance_field_subtractd_sse2( double * outside, const double * inside, size_t count,
+							   double * min ) {
+	const __m128d zero = _mm_setzero_pd( );
+	__m128d m = _mm_set1_pd( *min ), o, n;
+	double l[2];
+	size_t i;
+
+	for ( i = 0; i + 2 <= count; i += 2 ) {
+		o = _mm_loadu_pd( outside + i );
+		n = _mm_loadu_pd( inside + i );
+		o = _mm_andnot_pd( _mm_cmplt_pd( o, zero ), o );
+		n = _mm_andnot_pd( _mm_cmplt_pd( n, zero ), n );
+		o = _mm_sub_pd( o, n );
+		_mm_storeu_pd( outside + i, o );
+		m = _mm_min_pd( o, m );
+	}
+	_mm_storeu_pd( l, m );
+	*min = l[0] < l[1] ? l[0] : l[1];
+	return i;
+}
+
+PLATFORM_TARGET("avx2") static size_t
+distance_field_subtractd_avx2( double * outside, const double * inside, size_t count,
+							   double * min ) {
+	const __m256d zero = _mm256_setzero_pd( );
+	__m256d m = _mm256_set1_pd( *min ), o, n;
+	double l[4];
+	size_t i;
+	int k;
+
+	for ( i = 0; i + 4 <= count; i += 4 ) {
+		o = _mm256_loadu_pd( outside + i );
+		n = _mm256_loadu_pd( inside + i );
+		o = _mm256_andnot_pd( _mm256_cmp_pd( o, zero, _CMP_LT_OQ ), o );
+		n = _mm256_andnot_pd( _mm256_cmp_pd( n, zero, _CMP_LT_OQ ), n );
+		o = _mm256_sub_pd( o, n );
+		_mm256_storeu_pd( outside + i, o );
+		m = _mm256_min_pd( o, m );
+	}
+	_mm256_storeu_pd( l, m );
+	for ( k = 0; k < 4; ++k ) {
+		if ( l[k] < *min ) *min = l[k];
+	}
+	return i;
+}
+
+PLATFORM_TARGET("sse2") static size_t
+distance_field_scaled_sse2( const double * outside, double * data, size_t count,
+							double vmin ) {
+	const __m128d lo = _mm_set1_pd( -vmin ), hi = _mm_set1_pd( vmin );
+	const __m128d twice = _mm_set1_pd( 2 * vmin );
+	size_t i;
+
+	for ( i = 0; i + 2 <= count; i += 2 ) {
+		__m128d v = _mm_min_pd( _mm_max_pd( _mm_loadu_pd( outside + i ), lo ), hi );
+		_mm_storeu_pd( data + i, _mm_div_pd( _mm_add_pd( v, hi ), twice ) );
+	}
+	return i;
+}
+
+PLATFORM_TARGET("avx2") static size_t
+distance_field_scaled_avx2( const double * outside, double * data, size_t count,
+							double vmin ) {
+	const __m256d lo = _mm256_set1_pd( -vmin ), hi = _mm256_set1_pd( vmin );
+	const __m256d twice = _mm256_set1_pd( 2 * vmin );
+	size_t i;
+
+	for ( i = 0; i + 4 <= count; i += 4 ) {
+		__m256d v = _mm256_min_pd( _mm256_max_pd( _mm256_loadu_pd( outside + i ), lo ), hi );
+		_mm256_storeu_pd( data + i, _mm256_div_pd( _mm256_add_pd( v, hi ), twice ) );
+	}
+	return i;
+}
+
+PLATFORM_TARGET("sse2") static size_t
+distance_field_packd_sse2( const double * data, unsigned char * out, size_t count ) {
+	const __m128d one = _mm_set1_pd( 1 ), scale = _mm_set1_pd( 255 );
+	size_t i;
+
+	for ( i = 0; i + 4 <= count; i += 4 ) {
+		__m128i a = _mm_cvttpd_epi32( _mm_mul_pd( scale, _mm_sub_pd( one, _mm_loadu_pd( data + i ) ) ) );
+		__m128i b = _mm_cvttpd_epi32( _mm_mul_pd( scale, _mm_sub_pd( one, _mm_loadu_pd( data + i + 2 ) ) ) );
+		__m128i v = _mm_packs_epi32( _mm_unpacklo_epi64( a, b ), a );
+		int bytes = _mm_cvtsi128_si32( _mm_packus_epi16( v, v ) );
+		memcpy( out + i, &bytes, 4 );
+	}
+	return i;
+}
+
+PLATFORM_TARGET("avx2") static size_t
+distance_field_packd_avx2( const double * data, unsigned char * out, size_t count ) {
+	const __m256d one = _mm256_set1_pd( 1 ), scale = _mm256_set1_pd( 255 );
+	size_t i;
+
+	for ( i = 0; i + 4 <= count; i += 4 ) {
+		__m128i v = _mm256_cvttpd_epi32( _mm256_mul_pd( scale, _mm256_sub_pd( one, _mm256_loadu_pd( data + i ) ) ) );
+		int bytes;
+
+		v = _mm_packs_epi32( v, v );
+		bytes = _mm_cvtsi128_si32( _mm_packus_epi16( v, v ) );
+		memcpy( out + i, &bytes, 4 );
+	}
+	return i;
+}
+
+PLATFORM_TARGET("sse2") static size_t
+distance_field_minf_sse2( const float * outside, size_t count, float * min ) {
+	__m128 m = _mm_set1_ps( *min );
+	float l[4];
+	size_t i;
+	int k;
+
+	for ( i = 0; i + 4 <= count; i += 4 ) {
+		m = _mm_min_ps( _mm_loadu_ps( outside + i ), m );
+	}
+	_mm_storeu_ps( l, m );
+	for ( k = 0; k < 4; ++k ) {
+		if ( l[k] < *min ) *min = l[k];
+	}
+	return i;
+}
+
+PLATFORM_TARGET("avx2") static size_t
+distance_field_minf_avx2( const float * outside, size_t count, float * min ) {
+	__m256 m = _mm256_set1_ps( *min );
+	float l[8];
+	size_t i;
+	int k;
+
+	for ( i = 0; i + 8 <= count; i += 8 ) {
+		m = _mm256_min_ps( _mm256_loadu_ps( outside + i ), m );
+	}
+	_mm256_storeu_ps( l, m );
+	for ( k = 0; k < 8; ++k ) {
+		if ( l[k] < *min ) *min = l[k];
+	}
+	return i;
+}
+
+PLATFORM_TARGET("sse2") static size_t
+distance_field_packf_sse2( const float * outside, unsigned char * img, size_t count,
+						   float vmin ) {
+	const __m128 lo = _mm_set1_ps( -vmin ), hi = _mm_set1_ps( vmin );
+	const __m128 twice = _mm_set1_ps( 2 * vmin );
+	const __m128 one = _mm_set1_ps( 1 ), scale = _mm_set1_ps( 255 );
+	size_t i;
+
+	for ( i = 0; i + 4 <= count; i += 4 ) {
+		__m128 v = _mm_min_ps( _mm_max_ps( _mm_loadu_ps( outside + i ), lo ), hi );
+		__m128i b;
+		int bytes;
+
+		v = _mm_mul_ps( scale, _mm_sub_ps( one, _mm_div_ps( _mm_add_ps( v, hi ), twice ) ) );
+		b = _mm_cvttps_epi32( v );
+		b = _mm_packs_epi32( b, b );
+		bytes = _mm_cvtsi128_si32( _mm_packus_epi16( b, b ) );
+		memcpy( img + i, &bytes, 4 );
+	}
+	return i;
+}
+
+PLATFORM_TARGET("avx2") static size_t
+distance_field_packf_avx2( const float * outside, unsigned char * img, size_t count,
+						   float vmin ) {
+	const __m256 lo = _mm256_set1_ps( -vmin ), hi = _mm256_set1_ps( vmin );
+	const __m256 twice = _mm256_set1_ps( 2 * vmin );
+	const __m256 one = _mm256_set1_ps( 1 ), scale = _mm256_set1_ps( 255 );
+	size_t i;
+
+	for ( i = 0; i + 8 <= count; i += 8 ) {
+		__m256 v = _mm256_min_ps( _mm256_max_ps( _mm256_loadu_ps( outside + i ), lo ), hi );
+		__m256i b;
+		__m128i w;
+
+		v = _mm256_mul_ps( scale, _mm256_sub_ps( one, _mm256_div_ps( _mm256_add_ps( v, hi ), twice ) ) );
+		b = _mm256_cvttps_epi32( v );
+		w = _mm_packs_epi32( _mm256_castsi256_si128( b ), _mm256_extracti128_si256( b, 1 ) );
+		_mm_storel_epi64( (__m128i *) (img + i), _mm_packus_epi16( w, w ) );
+	}
+	return i;
+}
+#elif defined(PLATFORM_SIMD_ARM)
+static size_t
+distance_field_range_neon( const unsigned char * img, size_t count,
+						   unsigned char * min, unsigned char * max ) {
+	uint8x16_t lo = vdupq_n_u8( *min ), hi = vdupq_n_u8( *max );
+	size_t i;
+
+	for ( i = 0; i + 16 <= count; i += 16 ) {
+		uint8x16_t v = vld1q_u8( img + i );
+		lo = vminq_u8( lo, v );
+		hi = vmaxq_u8( hi, v );
+	}
+	*min = vminvq_u8( lo );
+	*max = vmaxvq_u8( hi );
+	return i;
+}
+
+static size_t
+distance_field_unpackd_neon( const unsigned char * img, double * data, size_t count,
+							 double min, double max ) {
+	const float64x2_t lo = vdupq_n_f64( min ), hi = vdupq_n_f64( max );
+	size_t i;
+	int k;
+
+	for ( i = 0; i + 8 <= count; i += 8 ) {
+		uint16x8_t v = vmovl_u8( vld1_u8( img + i ) );
+		uint32x4_t w[2] = { vmovl_u16( vget_low_u16( v ) ), vmovl_u16( vget_high_u16( v ) ) };
+
+		for ( k = 0; k < 2; ++k ) {
+			float64x2_t a = vcvtq_f64_u64( vmovl_u32( vget_low_u32( w[k] ) ) );
+			float64x2_t b = vcvtq_f64_u64( vmovl_u32( vget_high_u32( w[k] ) ) );
+			vst1q_f64( data + i + 4 * k, vdivq_f64( vsubq_f64( a, lo ), hi ) );
+			vst1q_f64( data + i + 4 * k + 2, vdivq_f64( vsubq_f64( b, lo ), hi ) );
+		}
+	}
+	return i;
+}
+
+static size_t
+distance_field_unpackf_neon( const unsigned char * img, float * data, size_t count,
+							 float min, float max ) {
+	const float32x4_t lo = vdupq_n_f32( min ), hi = vdupq_n_f32( max );
+	size_t i;
+
+	for ( i = 0; i + 8 <= count; i += 8 ) {
+		uint16x8_t v = vmovl_u8( vld1_u8( img + i ) );
+		float32x4_t a = vcvtq_f32_u32( vmovl_u16( vget_low_u16( v ) ) );
+		float32x4_t b = vcvtq_f32_u32( vmovl_u16( vget_high_u16( v ) ) );
+
+		vst1q_f32( data + i, vdivq_f32( vsubq_f32( a, lo ), hi ) );
+		vst1q_f32( data + i + 4, vdivq_f32( vsubq_f32( b, lo ), hi ) );
+	}
+	return i;
+}
+
+static size_t
+distance_field_subtractd_neon( double * outside, const double * inside, size_t count,
+							   double * min ) {
+	const float64x2_t zero = vdupq_n_f64( 0 );
+	float64x2_t m = vdupq_n_f64( *min ), o, n;
+	size_t i;
+
+	for ( i = 0; i + 2 <= count; i += 2 ) {
+		o = vld1q_f64( outside + i );
+		n = vld1q_f64( inside + i );
+		o = vbslq_f64( vcltq_f64( o, zero ), zero, o );
+		n = vbslq_f64( vcltq_f64( n, zero ), zero, n );
+		o = vsubq_f64( o, n );
+		vst1q_f64( outside + i, o );
+		m = vminq_f64( o, m );
+	}
+	*min = vminvq_f64( m );
+	return i;
+}
+
+static size_t
+distance_field_scaled_neon( const double * outside, double * data, size_t count,
+							double vmin ) {
+	const float64x2_t lo = vdupq_n_f64( -vmin ), hi = vdupq_n_f64( vmin );
+	const float64x2_t twice = vdupq_n_f64( 2 * vmin );
+	size_t i;
+
+	for ( i = 0; i + 2 <= count; i += 2 ) {
+		float64x2_t v = vminq_f64( vmaxq_f64( vld1q_f64( outside + i ), lo ), hi );
+		vst1q_f64( data + i, vdivq_f64( vaddq_f64( v, hi ), twice ) );
+	}
+	return i;
+}
+
+static size_t
+distance_field_packd_neon( const double * data, unsigned char * out, size_t count ) {
+	const float64x2_t one = vdupq_n_f64( 1 ), scale = vdupq_n_f64( 255 );
+	size_t i;
+	int k;
+
+	for ( i = 0; i + 8 <= count; i += 8 ) {
+		int32x2_t w[4];
+
+		for ( k = 0; k < 4; ++k ) {
+			float64x2_t v = vmulq_f64( scale, vsubq_f64( one, vld1q_f64( data + i + 2 * k ) ) );
+			w[k] = vmovn_s64( vcvtq_s64_f64( v ) );
+		}
+		vst1_u8( out + i, vqmovn_u16( vcombine_u16(
+			vqmovun_s32( vcombine_s32( w[0], w[1] ) ),
+			vqmovun_s32( vcombine_s32( w[2], w[3] ) ) ) ) );
+	}
+	return i;
+}
+
+static size_t
+distance_field_minf_neon( const float * outside, size_t count, float * min ) {
+	float32x4_t m = vdupq_n_f32( *min );
+	size_t i;
+
+	for ( i = 0; i + 4 <= count; i += 4 ) {
+		m = vminq_f32( vld1q_f32( outside + i ), m );
+	}
+	*min = vminvq_f32( m );
+	return i;
+}
+
+static size_t
+distance_field_packf_neon( const float * outside, unsigned char * img, size_t count,
+						   float vmin ) {
+	const float32x4_t lo = vdupq_n_f32( -vmin ), hi = vdupq_n_f32( vmin );
+	const float32x4_t twice = vdupq_n_f32( 2 * vmin );
+	const float32x4_t one = vdupq_n_f32( 1 ), scale = vdupq_n_f32( 255 );
+	size_t i;
+	int k;
+
+	for ( i = 0; i + 8 <= count; i += 8 ) {
+		uint16x4_t w[2];
+
+		for ( k = 0; k < 2; ++k ) {
+			float32x4_t v = vminq_f32( vmaxq_f32( vld1q_f32( outside + i + 4 * k ), lo ), hi );
+			v = vmulq_f32( scale, vsubq_f32( one, vdivq_f32( vaddq_f32( v, hi ), twice ) ) );
+			w[k] = vqmovun_s32( vcvtq_s32_f32( v ) );
+		}
+		vst1_u8( img + i, vqmovn_u16( vcombine_u16( w[0], w[1] ) ) );
+	}
+	return i;
+}
+#endif
+
+// Runs the kernel of the instruction set platform_simd picks, into i the
+// count of items it did (none without a kernel)
+#if defined(PLATFORM_SIMD_X86)
+#define DISTANCE_FIELD_SIMD(i, kernel, ...)								  \
+	switch ( platform_simd( ) ) {										  \
+	case PLATFORM_SIMD_AVX2: i = kernel##_avx2( __VA_ARGS__ ); break;	  \
+	case PLATFORM_SIMD_SSE2: i = kernel##_sse2( __VA_ARGS__ ); break;	  \
+	default: i = 0; break;												  \
+	}
+#elif defined(PLATFORM_SIMD_ARM)
+#define DISTANCE_FIELD_SIMD(i, kernel, ...)								  \
+	i = platform_simd( ) == PLATFORM_SIMD_NEON ? kernel##_neon( __VA_ARGS__ ) : 0;
+#else
+#define DISTANCE_FIELD_SIMD(i, kernel, ...) i = 0;
+#endif
+
+// --------------------------------------------------- distance_field_range ---
+/* Smallest and largest of count bytes */
+static void
+distance_field_range( const unsigned char * img, size_t count,
+					  unsigned char * min, unsigned char * max ) {
+	size_t i;
+
+	*min = 255;
+	*max = 0;
+	DISTANCE_FIELD_SIMD( i, distance_field_range, img, count, min, max );
+	for ( ; i < count; ++i ) {
+		if ( img[i] > *max )
+			*max = img[i];
+		if ( img[i] < *min )
+			*min = img[i];
+	}
+}
+
+// ------------------------------------------------- distance_field_unpackd ---
+/* Maps bytes from min - max to 0.0 - max / (max - min) */
+static void
+distance_field_unpackd( const unsigned char * img, double * data, size_t count,
+						double min, double max ) {
+	size_t i;
+
+	DISTANCE_FIELD_SIMD( i, distance_field_unpackd, img, data, count, min, max );
+	for ( ; i < count; ++i )
+		data[i] = (img[i] - min) / max;
+}
+
+// ------------------------------------------------- distance_field_unpackf ---
+/* Single precision distance_field_unpackd */
+static void
+distance_field_unpackf( const unsigned char * img, float * data, size_t count,
+						float min, float max ) {
+	size_t i;
+
+	DISTANCE_FIELD_SIMD( i, distance_field_unpackf, img, data, count, min, max );
+	for ( ; i < count; ++i )
+		data[i] = (img[i] - min) / max;
+}
+
+// ----------------------------------------------- distance_field_subtractd ---
+/* Bipolar distance field outside - inside, of the distances clamped to
+ * positive ones, into outside; returns its smallest value */
+static double
+distance_field_subtractd( double * outside, const double * inside, size_t count ) {
+	double vmin = DBL_MAX;
+	size_t i;
+
+	DISTANCE_FIELD_SIMD( i, distance_field_subtractd, outside, inside, count, &vmin );
+	for ( ; i < count; ++i ) {
+		outside[i] = (outside[i] < 0 ? 0 : outside[i]) - (inside[i] < 0 ? 0 : inside[i]);
+		if ( outside[i] < vmin )
+			vmin = outside[i];
+	}
+	return vmin;
+}
+
+// -------------------------------------------------- distance_field_scaled ---
+/* Maps a bipolar distance field from -vmin - +vmin to 0.0 - 1.0, clamped */
+static void
+distance_field_scaled( const double * outside, double * data, size_t count,
+					   double vmin ) {
+	size_t i;
+
+	DISTANCE_FIELD_SIMD( i, distance_field_scaled, outside, data, count, vmin );
+	for ( ; i < count; ++i ) {
+		double v = outside[i];
+
+		if ( v < -vmin ) v = -vmin;
+		else
+		if ( v > +vmin ) v = +vmin;
+		data[i] = (v + vmin) / (2 * vmin);
+	}
+}
+
+// --------------------------------------------------- distance_field_packd ---
+/* Maps values from 0.0 - 1.0 to 255 - 0 */
+static void
+distance_field_packd( const double * data, unsigned char * out, size_t count ) {
+	size_t i;
+
+	DISTANCE_FIELD_SIMD( i, distance_field_packd, data, out, count );
+	for ( ; i < count; ++i )
+		out[i] = (unsigned char) (255 * (1 - data[i]));
+}
 
 
 double *
@@ -18,15 +668,12 @@ make_distance_mapd( double *data, unsigned int width, unsigned int height ) {
 	double * gy      = (double *) calloc( width * height, sizeof(double) );
 	double * outside = (double *) calloc( width * height, sizeof(double) );
 	double * inside  = (double *) calloc( width * height, sizeof(double) );
-	double vmin = DBL_MAX;
+	double vmin;
 	unsigned int i;
 
 	// Compute outside = edtaa3(bitmap); % Transform background (0's)
 	computegradient( data, width, height, gx, gy);
 	edtaa3(data, gx, gy, width, height, xdist, ydist, outside);
-	for ( i=0; i<width*height; ++i)
-		if ( outside[i] < 0.0 )
-			outside[i] = 0.0;
 
 	// Compute inside = edtaa3(1-bitmap); % Transform foreground (1's)
 	memset( gx, 0, sizeof(double)*width*height );
@@ -35,26 +682,14 @@ make_distance_mapd( double *data, unsigned int width, unsigned int height ) {
 		data[i] = 1 - data[i];
 	computegradient( data, width, height, gx, gy );
 	edtaa3( data, gx, gy, width, height, xdist, ydist, inside );
-	for ( i=0; i<width*height; ++i )
-		if ( inside[i] < 0 )
-			inside[i] = 0.0;
 
-	// distmap = outside - inside; % Bipolar distance field
-	for ( i=0; i<width*height; ++i) {
-		outside[i] -= inside[i];
-		if ( outside[i] < vmin )
-			vmin = outside[i];
-	}
+	// distmap = outside - inside; % Bipolar distance field, of the
+	// distances clamped to positive ones
+	vmin = distance_field_subtractd( outside, inside, (size_t) width * height );
 
 	vmin = fabs(vmin);
 
-	for ( i=0; i<width*height; ++i) {
-		double v = outside[i];
-		if ( v < -vmin) outside[i] = -vmin;
-		else
-		if ( v > +vmin) outside[i] = +vmin;
-		data[i] = (outside[i]+vmin)/(2*vmin);
-	}
+	distance_field_scaled( outside, data, (size_t) width * height, vmin );
 
 	free( xdist );
 	free( ydist );
@@ -70,32 +705,1324 @@ make_distance_mapb( unsigned char *img,
 					unsigned int width, unsigned int height ) {
 	double * data    = (double *) calloc( width * height, sizeof(double) );
 	unsigned char *out = (unsigned char *) malloc( width * height * sizeof(unsigned char) );
-	unsigned int i;
+	unsigned char min, max;
 
 	// find minimimum and maximum values
-	double img_min = DBL_MAX;
-	double img_max = DBL_MIN;
-
-	for ( i=0; i<width*height; ++i) {
-		double v = img[i];
-		data[i] = v;
-		if (v > img_max)
-			img_max = v;
-		if (v < img_min)
-			img_min = v;
-	}
+	distance_field_range( img, (size_t) width * height, &min, &max );
 
 	// Map values from 0 - 255 to 0.0 - 1.0
-	for ( i=0; i<width*height; ++i)
-		data[i] = (img[i]-img_min)/img_max;
+	distance_field_unpackd( img, data, (size_t) width * height,
+							min, max ? max : DBL_MIN );
 
 	data = make_distance_mapd(data, width, height);
 
 	// map values from 0.0 - 1.0 to 0 - 255
-	for ( i=0; i<width*height; ++i)
-		out[i] = (unsigned char)(255*(1-data[i]));
+	distance_field_packd( data, out, (size_t) width * height );
 
 	free( data );
 
 	return out;
 }
+
+// ----------------------------------------------------- distance_field_new ---
+distance_field_t *
+distance_field_new( void ) {
+	distance_field_t *self = (distance_field_t *) calloc( 1, sizeof(*self) );
+
+	if ( !self ) {
+		freetype_gl_error( Out_Of_Memory,
+			   "%s:%d: No more memory for allocating data\n", __FILENAME__, __LINE__ );
+	}
+	return self;
+}
+
+// ------------------------------------------------- distance_field_release ---
+/* Frees the buffers of a context, and of its parts */
+static void
+distance_field_release( distance_field_t * self ) {
+	size_t i;
+
+	for ( i = 0; i < self->part_count; ++i ) {
+		distance_field_release( self->parts + i );
+	}
+	free( self->parts );
+	free( self->data );
+	if ( self->segments ) vector_delete( self->segments );
+	if ( self->edges ) vector_delete( self->edges );
+	if ( self->crossings ) vector_delete( self->crossings );
+}
+
+// -------------------------------------------------- distance_field_delete ---
+void
+distance_field_delete( distance_field_t * self ) {
+	assert( self );
+
+	distance_field_release( self );
+	free( self );
+}
+
+// ---------------------------------------------------- distance_field_grow ---
+/* Makes room for count pixels and lines of length items in the buffers,
+ * which share one allocation */
+static int
+distance_field_grow( distance_field_t * self,
+					 size_t count,
+					 size_t length ) {
+	size_t capacity = self->capacity ? self->capacity : 1024;
+	size_t line_capacity = self->line_capacity ? self->line_capacity : 64;
+	unsigned char *block;
+
+	if ( count <= self->capacity && length <= self->line_capacity ) {
+		return 1;
+	}
+	while ( capacity < count ) {
+		capacity *= 2;
+	}
+	while ( line_capacity < length ) {
+		line_capacity *= 2;
+	}
+	block = (unsigned char *) malloc( capacity * (5 * sizeof(float) + 2 * sizeof(short)) +
+									  line_capacity * (2 * sizeof(float) + sizeof(int) +
+													   sizeof(short)) );
+	if ( !block ) {
+		freetype_gl_error( Out_Of_Memory,
+			   "%s:%d: No more memory for allocating data\n", __FILENAME__, __LINE__ );
+		return 0;
+	}
+	free( self->data );
+
+	// Wider types first, so that all are aligned
+	self->data    = (float *) block;
+	self->gx      = self->data + capacity;
+	self->gy      = self->gx + capacity;
+	self->outside = self->gy + capacity;
+	self->inside  = self->outside + capacity;
+	self->line    = self->inside + capacity;
+	self->bounds  = self->line + line_capacity;
+	self->roots   = (int *) (self->bounds + line_capacity);
+	self->distx   = (short *) (self->roots + line_capacity);
+	self->disty   = self->distx + capacity;
+	self->offsets = self->disty + capacity;
+	self->capacity = capacity;
+	self->line_capacity = line_capacity;
+	self->allocations++;
+	return 1;
+}
+
+// --------------------------------------------------- distance_field_parts ---
+/* Number of parts, max at most, to split the work on an image into, after
+ * making room for count pixels and lines of length items in the buffers of
+ * each part, and for its crossings. Parts that get no room are not used. */
+static size_t
+distance_field_parts( distance_field_t * self,
+					  size_t max,
+					  size_t count, size_t length ) {
+	size_t i, parts = self->threads > 1 ? (size_t) self->threads : 1;
+
+	parts = parts < max ? parts : max;
+	if ( parts < 1 ) {
+		return 1;
+	}
+	if ( parts > self->part_count + 1 ) {
+		distance_field_t *grown = (distance_field_t *)
+			realloc( self->parts, (parts - 1) * sizeof(distance_field_t) );
+
+		if ( !grown ) {
+			freetype_gl_error( Out_Of_Memory,
+				   "%s:%d: No more memory for allocating data\n", __FILENAME__, __LINE__ );
+			return 1;
+		}
+		memset( grown + self->part_count, 0,
+				(parts - 1 - self->part_count) * sizeof(distance_field_t) );
+		self->parts = grown;
+		self->part_count = parts - 1;
+	}
+	for ( i = 1; i < parts; ++i ) {
+		distance_field_t *part = self->parts + i - 1;
+
+		if ( !part->crossings ) {
+			part->crossings = vector_new( sizeof(distance_crossing_t) );
+		}
+		if ( !part->crossings || !distance_field_grow( part, count, length ) ) {
+			return i;
+		}
+	}
+	return parts;
+}
+
+// ---------------------------------------------------- distance_field_part ---
+/* Context holding the scratch buffers of a part */
+static distance_field_t *
+distance_field_part( distance_field_t * self,
+					 size_t index ) {
+	return index ? self->parts + index - 1 : self;
+}
+
+// ---------------------------------------------------- distance_field_band ---
+/* Lines first to last - 1 of part index of count, of n lines */
+static void
+distance_field_band( unsigned int n,
+					 size_t index, size_t count,
+					 unsigned int * first, unsigned int * last ) {
+	*first = (unsigned int) (n * index / count);
+	*last = (unsigned int) (n * (index + 1) / count);
+}
+
+#ifdef FREETYPE_GL_USE_THREADS
+// -------------------------------------------------- distance_field_thread ---
+static void *
+distance_field_thread( void * data ) {
+	distance_field_thread_t *thread = (distance_field_thread_t *) data;
+
+	thread->task( thread->data, thread->index, thread->count );
+	return NULL;
+}
+#endif
+
+// ----------------------------------------------------- distance_field_run ---
+/* Runs the count parts of some work with the executor of the context, or
+ * on threads of its own, the calling thread doing the first part and those
+ * no thread could be started for */
+static void
+distance_field_run( distance_field_t * self,
+					distance_field_task_t task,
+					void * data, size_t count ) {
+	size_t i, started = 0;
+
+	if ( count > 1 && self->executor ) {
+		self->executor( self->executor_data, task, data, count );
+		return;
+	}
+#ifdef FREETYPE_GL_USE_THREADS
+	if ( count > 1 ) {
+		distance_field_thread_t *threads = (distance_field_thread_t *)
+			malloc( (count - 1) * sizeof(distance_field_thread_t) );
+
+		while ( threads && started < count - 1 ) {
+			distance_field_thread_t *thread = threads + started;
+
+			thread->task = task;
+			thread->data = data;
+			thread->index = started + 1;
+			thread->count = count;
+			if ( pthread_create( &thread->thread, NULL, distance_field_thread, thread ) ) {
+				break;
+			}
+			started++;
+		}
+		task( data, 0, count );
+		for ( i = started + 1; i < count; ++i ) {
+			task( data, i, count );
+		}
+		for ( i = 0; i < started; ++i ) {
+			pthread_join( threads[i].thread, NULL );
+		}
+		free( threads );
+		return;
+	}
+#endif
+	for ( i = started; i < count; ++i ) {
+		task( data, i, count );
+	}
+}
+
+// --------------------------------------------- distance_field_edtaa3_task ---
+/* Distances to the background (0's) into outside for part 0, to the
+ * foreground (1's) into inside for part 1, with edtaa3 and the buffers of
+ * the part */
+static void
+distance_field_edtaa3_task( void * data,
+							size_t index, size_t count ) {
+	distance_field_job_t *job = (distance_field_job_t *) data;
+	distance_field_t *self = job->self, *part = distance_field_part( self, index );
+	size_t i, n = (size_t) job->width * job->height;
+
+	(void) count;
+	if ( index ) {
+		for ( i = 0; i < n; ++i )
+			part->data[i] = 1 - self->data[i];
+	}
+	memset( part->gx, 0, n * sizeof(float) );
+	memset( part->gy, 0, n * sizeof(float) );
+	computegradientf( part->data, job->width, job->height, part->gx, part->gy );
+	edtaa3f( part->data, part->gx, part->gy, job->width, job->height,
+			 part->distx, part->disty, index ? self->inside : self->outside );
+}
+
+// -------------------------------------------------- distance_field_edtaa3 ---
+/* Bipolar distance field of data into outside, with edtaa3: distances to
+ * the background (0's) then to the foreground (1's), both at once on two
+ * parts if the context splits its work */
+static void
+distance_field_edtaa3( distance_field_t * self,
+					   unsigned int width, unsigned int height ) {
+	size_t i, count = (size_t) width * height;
+	float *data = self->data, *outside = self->outside, *inside = self->inside;
+	distance_field_job_t job;
+
+	if ( distance_field_parts( self, height / DISTANCE_FIELD_PART_LINES < 2 ? 1 : 2,
+							   count, 1 ) == 2 ) {
+		job.self = self;
+		job.width = width;
+		job.height = height;
+		distance_field_run( self, distance_field_edtaa3_task, &job, 2 );
+		for ( i = 0; i < count; ++i )
+			outside[i] = (outside[i] < 0 ? 0 : outside[i]) - (inside[i] < 0 ? 0 : inside[i]);
+		return;
+	}
+
+	memset( self->gx, 0, count * sizeof(float) );
+	memset( self->gy, 0, count * sizeof(float) );
+	computegradientf( data, width, height, self->gx, self->gy );
+	edtaa3f( data, self->gx, self->gy, width, height, self->distx, self->disty, outside );
+
+	memset( self->gx, 0, count * sizeof(float) );
+	memset( self->gy, 0, count * sizeof(float) );
+	for ( i = 0; i < count; ++i )
+		data[i] = 1 - data[i];
+	computegradientf( data, width, height, self->gx, self->gy );
+	edtaa3f( data, self->gx, self->gy, width, height, self->distx, self->disty, inside );
+
+	for ( i = 0; i < count; ++i )
+		outside[i] = (outside[i] < 0 ? 0 : outside[i]) - (inside[i] < 0 ? 0 : inside[i]);
+}
+
+// ----------------------------------------------------- distance_field_edt ---
+/* Squared distance transform of a line of a grid, in place: the lower
+ * envelope of the parabolas rooted at each sample (Felzenszwalb and
+ * Huttenlocher). The offset from each sample to the root of its parabola
+ * is stored in offsets, along the same line. */
+static void
+distance_field_edt( distance_field_t * self,
+					float * grid, short * offsets,
+					size_t start, size_t stride, unsigned int n ) {
+	float *f = self->line, *z = self->bounds;
+	int *v = self->roots;
+	unsigned int q;
+	int k = 0, r;
+	float s;
+
+	for ( q = 0; q < n; ++q )
+		f[q] = grid[start + q * stride];
+
+	v[0] = 0;
+	z[0] = -DISTANCE_FIELD_FAR;
+	z[1] = +DISTANCE_FIELD_FAR;
+	for ( q = 1; q < n; ++q ) {
+		do {
+			r = v[k];
+			s = (f[q] - f[r] + (float) q * q - (float) r * r) / (2.0f * (q - r));
+		} while ( s <= z[k] && --k >= 0 );
+		k++;
+		v[k] = q;
+		z[k] = s;
+		z[k + 1] = +DISTANCE_FIELD_FAR;
+	}
+
+	for ( q = 0, k = 0; q < n; ++q ) {
+		while ( z[k + 1] < q )
+			k++;
+		r = v[k];
+		grid[start + q * stride] = ((float) q - r) * ((float) q - r) + f[r];
+		offsets[start + q * stride] = q - r;
+	}
+}
+
+// ------------------------------------------ distance_field_transform_task ---
+/* Band of rows (DISTANCE_JOB_ROWS, DISTANCE_JOB_EDGES) or of columns
+ * (DISTANCE_JOB_COLUMNS) of a step of distance_field_transform, with the
+ * line buffers of the part */
+static void
+distance_field_transform_task( void * data,
+							   size_t index, size_t count ) {
+	distance_field_job_t *job = (distance_field_job_t *) data;
+	distance_field_t *self = job->self, *part = distance_field_part( self, index );
+	short *dx = self->distx, *dy = self->disty;
+	unsigned int width = job->width, height = job->height, x, y, first, last;
+	float *dist = job->dist;
+	size_t i;
+
+	distance_field_band( job->step == DISTANCE_JOB_COLUMNS ? width : height,
+						 index, count, &first, &last );
+	switch ( job->step ) {
+	case DISTANCE_JOB_ROWS:
+		for ( y = first; y < last; ++y ) {
+			distance_field_edt( part, dist, dx, (size_t) y * width, 1, width );
+		}
+		break;
+	case DISTANCE_JOB_COLUMNS:
+		for ( x = first; x < last; ++x ) {
+			for ( y = 0; y < height; ++y ) {
+				part->offsets[y] = dx[(size_t) y * width + x];
+			}
+			distance_field_edt( part, dist, dy, x, width, height );
+			for ( y = 0; y < height; ++y ) {
+				i = (size_t) y * width + x;
+				dx[i] = part->offsets[y - dy[i]];
+			}
+		}
+		break;
+	default:
+		for ( i = (size_t) first * width; i < (size_t) last * width; ++i ) {
+			if ( dist[i] >= DISTANCE_FIELD_FAR / 2 ) {
+				dist[i] = 1000000.0f; // No object pixel at all
+			} else if ( !dx[i] && !dy[i] && self->data[i] >= 1 ) {
+				dist[i] = 0;
+			} else {
+				dist[i] = distaa3f( self->data, self->gx, self->gy, width, i,
+									dx[i], dy[i], dx[i], dy[i] );
+			}
+		}
+		break;
+	}
+}
+
+// ----------------------------------------------- distance_field_transform ---
+/* Distances to the object pixels (of coverage > 0) into dist, with the
+ * metric of edtaa3: the closest object pixel is found by an exact
+ * transform, then the distance from its center to the edge is estimated
+ * from its coverage. Where pixels at the same distance have different
+ * coverages, the closest is not the one of the nearest edge: one sweep of
+ * edtaa3 settles these. */
+static void
+distance_field_transform( distance_field_t * self,
+						  float * dist,
+						  unsigned int width, unsigned int height ) {
+	size_t i, parts, count = (size_t) width * height;
+	distance_field_job_t job;
+
+	parts = distance_field_parts( self, (width < height ? width : height) /
+								  DISTANCE_FIELD_PART_LINES,
+								  0, (width > height ? width : height) + 1 );
+	job.self = self;
+	job.dist = dist;
+	job.width = width;
+	job.height = height;
+
+	for ( i = 0; i < count; ++i )
+		dist[i] = self->data[i] > 0 ? 0 : DISTANCE_FIELD_FAR;
+
+	// Rows give the column offsets, columns the row offsets, after which
+	// the column offsets of the rows they point to are picked up
+	job.step = DISTANCE_JOB_ROWS;
+	distance_field_run( self, distance_field_transform_task, &job, parts );
+	job.step = DISTANCE_JOB_COLUMNS;
+	distance_field_run( self, distance_field_transform_task, &job, parts );
+	job.step = DISTANCE_JOB_EDGES;
+	distance_field_run( self, distance_field_transform_task, &job, parts );
+	edtaa3f_sweep( self->data, self->gx, self->gy, width, height,
+				   self->distx, self->disty, dist );
+}
+
+// -------------------------------------------------- distance_field_linear ---
+/* Bipolar distance field of data into outside, with the linear transform:
+ * distances to the background (0's) then to the foreground (1's). The
+ * gradient of the inverted image is the opposite, edgedf does not mind. */
+static void
+distance_field_linear( distance_field_t * self,
+					   unsigned int width, unsigned int height ) {
+	size_t i, count = (size_t) width * height;
+	float *outside = self->outside, *inside = self->inside;
+
+	memset( self->gx, 0, count * sizeof(float) );
+	memset( self->gy, 0, count * sizeof(float) );
+	computegradientf( self->data, width, height, self->gx, self->gy );
+	distance_field_transform( self, outside, width, height );
+	for ( i = 0; i < count; ++i )
+		self->data[i] = 1 - self->data[i];
+	distance_field_transform( self, inside, width, height );
+
+	for ( i = 0; i < count; ++i )
+		outside[i] = (outside[i] < 0 ? 0 : outside[i]) - (inside[i] < 0 ? 0 : inside[i]);
+}
+
+// ----------------------------------------------- distance_field_normalize ---
+/* Maps a bipolar distance field to bytes, clamped to the spread of the
+ * context or else to the deepest inside distance, inside pixels being over
+ * 127 */
+static void
+distance_field_normalize( distance_field_t * self,
+						  const float * outside,
+						  unsigned char * img,
+						  size_t count ) {
+	float vmin = FLT_MAX;
+	size_t i;
+
+	if ( self->spread > 0 ) {
+		for ( i = 0; i < count; ++i ) {
+			float v = 255 * (0.5f - outside[i] / (2 * self->spread)) + 0.5f;
+
+			img[i] = (unsigned char) (v < 0 ? 0 : v > 255 ? 255 : v);
+		}
+		return;
+	}
+
+	DISTANCE_FIELD_SIMD( i, distance_field_minf, outside, count, &vmin );
+	for ( ; i < count; ++i ) {
+		if ( outside[i] < vmin )
+			vmin = outside[i];
+	}
+	vmin = fabsf( vmin );
+	if ( vmin == 0 ) {
+		vmin = 1;
+	}
+
+	DISTANCE_FIELD_SIMD( i, distance_field_packf, outside, img, count, vmin );
+	for ( ; i < count; ++i ) {
+		float v = outside[i];
+
+		if ( v < -vmin ) v = -vmin;
+		else
+		if ( v > +vmin ) v = +vmin;
+		img[i] = (unsigned char) (255 * (1 - (v + vmin) / (2 * vmin)));
+	}
+}
+
+// ------------------------------------------------- distance_field_compute ---
+/* Bipolar distance field of an image into outside, with the transform of
+ * the context mode; returns 0 if the buffers could not be grown */
+static int
+distance_field_compute( distance_field_t * self,
+						const unsigned char * img,
+						unsigned int width, unsigned int height ) {
+	size_t count = (size_t) width * height;
+	unsigned char min, max;
+
+	// One more item in lines for the envelope bounds
+	if ( !distance_field_grow( self, count,
+							   (width > height ? width : height) + 1 ) ) {
+		return 0;
+	}
+
+	// Map values from 0 - 255 to 0.0 - 1.0, as make_distance_mapb does
+	distance_field_range( img, count, &min, &max );
+	distance_field_unpackf( img, self->data, count, min, max ? max : 1 );
+
+	if ( self->mode == DISTANCE_FIELD_LINEAR ) {
+		distance_field_linear( self, width, height );
+	} else {
+		distance_field_edtaa3( self, width, height );
+	}
+	return 1;
+}
+
+// ----------------------------------------------- distance_field_make_mapb ---
+unsigned char *
+distance_field_make_mapb( distance_field_t * self,
+						  unsigned char * img,
+						  unsigned int width, unsigned int height ) {
+	assert( self && img );
+
+	if ( !distance_field_compute( self, img, width, height ) ) {
+		return NULL;
+	}
+	distance_field_normalize( self, self->outside, img, (size_t) width * height );
+	return img;
+}
+
+// ---------------------------------------- distance_field_make_downsampled ---
+unsigned char *
+distance_field_make_downsampled( distance_field_t * self,
+								 unsigned char * img,
+								 unsigned int width, unsigned int height,
+								 unsigned int factor ) {
+	unsigned int columns, rows, x, y, i, j;
+
+	assert( self && img && factor > 0 );
+
+	if ( !distance_field_compute( self, img, width, height ) ) {
+		return NULL;
+	}
+
+	// Distances averaged over the samples of each pixel, in pixels of
+	// the field
+	columns = width / factor;
+	rows = height / factor;
+	for ( y = 0; y < rows; ++y ) {
+		for ( x = 0; x < columns; ++x ) {
+			const float *sample = self->outside + ((size_t) y * width + x) * factor;
+			float sum = 0;
+
+			for ( j = 0; j < factor; ++j ) {
+				for ( i = 0; i < factor; ++i ) {
+					sum += sample[(size_t) j * width + i];
+				}
+			}
+			self->inside[(size_t) y * columns + x] = sum / ((float) factor * factor * factor);
+		}
+	}
+	distance_field_normalize( self, self->inside, img, (size_t) columns * rows );
+	return img;
+}
+
+// ------------------------------------------------- distance_segment_point ---
+/* Point of a segment at parameter t */
+static void
+distance_segment_point( const distance_segment_t * segment,
+						double t,
+						double point[2] ) {
+	const float (*p)[2] = segment->p;
+	double s = 1 - t;
+	int k;
+
+	for ( k = 0; k < 2; ++k ) {
+		switch ( segment->degree ) {
+		case 1:
+			point[k] = s * p[0][k] + t * p[1][k];
+			break;
+		case 2:
+			point[k] = s * s * p[0][k] + 2 * s * t * p[1][k] + t * t * p[2][k];
+			break;
+		default:
+			point[k] = s * s * s * p[0][k] + 3 * s * s * t * p[1][k] +
+				3 * s * t * t * p[2][k] + t * t * t * p[3][k];
+			break;
+		}
+	}
+}
+
+// ------------------------------------------------- distance_segment_bound ---
+/* Box of the control points of a segment, which holds the segment */
+static void
+distance_segment_bound( distance_segment_t * segment ) {
+	int i;
+
+	segment->box[0] = segment->box[2] = segment->p[0][0];
+	segment->box[1] = segment->box[3] = segment->p[0][1];
+	for ( i = 1; i <= segment->degree; ++i ) {
+		float x = segment->p[i][0], y = segment->p[i][1];
+
+		if ( x < segment->box[0] ) segment->box[0] = x;
+		if ( y < segment->box[1] ) segment->box[1] = y;
+		if ( x > segment->box[2] ) segment->box[2] = x;
+		if ( y > segment->box[3] ) segment->box[3] = y;
+	}
+}
+
+// --------------------------------------------- distance_segment_direction ---
+/* Direction of a segment at parameter t, not normalized. Where a control
+ * point lies on an end, the curve leaves it towards the next one. */
+static void
+distance_segment_direction( const distance_segment_t * segment,
+							double t,
+							double direction[2] ) {
+	const float (*p)[2] = segment->p;
+	double s = 1 - t;
+	int k;
+
+	for ( k = 0; k < 2; ++k ) {
+		switch ( segment->degree ) {
+		case 1:
+			direction[k] = p[1][k] - p[0][k];
+			break;
+		case 2:
+			direction[k] = s * (p[1][k] - p[0][k]) + t * (p[2][k] - p[1][k]);
+			break;
+		default:
+			direction[k] = s * s * (p[1][k] - p[0][k]) + 2 * s * t * (p[2][k] - p[1][k]) +
+				t * t * (p[3][k] - p[2][k]);
+			break;
+		}
+	}
+	if ( direction[0] == 0 && direction[1] == 0 && segment->degree > 1 ) {
+		for ( k = 0; k < 2; ++k ) {
+			direction[k] = t < 0.5 ? p[2][k] - p[0][k]
+								   : p[segment->degree][k] - p[segment->degree - 2][k];
+		}
+	}
+}
+
+// ------------------------------------------------- distance_segment_split ---
+/* Splits a segment at parameter t into two of the same degree (de
+ * Casteljau) */
+static void
+distance_segment_split( const distance_segment_t * segment,
+						double t,
+						distance_segment_t * first,
+						distance_segment_t * second ) {
+	float p[4][2];
+	int i, j, k, n = segment->degree;
+
+	memcpy( p, segment->p, sizeof(p) );
+	*first = *second = *segment;
+	for ( j = 1; j <= n; ++j ) {
+		for ( i = 0; i <= n - j; ++i ) {
+			for ( k = 0; k < 2; ++k ) {
+				p[i][k] = (float) ((1 - t) * p[i][k] + t * p[i + 1][k]);
+			}
+		}
+		for ( k = 0; k < 2; ++k ) {
+			first->p[j][k] = p[0][k];
+			second->p[n - j][k] = p[n - j][k];
+		}
+	}
+	distance_segment_bound( first );
+	distance_segment_bound( second );
+}
+
+// --------------------------------------------- distance_field_cubic_roots ---
+/* Real roots of a t^3 + b t^2 + c t + d, the leading coefficients possibly
+ * vanishing */
+static int
+distance_field_cubic_roots( double a, double b, double c, double d,
+							double t[3] ) {
+	double q, r, q3, r2, u, v;
+
+	if ( fabs( a ) < 1e-9 ) {
+		if ( fabs( b ) < 1e-9 ) {
+			if ( fabs( c ) < 1e-9 ) {
+				return 0;
+			}
+			t[0] = -d / c;
+			return 1;
+		}
+		q = c * c - 4 * b * d;
+		if ( q < 0 ) {
+			return 0;
+		}
+		q = sqrt( q );
+		t[0] = (-c + q) / (2 * b);
+		t[1] = (-c - q) / (2 * b);
+		return 2;
+	}
+
+	b /= a;
+	c /= a;
+	d /= a;
+	q = (b * b - 3 * c) / 9;
+	r = (b * (2 * b * b - 9 * c) + 27 * d) / 54;
+	q3 = q * q * q;
+	r2 = r * r;
+	b /= 3;
+	if ( r2 < q3 ) {
+		u = r / sqrt( q3 );
+		u = acos( u < -1 ? -1 : u > 1 ? 1 : u );
+		q = -2 * sqrt( q );
+		t[0] = q * cos( u / 3 ) - b;
+		t[1] = q * cos( (u + 2 * M_PI) / 3 ) - b;
+		t[2] = q * cos( (u - 2 * M_PI) / 3 ) - b;
+		return 3;
+	}
+	u = -cbrt( fabs( r ) + sqrt( r2 - q3 ) );
+	if ( r < 0 ) {
+		u = -u;
+	}
+	v = u == 0 ? 0 : q / u;
+	t[0] = u + v - b;
+	t[1] = -(u + v) / 2 - b;
+	return 2;
+}
+
+// ---------------------------------------------- distance_segment_distance ---
+/* Squared distance from a point to a segment, and the parameter of the
+ * closest point: that of a line is a projection, that of a conic a root of
+ * the derivative of the squared distance, a cubic, and that of a cubic is
+ * refined by Newton iterations from points spread along it. */
+static double
+distance_segment_distance( const distance_segment_t * segment,
+						   double x, double y,
+						   double * param ) {
+	const float (*p)[2] = segment->p;
+	double t[8], point[2], best = DBL_MAX;
+	double qx = p[0][0] - x, qy = p[0][1] - y;
+	double ax = p[1][0] - p[0][0], ay = p[1][1] - p[0][1];
+	int i, j, n = 0;
+
+	if ( segment->degree == 1 ) {
+		double length = ax * ax + ay * ay;
+
+		if ( length > 0 ) {
+			t[n++] = -(qx * ax + qy * ay) / length;
+		}
+	} else if ( segment->degree == 2 ) {
+		double bx = p[2][0] - 2 * p[1][0] + p[0][0];
+		double by = p[2][1] - 2 * p[1][1] + p[0][1];
+
+		n = distance_field_cubic_roots( bx * bx + by * by,
+										3 * (ax * bx + ay * by),
+										2 * (ax * ax + ay * ay) + qx * bx + qy * by,
+										qx * ax + qy * ay, t );
+	} else {
+		double bx = p[2][0] - 2 * p[1][0] + p[0][0];
+		double by = p[2][1] - 2 * p[1][1] + p[0][1];
+		double cx = p[3][0] - 3 * p[2][0] + 3 * p[1][0] - p[0][0];
+		double cy = p[3][1] - 3 * p[2][1] + 3 * p[1][1] - p[0][1];
+
+		for ( i = 0; i <= 4; ++i ) {
+			double u = i / 4.0;
+
+			for ( j = 0; j < 4; ++j ) {
+				double ex = qx + u * (3 * ax + u * (3 * bx + u * cx));
+				double ey = qy + u * (3 * ay + u * (3 * by + u * cy));
+				double dx = 3 * ax + u * (6 * bx + u * 3 * cx);
+				double dy = 3 * ay + u * (6 * by + u * 3 * cy);
+				double f = ex * dx + ey * dy;
+				double df = dx * dx + dy * dy + ex * (6 * bx + 6 * u * cx) + ey * (6 * by + 6 * u * cy);
+
+				if ( df <= 0 ) {
+					break;
+				}
+				u -= f / df;
+				u = u < 0 ? 0 : u > 1 ? 1 : u;
+			}
+			t[n++] = u;
+		}
+	}
+	t[n++] = 0;
+	t[n++] = 1;
+
+	for ( i = 0; i < n; ++i ) {
+		double d;
+
+		if ( t[i] < 0 || t[i] > 1 ) {
+			continue;
+		}
+		distance_segment_point( segment, t[i], point );
+		d = (point[0] - x) * (point[0] - x) + (point[1] - y) * (point[1] - y);
+		if ( d < best ) {
+			best = d;
+			*param = t[i];
+		}
+	}
+	return best;
+}
+
+// ------------------------------------------------- distance_field_segment ---
+/* Appends a segment from the last point of the outline through the given
+ * points, and the edges it is flattened into */
+static int
+distance_field_segment( distance_outline_t * outline,
+						int degree,
+						const FT_Vector ** points ) {
+	distance_field_t *self = outline->self;
+	distance_segment_t segment;
+	distance_edge_t edge;
+	double point[2];
+	float length = 0;
+	int i, n;
+
+	segment.degree = degree;
+	segment.contour = outline->contour;
+	segment.color = DISTANCE_WHITE;
+	segment.p[0][0] = outline->last[0];
+	segment.p[0][1] = outline->last[1];
+	for ( i = 1; i <= degree; ++i ) {
+		segment.p[i][0] = points[i - 1]->x / 64.0f - outline->left;
+		segment.p[i][1] = outline->top - points[i - 1]->y / 64.0f;
+		length += hypotf( segment.p[i][0] - segment.p[i - 1][0],
+						  segment.p[i][1] - segment.p[i - 1][1] );
+	}
+	// Points, which closing contours may give, have no direction
+	if ( length == 0 ) {
+		return 0;
+	}
+	distance_segment_bound( &segment );
+	vector_push_back( self->segments, &segment );
+
+	// Curves are flattened into pieces about a pixel long, which only
+	// stray from them by a fraction of a pixel: the winding may only be
+	// wrong that close to the outline, where distances are about 0
+	n = degree == 1 ? 1 : (int) ceilf( length );
+	n = n < 1 ? 1 : n > 64 ? 64 : n;
+	edge.x0 = segment.p[0][0];
+	edge.y0 = segment.p[0][1];
+	for ( i = 1; i <= n; ++i ) {
+		distance_segment_point( &segment, (double) i / n, point );
+		edge.x1 = (float) point[0];
+		edge.y1 = (float) point[1];
+		if ( edge.y0 != edge.y1 ) {
+			vector_push_back( self->edges, &edge );
+		}
+		edge.x0 = edge.x1;
+		edge.y0 = edge.y1;
+	}
+
+	outline->last[0] = segment.p[degree][0];
+	outline->last[1] = segment.p[degree][1];
+	return 0;
+}
+
+// ------------------------------------------------- distance_field_move_to ---
+static int
+distance_field_move_to( const FT_Vector * to,
+						void * user ) {
+	distance_outline_t *outline = (distance_outline_t *) user;
+
+	outline->contour++;
+	outline->last[0] = to->x / 64.0f - outline->left;
+	outline->last[1] = outline->top - to->y / 64.0f;
+	return 0;
+}
+
+// ------------------------------------------------- distance_field_line_to ---
+static int
+distance_field_line_to( const FT_Vector * to,
+						void * user ) {
+	return distance_field_segment( (distance_outline_t *) user, 1, &to );
+}
+
+// ------------------------------------------------ distance_field_conic_to ---
+static int
+distance_field_conic_to( const FT_Vector * control,
+						 const FT_Vector * to,
+						 void * user ) {
+	const FT_Vector *points[2] = { control, to };
+
+	return distance_field_segment( (distance_outline_t *) user, 2, points );
+}
+
+// ------------------------------------------------ distance_field_cubic_to ---
+static int
+distance_field_cubic_to( const FT_Vector * control1,
+						 const FT_Vector * control2,
+						 const FT_Vector * to,
+						 void * user ) {
+	const FT_Vector *points[3] = { control1, control2, to };
+
+	return distance_field_segment( (distance_outline_t *) user, 3, points );
+}
+
+// ----------------------------------------------- distance_field_decompose ---
+/* Decomposes an outline into the segments and edges of a context */
+static int
+distance_field_decompose( distance_field_t * self,
+						  const struct FT_Outline_ * outline,
+						  float left, float top ) {
+	FT_Outline_Funcs funcs = { distance_field_move_to, distance_field_line_to,
+							   distance_field_conic_to, distance_field_cubic_to, 0, 0 };
+	distance_outline_t decomposed;
+	FT_Error error;
+
+	if ( !self->segments ) {
+		self->segments = vector_new( sizeof(distance_segment_t) );
+		self->edges = vector_new( sizeof(distance_edge_t) );
+		self->crossings = vector_new( sizeof(distance_crossing_t) );
+	}
+	if ( !self->segments || !self->edges || !self->crossings ) {
+		return 0;
+	}
+	vector_clear( self->segments );
+	vector_clear( self->edges );
+
+	decomposed.self = self;
+	decomposed.left = left;
+	decomposed.top = top;
+	decomposed.last[0] = decomposed.last[1] = 0;
+	decomposed.contour = 0;
+	error = FT_Outline_Decompose( (FT_Outline *) outline, &funcs, &decomposed );
+	if ( error ) {
+		freetype_error( error, "FT_Error (%s:%d, code 0x%02x) : %s\n",
+			__FILENAME__, __LINE__, FT_Errors[error].code, FT_Errors[error].message);
+		return 0;
+	}
+	return 1;
+}
+
+// --------------------------------------- distance_field_compare_crossings ---
+static int
+distance_field_compare_crossings( const void * a,
+								  const void * b ) {
+	float xa = ((const distance_crossing_t *) a)->x;
+	float xb = ((const distance_crossing_t *) b)->x;
+
+	return xa < xb ? -1 : xa > xb;
+}
+
+// ----------------------------------------------- distance_field_cross_row ---
+/* Crossings of the edges with the row at ordinate y, from left to right */
+static void
+distance_field_cross_row( distance_field_t * self,
+						  vector_t * crossings,
+						  float y ) {
+	const distance_edge_t *edges = (const distance_edge_t *) self->edges->items;
+	size_t i, count = vector_size( self->edges );
+
+	vector_clear( crossings );
+	for ( i = 0; i < count; ++i ) {
+		const distance_edge_t *edge = edges + i;
+		distance_crossing_t crossing;
+
+		if ( (edge->y0 <= y) != (edge->y1 <= y) ) {
+			crossing.x = edge->x0 + (y - edge->y0) * (edge->x1 - edge->x0) / (edge->y1 - edge->y0);
+			crossing.winding = edge->y1 > edge->y0 ? 1 : -1;
+			vector_push_back( crossings, &crossing );
+		}
+	}
+	if ( vector_size( crossings ) > 1 ) {
+		vector_sort( crossings, distance_field_compare_crossings );
+	}
+}
+
+// -------------------------------------------- distance_field_outline_rows ---
+/* Signed distances to the segments of the pixels of rows first to last - 1
+ * into dist, positive outside. A pixel lies inside when the edges crossing
+ * its row on its left wind around it, as the fill rule decides. Rows only
+ * share the segments and edges, each needs its own crossings. */
+static void
+distance_field_outline_rows( distance_field_t * self,
+							 vector_t * crossings,
+							 float * dist,
+							 unsigned int width,
+							 unsigned int first, unsigned int last,
+							 int even_odd ) {
+	const distance_segment_t *segments = (const distance_segment_t *) self->segments->items;
+	size_t count = vector_size( self->segments );
+	size_t i, k;
+	unsigned int x, y;
+
+	for ( y = first; y < last; ++y ) {
+		const distance_crossing_t *crossing;
+		float py = y + 0.5f;
+		double d = DBL_MAX;
+		int winding = 0;
+
+		distance_field_cross_row( self, crossings, py );
+		crossing = (const distance_crossing_t *) crossings->items;
+
+		for ( x = 0, k = 0; x < width; ++x ) {
+			float px = x + 0.5f;
+			// A pixel is at most one further from the outline than the
+			// previous one, segments further away can be skipped
+			double best = d == DBL_MAX ? DBL_MAX : (d + 1) * (d + 1);
+			int inside;
+
+			for ( i = 0; i < count; ++i ) {
+				const float *box = segments[i].box;
+				double bx = px < box[0] ? box[0] - px : px > box[2] ? px - box[2] : 0;
+				double by = py < box[1] ? box[1] - py : py > box[3] ? py - box[3] : 0;
+
+				if ( bx * bx + by * by < best ) {
+					double t, e = distance_segment_distance( segments + i, px, py, &t );
+
+					if ( e < best ) {
+						best = e;
+					}
+				}
+			}
+			d = best == DBL_MAX ? DBL_MAX : sqrt( best );
+
+			while ( k < vector_size( crossings ) && crossing[k].x < px ) {
+				winding += crossing[k++].winding;
+			}
+			inside = even_odd ? winding & 1 : winding != 0;
+			if ( d == DBL_MAX ) {
+				dist[(size_t) y * width + x] = 1000000.0f; // No outline at all
+			} else {
+				dist[(size_t) y * width + x] = inside ? (float) -d : (float) d;
+			}
+		}
+	}
+}
+
+// -------------------------------------------- distance_field_outline_task ---
+/* Band of rows of distance_field_make_outline */
+static void
+distance_field_outline_task( void * data,
+							 size_t index, size_t count ) {
+	distance_field_job_t *job = (distance_field_job_t *) data;
+	unsigned int first, last;
+
+	distance_field_band( job->height, index, count, &first, &last );
+	distance_field_outline_rows( job->self, distance_field_part( job->self, index )->crossings,
+								 job->dist, job->width, first, last, job->even_odd );
+}
+
+// -------------------------------------------- distance_field_make_outline ---
+unsigned char *
+distance_field_make_outline( distance_field_t * self,
+							 const struct FT_Outline_ * outline,
+							 unsigned char * img,
+							 unsigned int width, unsigned int height,
+							 float left, float top ) {
+	size_t count = (size_t) width * height;
+	distance_field_job_t job;
+
+	assert( self && outline && img );
+
+	if ( !distance_field_grow( self, count, 1 ) ||
+		 !distance_field_decompose( self, outline, left, top ) ) {
+		return NULL;
+	}
+	job.self = self;
+	job.dist = self->outside;
+	job.width = width;
+	job.height = height;
+	job.even_odd = outline->flags & FT_OUTLINE_EVEN_ODD_FILL;
+	distance_field_run( self, distance_field_outline_task, &job,
+						distance_field_parts( self, height / DISTANCE_FIELD_PART_LINES, 0, 0 ) );
+	distance_field_normalize( self, self->outside, img, count );
+	return img;
+}
+
+// -------------------------------------------- distance_field_switch_color ---
+/* Color of the edges after a corner, other than the banned one: edges
+ * meeting at a corner share a single channel */
+static int
+distance_field_switch_color( int color,
+							 int banned ) {
+	int combined = color & banned;
+
+	if ( combined == DISTANCE_RED || combined == DISTANCE_GREEN || combined == DISTANCE_BLUE ) {
+		return combined ^ DISTANCE_WHITE;
+	}
+	if ( color == DISTANCE_WHITE ) {
+		return DISTANCE_CYAN;
+	}
+	color <<= 1;
+	return (color | color >> 3) & DISTANCE_WHITE;
+}
+
+// ----------------------------------------------- distance_field_is_corner ---
+/* Whether a segment leaves the end of the previous one at an angle */
+static int
+distance_field_is_corner( const distance_segment_t * previous,
+						  const distance_segment_t * segment ) {
+	double a[2], b[2], length;
+
+	distance_segment_direction( previous, 1, a );
+	distance_segment_direction( segment, 0, b );
+	length = hypot( a[0], a[1] ) * hypot( b[0], b[1] );
+	if ( length == 0 ) {
+		return 0;
+	}
+	return a[0] * b[0] + a[1] * b[1] <= 0 ||
+		fabs( a[0] * b[1] - a[1] * b[0] ) > DISTANCE_CORNER * length;
+}
+
+// --------------------------------------------- distance_field_color_edges ---
+/* Colors the segments of each contour so that those meeting at a corner
+ * share one channel only, which the median of the channels then keeps
+ * sharp: the simple edge coloring of Chlumsky's msdfgen. Smooth contours
+ * stay white, and the segments of a contour with a single corner are
+ * split until there are three to color. */
+static void
+distance_field_color_edges( distance_field_t * self ) {
+	distance_segment_t *segments, pieces[4];
+	size_t begin, end, i, m, start, corners;
+	int color, initial, spline;
+
+	for ( begin = 0; begin < vector_size( self->segments ); begin = end ) {
+		segments = (distance_segment_t *) self->segments->items;
+		for ( end = begin + 1; end < vector_size( self->segments ) &&
+				  segments[end].contour == segments[begin].contour; ++end ) {
+		}
+		m = end - begin;
+
+		for ( i = 0, start = 0, corners = 0; i < m; ++i ) {
+			if ( distance_field_is_corner( segments + begin + (i + m - 1) % m,
+										   segments + begin + i ) ) {
+				start = corners++ ? start : i;
+			}
+		}
+
+		if ( corners == 1 ) {
+			const int colors[3] = { DISTANCE_CYAN, DISTANCE_WHITE, DISTANCE_MAGENTA };
+
+			if ( m == 1 ) {
+				distance_segment_split( segments + begin, 1 / 3.0, pieces, pieces + 1 );
+				distance_segment_split( pieces + 1, 0.5, pieces + 1, pieces + 2 );
+				vector_set( self->segments, begin, pieces );
+				vector_insert( self->segments, begin + 1, pieces + 1 );
+				vector_insert( self->segments, begin + 2, pieces + 2 );
+			} else if ( m == 2 ) {
+				distance_segment_split( segments + begin, 0.5, pieces, pieces + 1 );
+				distance_segment_split( segments + begin + 1, 0.5, pieces + 2, pieces + 3 );
+				vector_set( self->segments, begin, pieces );
+				vector_set( self->segments, begin + 1, pieces + 1 );
+				vector_insert( self->segments, begin + 2, pieces + 2 );
+				vector_insert( self->segments, begin + 3, pieces + 3 );
+				start *= 2;
+			}
+			segments = (distance_segment_t *) self->segments->items;
+			m = m < 3 ? m + 2 : m;
+			end = begin + m;
+			for ( i = 0; i < m; ++i ) {
+				segments[begin + (start + i) % m].color =
+					colors[(int) (3 + 2.875 * i / (m - 1) - 0.9375) - 2];
+			}
+		} else if ( corners > 1 ) {
+			color = initial = distance_field_switch_color( DISTANCE_WHITE, 0 );
+			for ( i = 0, spline = 0; i < m; ++i ) {
+				size_t index = begin + (start + i) % m;
+
+				if ( i && distance_field_is_corner( segments + begin + (start + i + m - 1) % m,
+													segments + index ) ) {
+					++spline;
+					color = distance_field_switch_color(
+						color, spline == (int) corners - 1 ? initial : 0 );
+				}
+				segments[index].color = color;
+			}
+		}
+	}
+}
+
+// ------------------------------------------------ distance_segment_pseudo ---
+/* Signed distance from a point to a segment whose closest point is at
+ * parameter t and distance d, positive on the left of the segment. Past
+ * the ends of the segment, the distance to its tangent there is taken
+ * instead when it is closer, so that the edges of a corner stay straight
+ * in the field. */
+static double
+distance_segment_pseudo( const distance_segment_t * segment,
+						 double t, double d,
+						 double x, double y ) {
+	double point[2], direction[2], length, qx, qy, cross, along;
+
+	distance_segment_point( segment, t, point );
+	distance_segment_direction( segment, t, direction );
+	length = hypot( direction[0], direction[1] );
+	if ( length == 0 ) {
+		return d;
+	}
+	qx = x - point[0];
+	qy = y - point[1];
+	cross = (direction[0] * qy - direction[1] * qx) / length;
+	along = (direction[0] * qx + direction[1] * qy) / length;
+	if ( ((t == 0 && along < 0) || (t == 1 && along > 0)) && fabs( cross ) <= d ) {
+		return cross;
+	}
+	return cross < 0 ? -d : d;
+}
+
+// ----------------------------------------------- distance_field_msdf_rows ---
+/* Multi-channel distances of the pixels of rows first to last - 1 into
+ * img, three bytes a pixel. Each channel holds the signed distance to the
+ * closest segment of its color, ties going to the segment the point is
+ * most square to. Where the median of the channels puts a pixel on the
+ * wrong side of the outline, as its winding tells, all channels take the
+ * true distance instead. */
+static void
+distance_field_msdf_rows( distance_field_t * self,
+						  vector_t * crossings,
+						  unsigned char * img,
+						  unsigned int width,
+						  unsigned int first, unsigned int last,
+						  int even_odd, double orientation, float range ) {
+	const distance_segment_t *segments = (const distance_segment_t *) self->segments->items;
+	size_t count = vector_size( self->segments );
+	size_t i, k;
+	unsigned int x, y;
+	int c;
+
+	for ( y = first; y < last; ++y ) {
+		const distance_crossing_t *crossing;
+		float py = y + 0.5f;
+		int winding = 0;
+
+		distance_field_cross_row( self, crossings, py );
+		crossing = (const distance_crossing_t *) crossings->items;
+
+		for ( x = 0, k = 0; x < width; ++x ) {
+			float px = x + 0.5f;
+			double best[3] = { DBL_MAX, DBL_MAX, DBL_MAX }, dots[3] = { 1, 1, 1 };
+			double params[3] = { 0, 0, 0 }, v[3];
+			double d, median;
+			int owners[3] = { -1, -1, -1 }, inside;
+			unsigned char *pixel = img + ((size_t) y * width + x) * 3;
+
+			for ( i = 0; i < count; ++i ) {
+				const distance_segment_t *segment = segments + i;
+				const float *box = segment->box;
+				double bx = px < box[0] ? box[0] - px : px > box[2] ? px - box[2] : 0;
+				double by = py < box[1] ? box[1] - py : py > box[3] ? py - box[3] : 0;
+				double bound = 0, t, e, dot, point[2], direction[2], length;
+
+				for ( c = 0; c < 3; ++c ) {
+					if ( (segment->color >> c & 1) && best[c] > bound ) {
+						bound = best[c];
+					}
+				}
+				if ( bound < DBL_MAX && bx * bx + by * by > bound * bound ) {
+					continue;
+				}
+
+				e = sqrt( distance_segment_distance( segment, px, py, &t ) );
+				distance_segment_point( segment, t, point );
+				distance_segment_direction( segment, t, direction );
+				length = hypot( direction[0], direction[1] ) * e;
+				dot = length > 0 ? fabs( direction[0] * (point[0] - px) +
+										 direction[1] * (point[1] - py) ) / length : 0;
+				for ( c = 0; c < 3; ++c ) {
+					if ( (segment->color >> c & 1) &&
+						 (e < best[c] || (e == best[c] && dot < dots[c])) ) {
+						best[c] = e;
+						dots[c] = dot;
+						params[c] = t;
+						owners[c] = (int) i;
+					}
+				}
+			}
+
+			while ( k < vector_size( crossings ) && crossing[k].x < px ) {
+				winding += crossing[k++].winding;
+			}
+			inside = even_odd ? winding & 1 : winding != 0;
+
+			d = DBL_MAX;
+			for ( c = 0; c < 3; ++c ) {
+				if ( owners[c] < 0 ) {
+					v[c] = 1000000.0; // No outline at all
+				} else {
+					v[c] = orientation * distance_segment_pseudo( segments + owners[c],
+																  params[c], best[c], px, py );
+				}
+				d = best[c] < d ? best[c] : d;
+			}
+			median = fmax( fmin( v[0], v[1] ), fmin( fmax( v[0], v[1] ), v[2] ) );
+			if ( d < DBL_MAX && (median < 0) != inside ) {
+				v[0] = v[1] = v[2] = inside ? -d : d;
+			}
+
+			for ( c = 0; c < 3; ++c ) {
+				double value = 255 * (0.5 - v[c] / range) + 0.5;
+
+				pixel[c] = (unsigned char) (value < 0 ? 0 : value > 255 ? 255 : value);
+			}
+		}
+	}
+}
+
+// ----------------------------------------------- distance_field_msdf_task ---
+/* Band of rows of distance_field_make_msdf */
+static void
+distance_field_msdf_task( void * data,
+						  size_t index, size_t count ) {
+	distance_field_job_t *job = (distance_field_job_t *) data;
+	unsigned int first, last;
+
+	distance_field_band( job->height, index, count, &first, &last );
+	distance_field_msdf_rows( job->self, distance_field_part( job->self, index )->crossings,
+							  job->img, job->width, first, last, job->even_odd,
+							  job->orientation, job->range );
+}
+
+// ----------------------------------------------- distance_field_make_msdf ---
+unsigned char *
+distance_field_make_msdf( distance_field_t * self,
+						  const struct FT_Outline_ * outline,
+						  unsigned char * img,
+						  unsigned int width, unsigned int height,
+						  float left, float top, float range ) {
+	distance_field_job_t job;
+
+	assert( self && outline && img && range > 0 );
+
+	if ( !distance_field_decompose( self, outline, left, top ) ) {
+		return NULL;
+	}
+	distance_field_color_edges( self );
+
+	// Filled contours turn one way or the other, and y points down here
+	job.orientation = FT_Outline_Get_Orientation( (FT_Outline *) outline ) ==
+		FT_ORIENTATION_POSTSCRIPT ? 1 : -1;
+	job.self = self;
+	job.img = img;
+	job.width = width;
+	job.height = height;
+	job.even_odd = outline->flags & FT_OUTLINE_EVEN_ODD_FILL;
+	job.range = range;
+	distance_field_run( self, distance_field_msdf_task, &job,
+						distance_field_parts( self, height / DISTANCE_FIELD_PART_LINES, 0, 0 ) );
+	return img;
+}
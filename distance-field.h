@@ -6,6 +6,12 @@
 #ifndef __DISTANCE_FIELD_H__
 #define __DISTANCE_FIELD_H__
 
+#include <stddef.h>
+#include "vector.h"
+
+/* FreeType outlines, declared here not to require the FreeType headers */
+struct FT_Outline_;
+
 #ifdef __cplusplus
 extern "C" {
 namespace ftgl {
@@ -35,6 +41,15 @@ namespace ftgl {
  * }
  * @endcode
  *
+ * The gradient, conversion and normalization loops run vectorized with
+ * the instruction set platform_simd() picks at run time (SSE2 or AVX2 on
+ * x86, NEON on 64 bit ARM, see platform.h), the sweeps of edtaa3 staying
+ * scalar. The vectorized loops do the same operations in the same order as
+ * the scalar ones, without fused multiply-adds: their distance fields are
+ * the same, byte for byte. Only where the compiler fuses the multiplies and
+ * adds of the scalar gradient (as on ARM, or with -ffp-contract=fast and an
+ * FMA target) may they differ, by one level at most.
+ *
  * @{
  */
 
@@ -57,6 +72,272 @@ unsigned char *
 make_distance_mapb( unsigned char *img,
 					unsigned int width, unsigned int height );
 
+/**
+ * Distance transforms a distance field context computes with
+ */
+typedef enum distance_field_mode_t {
+	/**
+	 * edtaa3, which sweeps the image until distances stop changing: its
+	 * time depends on the shape. The default.
+	 */
+	DISTANCE_FIELD_EDTAA3,
+
+	/**
+	 * Exact distance transform in linear time (Felzenszwalb and
+	 * Huttenlocher) to the closest object pixel, whose coverage then
+	 * gives the sub-pixel distance to the edge as in edtaa3, followed by a
+	 * single sweep of edtaa3 for pixels whose closest edge is not that of
+	 * the closest pixel. Its time only depends on the image size, and the
+	 * fields differ from those of edtaa3 by a few levels at most (see
+	 * demos/benchmark-sdf.c).
+	 */
+	DISTANCE_FIELD_LINEAR,
+
+	/**
+	 * Exact distances to the outline of a glyph instead of its bitmap (see
+	 * distance_field_make_outline), so that small fields do not lose the
+	 * precision of the bitmap. Fields of images, which have no outline,
+	 * are computed with edtaa3.
+	 */
+	DISTANCE_FIELD_OUTLINE
+} distance_field_mode_t;
+
+/**
+ * Part of a distance field computation split into count parts: does part
+ * index of the work data describes. Parts are independent of each other.
+ */
+typedef void (*distance_field_task_t)( void * data, size_t index, size_t count );
+
+/**
+ * Runs a distance field computation split into parts, as a job system
+ * would: calls task( data, index, count ) for every index of [0, count),
+ * in any order and on any threads, and returns once all calls returned.
+ *
+ * @param user   The executor_data of the context
+ * @param task   The task to run on each part
+ * @param data   The work the parts belong to
+ * @param count  The number of parts, 2 or more
+ */
+typedef void (*distance_field_executor_t)( void * user,
+										   distance_field_task_t task,
+										   void * data, size_t count );
+
+/**
+ * Scratch buffers of distance field computations, kept from one image to
+ * the next. The buffers are allocated at once and only grow, and they are
+ * single precision, which is plenty for a distance field stored on 8 bits.
+ * A context is not thread safe, each thread needs its own.
+ *
+ * A context with threads above 1 splits the work on an image into as many
+ * parts, run by its executor or on threads of its own: bands of rows for
+ * DISTANCE_FIELD_OUTLINE and multi-channel fields, bands of rows then of
+ * columns for the passes of DISTANCE_FIELD_LINEAR (whose final sweep stays
+ * on the calling thread), the distances outside and inside for
+ * DISTANCE_FIELD_EDTAA3. The fields are the same whatever the split, which
+ * only happens for images of 16 rows a part or more.
+ */
+typedef struct distance_field_t {
+	/**
+	 * Distance transform to use, DISTANCE_FIELD_EDTAA3 by default
+	 */
+	distance_field_mode_t mode;
+
+	/**
+	 * Distance in pixels from the edge to the bytes 0 (outside) and 255
+	 * (inside), the edge being at 127.5, so that all fields share a scale
+	 * and a single threshold; 0 (the default) scales each field to its
+	 * deepest inside distance instead
+	 */
+	float spread;
+
+	/**
+	 * Number of pixels the buffers have room for
+	 */
+	size_t capacity;
+
+	/**
+	 * Number of times the buffers were allocated, for statistics
+	 */
+	size_t allocations;
+
+	/**
+	 * Offsets to the closest edge pixels
+	 */
+	short * distx;
+	short * disty;
+
+	/**
+	 * Normalized image, edge gradients and distances outside and inside
+	 */
+	float * data;
+	float * gx;
+	float * gy;
+	float * outside;
+	float * inside;
+
+	/**
+	 * Number of items the line buffers have room for
+	 */
+	size_t line_capacity;
+
+	/**
+	 * Line buffers of DISTANCE_FIELD_LINEAR: squared distances, bounds
+	 * and roots of the parabolas of the lower envelope, and offsets to
+	 * the closest object pixels
+	 */
+	float * line;
+	float * bounds;
+	int * roots;
+	short * offsets;
+
+	/**
+	 * Segments of the outline of distance_field_make_outline and
+	 * distance_field_make_msdf, edges of the polygon they are flattened
+	 * into, and crossings of a pixel row with these edges (see
+	 * distance-field.c)
+	 */
+	vector_t * segments;
+	vector_t * edges;
+	vector_t * crossings;
+
+	/**
+	 * Number of parts the work on an image is split into, 0 or 1 for
+	 * all of it on the calling thread
+	 */
+	int threads;
+
+	/**
+	 * Runs the parts, NULL to run them on threads of the context (when
+	 * built with FREETYPE_GL_USE_THREADS, on the calling thread otherwise)
+	 */
+	distance_field_executor_t executor;
+
+	/**
+	 * User data of the executor
+	 */
+	void * executor_data;
+
+	/**
+	 * Contexts holding the scratch buffers of the parts after the first,
+	 * which uses the buffers above
+	 */
+	struct distance_field_t * parts;
+	size_t part_count;
+} distance_field_t;
+
+/**
+ * Creates an empty distance field context, the buffers are allocated by
+ * the first distance_field_make_mapb.
+ *
+ * @return  a new distance field context, NULL on error
+ */
+distance_field_t *
+distance_field_new( void );
+
+/**
+ * Deletes a distance field context and its buffers.
+ *
+ * @param self  a distance field context
+ */
+void
+distance_field_delete( distance_field_t * self );
+
+/**
+ * Replaces an image by its distance field, as make_distance_mapb computes
+ * it, using the buffers of a context instead of allocating them. The
+ * distance transform is the one of the context mode, the scale of the
+ * field is the same for all modes.
+ *
+ * @param self    A distance field context
+ * @param img     A greyscale image, overwritten by its distance field
+ * @param width   The width of the given image
+ * @param height  The height of the given image
+ *
+ * @return        img, NULL if the buffers could not be grown
+ */
+unsigned char *
+distance_field_make_mapb( distance_field_t * self,
+						  unsigned char * img,
+						  unsigned int width, unsigned int height );
+
+/**
+ * Replaces an image rendered factor times larger than wanted by its
+ * distance field, factor times smaller: the field is computed at the size
+ * of the image then each pixel gets the mean of its factor x factor
+ * samples, in pixels of the smaller field, which is written at the start
+ * of img with rows width / factor pixels long. Glyph edges come out
+ * smoother than from an image rendered at the smaller size, best with a
+ * spread set on the context.
+ *
+ * @param self    A distance field context
+ * @param img     A greyscale image, overwritten by its distance field
+ * @param width   The width of the given image, a multiple of factor
+ * @param height  The height of the given image, a multiple of factor
+ * @param factor  The ratio of the image size to the field one
+ *
+ * @return        img, NULL if the buffers could not be grown
+ */
+unsigned char *
+distance_field_make_downsampled( distance_field_t * self,
+								 unsigned char * img,
+								 unsigned int width, unsigned int height,
+								 unsigned int factor );
+
+/**
+ * Computes the distance field of a FreeType outline straight from its
+ * contours: the distance from the center of each pixel to the closest
+ * line, conic or cubic segment, inside or outside as the fill rule of the
+ * outline decides from the winding of the contours around the pixel. The
+ * field has the scale of distance_field_make_mapb ones, and rows are
+ * computed independently of each other.
+ *
+ * @param self     A distance field context
+ * @param outline  An FT_Outline, in 26.6 pixels
+ * @param img      The image the distance field is written to
+ * @param width    The width of the given image
+ * @param height   The height of the given image
+ * @param left     The outline abscissa of the left side of the image
+ * @param top      The outline ordinate of the top side of the image
+ *
+ * @return         img, NULL if the outline could not be decomposed or
+ *                 the buffers could not be grown
+ */
+unsigned char *
+distance_field_make_outline( distance_field_t * self,
+							 const struct FT_Outline_ * outline,
+							 unsigned char * img,
+							 unsigned int width, unsigned int height,
+							 float left, float top );
+
+/**
+ * Computes the multi-channel distance field of a FreeType outline (after
+ * Chlumsky's msdfgen): the segments are colored red, green and blue so
+ * that those meeting at a corner share a single channel, and each channel
+ * holds the signed distance to the closest segment of its color. The
+ * median of the three channels is then the distance to a shape whose
+ * corners stay sharp, however small the field. Inside pixels are over
+ * 127 in that median, and pixels at range / 2 or further from the outline
+ * are 0 or 255.
+ *
+ * @param self     A distance field context
+ * @param outline  An FT_Outline, in 26.6 pixels
+ * @param img      The image the distance field is written to, three bytes
+ *                 (red, green and blue) a pixel
+ * @param width    The width of the given image
+ * @param height   The height of the given image
+ * @param left     The outline abscissa of the left side of the image
+ * @param top      The outline ordinate of the top side of the image
+ * @param range    The span of distances the field encodes, in pixels
+ *
+ * @return         img, NULL if the outline could not be decomposed
+ */
+unsigned char *
+distance_field_make_msdf( distance_field_t * self,
+						  const struct FT_Outline_ * outline,
+						  unsigned char * img,
+						  unsigned int width, unsigned int height,
+						  float left, float top, float range );
+
 /** @} */
 
 #ifdef __cplusplus
@@ -56,6 +56,220 @@
 
 #include <math.h>
 #include "edtaa3func.h"
+#include "platform.h"
+#if defined(PLATFORM_SIMD_X86)
+#include <immintrin.h>
+#elif defined(PLATFORM_SIMD_ARM)
+#include <arm_neon.h>
+#endif
+
+#define SQRT2 1.4142136
+
+/*
+ * Vectorized interiors of the rows of computegradient and computegradientf:
+ * the gradient of several pixels at once, the same operations in the same
+ * order as the scalar code, written only where the pixel is an edge pixel.
+ * Each returns the first column of row i it left to the scalar code.
+ */
+#if defined(PLATFORM_SIMD_X86)
+PLATFORM_TARGET("sse2")
+static int computegradient_sse2(double *img, int w, int i, double *gx, double *gy) {
+	const __m128d s = _mm_set1_pd(SQRT2), sign = _mm_set1_pd(-0.0);
+	const __m128d zero = _mm_setzero_pd(), one = _mm_set1_pd(1.0);
+	__m128d a, x, y, glength, nz, edge;
+	int j, k;
+	for (j = 1; j + 2 < w; j += 2) {
+		k = i*w + j;
+		a = _mm_loadu_pd(img+k);
+		edge = _mm_and_pd(_mm_cmpgt_pd(a, zero), _mm_cmplt_pd(a, one));
+		if (!_mm_movemask_pd(edge)) continue;
+		x = _mm_xor_pd(_mm_loadu_pd(img+k-w-1), sign);
+		x = _mm_sub_pd(x, _mm_mul_pd(s, _mm_loadu_pd(img+k-1)));
+		x = _mm_sub_pd(x, _mm_loadu_pd(img+k+w-1));
+		x = _mm_add_pd(x, _mm_loadu_pd(img+k-w+1));
+		x = _mm_add_pd(x, _mm_mul_pd(s, _mm_loadu_pd(img+k+1)));
+		x = _mm_add_pd(x, _mm_loadu_pd(img+k+w+1));
+		y = _mm_xor_pd(_mm_loadu_pd(img+k-w-1), sign);
+		y = _mm_sub_pd(y, _mm_mul_pd(s, _mm_loadu_pd(img+k-w)));
+		y = _mm_sub_pd(y, _mm_loadu_pd(img+k-w+1));
+		y = _mm_add_pd(y, _mm_loadu_pd(img+k+w-1));
+		y = _mm_add_pd(y, _mm_mul_pd(s, _mm_loadu_pd(img+k+w)));
+		y = _mm_add_pd(y, _mm_loadu_pd(img+k+w+1));
+		glength = _mm_add_pd(_mm_mul_pd(x, x), _mm_mul_pd(y, y));
+		nz = _mm_cmpgt_pd(glength, zero); // Divide by one where the length is zero
+		glength = _mm_or_pd(_mm_and_pd(nz, _mm_sqrt_pd(glength)), _mm_andnot_pd(nz, one));
+		x = _mm_div_pd(x, glength);
+		y = _mm_div_pd(y, glength);
+		_mm_storeu_pd(gx+k, _mm_or_pd(_mm_and_pd(edge, x), _mm_andnot_pd(edge, _mm_loadu_pd(gx+k))));
+		_mm_storeu_pd(gy+k, _mm_or_pd(_mm_and_pd(edge, y), _mm_andnot_pd(edge, _mm_loadu_pd(gy+k))));
+	}
+	return j;
+}
+
+PLATFORM_TARGET("avx2")
+static int computegradient_avx2(double *img, int w, int i, double *gx, double *gy) {
+	const __m256d s = _mm256_set1_pd(SQRT2), sign = _mm256_set1_pd(-0.0);
+	const __m256d zero = _mm256_setzero_pd(), one = _mm256_set1_pd(1.0);
+	__m256d a, x, y, glength, edge;
+	int j, k;
+	for (j = 1; j + 4 < w; j += 4) {
+		k = i*w + j;
+		a = _mm256_loadu_pd(img+k);
+		edge = _mm256_and_pd(_mm256_cmp_pd(a, zero, _CMP_GT_OQ), _mm256_cmp_pd(a, one, _CMP_LT_OQ));
+		if (!_mm256_movemask_pd(edge)) continue;
+		x = _mm256_xor_pd(_mm256_loadu_pd(img+k-w-1), sign);
+		x = _mm256_sub_pd(x, _mm256_mul_pd(s, _mm256_loadu_pd(img+k-1)));
+		x = _mm256_sub_pd(x, _mm256_loadu_pd(img+k+w-1));
+		x = _mm256_add_pd(x, _mm256_loadu_pd(img+k-w+1));
+		x = _mm256_add_pd(x, _mm256_mul_pd(s, _mm256_loadu_pd(img+k+1)));
+		x = _mm256_add_pd(x, _mm256_loadu_pd(img+k+w+1));
+		y = _mm256_xor_pd(_mm256_loadu_pd(img+k-w-1), sign);
+		y = _mm256_sub_pd(y, _mm256_mul_pd(s, _mm256_loadu_pd(img+k-w)));
+		y = _mm256_sub_pd(y, _mm256_loadu_pd(img+k-w+1));
+		y = _mm256_add_pd(y, _mm256_loadu_pd(img+k+w-1));
+		y = _mm256_add_pd(y, _mm256_mul_pd(s, _mm256_loadu_pd(img+k+w)));
+		y = _mm256_add_pd(y, _mm256_loadu_pd(img+k+w+1));
+		glength = _mm256_add_pd(_mm256_mul_pd(x, x), _mm256_mul_pd(y, y));
+		glength = _mm256_blendv_pd(one, _mm256_sqrt_pd(glength), _mm256_cmp_pd(glength, zero, _CMP_GT_OQ));
+		x = _mm256_div_pd(x, glength);
+		y = _mm256_div_pd(y, glength);
+		_mm256_storeu_pd(gx+k, _mm256_blendv_pd(_mm256_loadu_pd(gx+k), x, edge));
+		_mm256_storeu_pd(gy+k, _mm256_blendv_pd(_mm256_loadu_pd(gy+k), y, edge));
+	}
+	return j;
+}
+
+PLATFORM_TARGET("sse2")
+static int computegradientf_sse2(float *img, int w, int i, float *gx, float *gy) {
+	const __m128 s = _mm_set1_ps((float)SQRT2), sign = _mm_set1_ps(-0.0f);
+	const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+	__m128 a, x, y, glength, nz, edge;
+	int j, k;
+	for (j = 1; j + 4 < w; j += 4) {
+		k = i*w + j;
+		a = _mm_loadu_ps(img+k);
+		edge = _mm_and_ps(_mm_cmpgt_ps(a, zero), _mm_cmplt_ps(a, one));
+		if (!_mm_movemask_ps(edge)) continue;
+		x = _mm_xor_ps(_mm_loadu_ps(img+k-w-1), sign);
+		x = _mm_sub_ps(x, _mm_mul_ps(s, _mm_loadu_ps(img+k-1)));
+		x = _mm_sub_ps(x, _mm_loadu_ps(img+k+w-1));
+		x = _mm_add_ps(x, _mm_loadu_ps(img+k-w+1));
+		x = _mm_add_ps(x, _mm_mul_ps(s, _mm_loadu_ps(img+k+1)));
+		x = _mm_add_ps(x, _mm_loadu_ps(img+k+w+1));
+		y = _mm_xor_ps(_mm_loadu_ps(img+k-w-1), sign);
+		y = _mm_sub_ps(y, _mm_mul_ps(s, _mm_loadu_ps(img+k-w)));
+		y = _mm_sub_ps(y, _mm_loadu_ps(img+k-w+1));
+		y = _mm_add_ps(y, _mm_loadu_ps(img+k+w-1));
+		y = _mm_add_ps(y, _mm_mul_ps(s, _mm_loadu_ps(img+k+w)));
+		y = _mm_add_ps(y, _mm_loadu_ps(img+k+w+1));
+		glength = _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y));
+		nz = _mm_cmpgt_ps(glength, zero);
+		glength = _mm_or_ps(_mm_and_ps(nz, _mm_sqrt_ps(glength)), _mm_andnot_ps(nz, one));
+		x = _mm_div_ps(x, glength);
+		y = _mm_div_ps(y, glength);
+		_mm_storeu_ps(gx+k, _mm_or_ps(_mm_and_ps(edge, x), _mm_andnot_ps(edge, _mm_loadu_ps(gx+k))));
+		_mm_storeu_ps(gy+k, _mm_or_ps(_mm_and_ps(edge, y), _mm_andnot_ps(edge, _mm_loadu_ps(gy+k))));
+	}
+	return j;
+}
+
+PLATFORM_TARGET("avx2")
+static int computegradientf_avx2(float *img, int w, int i, float *gx, float *gy) {
+	const __m256 s = _mm256_set1_ps((float)SQRT2), sign = _mm256_set1_ps(-0.0f);
+	const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+	__m256 a, x, y, glength, edge;
+	int j, k;
+	for (j = 1; j + 8 < w; j += 8) {
+		k = i*w + j;
+		a = _mm256_loadu_ps(img+k);
+		edge = _mm256_and_ps(_mm256_cmp_ps(a, zero, _CMP_GT_OQ), _mm256_cmp_ps(a, one, _CMP_LT_OQ));
+		if (!_mm256_movemask_ps(edge)) continue;
+		x = _mm256_xor_ps(_mm256_loadu_ps(img+k-w-1), sign);
+		x = _mm256_sub_ps(x, _mm256_mul_ps(s, _mm256_loadu_ps(img+k-1)));
+		x = _mm256_sub_ps(x, _mm256_loadu_ps(img+k+w-1));
+		x = _mm256_add_ps(x, _mm256_loadu_ps(img+k-w+1));
+		x = _mm256_add_ps(x, _mm256_mul_ps(s, _mm256_loadu_ps(img+k+1)));
+		x = _mm256_add_ps(x, _mm256_loadu_ps(img+k+w+1));
+		y = _mm256_xor_ps(_mm256_loadu_ps(img+k-w-1), sign);
+		y = _mm256_sub_ps(y, _mm256_mul_ps(s, _mm256_loadu_ps(img+k-w)));
+		y = _mm256_sub_ps(y, _mm256_loadu_ps(img+k-w+1));
+		y = _mm256_add_ps(y, _mm256_loadu_ps(img+k+w-1));
+		y = _mm256_add_ps(y, _mm256_mul_ps(s, _mm256_loadu_ps(img+k+w)));
+		y = _mm256_add_ps(y, _mm256_loadu_ps(img+k+w+1));
+		glength = _mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y));
+		glength = _mm256_blendv_ps(one, _mm256_sqrt_ps(glength), _mm256_cmp_ps(glength, zero, _CMP_GT_OQ));
+		x = _mm256_div_ps(x, glength);
+		y = _mm256_div_ps(y, glength);
+		_mm256_storeu_ps(gx+k, _mm256_blendv_ps(_mm256_loadu_ps(gx+k), x, edge));
+		_mm256_storeu_ps(gy+k, _mm256_blendv_ps(_mm256_loadu_ps(gy+k), y, edge));
+	}
+	return j;
+}
+#elif defined(PLATFORM_SIMD_ARM)
+static int computegradient_neon(double *img, int w, int i, double *gx, double *gy) {
+	const float64x2_t s = vdupq_n_f64(SQRT2), zero = vdupq_n_f64(0.0), one = vdupq_n_f64(1.0);
+	float64x2_t a, x, y, glength;
+	uint64x2_t edge;
+	int j, k;
+	for (j = 1; j + 2 < w; j += 2) {
+		k = i*w + j;
+		a = vld1q_f64(img+k);
+		edge = vandq_u64(vcgtq_f64(a, zero), vcltq_f64(a, one));
+		if (!vmaxvq_u32(vreinterpretq_u32_u64(edge))) continue;
+		x = vnegq_f64(vld1q_f64(img+k-w-1));
+		x = vsubq_f64(x, vmulq_f64(s, vld1q_f64(img+k-1)));
+		x = vsubq_f64(x, vld1q_f64(img+k+w-1));
+		x = vaddq_f64(x, vld1q_f64(img+k-w+1));
+		x = vaddq_f64(x, vmulq_f64(s, vld1q_f64(img+k+1)));
+		x = vaddq_f64(x, vld1q_f64(img+k+w+1));
+		y = vnegq_f64(vld1q_f64(img+k-w-1));
+		y = vsubq_f64(y, vmulq_f64(s, vld1q_f64(img+k-w)));
+		y = vsubq_f64(y, vld1q_f64(img+k-w+1));
+		y = vaddq_f64(y, vld1q_f64(img+k+w-1));
+		y = vaddq_f64(y, vmulq_f64(s, vld1q_f64(img+k+w)));
+		y = vaddq_f64(y, vld1q_f64(img+k+w+1));
+		glength = vaddq_f64(vmulq_f64(x, x), vmulq_f64(y, y));
+		glength = vbslq_f64(vcgtq_f64(glength, zero), vsqrtq_f64(glength), one);
+		x = vdivq_f64(x, glength);
+		y = vdivq_f64(y, glength);
+		vst1q_f64(gx+k, vbslq_f64(edge, x, vld1q_f64(gx+k)));
+		vst1q_f64(gy+k, vbslq_f64(edge, y, vld1q_f64(gy+k)));
+	}
+	return j;
+}
+
+static int computegradientf_neon(float *img, int w, int i, float *gx, float *gy) {
+	const float32x4_t s = vdupq_n_f32((float)SQRT2), zero = vdupq_n_f32(0.0f), one = vdupq_n_f32(1.0f);
+	float32x4_t a, x, y, glength;
+	uint32x4_t edge;
+	int j, k;
+	for (j = 1; j + 4 < w; j += 4) {
+		k = i*w + j;
+		a = vld1q_f32(img+k);
+		edge = vandq_u32(vcgtq_f32(a, zero), vcltq_f32(a, one));
+		if (!vmaxvq_u32(edge)) continue;
+		x = vnegq_f32(vld1q_f32(img+k-w-1));
+		x = vsubq_f32(x, vmulq_f32(s, vld1q_f32(img+k-1)));
+		x = vsubq_f32(x, vld1q_f32(img+k+w-1));
+		x = vaddq_f32(x, vld1q_f32(img+k-w+1));
+		x = vaddq_f32(x, vmulq_f32(s, vld1q_f32(img+k+1)));
+		x = vaddq_f32(x, vld1q_f32(img+k+w+1));
+		y = vnegq_f32(vld1q_f32(img+k-w-1));
+		y = vsubq_f32(y, vmulq_f32(s, vld1q_f32(img+k-w)));
+		y = vsubq_f32(y, vld1q_f32(img+k-w+1));
+		y = vaddq_f32(y, vld1q_f32(img+k+w-1));
+		y = vaddq_f32(y, vmulq_f32(s, vld1q_f32(img+k+w)));
+		y = vaddq_f32(y, vld1q_f32(img+k+w+1));
+		glength = vaddq_f32(vmulq_f32(x, x), vmulq_f32(y, y));
+		glength = vbslq_f32(vcgtq_f32(glength, zero), vsqrtq_f32(glength), one);
+		x = vdivq_f32(x, glength);
+		y = vdivq_f32(y, glength);
+		vst1q_f32(gx+k, vbslq_f32(edge, x, vld1q_f32(gx+k)));
+		vst1q_f32(gy+k, vbslq_f32(edge, y, vld1q_f32(gy+k)));
+	}
+	return j;
+}
+#endif
 
 /*
  * Compute the local gradient at edge pixels using convolution filters.
@@ -65,9 +279,17 @@
 void computegradient(double *img, int w, int h, double *gx, double *gy) {
 	int i,j,k,p,q;
 	double glength, phi, phiscaled, ascaled, errsign, pfrac, qfrac, err0, err1, err;
-#define SQRT2 1.4142136
+	platform_simd_t simd = platform_simd();
+	(void) simd;
 	for (i = 1; i < h-1; i++) { // Avoid edges where the kernels would spill over
-		for (j = 1; j < w-1; j++) {
+		j = 1;
+#if defined(PLATFORM_SIMD_X86)
+		if (simd == PLATFORM_SIMD_AVX2) j = computegradient_avx2(img, w, i, gx, gy);
+		else if (simd == PLATFORM_SIMD_SSE2) j = computegradient_sse2(img, w, i, gx, gy);
+#elif defined(PLATFORM_SIMD_ARM)
+		if (simd == PLATFORM_SIMD_NEON) j = computegradient_neon(img, w, i, gx, gy);
+#endif
+		for (; j < w-1; j++) {
 			k = i*w + j;
 			if ((img[k]>0.0) && (img[k]<1.0)) { // Compute gradient for edge pixels only
 				gx[k] = -img[k-w-1] - SQRT2*img[k-1] - img[k+w-1] + img[k-w+1] + SQRT2*img[k+1] + img[k+w+1];
@@ -536,3 +758,215 @@ void edtaa3(double *img, double *gx, double *gy, int w, int h, short *distx, sho
 
 	/* The transformation is completed. */
 }
+
+/*
+ * Single precision versions of the functions above, they are the same
+ * computations on floats.
+ */
+void computegradientf(float *img, int w, int h, float *gx, float *gy) {
+	int i,j,k;
+	float glength;
+	platform_simd_t simd = platform_simd();
+	(void) simd;
+	for (i = 1; i < h-1; i++) { // Avoid edges where the kernels would spill over
+		j = 1;
+#if defined(PLATFORM_SIMD_X86)
+		if (simd == PLATFORM_SIMD_AVX2) j = computegradientf_avx2(img, w, i, gx, gy);
+		else if (simd == PLATFORM_SIMD_SSE2) j = computegradientf_sse2(img, w, i, gx, gy);
+#elif defined(PLATFORM_SIMD_ARM)
+		if (simd == PLATFORM_SIMD_NEON) j = computegradientf_neon(img, w, i, gx, gy);
+#endif
+		for (; j < w-1; j++) {
+			k = i*w + j;
+			if ((img[k]>0.0f) && (img[k]<1.0f)) { // Compute gradient for edge pixels only
+				gx[k] = -img[k-w-1] - (float)SQRT2*img[k-1] - img[k+w-1] + img[k-w+1] + (float)SQRT2*img[k+1] + img[k+w+1];
+				gy[k] = -img[k-w-1] - (float)SQRT2*img[k-w] - img[k-w+1] + img[k+w-1] + (float)SQRT2*img[k+w] + img[k+w+1];
+				glength = gx[k]*gx[k] + gy[k]*gy[k];
+				if (glength > 0.0f) { // Avoid division by zero
+					glength = sqrtf(glength);
+					gx[k]=gx[k]/glength;
+					gy[k]=gy[k]/glength;
+				}
+			}
+		}
+	}
+}
+
+float edgedff(float gx, float gy, float a) {
+	float df, glength, temp, a1;
+
+	if ((gx == 0) || (gy == 0)) { // Either A) gu or gv are zero, or B) both
+		df = 0.5f-a;  // Linear approximation is A) correct or B) a fair guess
+	} else {
+		glength = sqrtf(gx*gx + gy*gy);
+		if (glength>0) {
+			gx = gx/glength;
+			gy = gy/glength;
+		}
+		// Move to first octant, see edgedf
+		gx = fabsf(gx);
+		gy = fabsf(gy);
+		if (gx<gy) {
+			temp = gx;
+			gx = gy;
+			gy = temp;
+		}
+		a1 = 0.5f*gy/gx;
+		if (a < a1) { // 0 <= a < a1
+			df = 0.5f*(gx + gy) - sqrtf(2.0f*gx*gy*a);
+		} else
+		if (a < (1.0f-a1)) { // a1 <= a <= 1-a1
+			df = (0.5f-a)*gx;
+		} else { // 1-a1 < a <= 1
+			df = -0.5f*(gx + gy) + sqrtf(2.0f*gx*gy*(1.0f-a));
+		}
+	}
+	return df;
+}
+
+float distaa3f(float *img, float *gximg, float *gyimg, int w, int c, int xc, int yc, int xi, int yi) {
+	float di, df, dx, dy, gx, gy, a;
+	int closest;
+
+	closest = c-xc-yc*w; // Index to the edge pixel pointed to from c
+	a = img[closest];    // Grayscale value at the edge pixel
+	gx = gximg[closest]; // X gradient component at the edge pixel
+	gy = gyimg[closest]; // Y gradient component at the edge pixel
+
+	if (a > 1.0f) a = 1.0f;
+	if (a < 0.0f) a = 0.0f; // Clip grayscale values outside the range [0,1]
+	if (a == 0.0f) return 1000000.0f; // Not an object pixel, return "very far" ("don't know yet")
+
+	dx = (float)xi;
+	dy = (float)yi;
+	di = sqrtf(dx*dx + dy*dy); // Length of integer vector, like a traditional EDT
+	if (di==0) { // Use local gradient only at edges
+		df = edgedff(gx, gy, a);
+	} else {
+		df = edgedff(dx, dy, a);
+	}
+	return di + df;
+}
+
+// Test the candidate at the given offset of pixel i, which points to the
+// edge pixel it knows moved by (dx,dy), and keep it if it is closer. A
+// candidate pointing to the edge pixel i already points to is skipped,
+// its distance is the one i has.
+#define EDTAA3F_TRY(offset, dx, dy) do {                                   \
+	c = i+(offset);                                                        \
+	cdistx = distx[c];                                                     \
+	cdisty = disty[c];                                                     \
+	newdistx = cdistx+(dx);                                                \
+	newdisty = cdisty+(dy);                                                \
+	if (newdistx == distx[i] && newdisty == disty[i]) break;              \
+	newdist = distaa3f(img, gx, gy, w, c, cdistx, cdisty, newdistx, newdisty); \
+	if (newdist < olddist-epsilon) {                                       \
+		distx[i]=newdistx;                                                 \
+		disty[i]=newdisty;                                                 \
+		dist[i]=newdist;                                                   \
+		olddist=newdist;                                                   \
+		changed = 1;                                                       \
+	}                                                                      \
+} while (0)
+
+/* One forward and one backward sweep of edtaa3f over distances already
+ * set, returns whether one of them changed */
+int edtaa3f_sweep(float *img, float *gx, float *gy, int w, int h, short *distx, short *disty, float *dist) {
+	int x, y, i, c;
+	float olddist, newdist;
+	int cdistx, cdisty, newdistx, newdisty;
+	int changed = 0;
+	float epsilon = 1e-3f;
+
+	/* Scan rows, except first row */
+	for (y=1; y<h; y++) {
+		/* Scan right, propagate distances from above & left */
+		i = y*w;
+		olddist = dist[i];
+		if (olddist > 0) {
+			EDTAA3F_TRY(-w, 0, 1);
+			EDTAA3F_TRY(-w+1, -1, 1);
+		}
+		i++;
+		for (x=1; x<w-1; x++, i++) {
+			olddist = dist[i];
+			if (olddist <= 0) continue;
+			EDTAA3F_TRY(-1, 1, 0);
+			EDTAA3F_TRY(-w-1, 1, 1);
+			EDTAA3F_TRY(-w, 0, 1);
+			EDTAA3F_TRY(-w+1, -1, 1);
+		}
+		olddist = dist[i];
+		if (olddist > 0) {
+			EDTAA3F_TRY(-1, 1, 0);
+			EDTAA3F_TRY(-w-1, 1, 1);
+			EDTAA3F_TRY(-w, 0, 1);
+		}
+
+		/* Scan left, propagate distance from right */
+		i = y*w + w-2;
+		for (x=w-2; x>=0; x--, i--) {
+			olddist = dist[i];
+			if (olddist <= 0) continue;
+			EDTAA3F_TRY(1, -1, 0);
+		}
+	}
+
+	/* Scan rows in reverse order, except last row */
+	for (y=h-2; y>=0; y--) {
+		/* Scan left, propagate distances from below & right */
+		i = y*w + w-1;
+		olddist = dist[i];
+		if (olddist > 0) {
+			EDTAA3F_TRY(w, 0, -1);
+			EDTAA3F_TRY(w-1, 1, -1);
+		}
+		i--;
+		for (x=w-2; x>0; x--, i--) {
+			olddist = dist[i];
+			if (olddist <= 0) continue;
+			EDTAA3F_TRY(1, -1, 0);
+			EDTAA3F_TRY(w+1, -1, -1);
+			EDTAA3F_TRY(w, 0, -1);
+			EDTAA3F_TRY(w-1, 1, -1);
+		}
+		olddist = dist[i];
+		if (olddist > 0) {
+			EDTAA3F_TRY(1, -1, 0);
+			EDTAA3F_TRY(w+1, -1, -1);
+			EDTAA3F_TRY(w, 0, -1);
+		}
+
+		/* Scan right, propagate distance from left */
+		i = y*w + 1;
+		for (x=1; x<w; x++, i++) {
+			olddist = dist[i];
+			if (olddist <= 0) continue;
+			EDTAA3F_TRY(-1, 1, 0);
+		}
+	}
+	return changed;
+}
+
+void edtaa3f(float *img, float *gx, float *gy, int w, int h, short *distx, short *disty, float *dist) {
+	int i;
+
+	/* Initialize the distance images */
+	for (i=0; i<w*h; i++) {
+		distx[i] = 0; // At first, all pixels point to
+		disty[i] = 0; // themselves as the closest known.
+		if (img[i] <= 0.0f) {
+			dist[i]= 1000000.0f; // Big value, means "not set yet"
+		} else
+		if (img[i]<1.0f) {
+			dist[i] = edgedff(gx[i], gy[i], img[i]); // Gradient-assisted estimate
+		} else {
+			dist[i]= 0.0f; // Inside the object
+		}
+	}
+
+	/* Sweep until no more updates are made */
+	while (edtaa3f_sweep(img, gx, gy, w, h, distx, disty, dist));
+}
+
+#undef EDTAA3F_TRY
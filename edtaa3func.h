@@ -93,6 +93,22 @@ double distaa3(double *img, double *gximg, double *gyimg, int w, int c, int xc,
 
 void edtaa3(double *img, double *gx, double *gy, int w, int h, short *distx, short *disty, double *dist);
 
+/*
+ * Single precision versions of the above, for the scratch buffers of
+ * distance_field_t (see distance-field.h): half the memory to go through
+ * for the same 8 bit output.
+ */
+void computegradientf(float *img, int w, int h, float *gx, float *gy);
+
+float edgedff(float gx, float gy, float a);
+
+float distaa3f(float *img, float *gximg, float *gyimg, int w, int c, int xc, int yc, int xi, int yi);
+
+void edtaa3f(float *img, float *gx, float *gy, int w, int h, short *distx, short *disty, float *dist);
+
+// One sweep of edtaa3f from the given distances, returns whether one changed
+int edtaa3f_sweep(float *img, float *gx, float *gy, int w, int h, short *distx, short *disty, float *dist);
+
 
 #ifdef __cplusplus
 	}
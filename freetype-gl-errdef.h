@@ -31,6 +31,10 @@ FTGL_ERROR_START_LIST
 		  "No format specified for attribute" )
   FTGL_ERRORDEF_( Vertex_Attribute_Format_Wrong,	0x0A,
 		  "Vertex attribute format not understood" )
+  FTGL_ERRORDEF_( Snapshot_Mismatch,			0x0B,
+		  "Snapshot does not match the font" )
+  FTGL_ERRORDEF_( Render_Mode_Unsupported,		0x0C,
+		  "Glyph cannot be rendered in this render mode" )
 
 FTGL_ERROR_END_LIST
 
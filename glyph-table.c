@@ -0,0 +1,286 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "glyph-table.h"
+#include "freetype-gl-err.h"
+
+
+// ------------------------------------------------------- glyph_entry_slot ---
+// Home slot of a key. Codepoints come in dense ranges: Fibonacci hashing
+// spreads consecutive codepoints evenly over the table, so that most lookups
+// are found at the first probe. Variants are mixed in beforehand.
+static inline size_t
+glyph_entry_slot( uint32_t codepoint, int rendermode, float outline_thickness,
+				  size_t capacity ) {
+	uint32_t variant;
+
+	memcpy( &variant, &outline_thickness, sizeof(variant) );
+	variant ^= (uint32_t) rendermode * 0x9E3779B1u;
+	variant ^= variant >> 16;
+	variant *= 0x85EBCA6Bu;
+	variant ^= variant >> 13;
+	variant *= 0xC2B2AE35u;
+	variant ^= variant >> 16;
+
+	return ((uint64_t) ((codepoint ^ variant) * 0x9E3779B1u) * capacity) >> 32;
+}
+
+
+// ------------------------------------------------------ glyph_entry_match ---
+static inline int
+glyph_entry_match( const glyph_entry_t *entry, uint32_t codepoint,
+				   int rendermode, float outline_thickness ) {
+	return entry->codepoint == codepoint &&
+		entry->rendermode == rendermode &&
+		entry->outline_thickness == outline_thickness;
+}
+
+
+// -------------------------------------------------------- glyph_table_new ---
+glyph_table_t *
+glyph_table_new( void ) {
+	glyph_table_t *self = (glyph_table_t *) malloc( sizeof(glyph_table_t) );
+
+	if ( !self ) {
+		freetype_gl_error( Out_Of_Memory,
+			   "line %d: No more memory for allocating data\n", __LINE__ );
+		return NULL;
+	}
+	self->entries  = NULL;
+	self->capacity = 0;
+	self->size     = 0;
+	self->borrowed = 0;
+	return self;
+}
+
+
+// ----------------------------------------------------- glyph_table_delete ---
+void
+glyph_table_delete( glyph_table_t *self ) {
+	assert( self );
+
+	if ( !self->borrowed ) {
+		free( self->entries );
+	}
+	free( self );
+}
+
+
+// -------------------------------------------------------- glyph_table_get ---
+struct texture_glyph_t *
+glyph_table_get( const glyph_table_t *self,
+				 uint32_t codepoint,
+				 int rendermode,
+				 float outline_thickness ) {
+	size_t mask, i;
+
+	assert( self );
+	if ( !self->size ) {
+		return NULL;
+	}
+
+	// -0.0 and 0.0 must hash the same
+	outline_thickness += 0.0f;
+
+	mask = self->capacity - 1;
+	for ( i = glyph_entry_slot( codepoint, rendermode, outline_thickness,
+								self->capacity ); ; i = (i + 1) & mask ) {
+		const glyph_entry_t *entry = self->entries + i;
+
+		if ( entry->codepoint == GLYPH_TABLE_EMPTY ) {
+			return NULL;
+		}
+		if ( glyph_entry_match( entry, codepoint, rendermode, outline_thickness ) ) {
+			return entry->glyph;
+		}
+	}
+}
+
+
+// ------------------------------------------------------ glyph_table_place ---
+static glyph_entry_t *
+glyph_table_place( glyph_entry_t *entries, size_t capacity, uint32_t codepoint,
+				   int rendermode, float outline_thickness ) {
+	size_t mask = capacity - 1;
+	size_t i;
+
+	for ( i = glyph_entry_slot( codepoint, rendermode, outline_thickness,
+								capacity ); ; i = (i + 1) & mask ) {
+		if ( entries[i].codepoint == GLYPH_TABLE_EMPTY ||
+			 glyph_entry_match( entries + i, codepoint, rendermode, outline_thickness ) ) {
+			return entries + i;
+		}
+	}
+}
+
+
+// ----------------------------------------------------- glyph_table_resize ---
+static int
+glyph_table_resize( glyph_table_t *self, size_t capacity ) {
+	glyph_entry_t *entries = malloc( capacity * sizeof(glyph_entry_t) );
+	size_t i;
+
+	if ( !entries ) {
+		freetype_gl_error( Out_Of_Memory,
+			   "line %d: No more memory for allocating data\n", __LINE__ );
+		return -1;
+	}
+	for ( i = 0; i < capacity; ++i ) {
+		entries[i].codepoint = GLYPH_TABLE_EMPTY;
+	}
+
+	for ( i = 0; i < self->capacity; ++i ) {
+		glyph_entry_t *entry = self->entries + i;
+
+		if ( entry->codepoint != GLYPH_TABLE_EMPTY ) {
+			*glyph_table_place( entries, capacity, entry->codepoint,
+								entry->rendermode, entry->outline_thickness ) = *entry;
+		}
+	}
+	if ( !self->borrowed ) {
+		free( self->entries );
+	}
+	self->entries  = entries;
+	self->capacity = capacity;
+	self->borrowed = 0;
+	return 0;
+}
+
+
+// -------------------------------------------------------- glyph_table_own ---
+/* Copies borrowed entries into entries of the table's own, which can then
+ * be written to */
+static int
+glyph_table_own( glyph_table_t *self ) {
+	if ( !self->borrowed ) {
+		return 0;
+	}
+	if ( !self->capacity ) {
+		self->entries  = NULL;
+		self->borrowed = 0;
+		return 0;
+	}
+	return glyph_table_resize( self, self->capacity );
+}
+
+
+// -------------------------------------------------------- glyph_table_set ---
+int
+glyph_table_set( glyph_table_t *self,
+				 uint32_t codepoint,
+				 int rendermode,
+				 float outline_thickness,
+				 struct texture_glyph_t *glyph ) {
+	glyph_entry_t *entry;
+
+	assert( self );
+	assert( codepoint != GLYPH_TABLE_EMPTY );
+
+	outline_thickness += 0.0f;
+
+	if ( glyph_table_own( self ) ) {
+		return -1;
+	}
+
+	// Keep the load factor under 1/2 so that probe sequences stay short
+	if ( 2 * (self->size + 1) > self->capacity ) {
+		if ( glyph_table_resize( self, self->capacity ? 2 * self->capacity : 256 ) ) {
+			return -1;
+		}
+	}
+
+	entry = glyph_table_place( self->entries, self->capacity, codepoint,
+							   rendermode, outline_thickness );
+	if ( entry->codepoint == GLYPH_TABLE_EMPTY ) {
+		entry->codepoint         = codepoint;
+		entry->rendermode        = rendermode;
+		entry->outline_thickness = outline_thickness;
+		self->size++;
+	}
+	entry->glyph = glyph;
+	return 0;
+}
+
+
+// ----------------------------------------------------- glyph_table_remove ---
+struct texture_glyph_t *
+glyph_table_remove( glyph_table_t *self,
+					uint32_t codepoint,
+					int rendermode,
+					float outline_thickness ) {
+	struct texture_glyph_t *glyph;
+	size_t mask, hole, i, home;
+
+	assert( self );
+	if ( !self->size ) {
+		return NULL;
+	}
+
+	outline_thickness += 0.0f;
+
+	hole = glyph_table_place( self->entries, self->capacity, codepoint,
+							  rendermode, outline_thickness ) - self->entries;
+	if ( self->entries[hole].codepoint == GLYPH_TABLE_EMPTY ) {
+		return NULL;
+	}
+	if ( self->borrowed ) {
+		if ( glyph_table_own( self ) ) {
+			return NULL;
+		}
+		hole = glyph_table_place( self->entries, self->capacity, codepoint,
+								  rendermode, outline_thickness ) - self->entries;
+	}
+	glyph = self->entries[hole].glyph;
+
+	// Shift back the entries of the probe sequence that would no longer be
+	// found past the hole
+	mask = self->capacity - 1;
+	for ( i = (hole + 1) & mask;
+		  self->entries[i].codepoint != GLYPH_TABLE_EMPTY; i = (i + 1) & mask ) {
+		const glyph_entry_t *entry = self->entries + i;
+
+		home = glyph_entry_slot( entry->codepoint, entry->rendermode,
+								 entry->outline_thickness, self->capacity );
+		if ( ((i - home) & mask) >= ((i - hole) & mask) ) {
+			self->entries[hole] = *entry;
+			hole = i;
+		}
+	}
+	self->entries[hole].codepoint = GLYPH_TABLE_EMPTY;
+	self->size--;
+	return glyph;
+}
+
+
+// ------------------------------------------------------ glyph_table_clear ---
+void
+glyph_table_clear( glyph_table_t *self ) {
+	size_t i;
+
+	assert( self );
+
+	// Borrowed entries are let go of rather than copied to be emptied
+	if ( self->borrowed ) {
+		self->entries  = NULL;
+		self->capacity = 0;
+		self->borrowed = 0;
+	}
+	for ( i = 0; i < self->capacity; ++i ) {
+		self->entries[i].codepoint = GLYPH_TABLE_EMPTY;
+	}
+	self->size = 0;
+}
+
+
+// ----------------------------------------------------- glyph_table_memory ---
+size_t
+glyph_table_memory( const glyph_table_t *self ) {
+	assert( self );
+
+	return sizeof(glyph_table_t) + self->capacity * sizeof(glyph_entry_t);
+}
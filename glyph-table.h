@@ -0,0 +1,195 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+#ifndef __GLYPH_TABLE_H__
+#define __GLYPH_TABLE_H__
+
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+namespace ftgl {
+#endif
+
+/**
+ * @file   glyph-table.h
+ *
+ * @defgroup glyph-table Glyph table
+ *
+ * The glyph table maps a glyph variant, that is a codepoint together with
+ * the rendermode and outline thickness it was rendered with, to a glyph. It
+ * is an open-addressed hash table with linear probing: a lookup costs the
+ * same for any codepoint and any number of variants.
+ *
+ * The table only stores glyph pointers and never moves nor frees the glyphs
+ * themselves, so that pointers handed out stay valid as the table grows.
+ *
+ * <b>Example Usage</b>:
+ * @code
+ * #include "glyph-table.h"
+ *
+ * int main( int arrgc, char *argv[] )
+ * {
+ *   glyph_table_t * table = glyph_table_new( );
+ *   glyph_table_set( table, 'A', RENDER_NORMAL, 0.0f, glyph );
+ *
+ *   glyph = glyph_table_get( table, 'A', RENDER_NORMAL, 0.0f );
+ *   glyph_table_delete( table );
+ *
+ *   return 0;
+ * }
+ * @endcode
+ *
+ * @{
+ */
+
+/**
+ * Marks an empty slot of the table (not a valid Unicode codepoint).
+ */
+#define GLYPH_TABLE_EMPTY 0xFFFFFFFFu
+
+struct texture_glyph_t;
+
+/**
+ * A glyph table entry.
+ */
+typedef struct glyph_entry_t
+{
+	/** Codepoint the glyph is found with. */
+	uint32_t codepoint;
+
+	/** Rendermode the glyph was rendered with. */
+	int rendermode;
+
+	/** Outline thickness the glyph was rendered with. */
+	float outline_thickness;
+
+	/** The glyph. */
+	struct texture_glyph_t * glyph;
+} glyph_entry_t;
+
+/**
+ * Open-addressed hash table of glyphs.
+ */
+typedef struct glyph_table_t
+{
+	/** Entry slots, NULL until the first glyph is set. */
+	glyph_entry_t * entries;
+
+	/** Number of slots, always zero or a power of two. */
+	size_t capacity;
+
+	/** Number of entries. */
+	size_t size;
+
+	/** Whether the entries are borrowed (e.g. from a mapped snapshot)
+	 *  rather than allocated by the table, which then never frees them
+	 *  and copies them before the first write. */
+	int borrowed;
+} glyph_table_t;
+
+
+/**
+ * Creates a new empty glyph table.
+ *
+ * @return a new empty glyph table
+ */
+  glyph_table_t *
+  glyph_table_new( void );
+
+
+/**
+ * Deletes a glyph table. The glyphs are not deleted.
+ *
+ * @param self a glyph table
+ */
+  void
+  glyph_table_delete( glyph_table_t *self );
+
+
+/**
+ * Look for a glyph.
+ *
+ * @param self               a glyph table
+ * @param codepoint          codepoint of the glyph
+ * @param rendermode         rendermode of the glyph
+ * @param outline_thickness  outline thickness of the glyph
+ * @return                   the glyph, NULL if there is none for this key
+ */
+  struct texture_glyph_t *
+  glyph_table_get( const glyph_table_t *self,
+				   uint32_t codepoint,
+				   int rendermode,
+				   float outline_thickness );
+
+
+/**
+ * Set (insert or replace) the glyph of a key.
+ *
+ * @param self               a glyph table
+ * @param codepoint          codepoint of the glyph
+ * @param rendermode         rendermode of the glyph
+ * @param outline_thickness  outline thickness of the glyph
+ * @param glyph              the glyph
+ * @return                   0 on success, -1 if memory could not be allocated
+ */
+  int
+  glyph_table_set( glyph_table_t *self,
+				   uint32_t codepoint,
+				   int rendermode,
+				   float outline_thickness,
+				   struct texture_glyph_t *glyph );
+
+
+/**
+ * Remove the entry of a key. The glyph is not deleted.
+ *
+ * @param self               a glyph table
+ * @param codepoint          codepoint of the glyph
+ * @param rendermode         rendermode of the glyph
+ * @param outline_thickness  outline thickness of the glyph
+ * @return                   the glyph of the removed entry, NULL if there
+ *                           was none
+ */
+  struct texture_glyph_t *
+  glyph_table_remove( glyph_table_t *self,
+					  uint32_t codepoint,
+					  int rendermode,
+					  float outline_thickness );
+
+
+/**
+ * Remove all the entries of the table, keeping its capacity.
+ *
+ * @param self a glyph table
+ */
+  void
+  glyph_table_clear( glyph_table_t *self );
+
+
+/**
+ * Memory used by the table.
+ *
+ * @param self a glyph table
+ * @return     number of bytes allocated for the table, including the table
+ *             structure itself but not the glyphs
+ */
+  size_t
+  glyph_table_memory( const glyph_table_t *self );
+
+/** @} */
+
+#ifdef __cplusplus
+}
+}
+#endif
+
+#endif /* __GLYPH_TABLE_H__ */
@@ -0,0 +1,272 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "kerning-table.h"
+#include "freetype-gl-err.h"
+
+
+// ------------------------------------------------------ kerning_pair_hash ---
+static inline uint32_t
+kerning_pair_hash( uint32_t left, uint32_t right ) {
+	uint32_t hash = left * 0x9E3779B1u ^ right * 0x85EBCA77u;
+
+	return hash ^ (hash >> 15);
+}
+
+
+// ------------------------------------------------------ kerning_table_new ---
+kerning_table_t *
+kerning_table_new( void ) {
+	kerning_table_t *self = (kerning_table_t *) malloc( sizeof(kerning_table_t) );
+
+	if ( !self ) {
+		freetype_gl_error( Out_Of_Memory,
+			   "line %d: No more memory for allocating data\n", __LINE__ );
+		return NULL;
+	}
+	self->pairs    = NULL;
+	self->capacity = 0;
+	self->size     = 0;
+	self->max_size = 0;
+	self->borrowed = 0;
+	return self;
+}
+
+
+// --------------------------------------------------- kerning_table_delete ---
+void
+kerning_table_delete( kerning_table_t *self ) {
+	assert( self );
+
+	if ( !self->borrowed ) {
+		free( self->pairs );
+	}
+	free( self );
+}
+
+
+// ----------------------------------------------------- kerning_table_find ---
+const kerning_pair_t *
+kerning_table_find( const kerning_table_t *self,
+					uint32_t left,
+					uint32_t right ) {
+	size_t mask, i;
+
+	assert( self );
+	if ( !self->size ) {
+		return NULL;
+	}
+
+	mask = self->capacity - 1;
+	for ( i = kerning_pair_hash( left, right ) & mask; ; i = (i + 1) & mask ) {
+		const kerning_pair_t *pair = self->pairs + i;
+
+		if ( pair->left == KERNING_TABLE_EMPTY ) {
+			return NULL;
+		}
+		if ( pair->left == left && pair->right == right ) {
+			return pair;
+		}
+	}
+}
+
+
+// ------------------------------------------------------ kerning_table_get ---
+float
+kerning_table_get( const kerning_table_t *self,
+				   uint32_t left,
+				   uint32_t right ) {
+	const kerning_pair_t *pair = kerning_table_find( self, left, right );
+
+	return pair ? pair->kerning : 0.0f;
+}
+
+
+// ---------------------------------------------------- kerning_table_place ---
+static kerning_pair_t *
+kerning_table_place( kerning_pair_t *pairs, size_t capacity,
+					 uint32_t left, uint32_t right ) {
+	size_t mask = capacity - 1;
+	size_t i;
+
+	for ( i = kerning_pair_hash( left, right ) & mask; ; i = (i + 1) & mask ) {
+		if ( pairs[i].left == KERNING_TABLE_EMPTY ||
+			 (pairs[i].left == left && pairs[i].right == right) ) {
+			return pairs + i;
+		}
+	}
+}
+
+
+// --------------------------------------------------- kerning_table_resize ---
+static int
+kerning_table_resize( kerning_table_t *self, size_t capacity ) {
+	kerning_pair_t *pairs = malloc( capacity * sizeof(kerning_pair_t) );
+	size_t i;
+
+	if ( !pairs ) {
+		freetype_gl_error( Out_Of_Memory,
+			   "line %d: No more memory for allocating data\n", __LINE__ );
+		return -1;
+	}
+	// An all ones byte pattern is KERNING_TABLE_EMPTY
+	memset( pairs, 0xFF, capacity * sizeof(kerning_pair_t) );
+
+	for ( i = 0; i < self->capacity; ++i ) {
+		kerning_pair_t *pair = self->pairs + i;
+
+		if ( pair->left != KERNING_TABLE_EMPTY ) {
+			*kerning_table_place( pairs, capacity, pair->left, pair->right ) = *pair;
+		}
+	}
+	if ( !self->borrowed ) {
+		free( self->pairs );
+	}
+	self->pairs    = pairs;
+	self->capacity = capacity;
+	self->borrowed = 0;
+	return 0;
+}
+
+
+// ------------------------------------------------------ kerning_table_own ---
+/* Copies borrowed pairs into pairs of the table's own, which can then be
+ * written to */
+static int
+kerning_table_own( kerning_table_t *self ) {
+	if ( !self->borrowed ) {
+		return 0;
+	}
+	if ( !self->capacity ) {
+		self->pairs    = NULL;
+		self->borrowed = 0;
+		return 0;
+	}
+	return kerning_table_resize( self, self->capacity );
+}
+
+
+// ---------------------------------------------------- kerning_table_erase ---
+/* Empties a slot, moving back the pairs after it in its cluster that
+ * would not be found past the hole anymore */
+static void
+kerning_table_erase( kerning_table_t *self, size_t i ) {
+	size_t mask = self->capacity - 1;
+	size_t j = i, home;
+
+	for ( ;; ) {
+		j = (j + 1) & mask;
+		if ( self->pairs[j].left == KERNING_TABLE_EMPTY ) {
+			break;
+		}
+		home = kerning_pair_hash( self->pairs[j].left, self->pairs[j].right ) & mask;
+
+		// The pair stays if its home lies cyclically in (i, j]
+		if ( i <= j ? (home <= i || home > j) : (home <= i && home > j) ) {
+			self->pairs[i] = self->pairs[j];
+			i = j;
+		}
+	}
+	self->pairs[i].left  = KERNING_TABLE_EMPTY;
+	self->pairs[i].right = KERNING_TABLE_EMPTY;
+	self->size--;
+}
+
+
+// ------------------------------------------------------ kerning_table_set ---
+int
+kerning_table_set( kerning_table_t *self,
+				   uint32_t left,
+				   uint32_t right,
+				   float kerning ) {
+	kerning_pair_t *pair;
+
+	assert( self );
+	assert( left != KERNING_TABLE_EMPTY );
+
+	if ( kerning_table_own( self ) ) {
+		return -1;
+	}
+
+	// A bounded table is a cache: a full one drops the first pair of the
+	// probe sequence of the new one, which is as good as a random pair
+	if ( self->max_size && self->size >= self->max_size &&
+		 !kerning_table_find( self, left, right ) ) {
+		size_t mask = self->capacity - 1;
+		size_t i = kerning_pair_hash( left, right ) & mask;
+
+		while ( self->pairs[i].left == KERNING_TABLE_EMPTY ) {
+			i = (i + 1) & mask;
+		}
+		kerning_table_erase( self, i );
+	}
+
+	// Keep the load factor under 1/2 so that probe sequences stay short
+	if ( 2 * (self->size + 1) > self->capacity ) {
+		if ( kerning_table_resize( self, self->capacity ? 2 * self->capacity : 16 ) ) {
+			return -1;
+		}
+	}
+
+	pair = kerning_table_place( self->pairs, self->capacity, left, right );
+	if ( pair->left == KERNING_TABLE_EMPTY ) {
+		pair->left  = left;
+		pair->right = right;
+		self->size++;
+	}
+	pair->kerning = kerning;
+	return 0;
+}
+
+
+// --------------------------------------------------- kerning_table_remove ---
+int
+kerning_table_remove( kerning_table_t *self,
+					  uint32_t left,
+					  uint32_t right ) {
+	const kerning_pair_t *pair;
+
+	assert( self );
+
+	pair = kerning_table_find( self, left, right );
+	if ( !pair ) {
+		return 0;
+	}
+	if ( kerning_table_own( self ) ) {
+		return 0;
+	}
+	kerning_table_erase( self, (size_t) (kerning_table_find( self, left, right ) - self->pairs) );
+	return 1;
+}
+
+
+// ---------------------------------------------------- kerning_table_clear ---
+void
+kerning_table_clear( kerning_table_t *self ) {
+	assert( self );
+
+	// Borrowed pairs are let go of rather than copied to be emptied
+	if ( self->borrowed ) {
+		self->pairs    = NULL;
+		self->capacity = 0;
+		self->borrowed = 0;
+	}
+	if ( self->pairs ) {
+		memset( self->pairs, 0xFF, self->capacity * sizeof(kerning_pair_t) );
+	}
+	self->size = 0;
+}
+
+
+// --------------------------------------------------- kerning_table_memory ---
+size_t
+kerning_table_memory( const kerning_table_t *self ) {
+	assert( self );
+
+	return sizeof(kerning_table_t) + self->capacity * sizeof(kerning_pair_t);
+}
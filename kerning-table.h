@@ -0,0 +1,206 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+#ifndef __KERNING_TABLE_H__
+#define __KERNING_TABLE_H__
+
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+namespace ftgl {
+#endif
+
+/**
+ * @file   kerning-table.h
+ *
+ * @defgroup kerning-table Kerning table
+ *
+ * The kerning table stores the kerning values of a font as a sparse set of
+ * (left, right) codepoint pairs. It is an open-addressed hash table with
+ * linear probing, so that a lookup is a few integer operations and at most
+ * a couple of cache lines, whatever the codepoints involved. Only pairs that
+ * have actually been set are stored: fonts without kerning do not allocate
+ * anything.
+ *
+ * <b>Example Usage</b>:
+ * @code
+ * #include "kerning-table.h"
+ *
+ * int main( int arrgc, char *argv[] )
+ * {
+ *   kerning_table_t * table = kerning_table_new( );
+ *   kerning_table_set( table, 'A', 'V', -1.5f );
+ *
+ *   float kerning = kerning_table_get( table, 'A', 'V' );
+ *   kerning_table_delete( table );
+ *
+ *   return 0;
+ * }
+ * @endcode
+ *
+ * @{
+ */
+
+/**
+ * Marks an empty slot of the table (not a valid Unicode codepoint).
+ */
+#define KERNING_TABLE_EMPTY 0xFFFFFFFFu
+
+/**
+ * A kerning pair.
+ */
+typedef struct kerning_pair_t
+{
+	/** Codepoint of the left (preceding) character. */
+	uint32_t left;
+
+	/** Codepoint of the right (current) character. */
+	uint32_t right;
+
+	/** Horizontal kerning, in fractional pixels. */
+	float kerning;
+} kerning_pair_t;
+
+/**
+ * Open-addressed hash table of kerning pairs.
+ */
+typedef struct kerning_table_t
+{
+	/** Pair slots, NULL until the first pair is set. */
+	kerning_pair_t * pairs;
+
+	/** Number of slots, always zero or a power of two. */
+	size_t capacity;
+
+	/** Number of pairs stored. */
+	size_t size;
+
+	/**
+	 * Maximum number of pairs, 0 for no limit. When a new pair does not fit,
+	 * a pair stored near its slot is dropped first: the table is then used
+	 * as a cache.
+	 */
+	size_t max_size;
+
+	/**
+	 * Whether the pairs are borrowed (e.g. from a mapped snapshot) rather
+	 * than allocated by the table, which then never frees them and copies
+	 * them before the first write.
+	 */
+	int borrowed;
+} kerning_table_t;
+
+
+/**
+ * Creates a new empty kerning table.
+ *
+ * @return a new empty kerning table
+ */
+  kerning_table_t *
+  kerning_table_new( void );
+
+
+/**
+ * Deletes a kerning table.
+ *
+ * @param self a kerning table
+ */
+  void
+  kerning_table_delete( kerning_table_t *self );
+
+
+/**
+ * Get the kerning of a pair.
+ *
+ * @param self   a kerning table
+ * @param left   codepoint of the preceding character
+ * @param right  codepoint of the current character
+ * @return       the kerning value, 0 if the pair is not in the table
+ */
+  float
+  kerning_table_get( const kerning_table_t *self,
+					 uint32_t left,
+					 uint32_t right );
+
+
+/**
+ * Look for a pair in the table.
+ *
+ * @param self   a kerning table
+ * @param left   codepoint of the preceding character
+ * @param right  codepoint of the current character
+ * @return       the stored pair, NULL if the pair is not in the table
+ */
+  const kerning_pair_t *
+  kerning_table_find( const kerning_table_t *self,
+					  uint32_t left,
+					  uint32_t right );
+
+
+/**
+ * Set (insert or replace) the kerning of a pair. If the table is bounded
+ * and full, another pair is dropped before a new pair is inserted.
+ *
+ * @param self     a kerning table
+ * @param left     codepoint of the preceding character
+ * @param right    codepoint of the current character
+ * @param kerning  kerning value
+ * @return         0 on success, -1 if memory could not be allocated
+ */
+  int
+  kerning_table_set( kerning_table_t *self,
+					 uint32_t left,
+					 uint32_t right,
+					 float kerning );
+
+
+/**
+ * Removes a pair.
+ *
+ * @param self   a kerning table
+ * @param left   codepoint of the preceding character
+ * @param right  codepoint of the current character
+ * @return       1 if the pair was in the table, 0 otherwise
+ */
+  int
+  kerning_table_remove( kerning_table_t *self,
+						uint32_t left,
+						uint32_t right );
+
+
+/**
+ * Removes all pairs, keeping the allocated storage.
+ *
+ * @param self a kerning table
+ */
+  void
+  kerning_table_clear( kerning_table_t *self );
+
+
+/**
+ * Memory used by the table.
+ *
+ * @param self a kerning table
+ * @return     number of bytes allocated for the table, including the table
+ *             structure itself
+ */
+  size_t
+  kerning_table_memory( const kerning_table_t *self );
+
+/** @} */
+
+#ifdef __cplusplus
+}
+}
+#endif
+
+#endif /* __KERNING_TABLE_H__ */
@@ -25,31 +25,106 @@ void print_help() {
 	fprintf( stderr, "Usage: makefont [--help] --font <font file> "
 			 "--header <header file> --size <font size> "
 			 "--variable <variable name> --texture <texture size>"
-			 "--rendermode <one of 'normal', 'outline_edge', 'outline_positive', 'outline_negative' or 'sdf'>\n" );
+			 "--rendermode <one of 'normal', 'outline_edge', 'outline_positive', 'outline_negative', 'sdf' or 'msdf'> "
+			 "--format <one of 'header', 'blob' or 'array'> "
+			 "--pack <one of 'batch' or 'string'>\n"
+			 "  header: C structures with the glyphs, their kerning and the texture\n"
+			 "  blob:   binary file for texture_font_new_from_blob, to be loaded or\n"
+			 "          embedded (#embed, incbin)\n"
+			 "  array:  the same blob as a C array of 32 bit words\n"
+			 "  batch:  glyphs packed together, highest first (the default)\n"
+			 "  string: glyphs packed one after the other, in character order\n" );
+}
+
+// ------------------------------------------------------------- write_blob ---
+// Write the blob of a font, as is or as a C array that keeps it aligned.
+int write_blob( texture_font_t * font, const char * filename,
+				const char * variable_name, int array ) {
+	size_t size, i;
+	void * blob = texture_font_make_blob( font, &size );
+	FILE * file;
+
+	if ( !blob )
+		return 0;
+	if ( !( file = fopen( filename, array ? "w" : "wb" ) ) ) {
+		fprintf( stderr, "Cannot write \"%s\".\n", filename );
+		free( blob );
+		return 0;
+	}
+
+	if ( !array ) {
+		fwrite( blob, 1, size, file );
+	} else {
+		const uint32_t * words = (const uint32_t *) blob;
+
+		fprintf( file,
+			"/* Font blob made by makefont, see texture_font_new_from_blob */\n"
+			"#include <stddef.h>\n"
+			"#include <stdint.h>\n"
+			"#ifdef __cplusplus\n"
+			"extern \"C\" {\n"
+			"#endif\n"
+			"\n"
+			"const size_t %s_size = %" PRIzu ";\n"
+			"const uint32_t %s[] = {", variable_name, size, variable_name );
+		for ( i=0; i < size / 4; ++i ) {
+			fprintf( file, "%s0x%08x,", i % 8 ? " " : "\n ", words[i] );
+		}
+		fprintf( file,
+			"\n};\n"
+			"#ifdef __cplusplus\n"
+			"}\n"
+			"#endif\n" );
+	}
+
+	fclose( file );
+	free( blob );
+	return 1;
+}
+
+// ---------------------------------------------------- glyph_kerning_count ---
+// Number of 0x100 kerning pages needed for the pairs ending with this glyph.
+size_t glyph_kerning_count( texture_glyph_t * glyph ) {
+	kerning_table_t * table;
+	size_t i, count = 0;
+
+	if ( !glyph->font )
+	return 0;
+	table = glyph->font->kerning_table;
+
+	for ( i=0; i < table->capacity; ++i ) {
+		kerning_pair_t * pair = table->pairs + i;
+		if ( pair->left != KERNING_TABLE_EMPTY &&
+			 pair->right == glyph->codepoint &&
+			 (pair->left >> 8) + 1 > count )
+		count = (pair->left >> 8) + 1;
+	}
+	return count;
 }
 
 void print_glyph(FILE * file, texture_glyph_t * glyph) {
+	size_t kerning_count = glyph_kerning_count( glyph );
 	// TextureFont
 	fprintf( file, "  {%u, ", glyph->codepoint );
 	fprintf( file, "%" PRIzu ", %" PRIzu ", ", glyph->width, glyph->height );
 	fprintf( file, "%d, %d, ", glyph->offset_x, glyph->offset_y );
 	fprintf( file, "%ff, %ff, ", glyph->advance_x, glyph->advance_y );
 	fprintf( file, "%ff, %ff, %ff, %ff, ", glyph->s0, glyph->t0, glyph->s1, glyph->t1 );
-	fprintf( file, "%" PRIzu ", ", vector_size(glyph->kerning) );
-	if (vector_size(glyph->kerning) == 0) {
+	fprintf( file, "%" PRIzu ", ", kerning_count );
+	if (kerning_count == 0) {
 	fprintf( file, "0" );
 	} else {
-	int k;
+	size_t k;
 	fprintf( file, "{ " );
-	for ( k=0; k < vector_size(glyph->kerning); ++k ) {
-		float *kerning = *(float **) vector_get( glyph->kerning, k);
+	for ( k=0; k < kerning_count; ++k ) {
 		int l;
 		fprintf( file, "{" );
-		for ( l=0; l<0xff; l++ )
-		fprintf( file, " %ff,", kerning[l] );
-		fprintf( file, " %ff }", kerning[0xFF] );
+		for ( l=0; l<0x100; l++ )
+		fprintf( file, " %ff%s", kerning_table_get( glyph->font->kerning_table,
+													(k << 8) | l, glyph->codepoint ),
+				 l < 0xff ? "," : " }" );
 
-		if ( k < (vector_size(glyph->kerning)-1))
+		if ( k < (kerning_count-1))
 		fprintf( file, ",\n" );
 	}
 	fprintf( file, " }" );
@@ -71,15 +146,18 @@ int main( int argc, char **argv ) {
 	const char * font_filename   = NULL;
 	const char * header_filename = NULL;
 	const char * variable_name   = "font";
+	const char * format          = NULL;
+	const char * pack            = NULL;
 	int show_help = 0;
 	size_t texture_width = 128;
 	rendermode_t rendermode = RENDER_NORMAL;
-	const char *rendermodes[5];
+	const char *rendermodes[6];
 	rendermodes[RENDER_NORMAL] = "normal";
 	rendermodes[RENDER_OUTLINE_EDGE] = "outline edge";
 	rendermodes[RENDER_OUTLINE_POSITIVE] = "outline added";
 	rendermodes[RENDER_OUTLINE_NEGATIVE] = "outline removed";
 	rendermodes[RENDER_SIGNED_DISTANCE_FIELD] = "signed distance field";
+	rendermodes[RENDER_MSDF] = "multi-channel signed distance field";
 
 	for ( arg = 1; arg < argc; ++arg ) {
 		if ( 0 == strcmp( "--font", argv[arg] ) || 0 == strcmp( "-f", argv[arg] ) ) {
@@ -231,6 +309,9 @@ int main( int argc, char **argv ) {
 			} else
 			if ( 0 == strcmp( "sdf", argv[arg] ) ) {
 				rendermode = RENDER_SIGNED_DISTANCE_FIELD;
+			} else
+			if ( 0 == strcmp( "msdf", argv[arg] ) ) {
+				rendermode = RENDER_MSDF;
 			} else {
 				fprintf( stderr, "No valid render mode given.\n" );
 				print_help();
@@ -240,6 +321,57 @@ int main( int argc, char **argv ) {
 			continue;
 		}
 
+		if ( 0 == strcmp( "--format", argv[arg] ) || 0 == strcmp( "-m", argv[arg] ) ) {
+			++arg;
+
+			if ( format ) {
+				fprintf( stderr, "Multiple --format parameters.\n" );
+				print_help();
+				exit( 1 );
+			}
+
+			if ( arg >= argc ) {
+				fprintf( stderr, "No format given.\n" );
+				print_help();
+				exit( 1 );
+			}
+
+			if ( strcmp( "header", argv[arg] ) && strcmp( "blob", argv[arg] ) &&
+				 strcmp( "array", argv[arg] ) ) {
+				fprintf( stderr, "No valid format given.\n" );
+				print_help();
+				exit( 1 );
+			}
+			format = argv[arg];
+
+			continue;
+		}
+
+		if ( 0 == strcmp( "--pack", argv[arg] ) || 0 == strcmp( "-p", argv[arg] ) ) {
+			++arg;
+
+			if ( pack ) {
+				fprintf( stderr, "Multiple --pack parameters.\n" );
+				print_help();
+				exit( 1 );
+			}
+
+			if ( arg >= argc ) {
+				fprintf( stderr, "No packing given.\n" );
+				print_help();
+				exit( 1 );
+			}
+
+			if ( strcmp( "batch", argv[arg] ) && strcmp( "string", argv[arg] ) ) {
+				fprintf( stderr, "No valid packing given.\n" );
+				print_help();
+				exit( 1 );
+			}
+			pack = argv[arg];
+
+			continue;
+		}
+
 		fprintf( stderr, "Unknown parameter %s\n", argv[arg] );
 		print_help();
 		exit( 1 );
@@ -274,47 +406,78 @@ int main( int argc, char **argv ) {
 		exit( 1 );
 	}
 
-	texture_atlas_t * atlas = texture_atlas_new( texture_width, texture_width, 1 );
+	if ( !format ) {
+		format = "header";
+	}
+
+	// Multi-channel distance fields take three channels
+	texture_atlas_t * atlas = texture_atlas_new( texture_width, texture_width,
+												 rendermode == RENDER_MSDF ? 3 : 1 );
 	texture_font_t  * font  = texture_font_new_from_file( atlas, font_size, font_filename );
 	font->rendermode = rendermode;
+	// Packed together, the glyphs take less of the texture
+	font->pack_batches = !pack || 0 == strcmp( "batch", pack );
 
 	size_t missed = texture_font_load_glyphs( font, font_cache );
 
+	// Rows of the texture the glyphs ended up in
+	size_t height_used = 0;
+	for ( i=0; i < font->glyphs->capacity; ++i ) {
+		glyph_entry_t *entry = font->glyphs->entries + i;
+		if ( entry->codepoint != GLYPH_TABLE_EMPTY &&
+			 (size_t) (entry->glyph->region.y + entry->glyph->region.height) > height_used ) {
+			height_used = entry->glyph->region.y + entry->glyph->region.height;
+		}
+	}
+
 	printf( "Font filename           : %s\n"
 			"Font size               : %.1f\n"
 			"Number of glyphs        : %ld\n"
 			"Number of missed glyphs : %ld\n"
 			"Texture size            : %ldx%ldx%ld\n"
 			"Texture occupancy       : %.2f%%\n"
+			"Texture height used     : %ld\n"
 			"\n"
 			"Header filename         : %s\n"
 			"Variable name           : %s\n"
-			"Render mode             : %s\n",
+			"Render mode             : %s\n"
+			"Output format           : %s\n"
+			"Packing                 : %s\n",
 			font_filename,
 			font_size,
 			strlen(font_cache),
 			missed,
 			atlas->width, atlas->height, atlas->depth,
 			100.0 * atlas->used / (float)(atlas->width * atlas->height),
+			height_used,
 			header_filename,
 			variable_name,
-			rendermodes[rendermode] );
+			rendermodes[rendermode],
+			format,
+			font->pack_batches ? "batch" : "string" );
+
+	// The blob holds the pixels, the glyphs and the kerning pairs the font
+	// has, instead of initializers for every 0x100 codepoints
+	if ( 0 != strcmp( "header", format ) ) {
+		return write_blob( font, header_filename, variable_name,
+						   0 == strcmp( "array", format ) ) ? 0 : 1;
+	}
 
 	size_t texture_size = atlas->width * atlas->height * atlas->depth;
-	size_t glyph_count = font->glyphs->size;
+	size_t glyph_count = 0;
 	size_t max_kerning_count = 1;
-	for ( i=0; i < glyph_count; ++i ) {
-		texture_glyph_t **glyph_0x100 = *(texture_glyph_t ***) vector_get( font->glyphs, i );
-	if (glyph_0x100) {
-		for ( j=0; j < 0x100; ++j ) {
-		texture_glyph_t *glyph;
-		if (( glyph = glyph_0x100[j] )) {
-			size_t new_max = vector_size(glyph->kerning);
+	texture_glyph_t * glyph;
+
+	// The header indexes glyphs with a two-stage table of 0x100 glyphs each
+	for ( i=0; i < font->glyphs->capacity; ++i ) {
+		glyph_entry_t *entry = font->glyphs->entries + i;
+		if ( entry->codepoint != GLYPH_TABLE_EMPTY ) {
+			size_t new_max = glyph_kerning_count( entry->glyph );
+			if ( (entry->codepoint >> 8) + 1 > glyph_count )
+			glyph_count = (entry->codepoint >> 8) + 1;
 			if ( new_max > max_kerning_count )
 			max_kerning_count = new_max;
 		}
-		}
-	}
 	}
 
 
@@ -405,9 +568,10 @@ int main( int argc, char **argv ) {
 		"    texture_glyph_0x100_t glyphs[%" PRIzu "];\n"
 		"} texture_font_t;\n\n", texture_size, glyph_count );
 
-	texture_glyph_t * glyph;
-
-	GLYPHS_ITERATOR(i, glyph, font->glyphs) {
+	for ( k=0; k < glyph_count << 8; ++k ) {
+	glyph = glyph_table_get( font->glyphs, k, font->rendermode, font->outline_thickness );
+	if ( !glyph || glyph->codepoint != k )
+		continue;
 	fprintf( file, "texture_glyph_t %s_glyph_%08x = ", variable_name, glyph->codepoint, glyph->codepoint );
  /*
 		// Debugging information
@@ -438,7 +602,6 @@ int main( int argc, char **argv ) {
 */
 	print_glyph(file, glyph);
 	}
-	GLYPHS_ITERATOR_END
 
 	fprintf( file, "texture_font_t %s = {\n", variable_name );
 
@@ -475,16 +638,19 @@ int main( int argc, char **argv ) {
 	// Texture glyphs
 	// --------------
 	fprintf( file, " {\n" );
-	GLYPHS_ITERATOR1(i, glyph, font->glyphs) {
+	for ( i=0; i < glyph_count; ++i ) {
 	fprintf( file, " {\n" );
-	GLYPHS_ITERATOR2(i, glyph, font->glyphs) {
+	for ( j=0; j < 0x100; ++j ) {
+		glyph = glyph_table_get( font->glyphs, (i << 8) | j,
+								 font->rendermode, font->outline_thickness );
+		if ( glyph ) {
 		fprintf( file, "  &%s_glyph_%08x,\n", variable_name, glyph->codepoint );
-	} else {
+		} else {
 		fprintf( file, "  NULL,\n" );
+		}
 	}
-	GLYPHS_ITERATOR_END1;
 	fprintf( file, " },\n" );
-	} GLYPHS_ITERATOR_END2;
+	}
 	fprintf( file, " }\n};\n" );
 	fprintf( file,
 		"#ifdef __cplusplus\n"
@@ -28,3 +28,155 @@ char *strndup( const char *s1, size_t n) {
 	return copy;
 };
 #endif
+
+
+#if defined(_WIN32) || defined(_WIN64)
+
+#include <windows.h>
+
+// ------------------------------------------------------ platform_map_file ---
+void *
+platform_map_file( const char * filename, size_t * size ) {
+	HANDLE file, mapping;
+	LARGE_INTEGER length;
+	void *base = NULL;
+
+	file = CreateFileA( filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+						OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( file == INVALID_HANDLE_VALUE ) {
+		return NULL;
+	}
+	if ( GetFileSizeEx( file, &length ) && length.QuadPart > 0 ) {
+		mapping = CreateFileMappingA( file, NULL, PAGE_WRITECOPY, 0, 0, NULL );
+		if ( mapping ) {
+			base = MapViewOfFile( mapping, FILE_MAP_COPY, 0, 0, 0 );
+			CloseHandle( mapping );
+		}
+	}
+	CloseHandle( file );
+	*size = base ? (size_t) length.QuadPart : 0;
+	return base;
+}
+
+// ---------------------------------------------------- platform_unmap_file ---
+void
+platform_unmap_file( void * base, size_t size ) {
+	UnmapViewOfFile( base );
+}
+
+#else
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// ------------------------------------------------------ platform_map_file ---
+void *
+platform_map_file( const char * filename, size_t * size ) {
+	struct stat st;
+	void *base = NULL;
+	int fd = open( filename, O_RDONLY );
+
+	if ( fd < 0 ) {
+		return NULL;
+	}
+	if ( !fstat( fd, &st ) && st.st_size > 0 ) {
+		base = mmap( NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+		if ( base == MAP_FAILED ) {
+			base = NULL;
+		}
+	}
+	close( fd );
+	*size = base ? (size_t) st.st_size : 0;
+	return base;
+}
+
+// ---------------------------------------------------- platform_unmap_file ---
+void
+platform_unmap_file( void * base, size_t size ) {
+	munmap( base, size );
+}
+
+#endif
+
+
+#if defined(PLATFORM_SIMD_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#ifdef FREETYPE_GL_USE_THREADS
+#include <pthread.h>
+
+static pthread_once_t platform_simd_once = PTHREAD_ONCE_INIT;
+#else
+static int platform_simd_once = 0;
+#endif
+static platform_simd_t platform_simd_detected = PLATFORM_SIMD_NONE;
+static platform_simd_t platform_simd_limit = PLATFORM_SIMD_BEST;
+
+// --------------------------------------------------- platform_simd_detect ---
+static platform_simd_t
+platform_simd_detect( void ) {
+#if defined(PLATFORM_SIMD_X86) && defined(_MSC_VER)
+	int info[4];
+
+	// AVX2 needs the operating system to save the ymm registers too
+	__cpuid( info, 0 );
+	if ( info[0] >= 7 ) {
+		__cpuidex( info, 7, 0 );
+		if ( info[1] & (1 << 5) ) {
+			__cpuid( info, 1 );
+			if ( (info[2] & (1 << 27)) && (_xgetbv( 0 ) & 6) == 6 ) {
+				return PLATFORM_SIMD_AVX2;
+			}
+		}
+	}
+	return PLATFORM_SIMD_SSE2;
+#elif defined(PLATFORM_SIMD_X86)
+	__builtin_cpu_init( );
+	if ( __builtin_cpu_supports( "avx2" ) ) {
+		return PLATFORM_SIMD_AVX2;
+	}
+	if ( __builtin_cpu_supports( "sse2" ) ) {
+		return PLATFORM_SIMD_SSE2;
+	}
+	return PLATFORM_SIMD_NONE;
+#elif defined(PLATFORM_SIMD_ARM)
+	return PLATFORM_SIMD_NEON;
+#else
+	return PLATFORM_SIMD_NONE;
+#endif
+}
+
+// ----------------------------------------------------- platform_simd_init ---
+static void
+platform_simd_init( void ) {
+	platform_simd_detected = platform_simd_detect( );
+}
+
+// ---------------------------------------------------------- platform_simd ---
+platform_simd_t
+platform_simd( void ) {
+	platform_simd_t simd;
+
+#ifdef FREETYPE_GL_USE_THREADS
+	pthread_once( &platform_simd_once, platform_simd_init );
+#else
+	if ( !platform_simd_once ) {
+		platform_simd_init( );
+		platform_simd_once = 1;
+	}
+#endif
+	simd = platform_simd_detected;
+	if ( platform_simd_limit < simd ) {
+		// NEON has no lesser instruction set than itself
+		simd = simd == PLATFORM_SIMD_NEON ? PLATFORM_SIMD_NONE : platform_simd_limit;
+	}
+	return simd;
+}
+
+// ---------------------------------------------------- platform_limit_simd ---
+void
+platform_limit_simd( platform_simd_t limit ) {
+	platform_simd_limit = limit;
+}
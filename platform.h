@@ -22,10 +22,58 @@ namespace ftgl {
 #    pragma warning (disable: 4244) // suspend warnings
 #endif // _WIN32 || _WIN64
 
+	/* Maps a whole file in memory, copy on write: the pages written to are
+	 * private to the process and the file is never changed. Returns NULL if
+	 * the file cannot be mapped (or is empty), its size otherwise goes to
+	 * size. */
+	void * platform_map_file( const char * filename, size_t * size );
+
+	/* Unmaps a file mapped with platform_map_file */
+	void platform_unmap_file( void * base, size_t size );
+
+	/* Instruction sets of the vectorized code paths (distance fields), the
+	 * best one the processor supports being picked at run time.
+	 * PLATFORM_SIMD_BEST is no instruction set, only the absence of a cap
+	 * for platform_limit_simd. */
+	typedef enum platform_simd_t {
+		PLATFORM_SIMD_NONE,
+		PLATFORM_SIMD_SSE2,
+		PLATFORM_SIMD_AVX2,
+		PLATFORM_SIMD_NEON,
+		PLATFORM_SIMD_BEST
+	} platform_simd_t;
+
+	/* Instruction set of the vectorized code paths: the best one both the
+	 * build (FREETYPE_GL_USE_SIMD) and the processor support, capped by
+	 * platform_limit_simd. PLATFORM_SIMD_NONE runs the scalar code. The
+	 * processor is only queried once, whatever the thread calling first. */
+	platform_simd_t platform_simd( void );
+
+	/* Caps the instruction set platform_simd picks, PLATFORM_SIMD_NONE for
+	 * the scalar code everywhere (to compare with it), PLATFORM_SIMD_BEST
+	 * (the default) for no cap. Not to be changed while glyphs are being
+	 * rasterized on other threads. */
+	void platform_limit_simd( platform_simd_t limit );
+
 #ifdef __cplusplus
 }
 #endif // __cplusplus
 
+/* Kernels for the instruction sets platform_simd may pick: x86 ones are
+ * compiled for their instruction set whatever the target of the build, with
+ * PLATFORM_TARGET, and only called when the processor has it */
+#if defined(FREETYPE_GL_USE_SIMD) && (defined(__GNUC__) || defined(__clang__)) && \
+	(defined(__x86_64__) || defined(__i386__))
+#define PLATFORM_SIMD_X86
+#define PLATFORM_TARGET(isa) __attribute__((target(isa)))
+#elif defined(FREETYPE_GL_USE_SIMD) && defined(_MSC_VER) && defined(_M_X64)
+#define PLATFORM_SIMD_X86
+#define PLATFORM_TARGET(isa)
+#elif defined(FREETYPE_GL_USE_SIMD) && (defined(__aarch64__) || defined(_M_ARM64))
+#define PLATFORM_SIMD_ARM
+#define PLATFORM_TARGET(isa)
+#endif
+
 #ifdef __ANDROID__
 #include <android/log.h>
 #define  LOG_TAG    "freetype-gl-demo-android"
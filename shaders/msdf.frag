@@ -0,0 +1,25 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+// Glyphs of a RENDER_MSDF font, with distance-field.vert: the median of the
+// three channels is the distance field, whose corners stay sharp.
+uniform sampler2D u_texture;
+
+const float glyph_center = 0.50;
+
+float median(float r, float g, float b)
+{
+    return max(min(r, g), min(max(r, g), b));
+}
+
+void main(void)
+{
+    vec3  texel = texture2D(u_texture, gl_TexCoord[0].st).rgb;
+    float dist  = median(texel.r, texel.g, texel.b);
+    float width = fwidth(dist);
+    float alpha = smoothstep(glyph_center-width, glyph_center+width, dist);
+
+    gl_FragColor = vec4(gl_Color.rgb, gl_Color.a*alpha);
+}
@@ -0,0 +1,66 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+// Same as text.frag, sampling the layer of a texture array given by the
+// third texture coordinate.
+#extension GL_EXT_texture_array : enable
+
+uniform sampler2DArray tex;
+uniform vec3 pixel;
+
+varying vec4 vcolor;
+varying vec3 vtex_coord;
+varying float vshift;
+varying float vgamma;
+
+void main()
+{
+    // LCD Off
+    if( pixel.z == 1.0)
+    {
+        float a = texture2DArray(tex, vtex_coord).r;
+        gl_FragColor = vcolor * pow( a, 1.0/vgamma );
+        return;
+    }
+
+    // LCD On
+    vec4 current = texture2DArray(tex, vtex_coord);
+    vec4 previous= texture2DArray(tex, vtex_coord+vec3(-pixel.x,0.,0.));
+    vec4 next    = texture2DArray(tex, vtex_coord+vec3(+pixel.x,0.,0.));
+
+    current = pow(current, vec4(1.0/vgamma));
+    previous= pow(previous, vec4(1.0/vgamma));
+
+    float r = current.r;
+    float g = current.g;
+    float b = current.b;
+
+    if( vshift <= 0.333 )
+    {
+        float z = vshift/0.333;
+        r = mix(current.r, previous.b, z);
+        g = mix(current.g, current.r,  z);
+        b = mix(current.b, current.g,  z);
+    }
+    else if( vshift <= 0.666 )
+    {
+        float z = (vshift-0.33)/0.333;
+        r = mix(previous.b, previous.g, z);
+        g = mix(current.r,  previous.b, z);
+        b = mix(current.g,  current.r,  z);
+    }
+    else if( vshift < 1.0 )
+    {
+        float z = (vshift-0.66)/0.334;
+        r = mix(previous.g, previous.r, z);
+        g = mix(previous.b, previous.g, z);
+        b = mix(current.r,  previous.b, z);
+    }
+
+    float t = max(max(r,g),b);
+    vec4 color = vec4(vcolor.rgb, (r+g+b)/3.0);
+    color = t*color + (1.0-t)*vec4(r,g,b, min(min(r,g),b));
+    gl_FragColor = vec4( color.rgb, vcolor.a*color.a);
+}
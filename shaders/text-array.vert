@@ -0,0 +1,30 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+// Same as text.vert, for an atlas of several pages uploaded as a texture
+// array: the third texture coordinate of text_buffer_t is the layer.
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+attribute vec3 vertex;
+attribute vec4 color;
+attribute vec3 tex_coord;
+attribute float ashift;
+attribute float agamma;
+
+varying vec4 vcolor;
+varying vec3 vtex_coord;
+varying float vshift;
+varying float vgamma;
+
+void main()
+{
+    vshift = ashift;
+    vgamma = agamma;
+    vcolor = color;
+    vtex_coord = tex_coord;
+    gl_Position = projection*(view*(model*vec4(vertex,1.0)));
+}
@@ -0,0 +1,564 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "texture-atlas.h"
+#include "texture-font.h"
+#include "text-buffer.h"
+
+static int failures = 0;
+
+#define CHECK( condition ) check( condition, #condition, __LINE__ )
+
+
+// ------------------------------------------------------------------ check ---
+void
+check( int condition, const char *text, int line ) {
+	if ( !condition ) {
+		fprintf( stderr, "test-texture-atlas.c:%d: check failed: %s\n", line, text );
+		failures++;
+	}
+}
+
+
+// --------------------------------------------------------------- contains ---
+int
+contains( const ivec4 *outer, const ivec4 *inner ) {
+	return inner->x >= outer->x && inner->y >= outer->y &&
+		inner->x + inner->width <= outer->x + outer->width &&
+		inner->y + inner->height <= outer->y + outer->height;
+}
+
+
+// ---------------------------------------------------------------- covered ---
+// Whether a rectangle is inside one of the dirty rectangles of the atlas
+int
+covered( const texture_atlas_t *atlas, const ivec4 *rect ) {
+	const ivec4 *dirty;
+	size_t i, count;
+
+	dirty = texture_atlas_get_dirty( atlas, &count );
+	for ( i = 0; i < count; ++i ) {
+		if ( contains( dirty + i, rect ) ) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+
+// ---------------------------------------------------------------- overlap ---
+int
+overlap( const ivec4 *a, const ivec4 *b ) {
+	return a->x < b->x + b->width && b->x < a->x + a->width &&
+		a->y < b->y + b->height && b->y < a->y + a->height;
+}
+
+
+// -------------------------------------------------------------- new_atlas ---
+// An atlas with nothing dirty
+texture_atlas_t *
+new_atlas( size_t width, size_t height ) {
+	texture_atlas_t *atlas = texture_atlas_new( width, height, 1 );
+
+	texture_atlas_clear_dirty( atlas );
+	return atlas;
+}
+
+
+// ------------------------------------------------------- test_whole_atlas ---
+void
+test_whole_atlas( void ) {
+	texture_atlas_t *atlas = texture_atlas_new( 64, 32, 1 );
+	ivec4 whole = {{0, 0, 64, 32}};
+	const ivec4 *dirty;
+	size_t count;
+
+	// A new atlas has to be uploaded as a whole
+	dirty = texture_atlas_get_dirty( atlas, &count );
+	CHECK( count == 1 );
+	CHECK( count == 1 && !memcmp( dirty, &whole, sizeof(ivec4) ) );
+	CHECK( atlas->modified );
+
+	texture_atlas_clear_dirty( atlas );
+	dirty = texture_atlas_get_dirty( atlas, &count );
+	CHECK( count == 0 && dirty == NULL );
+	CHECK( !atlas->modified );
+
+	// So does a cleared one
+	texture_atlas_get_region( atlas, 4, 4 );
+	texture_atlas_clear( atlas );
+	dirty = texture_atlas_get_dirty( atlas, &count );
+	CHECK( count == 1 && !memcmp( dirty, &whole, sizeof(ivec4) ) );
+
+	// And an enlarged one, with its new size
+	texture_atlas_clear_dirty( atlas );
+	texture_atlas_get_region( atlas, 4, 4 );
+	texture_atlas_enlarge_texture( atlas, 64, 64 );
+	whole.height = 64;
+	dirty = texture_atlas_get_dirty( atlas, &count );
+	CHECK( count == 1 && !memcmp( dirty, &whole, sizeof(ivec4) ) );
+
+	texture_atlas_delete( atlas );
+}
+
+
+// ------------------------------------------------------------ test_region ---
+void
+test_region( void ) {
+	texture_atlas_t *atlas = new_atlas( 64, 64 );
+	unsigned char data[10 * 8];
+	const ivec4 *dirty;
+	ivec4 region;
+	size_t count;
+
+	memset( data, 0xFF, sizeof(data) );
+
+	// A region handed out and uploaded is dirty once
+	region = texture_atlas_get_region( atlas, 10, 8 );
+	texture_atlas_set_region( atlas, region.x, region.y, 10, 8, data, 10 );
+	dirty = texture_atlas_get_dirty( atlas, &count );
+	CHECK( count == 1 && !memcmp( dirty, &region, sizeof(ivec4) ) );
+	CHECK( atlas->modified );
+
+	// Only the rectangle written to is dirty
+	texture_atlas_clear_dirty( atlas );
+	texture_atlas_set_region( atlas, region.x + 2, region.y + 3, 4, 2, data, 10 );
+	dirty = texture_atlas_get_dirty( atlas, &count );
+	CHECK( count == 1 && dirty[0].x == region.x + 2 && dirty[0].y == region.y + 3 &&
+		   dirty[0].width == 4 && dirty[0].height == 2 );
+
+	// A freed region is cleared, hence dirty
+	texture_atlas_clear_dirty( atlas );
+	texture_atlas_free_region( atlas, region );
+	CHECK( covered( atlas, &region ) );
+
+	// Empty rectangles are ignored
+	texture_atlas_clear_dirty( atlas );
+	texture_atlas_add_dirty( atlas, (ivec4){{5, 5, 0, 10}} );
+	texture_atlas_add_dirty( atlas, (ivec4){{5, 5, 10, 0}} );
+	texture_atlas_get_dirty( atlas, &count );
+	CHECK( count == 0 );
+
+	texture_atlas_delete( atlas );
+}
+
+
+// ------------------------------------------------------------- test_merge ---
+void
+test_merge( void ) {
+	texture_atlas_t *atlas = new_atlas( 256, 256 );
+	ivec4 rects[64];
+	const ivec4 *dirty;
+	size_t i, count, area;
+
+	// Side by side rectangles of the same height make one
+	texture_atlas_add_dirty( atlas, (ivec4){{10, 10, 5, 8}} );
+	texture_atlas_add_dirty( atlas, (ivec4){{15, 10, 7, 8}} );
+	dirty = texture_atlas_get_dirty( atlas, &count );
+	CHECK( count == 1 && dirty[0].x == 10 && dirty[0].width == 12 &&
+		   dirty[0].y == 10 && dirty[0].height == 8 );
+
+	// A rectangle inside another one adds nothing
+	texture_atlas_add_dirty( atlas, (ivec4){{12, 12, 2, 2}} );
+	dirty = texture_atlas_get_dirty( atlas, &count );
+	CHECK( count == 1 && dirty[0].width == 12 && dirty[0].height == 8 );
+
+	// Distant rectangles are kept apart
+	texture_atlas_add_dirty( atlas, (ivec4){{200, 200, 4, 4}} );
+	dirty = texture_atlas_get_dirty( atlas, &count );
+	CHECK( count == 2 );
+
+	// Scattered rectangles are merged down to max_dirty, all of them
+	// staying covered, the closest ones being merged first
+	texture_atlas_clear_dirty( atlas );
+	for ( i = 0; i < 64; ++i ) {
+		rects[i] = (ivec4){{1 + (i % 8) * 31, 1 + (i / 8) * 31, 6, 6}};
+		texture_atlas_add_dirty( atlas, rects[i] );
+	}
+	dirty = texture_atlas_get_dirty( atlas, &count );
+	CHECK( count == atlas->max_dirty );
+	for ( i = 0; i < 64; ++i ) {
+		CHECK( covered( atlas, rects + i ) );
+	}
+	for ( i = 0, area = 0; i < count; ++i ) {
+		area += dirty[i].width * dirty[i].height;
+	}
+	CHECK( area < 256 * 256 / 2 );
+
+	// With a single rectangle, it is the bounding box of all of them
+	atlas->max_dirty = 1;
+	texture_atlas_add_dirty( atlas, (ivec4){{1, 1, 1, 1}} );
+	dirty = texture_atlas_get_dirty( atlas, &count );
+	CHECK( count == 1 && dirty[0].x == 1 && dirty[0].y == 1 &&
+		   dirty[0].width == 7 * 31 + 6 && dirty[0].height == 7 * 31 + 6 );
+
+	texture_atlas_delete( atlas );
+}
+
+
+// ------------------------------------------------------------ test_glyphs ---
+void
+test_glyphs( void ) {
+	texture_atlas_t *atlas = new_atlas( 512, 512 );
+	ivec4 regions[200];
+	unsigned int seed = 1;
+	size_t i;
+
+	// Every region handed out stays covered until the dirty rectangles are
+	// cleared
+	for ( i = 0; i < 200; ++i ) {
+		seed = seed * 1664525u + 1013904223u;
+		regions[i] = texture_atlas_get_region( atlas, 4 + (seed >> 8) % 20,
+											   6 + (seed >> 16) % 24 );
+		CHECK( regions[i].x > 0 );
+	}
+	for ( i = 0; i < 200; ++i ) {
+		CHECK( covered( atlas, regions + i ) );
+	}
+	CHECK( vector_size( atlas->dirty ) <= atlas->max_dirty );
+
+	texture_atlas_delete( atlas );
+}
+
+
+// ------------------------------------------------------------ copy_region ---
+unsigned char *
+copy_region( const texture_atlas_t *atlas, const ivec4 *region ) {
+	size_t row, size = region->width * atlas->depth;
+	unsigned char *pixels = malloc( size * region->height );
+
+	for ( row = 0; row < (size_t) region->height; ++row ) {
+		memcpy( pixels + row * size,
+				atlas->data + ((region->y + row) * atlas->width + region->x) * atlas->depth,
+				size );
+	}
+	return pixels;
+}
+
+
+// ----------------------------------------------------------- test_compact ---
+void
+test_compact( void ) {
+	texture_atlas_t *atlas = new_atlas( 256, 256 );
+	texture_glyph_t *glyphs[95], *special = (texture_glyph_t *) atlas->special;
+	unsigned char *pixels[95], *current;
+	texture_font_t *kept, *deleted;
+	// The special glyph takes 5x5 pixels
+	size_t i, used, live = 5 * 5;
+	char text[2] = {0, 0};
+	ivec4 moved;
+
+	texture_font_default_mode( MODE_ALWAYS_OPEN );
+	deleted = texture_font_new_from_file( atlas, 10, "fonts/VeraMoBd.ttf" );
+	kept = texture_font_new_from_file( atlas, 10, "fonts/Vera.ttf" );
+	CHECK( kept && deleted );
+	if ( !kept || !deleted ) {
+		texture_atlas_delete( atlas );
+		return;
+	}
+	for ( i = 0; i < 95; ++i ) {
+		text[0] = ' ' + i;
+		texture_font_get_glyph( deleted, text );
+	}
+	for ( i = 0; i < 95; ++i ) {
+		text[0] = ' ' + i;
+		glyphs[i] = texture_font_get_glyph( kept, text );
+		pixels[i] = copy_region( atlas, &glyphs[i]->region );
+		live += glyphs[i]->region.width * glyphs[i]->region.height;
+	}
+
+	// The glyphs of the deleted font are gone, those of the other one move
+	// down to where they were
+	texture_font_delete( deleted );
+	used = atlas->used;
+	texture_atlas_clear_dirty( atlas );
+	moved = texture_atlas_compact( atlas );
+	CHECK( moved.x > 0 && moved.width > 0 );
+	CHECK( atlas->used == live && live < used );
+	CHECK( atlas->modified );
+
+	for ( i = 0; i < 95; ++i ) {
+		text[0] = ' ' + i;
+		CHECK( texture_font_find_glyph( kept, text ) == glyphs[i] );
+		current = copy_region( atlas, &glyphs[i]->region );
+		CHECK( !memcmp( current, pixels[i],
+						glyphs[i]->region.width * glyphs[i]->region.height ) );
+		CHECK( fabs( glyphs[i]->s0 * atlas->width - glyphs[i]->region.x ) < 1e-3 );
+		CHECK( fabs( glyphs[i]->t0 * atlas->height - glyphs[i]->region.y ) < 1e-3 );
+		CHECK( fabs( (glyphs[i]->s1 - glyphs[i]->s0) * atlas->width -
+					 glyphs[i]->width ) < 1e-3 );
+		CHECK( covered( atlas, &glyphs[i]->region ) );
+		free( current );
+		free( pixels[i] );
+	}
+	CHECK( glyphs['W' - ' ']->region.y + glyphs['W' - ' ']->region.height <=
+		   moved.y + moved.height );
+	CHECK( fabs( special->s0 * atlas->width - special->region.x - 2 ) < 1e-3 );
+	CHECK( atlas->data[(size_t) (special->t0 * atlas->height) * atlas->width +
+					   (size_t) (special->s0 * atlas->width)] == 255 );
+
+	// All of the freed space is in one piece at the top of the atlas
+	CHECK( vector_size( atlas->freed ) == 0 );
+	CHECK( texture_atlas_get_region( atlas, 254, 200 ).x == 1 );
+
+	// A compact atlas stays as it is
+	texture_atlas_clear_dirty( atlas );
+	moved = texture_atlas_compact( atlas );
+	CHECK( moved.width == 0 && vector_size( atlas->dirty ) == 0 );
+
+	texture_font_delete( kept );
+	texture_atlas_delete( atlas );
+}
+
+// ------------------------------------------------------------ test_layers ---
+void
+test_layers( void ) {
+	texture_atlas_t *atlas = new_atlas( 64, 64 );
+	texture_atlas_stats_t stats;
+	unsigned char data[20 * 20];
+	ivec4 regions[27], region;
+	const ivec4 *dirty;
+	size_t i, count;
+
+	atlas->max_layers = 3;
+	memset( data, 0xFF, sizeof(data) );
+
+	// Pages are filled one after the other, nine 20x20 regions each but
+	// for the first one, where the special glyph takes the room of one
+	for ( i = 0; i < 27; ++i ) {
+		regions[i] = texture_atlas_get_region( atlas, 20, 20 );
+		if ( i == 8 ) {
+			dirty = texture_atlas_get_dirty( atlas, &count );
+			CHECK( count == 1 && dirty[0].width == 64 && dirty[0].height == 128 );
+		}
+	}
+	CHECK( regions[26].x == -1 );
+	CHECK( atlas->layers == 3 && atlas->layer == 2 );
+	for ( i = 0; i < 26; ++i ) {
+		CHECK( (size_t) regions[i].y / 64 == (i + 1) / 9 );
+		CHECK( regions[i].y % 64 >= 1 && regions[i].y % 64 + 20 <= 63 );
+	}
+	stats = texture_atlas_get_stats( atlas );
+	CHECK( stats.area == 3 * 62 * 62 );
+	CHECK( stats.used == 26 * 20 * 20 + 5 * 5 );
+
+	// Regions of other pages are written where the texture array has them
+	texture_atlas_set_region( atlas, regions[20].x, regions[20].y, 20, 20, data, 20 );
+	CHECK( atlas->data[(2 * 64 + regions[20].y % 64) * 64 + regions[20].x] == 0xFF );
+
+	// Freed regions of full pages are reused
+	texture_atlas_free_region( atlas, regions[4] );
+	region = texture_atlas_get_region( atlas, 20, 20 );
+	CHECK( region.x == regions[4].x && region.y == regions[4].y );
+
+	// Clearing goes back to the first page, keeping all of them
+	texture_atlas_clear_dirty( atlas );
+	texture_atlas_clear( atlas );
+	CHECK( atlas->layers == 3 && atlas->layer == 0 );
+	dirty = texture_atlas_get_dirty( atlas, &count );
+	CHECK( count == 1 && dirty[0].height == 3 * 64 );
+	region = texture_atlas_get_region( atlas, 20, 20 );
+	CHECK( region.y > 0 && region.y < 64 );
+	texture_atlas_delete( atlas );
+
+	// An atlas that can grow does so before it adds pages
+	atlas = new_atlas( 64, 64 );
+	atlas->growth = 2;
+	atlas->max_width = atlas->max_height = 128;
+	atlas->max_layers = 2;
+	for ( i = 0; texture_atlas_get_region( atlas, 20, 20 ).x >= 0; ++i );
+	CHECK( atlas->width == 128 && atlas->height == 128 && atlas->layers == 2 );
+	CHECK( i == 35 + 36 );
+	texture_atlas_delete( atlas );
+}
+
+
+// ----------------------------------------------------------- test_packers ---
+// Both other packers hand out regions within the atlas that overlap neither
+// each other nor the special glyph, and reuse the ones freed.
+void
+test_packers( void ) {
+	const packer_t packers[2] = { PACKER_MAXRECTS, PACKER_SHELF };
+	texture_atlas_t *atlas;
+	texture_atlas_stats_t stats;
+	ivec4 regions[256], region;
+	size_t i, j, p, count, used;
+
+	for ( p = 0; p < 2; ++p ) {
+		atlas = new_atlas( 128, 128 );
+		texture_atlas_set_packer( atlas, packers[p] );
+		regions[0] = ((texture_glyph_t *) atlas->special)->region;
+		for ( count = 1; count < 256; ++count ) {
+			regions[count] = texture_atlas_get_region( atlas, 3 + count * 7 % 17,
+													   3 + count * 5 % 13 );
+			if ( regions[count].x < 0 ) {
+				break;
+			}
+		}
+		CHECK( count > 50 && count < 256 );
+		for ( i = 1; i < count; ++i ) {
+			CHECK( regions[i].x >= 1 && regions[i].y >= 1 &&
+				   regions[i].x + regions[i].width <= 127 &&
+				   regions[i].y + regions[i].height <= 127 );
+			for ( j = 0; j < i; ++j ) {
+				CHECK( !overlap( regions + i, regions + j ) );
+			}
+		}
+
+		// A full atlas still has the room of a freed region
+		used = atlas->used;
+		texture_atlas_free_region( atlas, regions[count / 2] );
+		CHECK( atlas->used == used - regions[count / 2].width * regions[count / 2].height );
+		region = texture_atlas_get_region( atlas, regions[count / 2].width,
+										   regions[count / 2].height );
+		CHECK( region.x == regions[count / 2].x && region.y == regions[count / 2].y );
+		CHECK( atlas->used == used );
+		texture_atlas_delete( atlas );
+	}
+
+	// Cleared, all the pages of an atlas are free, whatever the packer
+	for ( p = 0; p < 3; ++p ) {
+		atlas = new_atlas( 64, 64 );
+		atlas->max_layers = 2;
+		texture_atlas_set_packer( atlas, p < 2 ? packers[p] : PACKER_SKYLINE );
+		while ( texture_atlas_get_region( atlas, 20, 20 ).x >= 0 );
+		CHECK( atlas->layers == 2 );
+		texture_atlas_clear( atlas );
+		stats = texture_atlas_get_stats( atlas );
+		CHECK( stats.used == 0 && stats.free == stats.area && stats.area == 2 * 62 * 62 );
+		texture_atlas_delete( atlas );
+	}
+}
+
+
+// ---------------------------------------------------- test_shared_growth ---
+void
+test_shared_growth( void ) {
+	texture_atlas_t *atlas = new_atlas( 64, 64 );
+	texture_font_t *fonts[2];
+	texture_glyph_t *glyph;
+	size_t i, j, before = 0;
+	char text[2] = {0, 0};
+
+	atlas->growth = 2;
+	atlas->max_width = 64;
+	atlas->max_height = 256;
+	fonts[0] = texture_font_new_from_file( atlas, 10, "fonts/Vera.ttf" );
+	fonts[1] = texture_font_new_from_file( atlas, 8, "fonts/Vera.ttf" );
+	CHECK( fonts[0] != NULL && fonts[1] != NULL );
+	if ( !fonts[0] || !fonts[1] ) {
+		if ( fonts[0] ) texture_font_delete( fonts[0] );
+		if ( fonts[1] ) texture_font_delete( fonts[1] );
+		texture_atlas_delete( atlas );
+		return;
+	}
+
+	// Glyphs of both fonts fill the atlas in turns, until it grows
+	for ( i = 0; i < 95 && atlas->height == 64; ++i ) {
+		text[0] = ' ' + i;
+		for ( j = 0; j < 2; ++j ) {
+			CHECK( texture_font_get_glyph( fonts[j], text ) != NULL );
+		}
+	}
+	CHECK( atlas->width == 64 && atlas->height > 64 );
+
+	// The texture coordinates of every glyph of both fonts follow the new
+	// size, those loaded before it as well
+	for ( j = 0; j < 2; ++j ) {
+		GLYPHS_ITERATOR(i, glyph, fonts[j]->glyphs) {
+			if ( !glyph->region.width ) {
+				continue;
+			}
+			CHECK( fabs( glyph->s0 * atlas->width - glyph->region.x ) < 1e-3 );
+			CHECK( fabs( glyph->t0 * atlas->height - glyph->region.y ) < 1e-3 );
+			before += glyph->region.y < 64;
+		} GLYPHS_ITERATOR_END
+	}
+	CHECK( before > 0 );
+
+	texture_font_delete( fonts[0] );
+	texture_font_delete( fonts[1] );
+	texture_atlas_delete( atlas );
+}
+
+
+// ------------------------------------------------------ test_layer_glyphs ---
+void
+test_layer_glyphs( void ) {
+	texture_atlas_t *atlas = new_atlas( 64, 64 );
+	text_buffer_t *buffer = text_buffer_new( );
+	markup_t markup;
+	texture_glyph_t *glyph;
+	glyph_vertex_t *vertex;
+	size_t i, last = 0;
+	vec2 pen = {{0, 0}};
+	char text[2] = {0, 0};
+
+	atlas->max_layers = 16;
+	memset( &markup, 0, sizeof(markup_t) );
+	markup.gamma = 1.0;
+	markup.foreground_color = (vec4){{0.0, 0.0, 0.0, 1.0}};
+	markup.font = texture_font_new_from_file( atlas, 10, "fonts/Vera.ttf" );
+	CHECK( markup.font != NULL );
+	if ( !markup.font ) {
+		text_buffer_delete( buffer );
+		texture_atlas_delete( atlas );
+		return;
+	}
+
+	// Glyphs carry their page, their texture coordinates are within it
+	for ( i = 0; i < 95; ++i ) {
+		text[0] = ' ' + i;
+		glyph = texture_font_get_glyph( markup.font, text );
+		CHECK( glyph != NULL );
+		if ( !glyph ) {
+			continue;
+		}
+		CHECK( glyph->layer == glyph->region.y / atlas->height );
+		CHECK( glyph->layer >= last );
+		CHECK( fabs( glyph->t0 * atlas->height - glyph->region.y % atlas->height ) < 1e-3 );
+		CHECK( glyph->t1 <= 1 );
+		last = glyph->layer;
+	}
+	CHECK( atlas->layers > 1 && last == atlas->layers - 1 );
+
+	// The text buffer hands the layer over with the texture coordinates
+	text_buffer_add_text( buffer, &pen, &markup, "~", 1 );
+	glyph = texture_font_get_glyph( markup.font, "~" );
+	CHECK( vector_size( buffer->buffer->vertices ) == 4 );
+	for ( i = 0; i < vector_size( buffer->buffer->vertices ); ++i ) {
+		vertex = (glyph_vertex_t *) vector_get( buffer->buffer->vertices, i );
+		CHECK( vertex->layer == glyph->layer && vertex->layer > 0 );
+	}
+
+	text_buffer_delete( buffer );
+	texture_font_delete( markup.font );
+	texture_atlas_delete( atlas );
+}
+
+// ------------------------------------------------------------------- main ---
+int main( void ) {
+	test_whole_atlas( );
+	test_region( );
+	test_merge( );
+	test_glyphs( );
+	test_compact( );
+	test_layers( );
+	test_packers( );
+	test_shared_growth( );
+	test_layer_glyphs( );
+
+	if ( failures ) {
+		fprintf( stderr, "%d check(s) failed\n", failures );
+		return EXIT_FAILURE;
+	}
+	printf( "All texture atlas checks passed\n" );
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,1572 @@
+/* Freetype GL - A C OpenGL Freetype engine
+ *
+ * Distributed under the OSI-approved BSD 2-Clause License.  See accompanying
+ * file `LICENSE` for more details.
+ */
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_OUTLINE_H
+
+#include "texture-atlas.h"
+#include "texture-font.h"
+#include "freetype-gl-err.h"
+#include "platform.h"
+
+static int failures = 0;
+
+static const char *text = "The quick brown fox jumps over the lazy dog. AVAWTo";
+
+#define CHECK( condition ) check( condition, #condition, __LINE__ )
+
+
+// ------------------------------------------------------------------ check ---
+void
+check( int condition, const char *text, int line ) {
+	if ( !condition ) {
+		fprintf( stderr, "test-texture-font.c:%d: check failed: %s\n", line, text );
+		failures++;
+	}
+}
+
+
+// ------------------------------------------------------------ same_glyph ---
+int
+same_glyph( const texture_glyph_t *a, const texture_glyph_t *b ) {
+	return a && b && a->codepoint == b->codepoint &&
+		a->width == b->width && a->height == b->height &&
+		a->offset_x == b->offset_x && a->offset_y == b->offset_y &&
+		a->advance_x == b->advance_x && a->advance_y == b->advance_y &&
+		a->s0 == b->s0 && a->t0 == b->t0 && a->s1 == b->s1 && a->t1 == b->t1 &&
+		!memcmp( &a->region, &b->region, sizeof(ivec4) );
+}
+
+
+// ------------------------------------------------------------ same_pixels ---
+int
+same_pixels( const texture_atlas_t *atlas_a, const texture_glyph_t *a,
+			 const texture_atlas_t *atlas_b, const texture_glyph_t *b ) {
+	size_t y, depth = atlas_a->depth;
+
+	if ( !a || !b || a->width != b->width || a->height != b->height ||
+		 atlas_b->depth != depth ) {
+		return 0;
+	}
+	for ( y = 0; y < a->height; ++y ) {
+		if ( memcmp( atlas_a->data + ((a->region.y + y) * atlas_a->width + a->region.x) * depth,
+					 atlas_b->data + ((b->region.y + y) * atlas_b->width + b->region.x) * depth,
+					 a->width * depth ) ) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+
+// -------------------------------------------------------------- same_font ---
+// Whether a font loaded from another one has its metrics, finds the same
+// glyphs for the same codepoints and has the same kerning pairs
+int
+same_font( texture_font_t *a, texture_font_t *b ) {
+	const glyph_entry_t *entry;
+	const kerning_pair_t *pair, *found;
+	texture_glyph_t *glyph;
+	size_t i;
+
+	if ( a->glyphs->size != b->glyphs->size ||
+		 a->kerning_table->size != b->kerning_table->size ||
+		 a->height != b->height || a->ascender != b->ascender ||
+		 a->descender != b->descender || a->linegap != b->linegap ) {
+		return 0;
+	}
+	for ( i = 0; i < b->glyphs->capacity; ++i ) {
+		entry = b->glyphs->entries + i;
+		if ( entry->codepoint == GLYPH_TABLE_EMPTY ) {
+			continue;
+		}
+		// A missing glyph stands in for its codepoint in both
+		glyph = texture_font_find_glyph_utf32( a, entry->codepoint );
+		if ( !same_glyph( glyph, entry->glyph ) || glyph->font != a ||
+			 glyph != texture_font_find_glyph_utf32( a, entry->glyph->codepoint ) ) {
+			return 0;
+		}
+	}
+	for ( i = 0; i < b->kerning_table->capacity; ++i ) {
+		pair = b->kerning_table->pairs + i;
+		if ( pair->left != KERNING_TABLE_EMPTY &&
+			 (!(found = kerning_table_find( a->kerning_table, pair->left, pair->right )) ||
+			  found->kerning != pair->kerning) ) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+
+// ------------------------------------------------------------ count_error ---
+static int errors = 0;
+
+void
+count_error( int code, char *message, char *format, ... ) {
+	(void) code;
+	(void) message;
+	(void) format;
+	errors++;
+}
+
+
+// ----------------------------------------------------- test_kerning_cache ---
+void
+test_kerning_cache( void ) {
+	texture_atlas_t *atlas = texture_atlas_new( 256, 256, 1 );
+	texture_font_t *font, *reference;
+	void (*errhook)(int, char *, char *, ...) = freetype_gl_errhook;
+	const char *p, *q;
+	int failures_before;
+
+	font = texture_font_new_from_file( atlas, 10, "fonts/Vera.ttf" );
+	reference = texture_font_new_from_file( atlas, 10, "fonts/Vera.ttf" );
+	CHECK( font && reference );
+	if ( !font || !reference ) {
+		if ( font ) texture_font_delete( font );
+		if ( reference ) texture_font_delete( reference );
+		texture_atlas_delete( atlas );
+		return;
+	}
+	texture_font_set_kerning_mode( font, KERNING_ON_DEMAND, 8 );
+	texture_font_load_glyphs( font, text );
+	texture_font_load_glyphs( reference, text );
+
+	// A full cache drops a pair at a time, and keeps the last one
+	for ( p = text; *p; ++p ) {
+		for ( q = text; *q; ++q ) {
+			char left[2] = { *p, 0 }, right[2] = { *q, 0 };
+
+			CHECK( texture_glyph_get_kerning( texture_font_find_glyph( font, right ), left ) ==
+				   texture_glyph_get_kerning( texture_font_find_glyph( reference, right ), left ) );
+			CHECK( kerning_table_find( font->kerning_table, *p, *q ) != NULL );
+			CHECK( font->kerning_table->size <= 8 );
+		}
+	}
+	CHECK( font->kerning_table->size == 8 );
+	CHECK( texture_glyph_get_kerning( texture_font_find_glyph( font, "V" ), "A" ) < 0 );
+	texture_font_delete( reference );
+
+	// A face that cannot be opened anymore fails once, not for each pair
+	texture_font_close( font, MODE_ALWAYS_OPEN, MODE_AUTO_CLOSE );
+	free( font->filename );
+	font->filename = malloc( sizeof("fonts/missing") );
+	strcpy( font->filename, "fonts/missing" );
+	freetype_gl_errhook = count_error;
+	errors = 0;
+	failures_before = failures;
+	for ( p = "0123456789"; *p; ++p ) {
+		char left[2] = { *p, 0 };
+
+		CHECK( texture_glyph_get_kerning( texture_font_find_glyph( font, "A" ), left ) == 0 );
+	}
+	freetype_gl_errhook = errhook;
+	CHECK( errors == 1 && font->kerning_failed );
+	CHECK( failures == failures_before );
+
+	texture_font_delete( font );
+	texture_atlas_delete( atlas );
+}
+
+
+// ---------------------------------------------------- test_glyph_iterators ---
+void
+test_glyph_iterators( void ) {
+	texture_atlas_t *atlas = texture_atlas_new( 256, 256, 1 );
+	texture_font_t *font = texture_font_new_from_file( atlas, 10, "fonts/Vera.ttf" );
+	texture_glyph_t *glyph;
+	size_t i, count = 0, staged = 0, passes = 0;
+
+	CHECK( font != NULL );
+	if ( !font ) {
+		texture_atlas_delete( atlas );
+		return;
+	}
+	texture_font_load_glyphs( font, text );
+	// A missing glyph stands in for its codepoint, and is seen once
+	texture_font_load_glyph( font, "\xe4\xb8\xad" );
+
+	GLYPHS_ITERATOR(i, glyph, font->glyphs) {
+		count++;
+		CHECK( glyph->glyphmode == GLYPH_END );
+	} GLYPHS_ITERATOR_END
+
+	// The two stages of the former page index, and their ends
+	GLYPHS_ITERATOR1(i, glyph, font->glyphs) {
+		passes++;
+		GLYPHS_ITERATOR2(i, glyph, font->glyphs) {
+			staged++;
+		}
+		GLYPHS_ITERATOR_END1
+	} GLYPHS_ITERATOR_END2
+	CHECK( count > 0 && staged == count && passes == 1 );
+
+	staged = 0;
+	GLYPHS_ITERATOR(i, glyph, font->glyphs) {
+		staged++;
+	} GLYPHS_ITERATOR_END1
+	GLYPHS_ITERATOR_END2
+	CHECK( staged == count );
+
+	texture_font_delete( font );
+	texture_atlas_delete( atlas );
+}
+
+
+// ------------------------------------------------------------- test_async ---
+void
+test_async( void ) {
+	texture_atlas_t *atlases[3];
+	texture_font_t *fonts[3];
+	texture_glyph_t *glyph, *placeholder;
+	size_t i, published = 0, tries;
+	const char *p;
+
+	for ( i = 0; i < 3; ++i ) {
+		atlases[i] = texture_atlas_new( 256, 256, 1 );
+		fonts[i] = texture_font_new_from_file( atlases[i], 10, "fonts/Vera.ttf" );
+		CHECK( fonts[i] != NULL );
+		if ( !fonts[i] ) {
+			texture_atlas_delete( atlases[i] );
+			while ( i-- ) {
+				texture_font_delete( fonts[i] );
+				texture_atlas_delete( atlases[i] );
+			}
+			return;
+		}
+	}
+
+	// Requests keep the settings of the font when they were made, however
+	// it is set up when they are committed
+	fonts[0]->rendermode = fonts[1]->rendermode = RENDER_SIGNED_DISTANCE_FIELD;
+	fonts[0]->distance_spread = fonts[1]->distance_spread = 4;
+	placeholder = texture_font_get_glyph_async( fonts[0], "A" );
+	CHECK( placeholder == texture_font_find_glyph_utf32( fonts[0], -1 ) );
+	fonts[0]->rendermode = RENDER_NORMAL;
+	fonts[0]->hinting = fonts[2]->hinting = 0;
+	CHECK( texture_font_get_glyph_async( fonts[0], "B" ) == placeholder );
+	fonts[0]->rendermode = RENDER_SIGNED_DISTANCE_FIELD;
+	fonts[0]->distance_spread = 0;
+	fonts[0]->hinting = 1;
+
+	for ( tries = 0; published < 2 && tries < 1000000; ++tries ) {
+		published += texture_font_commit( fonts[0], NULL );
+	}
+	CHECK( published == 2 );
+	CHECK( fonts[0]->distance_spread == 0 && fonts[0]->hinting == 1 );
+
+	texture_font_load_glyph( fonts[1], "A" );
+	texture_font_load_glyph( fonts[2], "B" );
+	glyph = glyph_table_get( fonts[0]->glyphs, 'A', RENDER_SIGNED_DISTANCE_FIELD, 0 );
+	CHECK( same_pixels( atlases[0], glyph, atlases[1], texture_font_find_glyph( fonts[1], "A" ) ) );
+	CHECK( glyph && glyph->offset_x == texture_font_find_glyph( fonts[1], "A" )->offset_x );
+	glyph = glyph_table_get( fonts[0]->glyphs, 'B', RENDER_NORMAL, 0 );
+	CHECK( same_pixels( atlases[0], glyph, atlases[2], texture_font_find_glyph( fonts[2], "B" ) ) );
+	CHECK( texture_font_commit( fonts[0], NULL ) == 0 );
+
+	for ( i = 0; i < 3; ++i ) {
+		texture_font_delete( fonts[i] );
+		texture_atlas_delete( atlases[i] );
+	}
+
+	// The placeholder is the least recently used glyph, yet it is not
+	// evicted to make room for others
+	atlases[0] = texture_atlas_new( 32, 32, 1 );
+	fonts[0] = texture_font_new_from_file( atlases[0], 10, "fonts/Vera.ttf" );
+	CHECK( fonts[0] != NULL );
+	if ( !fonts[0] ) {
+		texture_atlas_delete( atlases[0] );
+		return;
+	}
+	fonts[0]->evict = 1;
+	fonts[0]->placeholder = texture_font_get_glyph( fonts[0], "." );
+	for ( p = text; *p; ++p ) {
+		char digit[2] = { *p, 0 };
+
+		texture_font_get_glyph( fonts[0], digit );
+	}
+	for ( p = "0123456789abcdefghijklmnopqrstuvwxyz"; *p; ++p ) {
+		char letter[2] = { *p, 0 };
+
+		texture_font_get_glyph( fonts[0], letter );
+	}
+	CHECK( vector_size( fonts[0]->evicted ) > 0 );
+	for ( i = 0; i < vector_size( fonts[0]->evicted ); ++i ) {
+		CHECK( *(texture_glyph_t **) vector_get( fonts[0]->evicted, i ) != fonts[0]->placeholder );
+	}
+	CHECK( glyph_table_get( fonts[0]->glyphs, '.', RENDER_NORMAL, 0 ) == fonts[0]->placeholder );
+	texture_font_delete( fonts[0] );
+	texture_atlas_delete( atlases[0] );
+}
+
+
+// ------------------------------------------------------ test_pack_batches ---
+void
+test_pack_batches( void ) {
+	texture_atlas_t *atlases[3];
+	texture_font_t *fonts[3];
+	void (*errhook)(int, char *, char *, ...) = freetype_gl_errhook;
+	size_t i, missed[3] = {0, 0, 0};
+	const char *p;
+
+	for ( i = 0; i < 3; ++i ) {
+		atlases[i] = texture_atlas_new( 40, 40, 1 );
+		fonts[i] = texture_font_new_from_file( atlases[i], 10, "fonts/Vera.ttf" );
+		CHECK( fonts[i] != NULL );
+		if ( !fonts[i] ) {
+			texture_atlas_delete( atlases[i] );
+			while ( i-- ) {
+				texture_font_delete( fonts[i] );
+				texture_atlas_delete( atlases[i] );
+			}
+			return;
+		}
+	}
+
+	// By default a batch packs as its glyphs loaded one at a time, and
+	// stops at the first one that does not fit
+	freetype_gl_errhook = count_error;
+	missed[0] = texture_font_load_glyphs( fonts[0], text );
+	for ( p = text; *p; ++p ) {
+		char letter[2] = { *p, 0 };
+
+		if ( !texture_font_load_glyph( fonts[1], letter ) ) {
+			missed[1] = strlen( p );
+			break;
+		}
+	}
+	CHECK( missed[0] > 0 && missed[0] == missed[1] );
+	CHECK( !memcmp( atlases[0]->data, atlases[1]->data, 40 * 40 ) );
+
+	// Packed together, more of them fit
+	fonts[2]->pack_batches = 1;
+	missed[2] = texture_font_load_glyphs( fonts[2], text );
+	freetype_gl_errhook = errhook;
+	CHECK( fonts[2]->glyphs->size > fonts[0]->glyphs->size );
+	CHECK( missed[2] > 0 && missed[2] < missed[0] );
+
+	for ( i = 0; i < 3; ++i ) {
+		texture_font_delete( fonts[i] );
+		texture_atlas_delete( atlases[i] );
+	}
+}
+
+
+// ------------------------------------------------------ test_direct_raster ---
+// Glyphs loaded one at a time are rendered straight into the atlas, those
+// of a batch through a buffer of their own: both give the same atlas.
+void
+test_direct_raster( void ) {
+	const rendermode_t modes[2] = { RENDER_NORMAL, RENDER_OUTLINE_EDGE };
+	texture_atlas_t *atlases[2];
+	texture_font_t *fonts[2];
+	size_t i, m;
+	const char *p;
+
+	for ( m = 0; m < 2; ++m ) {
+		for ( i = 0; i < 2; ++i ) {
+			atlases[i] = texture_atlas_new( 256, 256, 1 );
+			fonts[i] = texture_font_new_from_file( atlases[i], 10, "fonts/Vera.ttf" );
+			CHECK( fonts[i] != NULL );
+			if ( !fonts[i] ) {
+				texture_atlas_delete( atlases[i] );
+				if ( i ) {
+					texture_font_delete( fonts[0] );
+					texture_atlas_delete( atlases[0] );
+				}
+				return;
+			}
+			fonts[i]->rendermode = modes[m];
+			fonts[i]->outline_thickness = m;
+		}
+
+		for ( p = text; *p; ++p ) {
+			char letter[2] = { *p, 0 };
+
+			CHECK( texture_font_load_glyph( fonts[0], letter ) );
+		}
+		CHECK( texture_font_load_glyphs( fonts[1], text ) == 0 );
+		for ( p = text; *p; ++p ) {
+			char letter[2] = { *p, 0 };
+			texture_glyph_t *direct = texture_font_find_glyph( fonts[0], letter );
+			texture_glyph_t *buffered = texture_font_find_glyph( fonts[1], letter );
+
+			CHECK( same_glyph( direct, buffered ) );
+			CHECK( same_pixels( atlases[0], direct, atlases[1], buffered ) );
+		}
+		CHECK( !memcmp( atlases[0]->data, atlases[1]->data, 256 * 256 ) );
+
+		for ( i = 0; i < 2; ++i ) {
+			texture_font_delete( fonts[i] );
+			texture_atlas_delete( atlases[i] );
+		}
+	}
+}
+
+
+// -------------------------------------------------------- test_get_glyphs ---
+void
+test_get_glyphs( void ) {
+	texture_atlas_t *atlas = texture_atlas_new( 64, 64, 1 );
+	texture_font_t *font = texture_font_new_from_file( atlas, 10, "fonts/Vera.ttf" );
+	uint32_t codepoints[94];
+	texture_glyph_t *glyphs[94];
+	float kerning[94];
+	size_t i, missed, count;
+
+	CHECK( font != NULL );
+	if ( !font ) {
+		texture_atlas_delete( atlas );
+		return;
+	}
+
+	// The glyphs are those found one at a time, with their kerning
+	for ( i = 0; i < 4; ++i ) {
+		codepoints[i] = "AVAW"[i];
+	}
+	CHECK( texture_font_get_glyphs_utf32( font, codepoints, 4, glyphs, kerning ) == 0 );
+	for ( i = 0; i < 4; ++i ) {
+		CHECK( glyphs[i] && glyphs[i] == texture_font_find_glyph_utf32( font, codepoints[i] ) );
+	}
+	CHECK( kerning[0] == 0 && kerning[1] < 0 &&
+		   kerning[1] == texture_glyph_get_kerning( glyphs[1], "A" ) );
+
+	// In a full atlas, loading the last glyphs of a string does not evict
+	// the first ones: those that do not fit are missed
+	font->evict = 1;
+	for ( i = 0; i < 94; ++i ) {
+		codepoints[i] = 0x21 + i;
+	}
+	missed = texture_font_get_glyphs_utf32( font, codepoints, 94, glyphs, NULL );
+	texture_font_release_evicted( font );
+	for ( i = count = 0; i < 94; ++i ) {
+		if ( glyphs[i] ) {
+			CHECK( glyph_table_get( font->glyphs, codepoints[i], RENDER_NORMAL, 0 ) == glyphs[i] );
+		} else {
+			count++;
+		}
+	}
+	CHECK( missed > 0 && missed < 94 && missed == count );
+	CHECK( font->pinned == 0 );
+
+	texture_font_delete( font );
+	texture_atlas_delete( atlas );
+}
+
+
+// ------------------------------------------------------------- test_clone ---
+void
+test_clone( void ) {
+	texture_atlas_t *atlas = texture_atlas_new( 256, 256, 1 );
+	texture_font_t *font, *clone, *loaded;
+	void *blob;
+	size_t size;
+
+	font = texture_font_new_from_file( atlas, 10, "fonts/Vera.ttf" );
+	CHECK( font != NULL );
+	if ( !font ) {
+		texture_atlas_delete( atlas );
+		return;
+	}
+	font->evict = 1;
+	CHECK( texture_font_load_glyphs( font, text ) == 0 );
+	font->placeholder = texture_font_find_glyph( font, "A" );
+
+	// The clone owns nothing of the font and outlives it
+	clone = texture_font_clone( font, 8 );
+	CHECK( clone != NULL );
+	if ( !clone ) {
+		texture_font_delete( font );
+		texture_atlas_delete( atlas );
+		return;
+	}
+	CHECK( clone->placeholder == NULL && clone->use_count == 0 && clone->lru_first == NULL );
+	CHECK( clone->filename != font->filename && !strcmp( clone->filename, font->filename ) );
+	CHECK( clone->face != font->face && clone->glyphs->size == 0 );
+	CHECK( vector_size( atlas->fonts ) == 2 );
+	texture_font_delete( font );
+	CHECK( vector_size( atlas->fonts ) == 1 );
+	CHECK( texture_font_load_glyphs( clone, text ) == 0 );
+	CHECK( texture_font_find_glyph( clone, "A" ) != NULL );
+
+	// A clone that fails leaves no font behind in the atlas
+	blob = texture_font_make_blob( clone, &size );
+	CHECK( blob != NULL );
+	loaded = blob ? texture_font_new_from_blob( blob, size ) : NULL;
+	CHECK( loaded != NULL );
+	if ( loaded ) {
+		CHECK( texture_font_clone( loaded, 8 ) == NULL );
+		CHECK( vector_size( loaded->atlas->fonts ) == 1 );
+		texture_atlas_delete( loaded->atlas );
+		texture_font_delete( loaded );
+	}
+	free( blob );
+
+	texture_font_delete( clone );
+	texture_atlas_delete( atlas );
+}
+
+
+// ---------------------------------------------------------- test_eviction ---
+void
+test_eviction( void ) {
+	texture_atlas_t *atlas = texture_atlas_new( 96, 96, 1 );
+	texture_font_t *font = texture_font_new_from_file( atlas, 10, "fonts/Vera.ttf" );
+	texture_glyph_t *glyph;
+	const kerning_pair_t *pair;
+	size_t i, round, loaded, resident, linked, most = 0;
+	uint32_t c;
+
+	CHECK( font != NULL );
+	if ( !font ) {
+		texture_atlas_delete( atlas );
+		return;
+	}
+
+	// Lookups leave the glyphs alone until eviction is on, and those
+	// loaded before are then the least recently used
+	CHECK( texture_font_load_glyphs( font, text ) == 0 );
+	CHECK( texture_font_find_glyph( font, "T" ) != NULL );
+	CHECK( font->use_count == 0 && font->lru_first == NULL );
+	font->evict = 1;
+
+	// The printable Latin-1 codepoints, three times, are far more glyphs
+	// than the atlas holds
+	for ( round = 0; round < 3; ++round ) {
+		loaded = 0;
+		for ( c = 0x21; c < 0x100; ++c ) {
+			char utf8[3] = { c < 0x80 ? c : 0xC0 | c >> 6, c < 0x80 ? 0 : 0x80 | (c & 0x3F), 0 };
+
+			if ( c >= 0x7F && c < 0xA1 ) {
+				continue;
+			}
+			CHECK( texture_font_load_glyph( font, utf8 ) );
+			texture_font_release_evicted( font );
+			loaded++;
+			CHECK( font->lru_last && font->lru_last->codepoint == c );
+		}
+
+		// Only the glyphs left are listed, least recently used first
+		resident = linked = 0;
+		GLYPHS_ITERATOR(i, glyph, font->glyphs) {
+			resident++;
+		} GLYPHS_ITERATOR_END
+		for ( glyph = font->lru_first; glyph; glyph = glyph->lru_next ) {
+			CHECK( !glyph->lru_next || glyph->last_use < glyph->lru_next->last_use );
+			linked++;
+		}
+		CHECK( linked == resident && resident < loaded );
+
+		// Kerning pairs of evicted glyphs go along with them
+		for ( i = 0; i < font->kerning_table->capacity; ++i ) {
+			pair = font->kerning_table->pairs + i;
+			if ( pair->left != KERNING_TABLE_EMPTY ) {
+				CHECK( glyph_table_get( font->glyphs, pair->left, RENDER_NORMAL, 0 ) &&
+					   glyph_table_get( font->glyphs, pair->right, RENDER_NORMAL, 0 ) );
+			}
+		}
+		if ( round == 1 ) {
+			most = font->kerning_table->capacity;
+		}
+	}
+	CHECK( most > 0 && font->kerning_table->capacity == most );
+
+	texture_font_delete( font );
+	texture_atlas_delete( atlas );
+}
+
+
+// ---------------------------------------------------------- test_snapshot ---
+void
+test_snapshot( const char *path ) {
+	texture_atlas_t *atlas = texture_atlas_new( 256, 256, 1 ), *loaded_atlas;
+	texture_font_t *font, *loaded;
+	const char *p;
+
+	font = texture_font_new_from_file( atlas, 10, "fonts/Vera.ttf" );
+	CHECK( font != NULL );
+	if ( !font ) {
+		texture_atlas_delete( atlas );
+		return;
+	}
+	texture_font_load_glyphs( font, text );
+	// A missing glyph stands in for its codepoint
+	texture_font_load_glyph( font, "\xe4\xb8\xad" );
+	CHECK( texture_font_save_snapshot( font, path ) );
+
+	loaded = texture_font_load_snapshot( path, "fonts/Vera.ttf", 10, RENDER_NORMAL );
+	CHECK( loaded != NULL );
+	if ( !loaded ) {
+		texture_font_delete( font );
+		texture_atlas_delete( atlas );
+		return;
+	}
+	loaded_atlas = loaded->atlas;
+
+	// The pixels are read in place, and are those of the saved atlas
+	CHECK( loaded_atlas->mapping && loaded->mapping == loaded_atlas->mapping );
+	CHECK( loaded_atlas->data > loaded_atlas->mapping->base &&
+		   loaded_atlas->data < loaded_atlas->mapping->base + loaded_atlas->mapping->size );
+	CHECK( loaded_atlas->width == 256 && loaded_atlas->height == 256 );
+	CHECK( !memcmp( loaded_atlas->data, atlas->data, 256 * 256 ) );
+	CHECK( loaded_atlas->used == atlas->used );
+	CHECK( same_glyph( loaded_atlas->special, atlas->special ) );
+
+	CHECK( same_font( loaded, font ) );
+	CHECK( texture_font_find_glyph( loaded, "\xe4\xb8\xad" ) ==
+		   texture_font_find_glyph_utf32( loaded, 0 ) );
+	// Settings left out of the snapshot are those of a new font
+	CHECK( loaded->threads == font->threads && loaded->pack_batches == font->pack_batches &&
+		   loaded->distance_oversample == font->distance_oversample );
+	CHECK( texture_glyph_get_kerning( texture_font_find_glyph( loaded, "V" ), "A" ) < 0 );
+
+	// The packer goes on where it was: new glyphs land where they would have
+	// in the saved atlas
+	CHECK( texture_font_load_glyphs( font, "0123456789" ) == 0 );
+	CHECK( texture_font_load_glyphs( loaded, "0123456789" ) == 0 );
+	for ( p = "0123456789"; *p; ++p ) {
+		char digit[2] = { *p, 0 };
+
+		CHECK( same_glyph( texture_font_find_glyph( loaded, digit ),
+						   texture_font_find_glyph( font, digit ) ) );
+	}
+	CHECK( !memcmp( loaded_atlas->data, atlas->data, 256 * 256 ) );
+
+	// Enlarging takes the pixels out of the snapshot
+	texture_font_enlarge_atlas( loaded, 256, 512 );
+	CHECK( loaded_atlas->mapping == NULL && loaded->mapping != NULL );
+	CHECK( !memcmp( loaded_atlas->data, atlas->data, 256 * 256 ) );
+
+	// The atlas goes first, the font keeps the snapshot alive
+	texture_atlas_delete( loaded_atlas );
+	CHECK( texture_font_find_glyph( loaded, "A" ) != NULL );
+	texture_font_delete( loaded );
+
+	texture_font_delete( font );
+	texture_atlas_delete( atlas );
+}
+
+
+// ---------------------------------------------------- test_stale_snapshot ---
+void
+test_stale_snapshot( const char *path ) {
+	texture_font_t *loaded;
+
+	// The snapshot of test_snapshot is only good for its font, size and
+	// rendermode
+	loaded = texture_font_load_snapshot( path, "fonts/Vera.ttf", 12, RENDER_NORMAL );
+	CHECK( loaded == NULL && freetype_gl_errno == FTGL_Err_Snapshot_Mismatch );
+	loaded = texture_font_load_snapshot( path, "fonts/Vera.ttf", 10,
+										 RENDER_SIGNED_DISTANCE_FIELD );
+	CHECK( loaded == NULL && freetype_gl_errno == FTGL_Err_Snapshot_Mismatch );
+	loaded = texture_font_load_snapshot( path, "fonts/VeraMono.ttf", 10, RENDER_NORMAL );
+	CHECK( loaded == NULL && freetype_gl_errno == FTGL_Err_Snapshot_Mismatch );
+
+	// Neither is a font file a snapshot
+	loaded = texture_font_load_snapshot( "fonts/Vera.ttf", "fonts/Vera.ttf", 10,
+										 RENDER_NORMAL );
+	CHECK( loaded == NULL && freetype_gl_errno == FTGL_Err_Snapshot_Mismatch );
+	loaded = texture_font_load_snapshot( "fonts/missing", "fonts/Vera.ttf", 10,
+										 RENDER_NORMAL );
+	CHECK( loaded == NULL && freetype_gl_errno == FTGL_Err_Cannot_Load_File );
+}
+
+
+// ----------------------------------------------------- test_full_snapshot ---
+void
+test_full_snapshot( const char *path ) {
+	const size_t key = offsetof(glyph_entry_t, outline_thickness) + sizeof(float);
+	texture_font_t *loaded;
+	unsigned char *data;
+	size_t i, size, start = 0, found = 0, used = 0;
+	char full[4096];
+	FILE *file;
+
+	// A snapshot whose glyph table has no empty slot left, lookups of
+	// missing glyphs would probe it forever
+	loaded = texture_font_load_snapshot( path, "fonts/Vera.ttf", 10, RENDER_NORMAL );
+	CHECK( loaded != NULL );
+	if ( !loaded ) {
+		return;
+	}
+	file = fopen( path, "rb" );
+	fseek( file, 0, SEEK_END );
+	size = (size_t) ftell( file );
+	fseek( file, 0, SEEK_SET );
+	data = (unsigned char *) malloc( size );
+	CHECK( fread( data, 1, size, file ) == size );
+	fclose( file );
+
+	// The slots are saved as they are but for their glyph pointers
+	for ( ; !found && start + loaded->glyphs->capacity * sizeof(glyph_entry_t) <= size;
+		  start += sizeof(uint32_t) ) {
+		for ( found = 1, i = 0; found && i < loaded->glyphs->capacity; ++i ) {
+			found = !memcmp( data + start + i * sizeof(glyph_entry_t),
+							 loaded->glyphs->entries + i, key );
+		}
+	}
+	CHECK( found );
+	start -= sizeof(uint32_t);
+	for ( i = 0; found && i < loaded->glyphs->capacity; ++i ) {
+		glyph_entry_t *entry = (glyph_entry_t *) (data + start + i * sizeof(glyph_entry_t));
+
+		if ( entry->codepoint != GLYPH_TABLE_EMPTY ) {
+			memcpy( data + start + used * sizeof(glyph_entry_t), entry, sizeof(*entry) );
+			used++;
+		}
+	}
+	for ( i = used; found && i < loaded->glyphs->capacity; ++i ) {
+		memcpy( data + start + i * sizeof(glyph_entry_t), data + start, sizeof(glyph_entry_t) );
+		((glyph_entry_t *) (data + start + i * sizeof(glyph_entry_t)))->codepoint =
+			0x10000 + (uint32_t) i;
+	}
+	texture_atlas_delete( loaded->atlas );
+	texture_font_delete( loaded );
+
+	snprintf( full, sizeof(full), "%s.full", path );
+	file = fopen( full, "wb" );
+	CHECK( fwrite( data, 1, size, file ) == size );
+	fclose( file );
+	free( data );
+
+	loaded = texture_font_load_snapshot( full, "fonts/Vera.ttf", 10, RENDER_NORMAL );
+	CHECK( loaded == NULL && freetype_gl_errno == FTGL_Err_Snapshot_Mismatch );
+	if ( loaded ) {
+		texture_atlas_delete( loaded->atlas );
+		texture_font_delete( loaded );
+	}
+	remove( full );
+}
+
+
+// --------------------------------------------------- test_borrowed_tables ---
+void
+test_borrowed_tables( void ) {
+	texture_glyph_t *glyphs = (texture_glyph_t *) calloc( 3, sizeof(texture_glyph_t) );
+	glyph_table_t *glyph_owner = glyph_table_new( ), *glyph_table;
+	kerning_table_t *kerning_owner = kerning_table_new( ), *kerning_table;
+	glyph_entry_t *entries;
+	kerning_pair_t *pairs;
+	int write;
+
+	glyph_table_set( glyph_owner, 'A', RENDER_NORMAL, 0, glyphs );
+	glyph_table_set( glyph_owner, 'B', RENDER_NORMAL, 0, glyphs + 1 );
+	kerning_table_set( kerning_owner, 'A', 'V', -1 );
+	kerning_table_set( kerning_owner, 'V', 'A', -2 );
+	entries = malloc( glyph_owner->capacity * sizeof(glyph_entry_t) );
+	memcpy( entries, glyph_owner->entries, glyph_owner->capacity * sizeof(glyph_entry_t) );
+	pairs = malloc( kerning_owner->capacity * sizeof(kerning_pair_t) );
+	memcpy( pairs, kerning_owner->pairs, kerning_owner->capacity * sizeof(kerning_pair_t) );
+
+	// Writing to a table borrowing the slots of another copies them first
+	for ( write = 0; write < 3; ++write ) {
+		glyph_table = glyph_table_new( );
+		*glyph_table = *glyph_owner;
+		glyph_table->borrowed = 1;
+		kerning_table = kerning_table_new( );
+		*kerning_table = *kerning_owner;
+		kerning_table->borrowed = 1;
+
+		if ( write == 0 ) {
+			CHECK( glyph_table_set( glyph_table, 'C', RENDER_NORMAL, 0, glyphs + 2 ) == 0 );
+			CHECK( glyph_table_get( glyph_table, 'C', RENDER_NORMAL, 0 ) == glyphs + 2 );
+			CHECK( glyph_table_get( glyph_table, 'A', RENDER_NORMAL, 0 ) == glyphs );
+			CHECK( kerning_table_set( kerning_table, 'A', 'V', -3 ) == 0 );
+			CHECK( kerning_table_get( kerning_table, 'A', 'V' ) == -3 );
+			CHECK( kerning_table_get( kerning_table, 'V', 'A' ) == -2 );
+		} else if ( write == 1 ) {
+			CHECK( glyph_table_remove( glyph_table, 'A', RENDER_NORMAL, 0 ) == glyphs );
+			CHECK( glyph_table_get( glyph_table, 'A', RENDER_NORMAL, 0 ) == NULL );
+			CHECK( glyph_table_get( glyph_table, 'B', RENDER_NORMAL, 0 ) == glyphs + 1 );
+			CHECK( kerning_table_remove( kerning_table, 'A', 'V' ) );
+			CHECK( kerning_table_find( kerning_table, 'A', 'V' ) == NULL );
+			CHECK( kerning_table_get( kerning_table, 'V', 'A' ) == -2 );
+		} else {
+			glyph_table_clear( glyph_table );
+			CHECK( glyph_table_get( glyph_table, 'A', RENDER_NORMAL, 0 ) == NULL );
+			kerning_table_clear( kerning_table );
+			CHECK( kerning_table_find( kerning_table, 'A', 'V' ) == NULL );
+		}
+		CHECK( !glyph_table->borrowed && glyph_table->entries != glyph_owner->entries );
+		CHECK( !kerning_table->borrowed && kerning_table->pairs != kerning_owner->pairs );
+		CHECK( !memcmp( entries, glyph_owner->entries,
+						glyph_owner->capacity * sizeof(glyph_entry_t) ) );
+		CHECK( !memcmp( pairs, kerning_owner->pairs,
+						kerning_owner->capacity * sizeof(kerning_pair_t) ) );
+		glyph_table_delete( glyph_table );
+		kerning_table_delete( kerning_table );
+	}
+
+	free( entries );
+	free( pairs );
+	glyph_table_delete( glyph_owner );
+	kerning_table_delete( kerning_owner );
+	free( glyphs );
+}
+
+
+// -------------------------------------------------------------- test_blob ---
+void
+test_blob( void ) {
+	texture_atlas_t *atlas = texture_atlas_new( 256, 256, 1 );
+	texture_font_t *font, *loaded;
+	const kerning_pair_t *pairs;
+	unsigned char *blob;
+	char *filename;
+	size_t i, size;
+
+	font = texture_font_new_from_file( atlas, 10, "fonts/Vera.ttf" );
+	CHECK( font != NULL );
+	if ( !font ) {
+		texture_atlas_delete( atlas );
+		return;
+	}
+	texture_font_load_glyphs( font, text );
+	texture_font_load_glyph( font, "\xe4\xb8\xad" );
+	blob = (unsigned char *) texture_font_make_blob( font, &size );
+	CHECK( blob != NULL );
+
+	loaded = texture_font_new_from_blob( blob, size );
+	CHECK( loaded != NULL );
+	if ( !loaded ) {
+		free( blob );
+		texture_font_delete( font );
+		texture_atlas_delete( atlas );
+		return;
+	}
+
+	// The pixels are read in place
+	CHECK( loaded->atlas->data > blob && loaded->atlas->data < blob + size );
+	CHECK( !memcmp( loaded->atlas->data, atlas->data, 256 * 256 ) );
+	CHECK( same_glyph( loaded->atlas->special, atlas->special ) );
+	CHECK( same_font( loaded, font ) );
+
+	// The kerning pairs end the blob, without the empty slots of the table
+	CHECK( font->kerning_table->capacity > font->kerning_table->size );
+	pairs = (const kerning_pair_t *) (blob + size) - font->kerning_table->size;
+	for ( i = 0; i < font->kerning_table->size; ++i ) {
+		CHECK( kerning_table_find( font->kerning_table, pairs[i].left, pairs[i].right ) != NULL );
+	}
+	CHECK( texture_font_find_glyph( loaded, "\xe4\xb8\xad" ) ==
+		   texture_font_find_glyph_utf32( loaded, 0 ) );
+
+	// There is no face to render more glyphs with, those stored are all
+	// there is
+	CHECK( texture_font_get_glyph( loaded, "A" ) != NULL &&
+		   texture_font_get_glyph( loaded, "A" ) == texture_font_find_glyph( loaded, "A" ) );
+	CHECK( texture_font_find_glyph( loaded, "0" ) == NULL );
+	CHECK( texture_font_get_glyph( loaded, "0" ) == NULL &&
+		   freetype_gl_errno == FTGL_Err_Font_Unavailable );
+	CHECK( texture_font_load_glyphs( loaded, "0" ) == 1 );
+	CHECK( texture_font_load_glyphs( loaded, "The" ) == 0 );
+
+	texture_atlas_delete( loaded->atlas );
+	texture_font_delete( loaded );
+
+	// Truncated or misaligned blobs are rejected
+	CHECK( texture_font_new_from_blob( blob, size / 2 ) == NULL &&
+		   freetype_gl_errno == FTGL_Err_Snapshot_Mismatch );
+	memmove( blob + 1, blob, size - 1 );
+	CHECK( texture_font_new_from_blob( blob + 1, size - 1 ) == NULL &&
+		   freetype_gl_errno == FTGL_Err_Snapshot_Mismatch );
+
+	free( blob );
+
+	// Nor does a font that has all the glyphs already open its face again,
+	// which would fail here
+	font->mode = MODE_AUTO_CLOSE;
+	texture_font_close( font, MODE_AUTO_CLOSE, MODE_AUTO_CLOSE );
+	filename = font->filename;
+	font->filename = "fonts/missing";
+	CHECK( texture_font_load_glyphs( font, text ) == 0 && font->face == NULL );
+	font->filename = filename;
+
+	texture_font_delete( font );
+	texture_atlas_delete( atlas );
+}
+
+
+// ----------------------------------------------------- test_readonly_blob ---
+void
+test_readonly_blob( void ) {
+#ifndef _WIN32
+	texture_atlas_t *atlas = texture_atlas_new( 256, 256, 1 );
+	texture_font_t *font, *loaded;
+	texture_glyph_t *glyph;
+	unsigned char *blob, *copy;
+	size_t size, length;
+	int i;
+
+	font = texture_font_new_from_file( atlas, 10, "fonts/Vera.ttf" );
+	CHECK( font != NULL );
+	if ( !font ) {
+		texture_atlas_delete( atlas );
+		return;
+	}
+	texture_font_load_glyphs( font, text );
+	blob = (unsigned char *) texture_font_make_blob( font, &size );
+	CHECK( blob != NULL );
+	texture_font_delete( font );
+	texture_atlas_delete( atlas );
+	if ( !blob ) {
+		return;
+	}
+
+	// The atlas of a blob in read-only memory copies its pixels before
+	// clearing a region, compacting or clearing them
+	length = (size + sysconf( _SC_PAGESIZE ) - 1) & ~(size_t) (sysconf( _SC_PAGESIZE ) - 1);
+	copy = mmap( NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+	CHECK( copy != MAP_FAILED );
+	if ( copy == MAP_FAILED ) {
+		free( blob );
+		return;
+	}
+	memcpy( copy, blob, size );
+	mprotect( copy, length, PROT_READ );
+	for ( i = 0; i < 3; ++i ) {
+		loaded = texture_font_new_from_blob( copy, size );
+		CHECK( loaded != NULL );
+		if ( !loaded ) {
+			continue;
+		}
+		glyph = texture_font_find_glyph( loaded, "A" );
+		if ( i == 0 ) {
+			texture_atlas_free_region( loaded->atlas, glyph->region );
+		} else if ( i == 1 ) {
+			texture_atlas_compact( loaded->atlas );
+		} else {
+			texture_atlas_clear( loaded->atlas );
+		}
+		CHECK( loaded->atlas->mapping == NULL );
+		CHECK( !memcmp( copy, blob, size ) );
+		texture_atlas_delete( loaded->atlas );
+		texture_font_delete( loaded );
+	}
+
+	munmap( copy, length );
+	free( blob );
+#endif
+}
+
+
+// --------------------------------------------------------- sdf_settings_t ---
+typedef struct {
+	distance_field_mode_t mode;
+	float spread;
+	int oversample;
+} sdf_settings_t;
+
+// ------------------------------------------------------------ close_fonts ---
+void
+close_fonts( texture_atlas_t **atlases, texture_font_t **fonts, size_t count ) {
+	size_t i;
+
+	for ( i = 0; i < count; ++i ) {
+		texture_font_delete( fonts[i] );
+		texture_atlas_delete( atlases[i] );
+	}
+}
+
+// --------------------------------------------------------- open_sdf_fonts ---
+int
+open_sdf_fonts( texture_atlas_t **atlases, texture_font_t **fonts,
+				const sdf_settings_t *settings, size_t count ) {
+	size_t i;
+
+	// Each font has its own atlas, so that their pixels can be compared
+	for ( i = 0; i < count; ++i ) {
+		atlases[i] = texture_atlas_new( 256, 256, 1 );
+		fonts[i] = texture_font_new_from_file( atlases[i], 10, "fonts/Vera.ttf" );
+		CHECK( fonts[i] != NULL );
+		if ( !fonts[i] ) {
+			texture_atlas_delete( atlases[i] );
+			close_fonts( atlases, fonts, i );
+			return 0;
+		}
+		fonts[i]->rendermode = RENDER_SIGNED_DISTANCE_FIELD;
+		fonts[i]->distance_mode = settings[i].mode;
+		fonts[i]->distance_spread = settings[i].spread;
+		fonts[i]->distance_oversample = settings[i].oversample;
+	}
+	return 1;
+}
+
+
+// ----------------------------------------------------- test_distance_mode ---
+void
+test_distance_mode( void ) {
+	const sdf_settings_t settings[2] = {
+		{ DISTANCE_FIELD_EDTAA3, 0, 1 }, { DISTANCE_FIELD_LINEAR, 0, 1 } };
+	texture_atlas_t *atlases[2];
+	texture_font_t *fonts[2];
+	size_t i, differ = 0, max_error = 0;
+
+	// Both distance transforms give the same glyphs, give or take a few
+	// levels where the closest edge is ambiguous
+	if ( !open_sdf_fonts( atlases, fonts, settings, 2 ) ) {
+		return;
+	}
+	for ( i = 0; i < 2; ++i ) {
+		CHECK( texture_font_load_glyphs( fonts[i], text ) == 0 );
+	}
+	CHECK( fonts[0]->distance_field && fonts[0]->distance_field->mode == DISTANCE_FIELD_EDTAA3 );
+	CHECK( fonts[1]->distance_field && fonts[1]->distance_field->mode == DISTANCE_FIELD_LINEAR );
+	for ( i = 0; i < 256 * 256; ++i ) {
+		size_t error = abs( atlases[0]->data[i] - atlases[1]->data[i] );
+
+		differ += error != 0;
+		max_error = error > max_error ? error : max_error;
+	}
+	CHECK( differ < 256 * 256 / 100 );
+	CHECK( max_error <= 16 );
+
+	close_fonts( atlases, fonts, 2 );
+}
+
+
+// -------------------------------------------------- test_outline_distance ---
+void
+test_outline_distance( void ) {
+	const sdf_settings_t settings[2] = {
+		{ DISTANCE_FIELD_EDTAA3, 0, 1 }, { DISTANCE_FIELD_OUTLINE, 0, 1 } };
+	texture_atlas_t *atlases[2];
+	texture_font_t *fonts[2];
+	distance_field_t *context;
+	size_t i, x, y, flips = 0;
+	float error = 0;
+
+	// Distances to the outline put the same pixels inside as those to the
+	// bitmap, in glyphs of the same size
+	if ( !open_sdf_fonts( atlases, fonts, settings, 2 ) ) {
+		return;
+	}
+	for ( i = 0; i < 2; ++i ) {
+		CHECK( texture_font_load_glyphs( fonts[i], text ) == 0 );
+	}
+	for ( i = 0; text[i]; ++i ) {
+		texture_glyph_t *a = texture_font_find_glyph( fonts[0], text + i );
+		texture_glyph_t *b = texture_font_find_glyph( fonts[1], text + i );
+
+		CHECK( a && b );
+		if ( !a || !b ) {
+			continue;
+		}
+		CHECK( a->width == b->width && a->height == b->height );
+		CHECK( a->offset_x == b->offset_x && a->offset_y == b->offset_y );
+		for ( y = 0; y < a->height && a->width == b->width && a->height == b->height; ++y ) {
+			for ( x = 0; x < a->width; ++x ) {
+				int va = atlases[0]->data[(a->region.y + y) * 256 + a->region.x + x];
+				int vb = atlases[1]->data[(b->region.y + y) * 256 + b->region.x + x];
+
+				flips += (va > 160 && vb < 96) || (va < 96 && vb > 160);
+			}
+		}
+	}
+	CHECK( flips == 0 );
+
+	close_fonts( atlases, fonts, 2 );
+
+	// A circle of cubic segments, at pixel centers
+	{
+		const double r = 20, k = 0.5522847498 * r;
+		const double points[12][2] = {
+			{ r, 0 }, { r, k }, { k, r }, { 0, r }, { -k, r }, { -r, k },
+			{ -r, 0 }, { -r, -k }, { -k, -r }, { 0, -r }, { k, -r }, { r, -k } };
+		FT_Vector vectors[12];
+		char tags[12];
+		short ends[1] = { 11 };
+		FT_Outline outline;
+		unsigned char image[48 * 48];
+
+		for ( i = 0; i < 12; ++i ) {
+			vectors[i].x = lround( (points[i][0] + 24) * 64 );
+			vectors[i].y = lround( (points[i][1] + 24) * 64 );
+			tags[i] = i % 3 ? FT_CURVE_TAG_CUBIC : FT_CURVE_TAG_ON;
+		}
+		memset( &outline, 0, sizeof(outline) );
+		outline.n_contours = 1;
+		outline.n_points = 12;
+		outline.points = vectors;
+		outline.tags = tags;
+		outline.contours = ends;
+
+		context = distance_field_new( );
+		CHECK( distance_field_make_outline( context, &outline, image, 48, 48, 0, 48 ) == image );
+		for ( y = 0; y < 48; ++y ) {
+			for ( x = 0; x < 48; ++x ) {
+				double d = hypot( x + 0.5 - 24, y + 0.5 - 24 ) - r;
+				float e = fabsf( context->outside[y * 48 + x] - (float) d );
+
+				error = e > error ? e : error;
+			}
+		}
+		CHECK( error < 0.01f );
+		CHECK( image[24 * 48 + 24] == 255 && image[0] < 128 );
+		distance_field_delete( context );
+	}
+}
+
+
+// --------------------------------------------------- test_distance_spread ---
+void
+test_distance_spread( void ) {
+	const sdf_settings_t settings[4] = {
+		{ DISTANCE_FIELD_OUTLINE, 4, 1 }, { DISTANCE_FIELD_EDTAA3, 4, 1 },
+		{ DISTANCE_FIELD_EDTAA3, 4, 4 }, { DISTANCE_FIELD_EDTAA3, 0, 1 } };
+	texture_atlas_t *atlases[4];
+	texture_font_t *fonts[4];
+	double errors[2] = { 0, 0 };
+	size_t i, x, y, count = 0;
+
+	// Fields of a fixed spread, exact from the outline, from the bitmap and
+	// from the bitmap rendered 4 times larger, then one of the old scale
+	if ( !open_sdf_fonts( atlases, fonts, settings, 4 ) ) {
+		return;
+	}
+	for ( i = 0; i < 4; ++i ) {
+		CHECK( texture_font_load_glyphs( fonts[i], text ) == 0 );
+	}
+	for ( i = 0; text[i]; ++i ) {
+		texture_glyph_t *glyphs[4];
+		size_t j;
+
+		for ( j = 0; j < 4; ++j ) {
+			glyphs[j] = texture_font_find_glyph( fonts[j], text + i );
+		}
+		CHECK( glyphs[0] && glyphs[1] && glyphs[2] && glyphs[3] );
+		if ( !glyphs[0] || !glyphs[1] || !glyphs[2] || !glyphs[3] ) {
+			continue;
+		}
+		for ( j = 1; j < 3; ++j ) {
+			CHECK( glyphs[j]->width == glyphs[0]->width && glyphs[j]->height == glyphs[0]->height );
+			CHECK( glyphs[j]->offset_x == glyphs[0]->offset_x &&
+				   glyphs[j]->offset_y == glyphs[0]->offset_y );
+		}
+		if ( glyphs[3]->width ) {
+			// Padded by the spread, which the offsets include
+			CHECK( glyphs[0]->width == glyphs[3]->width + 6 );
+			CHECK( glyphs[0]->offset_x == glyphs[3]->offset_x - 4 );
+			CHECK( glyphs[0]->offset_y == glyphs[3]->offset_y + 4 );
+		}
+		if ( glyphs[1]->width != glyphs[0]->width || glyphs[2]->width != glyphs[0]->width ||
+			 glyphs[1]->height != glyphs[0]->height || glyphs[2]->height != glyphs[0]->height ) {
+			continue;
+		}
+		for ( y = 0; y < glyphs[0]->height; ++y ) {
+			for ( x = 0; x < glyphs[0]->width; ++x ) {
+				int v[3];
+
+				for ( j = 0; j < 3; ++j ) {
+					v[j] = atlases[j]->data[(glyphs[j]->region.y + y) * 256 +
+											glyphs[j]->region.x + x];
+				}
+				errors[0] += abs( v[1] - v[0] );
+				errors[1] += abs( v[2] - v[0] );
+				count++;
+			}
+		}
+		if ( glyphs[0]->width ) {
+			for ( j = 0; j < 3; ++j ) {
+				CHECK( atlases[j]->data[glyphs[j]->region.y * 256 + glyphs[j]->region.x] == 0 );
+			}
+		}
+	}
+	CHECK( count > 0 && errors[1] < errors[0] );
+
+	close_fonts( atlases, fonts, 4 );
+}
+
+
+// ------------------------------------------------------ test_sdf_snapshot ---
+void
+test_sdf_snapshot( const char *path ) {
+	const sdf_settings_t settings[1] = { { DISTANCE_FIELD_EDTAA3, 4, 4 } };
+	texture_atlas_t *atlases[1];
+	texture_font_t *fonts[1], *loaded;
+	const char *p;
+
+	// The distance field settings are saved, so that glyphs loaded after
+	// the snapshot are those of the saved font
+	if ( !open_sdf_fonts( atlases, fonts, settings, 1 ) ) {
+		return;
+	}
+	CHECK( texture_font_load_glyphs( fonts[0], text ) == 0 );
+	CHECK( texture_font_save_snapshot( fonts[0], path ) );
+	loaded = texture_font_load_snapshot( path, "fonts/Vera.ttf", 10,
+										 RENDER_SIGNED_DISTANCE_FIELD );
+	CHECK( loaded != NULL );
+	if ( !loaded ) {
+		close_fonts( atlases, fonts, 1 );
+		return;
+	}
+	CHECK( loaded->distance_mode == DISTANCE_FIELD_EDTAA3 );
+	CHECK( loaded->distance_spread == 4 && loaded->distance_oversample == 4 );
+	CHECK( texture_font_load_glyphs( fonts[0], "0123456789" ) == 0 );
+	CHECK( texture_font_load_glyphs( loaded, "0123456789" ) == 0 );
+	for ( p = "0123456789"; *p; ++p ) {
+		char digit[2] = { *p, 0 };
+
+		CHECK( same_glyph( texture_font_find_glyph( loaded, digit ),
+						   texture_font_find_glyph( fonts[0], digit ) ) );
+	}
+	CHECK( !memcmp( loaded->atlas->data, atlases[0]->data, 256 * 256 ) );
+
+	texture_atlas_delete( loaded->atlas );
+	texture_font_delete( loaded );
+	close_fonts( atlases, fonts, 1 );
+}
+
+
+// --------------------------------------------------------------- bilinear ---
+float
+bilinear( const float *field, int width, int height, float x, float y ) {
+	int x0, y0, x1, y1;
+	float fx, fy;
+
+	// Texels are sampled at their centers, and clamped to the edges
+	x -= 0.5f;
+	y -= 0.5f;
+	x0 = (int) floorf( x );
+	y0 = (int) floorf( y );
+	fx = x - x0;
+	fy = y - y0;
+	x1 = x0 + 1 >= width ? width - 1 : x0 + 1;
+	y1 = y0 + 1 >= height ? height - 1 : y0 + 1;
+	x0 = x0 < 0 ? 0 : x0;
+	y0 = y0 < 0 ? 0 : y0;
+	x1 = x1 < 0 ? 0 : x1;
+	y1 = y1 < 0 ? 0 : y1;
+	return (field[y0 * width + x0] * (1 - fx) + field[y0 * width + x1] * fx) * (1 - fy) +
+		(field[y1 * width + x0] * (1 - fx) + field[y1 * width + x1] * fx) * fy;
+}
+
+
+// -------------------------------------------------------------- test_msdf ---
+void
+test_msdf( void ) {
+	const char *glyphs = "AMkwx&@4";
+	const int scale = 4, spread = 2;
+	FT_Library library;
+	FT_Face face;
+	distance_field_t *context;
+	texture_atlas_t *atlas;
+	texture_font_t *font;
+	texture_glyph_t *glyph;
+	size_t i, total = 0, msdf_wrong = 0, sdf_wrong = 0;
+
+	// Glyphs drawn from the fields as shaders/msdf.frag and a single
+	// channel field would draw them, against reference images FreeType
+	// renders at that scale: the multi-channel field keeps the corners
+	CHECK( FT_Init_FreeType( &library ) == 0 );
+	CHECK( FT_New_Face( library, "fonts/Vera.ttf", 0, &face ) == 0 );
+	FT_Set_Char_Size( face, 16 * 64, 0, 72, 72 );
+	context = distance_field_new( );
+	for ( i = 0; glyphs[i]; ++i ) {
+		FT_Outline *outline, reference;
+		FT_Bitmap bitmap;
+		FT_Matrix matrix = { scale << 16, 0, 0, scale << 16 };
+		FT_BBox cbox;
+		unsigned char *msdf, *sdf, *expected;
+		float *fields[4];
+		int left, top, width, height, x, y, c;
+
+		CHECK( FT_Load_Char( face, glyphs[i], FT_LOAD_NO_HINTING | FT_LOAD_NO_BITMAP ) == 0 );
+		outline = &face->glyph->outline;
+		FT_Outline_Get_CBox( outline, &cbox );
+		left = (cbox.xMin >> 6) - spread;
+		top = ((cbox.yMax + 63) >> 6) + spread;
+		width = ((cbox.xMax + 63) >> 6) - (cbox.xMin >> 6) + 2 * spread;
+		height = ((cbox.yMax + 63) >> 6) - (cbox.yMin >> 6) + 2 * spread;
+
+		msdf = malloc( width * height * 3 );
+		sdf = malloc( width * height );
+		expected = calloc( width * height * scale * scale, 1 );
+		for ( c = 0; c < 4; ++c ) {
+			fields[c] = malloc( width * height * sizeof(float) );
+		}
+		CHECK( distance_field_make_msdf( context, outline, msdf, width, height,
+										 left, top, 2 * spread ) == msdf );
+		CHECK( distance_field_make_outline( context, outline, sdf, width, height,
+											left, top ) == sdf );
+		for ( x = 0; x < width * height; ++x ) {
+			for ( c = 0; c < 3; ++c ) {
+				fields[c][x] = msdf[x * 3 + c] - 127.5f;
+			}
+			fields[3][x] = -context->outside[x];
+		}
+
+		FT_Outline_New( library, outline->n_points, outline->n_contours, &reference );
+		FT_Outline_Copy( outline, &reference );
+		FT_Outline_Translate( &reference, -left * 64, -(top - height) * 64 );
+		FT_Outline_Transform( &reference, &matrix );
+		memset( &bitmap, 0, sizeof(bitmap) );
+		bitmap.rows = height * scale;
+		bitmap.width = width * scale;
+		bitmap.pitch = width * scale;
+		bitmap.buffer = expected;
+		bitmap.pixel_mode = FT_PIXEL_MODE_GRAY;
+		bitmap.num_grays = 256;
+		CHECK( FT_Outline_Get_Bitmap( library, &reference, &bitmap ) == 0 );
+
+		for ( y = 0; y < height * scale; ++y ) {
+			for ( x = 0; x < width * scale; ++x ) {
+				float u = (x + 0.5f) / scale, v = (y + 0.5f) / scale;
+				float r = bilinear( fields[0], width, height, u, v );
+				float g = bilinear( fields[1], width, height, u, v );
+				float b = bilinear( fields[2], width, height, u, v );
+				float median = fmaxf( fminf( r, g ), fminf( fmaxf( r, g ), b ) );
+				int inside = expected[y * width * scale + x] >= 128;
+
+				msdf_wrong += (median > 0) != inside;
+				sdf_wrong += (bilinear( fields[3], width, height, u, v ) > 0) != inside;
+				total++;
+			}
+		}
+
+		FT_Outline_Done( library, &reference );
+		for ( c = 0; c < 4; ++c ) {
+			free( fields[c] );
+		}
+		free( expected );
+		free( sdf );
+		free( msdf );
+	}
+	CHECK( msdf_wrong < total / 100 );
+	CHECK( msdf_wrong < sdf_wrong * 3 / 4 );
+	distance_field_delete( context );
+	FT_Done_Face( face );
+	FT_Done_FreeType( library );
+
+	// Fonts render them in atlases of depth 3, padded with the spread
+	atlas = texture_atlas_new( 256, 256, 3 );
+	font = texture_font_new_from_file( atlas, 10, "fonts/Vera.ttf" );
+	CHECK( font != NULL );
+	if ( !font ) {
+		texture_atlas_delete( atlas );
+		return;
+	}
+	font->rendermode = RENDER_MSDF;
+	CHECK( texture_font_load_glyphs( font, glyphs ) == 0 );
+	glyph = texture_font_find_glyph( font, "M" );
+	CHECK( glyph && glyph->rendermode == RENDER_MSDF );
+	CHECK( glyph && glyph->offset_x < 0 && glyph->width > 2 * (size_t) spread );
+	texture_font_delete( font );
+	texture_atlas_delete( atlas );
+
+	atlas = texture_atlas_new( 256, 256, 1 );
+	font = texture_font_new_from_file( atlas, 10, "fonts/Vera.ttf" );
+	font->rendermode = RENDER_MSDF;
+	CHECK( texture_font_load_glyph( font, "M" ) == 0 );
+	CHECK( freetype_gl_errno == FTGL_Err_Render_Mode_Unsupported );
+	texture_font_delete( font );
+	texture_atlas_delete( atlas );
+}
+
+// -------------------------------------------------------------- test_simd ---
+void
+test_simd( void ) {
+	const char *glyphs = "Ag@W&%";
+	platform_simd_t simd = platform_simd( );
+	FT_Library library;
+	FT_Face face;
+	distance_field_t *context;
+	size_t i, differ = 0, max_error = 0;
+	int mode, k;
+
+	platform_limit_simd( PLATFORM_SIMD_NONE );
+	CHECK( platform_simd( ) == PLATFORM_SIMD_NONE );
+
+	// Vectorized distance fields are those of the scalar code, give or take
+	// a level where the compiler fuses the multiply-adds of the latter, for
+	// images of widths the vectors do not divide
+	CHECK( FT_Init_FreeType( &library ) == 0 );
+	CHECK( FT_New_Face( library, "fonts/Vera.ttf", 0, &face ) == 0 );
+	FT_Set_Pixel_Sizes( face, 0, 27 );
+	context = distance_field_new( );
+	for ( i = 0; glyphs[i]; ++i ) {
+		FT_Bitmap *bitmap = &face->glyph->bitmap;
+		unsigned char *img, *fields[2];
+		int width, height, x, y;
+
+		CHECK( FT_Load_Char( face, glyphs[i], FT_LOAD_RENDER ) == 0 );
+		width = bitmap->width + 2 + (int) i;
+		height = bitmap->rows + 2;
+		img = calloc( width * height, 1 );
+		for ( y = 0; y < (int) bitmap->rows; ++y ) {
+			for ( x = 0; x < (int) bitmap->width; ++x ) {
+				img[(y + 1) * width + x + 1] = bitmap->buffer[y * bitmap->pitch + x];
+			}
+		}
+		for ( mode = 0; mode < 3; ++mode ) {
+			for ( k = 0; k < 2; ++k ) {
+				platform_limit_simd( k ? PLATFORM_SIMD_NONE : simd );
+				if ( mode == 2 ) {
+					fields[k] = make_distance_mapb( img, width, height );
+				} else {
+					context->mode = mode ? DISTANCE_FIELD_LINEAR : DISTANCE_FIELD_EDTAA3;
+					fields[k] = malloc( width * height );
+					memcpy( fields[k], img, width * height );
+					CHECK( distance_field_make_mapb( context, fields[k], width, height ) == fields[k] );
+				}
+			}
+			for ( x = 0; x < width * height; ++x ) {
+				size_t error = abs( fields[0][x] - fields[1][x] );
+
+				differ += error != 0;
+				max_error = error > max_error ? error : max_error;
+			}
+			free( fields[0] );
+			free( fields[1] );
+		}
+		free( img );
+	}
+	CHECK( max_error <= 1 );
+	CHECK( differ < 100 );
+	platform_limit_simd( PLATFORM_SIMD_BEST );
+	CHECK( platform_simd( ) == simd );
+
+	distance_field_delete( context );
+	FT_Done_Face( face );
+	FT_Done_FreeType( library );
+}
+
+// ------------------------------------------------------- reverse_executor ---
+/* Executor running the parts backwards on the calling thread, counting its
+ * calls in user */
+void
+reverse_executor( void *user, distance_field_task_t task, void *data, size_t count ) {
+	size_t i;
+
+	(*(int *) user)++;
+	for ( i = count; i-- > 0; ) {
+		task( data, i, count );
+	}
+}
+
+// ---------------------------------------------------------- test_executor ---
+void
+test_executor( void ) {
+	FT_Library library;
+	FT_Face face;
+	FT_BBox cbox;
+	distance_field_t *contexts[2];
+	texture_atlas_t *atlases[2];
+	texture_font_t *fonts[2];
+	const sdf_settings_t settings[2] = {
+		{ DISTANCE_FIELD_EDTAA3, 0, 1 }, { DISTANCE_FIELD_EDTAA3, 0, 1 } };
+	unsigned char *fields[2];
+	int width, height, i, calls = 0, field_calls;
+
+	// Fields split into parts are those computed at once, for each mode
+	CHECK( FT_Init_FreeType( &library ) == 0 );
+	CHECK( FT_New_Face( library, "fonts/Vera.ttf", 0, &face ) == 0 );
+	FT_Set_Pixel_Sizes( face, 0, 96 );
+	CHECK( FT_Load_Char( face, '@', FT_LOAD_NO_BITMAP ) == 0 );
+	FT_Outline_Get_CBox( &face->glyph->outline, &cbox );
+	width = ((cbox.xMax + 63) >> 6) - (cbox.xMin >> 6) + 2;
+	height = ((cbox.yMax + 63) >> 6) - (cbox.yMin >> 6) + 2;
+	for ( i = 0; i < 2; ++i ) {
+		contexts[i] = distance_field_new( );
+		fields[i] = malloc( width * height * 3 );
+	}
+	contexts[1]->threads = 3;
+	contexts[1]->executor = reverse_executor;
+	contexts[1]->executor_data = &calls;
+	for ( i = 0; i < 2; ++i ) {
+		CHECK( distance_field_make_outline( contexts[i], &face->glyph->outline, fields[i],
+											width, height, (cbox.xMin >> 6) - 1,
+											((cbox.yMax + 63) >> 6) + 1 ) == fields[i] );
+	}
+	CHECK( !memcmp( fields[0], fields[1], width * height ) );
+	for ( i = 0; i < 2; ++i ) {
+		CHECK( distance_field_make_msdf( contexts[i], &face->glyph->outline, fields[i],
+										 width, height, (cbox.xMin >> 6) - 1,
+										 ((cbox.yMax + 63) >> 6) + 1, 4 ) == fields[i] );
+	}
+	CHECK( !memcmp( fields[0], fields[1], width * height * 3 ) );
+	for ( i = 0; i < 2; ++i ) {
+		memset( fields[i], 0, width * height );
+		memset( fields[i] + width * 20 + 20, 255, width * 20 );
+		contexts[i]->mode = DISTANCE_FIELD_LINEAR;
+		CHECK( distance_field_make_mapb( contexts[i], fields[i], width, height ) == fields[i] );
+	}
+	CHECK( !memcmp( fields[0], fields[1], width * height ) );
+	CHECK( calls == 2 + 2 * 3 ); // Three steps outside and inside when linear
+	CHECK( contexts[1]->part_count == 2 );
+	for ( i = 0; i < 2; ++i ) {
+		distance_field_delete( contexts[i] );
+		free( fields[i] );
+	}
+	FT_Done_Face( face );
+	FT_Done_FreeType( library );
+
+	// Batches run as tasks of the executor give the same atlas
+	field_calls = calls;
+	if ( !open_sdf_fonts( atlases, fonts, settings, 2 ) ) {
+		return;
+	}
+	fonts[1]->threads = 4;
+	fonts[1]->executor = reverse_executor;
+	fonts[1]->executor_data = &calls;
+	for ( i = 0; i < 2; ++i ) {
+		CHECK( texture_font_load_glyphs( fonts[i], text ) == 0 );
+	}
+	CHECK( calls == field_calls + 1 );
+	CHECK( !memcmp( atlases[0]->data, atlases[1]->data, 256 * 256 ) );
+	close_fonts( atlases, fonts, 2 );
+}
+
+// ------------------------------------------------------------------- main ---
+int main( int argc, char **argv ) {
+	char path[4096];
+
+	// Files are written to the directory given, the current one otherwise
+	snprintf( path, sizeof(path), "%s/test-texture-font.snapshot",
+			  argc > 1 ? argv[1] : "." );
+
+	texture_font_default_mode( MODE_ALWAYS_OPEN );
+	test_kerning_cache( );
+	test_glyph_iterators( );
+	test_async( );
+	test_pack_batches( );
+	test_direct_raster( );
+	test_get_glyphs( );
+	test_clone( );
+	test_eviction( );
+	test_snapshot( path );
+	test_stale_snapshot( path );
+	test_full_snapshot( path );
+	remove( path );
+	test_borrowed_tables( );
+	test_blob( );
+	test_readonly_blob( );
+	test_distance_mode( );
+	test_outline_distance( );
+	test_distance_spread( );
+	test_sdf_snapshot( path );
+	remove( path );
+	test_msdf( );
+	test_simd( );
+	test_executor( );
+
+	if ( failures ) {
+		fprintf( stderr, "%d check(s) failed\n", failures );
+		return EXIT_FAILURE;
+	}
+	printf( "All texture font checks passed\n" );
+	return EXIT_SUCCESS;
+}
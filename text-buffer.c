@@ -14,10 +14,10 @@
 #include "utf8-utils.h"
 #include "freetype-gl-err.h"
 
-#define SET_GLYPH_VERTEX(value,x0,y0,z0,s0,t0,r,g,b,a,sh,gm) { \
+#define SET_GLYPH_VERTEX(value,x0,y0,z0,s0,t0,l,r,g,b,a,sh,gm) { \
 	glyph_vertex_t *gv=&value;                                 \
 	gv->x=x0; gv->y=y0; gv->z=z0;                              \
-	gv->u=s0; gv->v=t0;                                        \
+	gv->u=s0; gv->v=t0; gv->layer=l;                           \
 	gv->r=r; gv->g=g; gv->b=b; gv->a=a;                        \
 	gv->shift=sh; gv->gamma=gm;}
 
@@ -27,7 +27,7 @@ text_buffer_t *
 text_buffer_new( ) {
 	text_buffer_t *self = (text_buffer_t *) malloc (sizeof(text_buffer_t));
 	self->buffer = vertex_buffer_new(
-									 "vertex:3f,tex_coord:2f,color:4f,ashift:1f,agamma:1f" );
+									 "vertex:3f,tex_coord:3f,color:4f,ashift:1f,agamma:1f" );
 	self->line_start = 0;
 	self->line_ascender = 0;
 	self->base_color.r = 0.0;
@@ -269,15 +269,16 @@ text_buffer_add_char( text_buffer_t * self,
 		float t0 = black->t0;
 		float s1 = black->s1;
 		float t1 = black->t1;
+		float layer = black->layer;
 
 		SET_GLYPH_VERTEX(vertices[vcount+0],
-						 (float)(int)x0,y0,0,  s0,t0,  r,g,b,a,  x0-((int)x0), gamma );
+						 (float)(int)x0,y0,0,  s0,t0,layer,  r,g,b,a,  x0-((int)x0), gamma );
 		SET_GLYPH_VERTEX(vertices[vcount+1],
-						 (float)(int)x0,y1,0,  s0,t1,  r,g,b,a,  x0-((int)x0), gamma );
+						 (float)(int)x0,y1,0,  s0,t1,layer,  r,g,b,a,  x0-((int)x0), gamma );
 		SET_GLYPH_VERTEX(vertices[vcount+2],
-						 (float)(int)x1,y1,0,  s1,t1,  r,g,b,a,  x1-((int)x1), gamma );
+						 (float)(int)x1,y1,0,  s1,t1,layer,  r,g,b,a,  x1-((int)x1), gamma );
 		SET_GLYPH_VERTEX(vertices[vcount+3],
-						 (float)(int)x1,y0,0,  s1,t0,  r,g,b,a,  x1-((int)x1), gamma );
+						 (float)(int)x1,y0,0,  s1,t0,layer,  r,g,b,a,  x1-((int)x1), gamma );
 		indices[icount + 0] = vcount+0;
 		indices[icount + 1] = vcount+1;
 		indices[icount + 2] = vcount+2;
@@ -302,15 +303,16 @@ text_buffer_add_char( text_buffer_t * self,
 		float t0 = black->t0;
 		float s1 = black->s1;
 		float t1 = black->t1;
+		float layer = black->layer;
 
 		SET_GLYPH_VERTEX(vertices[vcount+0],
-						 (float)(int)x0,y0,0,  s0,t0,  r,g,b,a,  x0-((int)x0), gamma );
+						 (float)(int)x0,y0,0,  s0,t0,layer,  r,g,b,a,  x0-((int)x0), gamma );
 		SET_GLYPH_VERTEX(vertices[vcount+1],
-						 (float)(int)x0,y1,0,  s0,t1,  r,g,b,a,  x0-((int)x0), gamma );
+						 (float)(int)x0,y1,0,  s0,t1,layer,  r,g,b,a,  x0-((int)x0), gamma );
 		SET_GLYPH_VERTEX(vertices[vcount+2],
-						 (float)(int)x1,y1,0,  s1,t1,  r,g,b,a,  x1-((int)x1), gamma );
+						 (float)(int)x1,y1,0,  s1,t1,layer,  r,g,b,a,  x1-((int)x1), gamma );
 		SET_GLYPH_VERTEX(vertices[vcount+3],
-						 (float)(int)x1,y0,0,  s1,t0,  r,g,b,a,  x1-((int)x1), gamma );
+						 (float)(int)x1,y0,0,  s1,t0,layer,  r,g,b,a,  x1-((int)x1), gamma );
 		indices[icount + 0] = vcount+0;
 		indices[icount + 1] = vcount+1;
 		indices[icount + 2] = vcount+2;
@@ -335,14 +337,15 @@ text_buffer_add_char( text_buffer_t * self,
 		float t0 = black->t0;
 		float s1 = black->s1;
 		float t1 = black->t1;
+		float layer = black->layer;
 		SET_GLYPH_VERTEX(vertices[vcount+0],
-						 (float)(int)x0,y0,0,  s0,t0,  r,g,b,a,  x0-((int)x0), gamma );
+						 (float)(int)x0,y0,0,  s0,t0,layer,  r,g,b,a,  x0-((int)x0), gamma );
 		SET_GLYPH_VERTEX(vertices[vcount+1],
-						 (float)(int)x0,y1,0,  s0,t1,  r,g,b,a,  x0-((int)x0), gamma );
+						 (float)(int)x0,y1,0,  s0,t1,layer,  r,g,b,a,  x0-((int)x0), gamma );
 		SET_GLYPH_VERTEX(vertices[vcount+2],
-						 (float)(int)x1,y1,0,  s1,t1,  r,g,b,a,  x1-((int)x1), gamma );
+						 (float)(int)x1,y1,0,  s1,t1,layer,  r,g,b,a,  x1-((int)x1), gamma );
 		SET_GLYPH_VERTEX(vertices[vcount+3],
-						 (float)(int)x1,y0,0,  s1,t0,  r,g,b,a,  x1-((int)x1), gamma );
+						 (float)(int)x1,y0,0,  s1,t0,layer,  r,g,b,a,  x1-((int)x1), gamma );
 		indices[icount + 0] = vcount+0;
 		indices[icount + 1] = vcount+1;
 		indices[icount + 2] = vcount+2;
@@ -367,14 +370,15 @@ text_buffer_add_char( text_buffer_t * self,
 		float t0 = black->t0;
 		float s1 = black->s1;
 		float t1 = black->t1;
+		float layer = black->layer;
 		SET_GLYPH_VERTEX(vertices[vcount+0],
-						 (float)(int)x0,y0,0,  s0,t0,  r,g,b,a,  x0-((int)x0), gamma );
+						 (float)(int)x0,y0,0,  s0,t0,layer,  r,g,b,a,  x0-((int)x0), gamma );
 		SET_GLYPH_VERTEX(vertices[vcount+1],
-						 (float)(int)x0,y1,0,  s0,t1,  r,g,b,a,  x0-((int)x0), gamma );
+						 (float)(int)x0,y1,0,  s0,t1,layer,  r,g,b,a,  x0-((int)x0), gamma );
 		SET_GLYPH_VERTEX(vertices[vcount+2],
-						 (float)(int)x1,y1,0,  s1,t1,  r,g,b,a,  x1-((int)x1), gamma );
+						 (float)(int)x1,y1,0,  s1,t1,layer,  r,g,b,a,  x1-((int)x1), gamma );
 		SET_GLYPH_VERTEX(vertices[vcount+3],
-						 (float)(int)x1,y0,0,  s1,t0,  r,g,b,a,  x1-((int)x1), gamma );
+						 (float)(int)x1,y0,0,  s1,t0,layer,  r,g,b,a,  x1-((int)x1), gamma );
 		indices[icount + 0] = vcount+0;
 		indices[icount + 1] = vcount+1;
 		indices[icount + 2] = vcount+2;
@@ -398,15 +402,16 @@ text_buffer_add_char( text_buffer_t * self,
 		float t0 = glyph->t0;
 		float s1 = glyph->s1;
 		float t1 = glyph->t1;
+		float layer = glyph->layer;
 
 		SET_GLYPH_VERTEX(vertices[vcount+0],
-						 (float)(int)x0,y0,0,  s0,t0,  r,g,b,a,  x0-((int)x0), gamma );
+						 (float)(int)x0,y0,0,  s0,t0,layer,  r,g,b,a,  x0-((int)x0), gamma );
 		SET_GLYPH_VERTEX(vertices[vcount+1],
-						 (float)(int)x0,y1,0,  s0,t1,  r,g,b,a,  x0-((int)x0), gamma );
+						 (float)(int)x0,y1,0,  s0,t1,layer,  r,g,b,a,  x0-((int)x0), gamma );
 		SET_GLYPH_VERTEX(vertices[vcount+2],
-						 (float)(int)x1,y1,0,  s1,t1,  r,g,b,a,  x1-((int)x1), gamma );
+						 (float)(int)x1,y1,0,  s1,t1,layer,  r,g,b,a,  x1-((int)x1), gamma );
 		SET_GLYPH_VERTEX(vertices[vcount+3],
-						 (float)(int)x1,y0,0,  s1,t0,  r,g,b,a,  x1-((int)x1), gamma );
+						 (float)(int)x1,y0,0,  s1,t0,layer,  r,g,b,a,  x1-((int)x1), gamma );
 		indices[icount + 0] = vcount+0;
 		indices[icount + 1] = vcount+1;
 		indices[icount + 2] = vcount+2;
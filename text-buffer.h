@@ -134,6 +134,12 @@ typedef struct glyph_vertex_t {
 	 */
 	float v;
 
+	/**
+	 * Texture third coordinate: the layer of the atlas texture array (the
+	 * atlas page) holding the glyph, 0 for an atlas of a single page
+	 */
+	float layer;
+
 	/**
 	 * Color red component
 	 */
@@ -206,7 +212,10 @@ typedef enum Align
 
 
 /**
- * Creates a new empty text buffer.
+ * Creates a new empty text buffer. Its vertices (glyph_vertex_t) have the
+ * attributes vertex:3f, tex_coord:3f, color:4f, ashift:1f and agamma:1f, the
+ * third texture coordinate being the atlas layer (see
+ * shaders/text-array.vert), which shaders sampling a 2D texture ignore.
  *
  * @return  a new empty text buffer.
  *
@@ -8,9 +8,11 @@
 #include <string.h>
 #include <assert.h>
 #include <limits.h>
+#include <stdint.h>
 #include "texture-atlas.h"
 #include "texture-font.h"
 #include "freetype-gl-err.h"
+#include "platform.h"
 
 // -------------------------------------------------- texture_atlas_special ---
 
@@ -28,6 +30,7 @@ void texture_atlas_special ( texture_atlas_t * self ) {
 	
 	texture_atlas_set_region( self, region.x, region.y, 4, 4, data, 0 );
 	glyph->codepoint = -1;
+	glyph->region = region;
 	glyph->s0 = (region.x+2)/(float)self->width;
 	glyph->t0 = (region.y+2)/(float)self->height;
 	glyph->s1 = (region.x+3)/(float)self->width;
@@ -55,12 +58,28 @@ texture_atlas_new( const size_t width,
 		/* exit( EXIT_FAILURE ); */ /* Never exit from a library */
 	}
 	self->nodes = vector_new( sizeof(ivec3) );
+	self->freed = vector_new( sizeof(ivec4) );
+	self->fonts = vector_new( sizeof(texture_font_t *) );
+	self->growth = 0;
+	self->max_width = width;
+	self->max_height = height;
+	self->packer = PACKER_SKYLINE;
+	self->rects = vector_new( sizeof(ivec4) );
+	self->shelves = vector_new( sizeof(ivec3) );
+	self->window = vector_new( sizeof(size_t) );
+	self->dirty = vector_new( sizeof(ivec4) );
+	self->max_dirty = 16;
+	self->layers = 1;
+	self->layer = 0;
+	self->max_layers = 1;
+	self->mapping = NULL;
 	self->used = 0;
 	self->width = width;
 	self->height = height;
 	self->depth = depth;
 	self->id = 0;
 	self->modified = 1;
+	texture_atlas_add_dirty( self, (ivec4){{0, 0, width, height}} );
 
 	vector_push_back( self->nodes, &node );
 	self->data = (unsigned char *)
@@ -81,16 +100,134 @@ texture_atlas_new( const size_t width,
 // --------------------------------------------------- texture_atlas_delete ---
 void
 texture_atlas_delete( texture_atlas_t *self ) {
+	size_t i;
+
 	assert( self );
+	// Fonts deleted after the atlas must not look for it
+	for ( i = 0; i < vector_size( self->fonts ); ++i ) {
+		(*(texture_font_t **) vector_get( self->fonts, i ))->atlas = NULL;
+	}
+	vector_delete( self->fonts );
 	vector_delete( self->nodes );
+	vector_delete( self->freed );
+	vector_delete( self->rects );
+	vector_delete( self->shelves );
+	vector_delete( self->window );
+	vector_delete( self->dirty );
 	texture_glyph_delete( self->special );
-	if ( self->data ) {
+	if ( self->mapping ) {
+		texture_mapping_release( self->mapping );
+	} else if ( self->data ) {
 		free( self->data );
 	}
 	free( self );
 }
 
 
+// ---------------------------------------------------- texture_mapping_new ---
+texture_mapping_t *
+texture_mapping_new( const char * filename ) {
+	texture_mapping_t *self = (texture_mapping_t *) malloc( sizeof(texture_mapping_t) );
+
+	if ( !self ) {
+		freetype_gl_error( Out_Of_Memory,
+			   "%s:%d: No more memory for allocating data\n", __FILENAME__, __LINE__ );
+		return NULL;
+	}
+	self->base = (unsigned char *) platform_map_file( filename, &self->size );
+	if ( !self->base ) {
+		free( self );
+		return NULL;
+	}
+	self->refs = 1;
+	self->mapped = 1;
+	return self;
+}
+
+
+// --------------------------------------------------- texture_mapping_wrap ---
+texture_mapping_t *
+texture_mapping_wrap( const void * base,
+					  size_t size ) {
+	texture_mapping_t *self = (texture_mapping_t *) malloc( sizeof(texture_mapping_t) );
+
+	if ( !self ) {
+		freetype_gl_error( Out_Of_Memory,
+			   "%s:%d: No more memory for allocating data\n", __FILENAME__, __LINE__ );
+		return NULL;
+	}
+	self->base = (unsigned char *) base;
+	self->size = size;
+	self->refs = 1;
+	self->mapped = 0;
+	return self;
+}
+
+
+// ------------------------------------------------ texture_mapping_release ---
+void
+texture_mapping_release( texture_mapping_t * self ) {
+	assert( self && self->refs );
+
+	if ( --self->refs == 0 ) {
+		if ( self->mapped ) {
+			platform_unmap_file( self->base, self->size );
+		}
+		free( self );
+	}
+}
+
+
+// ------------------------------------------------- texture_atlas_own_data ---
+int
+texture_atlas_own_data( texture_atlas_t * self ) {
+	size_t size = self->width * self->height * self->depth * self->layers;
+	unsigned char *data;
+
+	if ( !self->mapping ) {
+		return 1;
+	}
+	data = (unsigned char *) malloc( size );
+	if ( !data ) {
+		freetype_gl_error( Out_Of_Memory,
+			   "%s:%d: No more memory for allocating data\n", __FILENAME__, __LINE__ );
+		return 0;
+	}
+	memcpy( data, self->data, size );
+	texture_mapping_release( self->mapping );
+	self->mapping = NULL;
+	self->data = data;
+	return 1;
+}
+
+
+// ---------------------------------------------------- texture_atlas_union ---
+static ivec4
+texture_atlas_union( const ivec4 * a,
+					 const ivec4 * b ) {
+	int x0 = a->x < b->x ? a->x : b->x;
+	int y0 = a->y < b->y ? a->y : b->y;
+	int x1 = a->x + a->width > b->x + b->width ? a->x + a->width : b->x + b->width;
+	int y1 = a->y + a->height > b->y + b->height ? a->y + a->height : b->y + b->height;
+
+	return (ivec4){{x0, y0, x1 - x0, y1 - y0}};
+}
+
+
+// ---------------------------------------------- texture_atlas_union_waste ---
+// Pixels the union of two rectangles covers beyond the two of them, 0
+// when their overlap makes up for it.
+static size_t
+texture_atlas_union_waste( const ivec4 * a,
+						   const ivec4 * b ) {
+	ivec4 u = texture_atlas_union( a, b );
+	size_t area = (size_t) u.width * u.height;
+	size_t sum = (size_t) a->width * a->height + (size_t) b->width * b->height;
+
+	return area > sum ? area - sum : 0;
+}
+
+
 // ----------------------------------------------- texture_atlas_set_region ---
 void
 texture_atlas_set_region( texture_atlas_t * self,
@@ -109,13 +246,18 @@ texture_atlas_set_region( texture_atlas_t * self,
 	assert( y > 0);
 	assert( x < (self->width-1));
 	assert( (x + width) <= (self->width-1));
-	assert( y < (self->height-1));
-	assert( (y + height) <= (self->height-1));
+	assert( y % self->height > 0 );
+	assert( y < self->height * self->layers );
+	assert( (y % self->height + height) <= (self->height-1));
 	
 	//prevent copying data from undefined position 
 	//and prevent memcpy's undefined behavior when count is zero
 	assert(height == 0 || (data != NULL && width > 0));
 
+	if ( !texture_atlas_own_data( self ) ) {
+		return;
+	}
+
 	depth = self->depth;
 	charsize = sizeof(char);
 	for ( i=0; i<height; ++i ) {
@@ -123,62 +265,791 @@ texture_atlas_set_region( texture_atlas_t * self,
 				data + (i*stride) * charsize, width * charsize * depth  );
 	}
 	self->modified = 1;
+	texture_atlas_add_dirty( self, (ivec4){{x, y, width, height}} );
+}
+
+
+// ------------------------------------------------ texture_atlas_add_dirty ---
+void
+texture_atlas_add_dirty( texture_atlas_t * self,
+						 const ivec4 rect ) {
+	ivec4 *dirty, *other, merged = rect;
+	size_t i, j, best_i = 0, best_j = 0, waste, best_waste;
+
+	assert( self );
+
+	if ( rect.width <= 0 || rect.height <= 0 ) {
+		return;
+	}
+
+	// Rectangles that overlap it enough to cost nothing are absorbed
+	for ( i = 0; i < vector_size( self->dirty ); ++i ) {
+		dirty = (ivec4 *) vector_get( self->dirty, i );
+		if ( texture_atlas_union_waste( dirty, &merged ) <= 0 ) {
+			merged = texture_atlas_union( dirty, &merged );
+			vector_erase( self->dirty, i );
+			i = -1;
+		}
+	}
+	vector_push_back( self->dirty, &merged );
+
+	// Then the pairs whose union adds the fewest pixels are merged
+	while ( vector_size( self->dirty ) > (self->max_dirty ? self->max_dirty : 1) ) {
+		best_waste = SIZE_MAX;
+		for ( i = 0; i < vector_size( self->dirty ); ++i ) {
+			dirty = (ivec4 *) vector_get( self->dirty, i );
+			for ( j = i + 1; j < vector_size( self->dirty ); ++j ) {
+				other = (ivec4 *) vector_get( self->dirty, j );
+				waste = texture_atlas_union_waste( dirty, other );
+				if ( waste < best_waste ) {
+					best_waste = waste;
+					best_i = i;
+					best_j = j;
+				}
+			}
+		}
+		dirty = (ivec4 *) vector_get( self->dirty, best_i );
+		*dirty = texture_atlas_union( dirty, (ivec4 *) vector_get( self->dirty, best_j ) );
+		vector_erase( self->dirty, best_j );
+	}
+}
+
+
+// ------------------------------------------------ texture_atlas_get_dirty ---
+const ivec4 *
+texture_atlas_get_dirty( const texture_atlas_t * self,
+						 size_t * count ) {
+	assert( self );
+	assert( count );
+
+	*count = vector_size( self->dirty );
+	return *count ? (const ivec4 *) vector_front( self->dirty ) : NULL;
+}
+
+
+// ---------------------------------------------- texture_atlas_clear_dirty ---
+void
+texture_atlas_clear_dirty( texture_atlas_t * self ) {
+	assert( self );
+
+	vector_clear( self->dirty );
+	self->modified = 0;
 }
 
 
 // ------------------------------------------------------ texture_atlas_fit ---
-int
+// Single pass best fit over the skyline. The nodes a region starting on
+// node i rests on form a window that only moves right as i does, so their
+// highest point is kept in a queue of decreasing heights instead of walking
+// the window again for every node. Returns the index of the node giving the
+// lowest top (the narrowest node on ties) with its y in *best_y, or -1.
+static int
 texture_atlas_fit( texture_atlas_t * self,
-				   const size_t index,
 				   const size_t width,
-				   const size_t height ) {
-	ivec3 *node;
-	int x, y, width_left;
+				   const size_t height,
+				   int * best_y ) {
+	ivec3 *nodes = (ivec3 *) vector_front( self->nodes );
+	size_t count = vector_size( self->nodes );
+	size_t best_height = SIZE_MAX, best_width = SIZE_MAX;
+	size_t *window, head = 0, tail = 0, i, j = 0, covered = 0;
+	int best_index = -1, y;
+
+	if ( vector_capacity( self->window ) < count ) {
+		vector_reserve( self->window, 2 * count );
+	}
+	window = (size_t *) self->window->items;
+
+	for ( i = 0; i < count; ++i ) {
+		if ( (size_t) nodes[i].x + width > self->width - 1 ) {
+			break;
+		}
+		// Node i-1 leaves the window
+		if ( i > 0 && j >= i ) {
+			covered -= nodes[i-1].z;
+			if ( head < tail && window[head] == i-1 ) {
+				++head;
+			}
+		} else if ( j < i ) {
+			j = i;
+			covered = 0;
+			head = tail = 0;
+		}
+		while ( covered < width && j < count ) {
+			while ( head < tail && nodes[window[tail-1]].y <= nodes[j].y ) {
+				--tail;
+			}
+			window[tail++] = j;
+			covered += nodes[j].z;
+			++j;
+		}
+		if ( covered < width ) {
+			break;
+		}
+
+		y = head < tail ? nodes[window[head]].y : nodes[i].y;
+		if ( (size_t) y + height > self->height - 1 ) {
+			continue;
+		}
+		if ( ( (y + height) < best_height ) ||
+				( ((y + height) == best_height) && (nodes[i].z > 0 && (size_t)nodes[i].z < best_width)) ) {
+			best_height = y + height;
+			best_width = nodes[i].z;
+			best_index = i;
+			*best_y = y;
+		}
+	}
+	return best_index;
+}
+
+
+// ---------------------------------------------------- texture_atlas_place ---
+// Lays a region on the skyline from node index on: the nodes it covers make
+// way for one node at its top, a node it only partly covers is shortened,
+// and neighbours of the same height are merged. The skyline is merged after
+// every allocation, so only the new node can have such neighbours.
+static void
+texture_atlas_place( texture_atlas_t * self,
+					 const size_t index,
+					 const ivec4 region ) {
+	ivec3 node = {{region.x, region.y + region.height, region.width}};
+	ivec3 *nodes = (ivec3 *) vector_front( self->nodes );
+	int right = region.x + region.width;
+	size_t last = index;
+
+	while ( last < vector_size( self->nodes ) &&
+			nodes[last].x + nodes[last].z <= right ) {
+		++last;
+	}
+	if ( last == index ) {
+		vector_insert( self->nodes, index, &node );
+		nodes = (ivec3 *) vector_front( self->nodes );
+	} else {
+		nodes[index] = node;
+		if ( last > index + 1 ) {
+			vector_erase_range( self->nodes, index + 1, last );
+		}
+	}
+
+	last = index + 1;
+	if ( last < vector_size( self->nodes ) && nodes[last].x < right ) {
+		nodes[last].z -= right - nodes[last].x;
+		nodes[last].x = right;
+	}
+	if ( last < vector_size( self->nodes ) && nodes[last].y == nodes[index].y ) {
+		nodes[index].z += nodes[last].z;
+		vector_erase( self->nodes, last );
+	}
+	if ( index > 0 && nodes[index-1].y == nodes[index].y ) {
+		nodes[index-1].z += nodes[index].z;
+		vector_erase( self->nodes, index );
+	}
+}
+
+
+// ------------------------------------------- texture_atlas_skyline_region ---
+static int
+texture_atlas_skyline_region( texture_atlas_t * self,
+							  const size_t width,
+							  const size_t height,
+							  ivec4 * region ) {
+	int y = 0, index;
+
+	index = texture_atlas_fit( self, width, height, &y );
+	if ( index == -1 ) {
+		return 0;
+	}
+	region->x = ((ivec3 *) vector_get( self->nodes, index ))->x;
+	region->y = y;
+	texture_atlas_place( self, index, *region );
+	return 1;
+}
+
+
+// ---------------------------------------------- texture_atlas_prune_rects ---
+// Drops the free rectangles from index first on that lie inside another
+// one. Those before first come from a pruned set and are left alone: none
+// of them can lie inside a rectangle split from a bigger one.
+static void
+texture_atlas_prune_rects( texture_atlas_t * self,
+						   size_t first ) {
+	ivec4 *a, *b;
+	size_t i, j;
+
+	for ( i = first; i < vector_size( self->rects ); ++i ) {
+		a = (ivec4 *) vector_get( self->rects, i );
+		for ( j = 0; j < vector_size( self->rects ); ++j ) {
+			b = (ivec4 *) vector_get( self->rects, j );
+			if ( j != i &&
+				 a->x >= b->x && a->x + a->width <= b->x + b->width &&
+				 a->y >= b->y && a->y + a->height <= b->y + b->height ) {
+				vector_erase( self->rects, i-- );
+				break;
+			}
+		}
+	}
+}
+
+
+// ---------------------------------------------- texture_atlas_split_rects ---
+// Every free rectangle the used region overlaps is replaced by what is
+// left of it on each side of the region.
+static void
+texture_atlas_split_rects( texture_atlas_t * self,
+						   const ivec4 used ) {
+	size_t i, count = vector_size( self->rects );
+	ivec4 rect, part;
+
+	if ( used.width == 0 || used.height == 0 ) {
+		return;
+	}
+	for ( i = 0; i < count; ) {
+		rect = *(ivec4 *) vector_get( self->rects, i );
+		if ( used.x >= rect.x + rect.width || used.x + used.width <= rect.x ||
+			 used.y >= rect.y + rect.height || used.y + used.height <= rect.y ) {
+			++i;
+			continue;
+		}
+		vector_erase( self->rects, i );
+		--count;
+		if ( used.x > rect.x ) {
+			part = (ivec4){{rect.x, rect.y, used.x - rect.x, rect.height}};
+			vector_push_back( self->rects, &part );
+		}
+		if ( used.x + used.width < rect.x + rect.width ) {
+			part = (ivec4){{used.x + used.width, rect.y,
+							rect.x + rect.width - used.x - used.width, rect.height}};
+			vector_push_back( self->rects, &part );
+		}
+		if ( used.y > rect.y ) {
+			part = (ivec4){{rect.x, rect.y, rect.width, used.y - rect.y}};
+			vector_push_back( self->rects, &part );
+		}
+		if ( used.y + used.height < rect.y + rect.height ) {
+			part = (ivec4){{rect.x, used.y + used.height, rect.width,
+							rect.y + rect.height - used.y - used.height}};
+			vector_push_back( self->rects, &part );
+		}
+	}
+	texture_atlas_prune_rects( self, count );
+}
+
+
+// -------------------------------------------- texture_atlas_enlarge_rects ---
+// Free rectangles reaching the former right or bottom border now reach the
+// new one, and the space gained is free.
+static void
+texture_atlas_enlarge_rects( texture_atlas_t * self,
+							 const size_t width_old,
+							 const size_t height_old ) {
+	size_t i, count = vector_size( self->rects );
+	ivec4 *rect, gained;
+
+	for ( i = 0; i < count; ++i ) {
+		rect = (ivec4 *) vector_get( self->rects, i );
+		if ( (size_t) (rect->x + rect->width) == width_old - 1 ) {
+			rect->width += self->width - width_old;
+		}
+		if ( (size_t) (rect->y + rect->height) == height_old - 1 ) {
+			rect->height += self->height - height_old;
+		}
+	}
+	if ( self->width > width_old ) {
+		gained = (ivec4){{width_old - 1, 1, self->width - width_old, self->height - 2}};
+		vector_push_back( self->rects, &gained );
+	}
+	if ( self->height > height_old ) {
+		gained = (ivec4){{1, height_old - 1, self->width - 2, self->height - height_old}};
+		vector_push_back( self->rects, &gained );
+	}
+	texture_atlas_prune_rects( self, 0 );
+}
+
+
+// ------------------------------------------ texture_atlas_maxrects_region ---
+// Best short side fit: the free rectangle leaving the least room along
+// one of its sides, then along the other one.
+static int
+texture_atlas_maxrects_region( texture_atlas_t * self,
+							   const size_t width,
+							   const size_t height,
+							   ivec4 * region ) {
+	size_t i, best_short = SIZE_MAX, best_long = SIZE_MAX, dw, dh;
+	ivec4 *rect, *best = NULL;
+
+	for ( i = 0; i < vector_size( self->rects ); ++i ) {
+		rect = (ivec4 *) vector_get( self->rects, i );
+		if ( (size_t) rect->width < width || (size_t) rect->height < height ) {
+			continue;
+		}
+		dw = rect->width - width;
+		dh = rect->height - height;
+		if ( (dw < dh ? dw : dh) < best_short ||
+			 ((dw < dh ? dw : dh) == best_short && (dw < dh ? dh : dw) < best_long) ) {
+			best_short = dw < dh ? dw : dh;
+			best_long = dw < dh ? dh : dw;
+			best = rect;
+		}
+	}
+	if ( !best ) {
+		return 0;
+	}
+	region->x = best->x;
+	region->y = best->y;
+	texture_atlas_split_rects( self, *region );
+	return 1;
+}
+
+
+// --------------------------------------------- texture_atlas_shelf_region ---
+// Best height fit: the lowest shelf the region fits in, a new shelf as
+// high as the region being opened when none does.
+static int
+texture_atlas_shelf_region( texture_atlas_t * self,
+							const size_t width,
+							const size_t height,
+							ivec4 * region ) {
+	ivec3 *shelf, *best = NULL, added;
 	size_t i;
 
+	for ( i = 0; i < vector_size( self->shelves ); ++i ) {
+		shelf = (ivec3 *) vector_get( self->shelves, i );
+		if ( (size_t) shelf->z >= height &&
+			 (size_t) shelf->x + width <= self->width - 1 &&
+			 ( !best || shelf->z < best->z ) ) {
+			best = shelf;
+		}
+	}
+	if ( !best ) {
+		added = (ivec3){{1, 1, height}};
+		if ( !vector_empty( self->shelves ) ) {
+			shelf = (ivec3 *) vector_back( self->shelves );
+			added.y = shelf->y + shelf->z;
+		}
+		if ( 1 + width > self->width - 1 ||
+			 (size_t) added.y + height > self->height - 1 ) {
+			return 0;
+		}
+		vector_push_back( self->shelves, &added );
+		best = (ivec3 *) vector_back( self->shelves );
+	}
+	region->x = best->x;
+	region->y = best->y;
+	best->x += width;
+	return 1;
+}
+
+
+// ----------------------------------------------- texture_atlas_set_packer ---
+void
+texture_atlas_set_packer( texture_atlas_t * self,
+						  const packer_t packer ) {
+	ivec3 *nodes, *shelf;
+	ivec4 *rect, space;
+	size_t i, l, r, count, top = 1;
+
+	assert( self );
+
+	// The skyline is brought up to the space the other packers have taken
+	if ( self->packer == PACKER_SHELF && !vector_empty( self->shelves ) ) {
+		shelf = (ivec3 *) vector_back( self->shelves );
+		top = shelf->y + shelf->z;
+	} else if ( self->packer == PACKER_MAXRECTS ) {
+		// Free rows at the end of the atlas make a free rectangle of their own
+		top = self->height - 1;
+		for ( i = 0; i < vector_size( self->rects ); ++i ) {
+			rect = (ivec4 *) vector_get( self->rects, i );
+			if ( rect->x == 1 && (size_t) rect->width == self->width - 2 &&
+				 (size_t) (rect->y + rect->height) == self->height - 1 &&
+				 (size_t) rect->y < top ) {
+				top = rect->y;
+			}
+		}
+	}
+	if ( self->packer != PACKER_SKYLINE ) {
+		ivec3 node = {{1, top, self->width - 2}};
+		vector_clear( self->nodes );
+		vector_push_back( self->nodes, &node );
+	}
+	vector_clear( self->rects );
+	vector_clear( self->shelves );
+
+	nodes = (ivec3 *) vector_front( self->nodes );
+	count = vector_size( self->nodes );
+	if ( packer == PACKER_MAXRECTS ) {
+		// The free space above the skyline: one rectangle per node, as wide
+		// as the nodes around it that are no higher allow
+		for ( i = 0; i < count; ++i ) {
+			for ( l = i; l > 0 && nodes[l-1].y <= nodes[i].y; --l );
+			for ( r = i; r + 1 < count && nodes[r+1].y <= nodes[i].y; ++r );
+			if ( (size_t) nodes[i].y < self->height - 1 ) {
+				space = (ivec4){{nodes[l].x, nodes[i].y,
+								nodes[r].x + nodes[r].z - nodes[l].x,
+								self->height - 1 - nodes[i].y}};
+				vector_push_back( self->rects, &space );
+			}
+		}
+		texture_atlas_prune_rects( self, 0 );
+	} else if ( packer == PACKER_SHELF ) {
+		// A full shelf stands for the rows taken so far
+		for ( i = 0, top = 1; i < count; ++i ) {
+			if ( (size_t) nodes[i].y > top ) {
+				top = nodes[i].y;
+			}
+		}
+		if ( top > 1 ) {
+			ivec3 full = {{self->width - 1, 1, top - 1}};
+			vector_push_back( self->shelves, &full );
+		}
+	}
+	self->packer = packer;
+}
+
+
+// ---------------------------------------------- texture_atlas_compare_int ---
+// Orders ints, or vectors by their first component.
+static int
+texture_atlas_compare_int( const void * a,
+						   const void * b ) {
+	return (*(const int *) a > *(const int *) b) - (*(const int *) a < *(const int *) b);
+}
+
+
+// ----------------------------------------------- texture_atlas_union_area ---
+// Area covered by possibly overlapping rectangles, summed over the vertical
+// slabs between their left and right sides.
+static size_t
+texture_atlas_union_area( const vector_t * rects ) {
+	size_t count = vector_size( rects ), area = 0, i, j, k, n, length;
+	int *xs = (int *) malloc( 2 * count * sizeof(int) );
+	ivec2 *spans = (ivec2 *) malloc( count * sizeof(ivec2) );
+	const ivec4 *rect;
+	int end;
+
+	if ( !xs || !spans ) {
+		free( xs );
+		free( spans );
+		return 0;
+	}
+	for ( i = 0; i < count; ++i ) {
+		rect = (const ivec4 *) vector_get( rects, i );
+		xs[2*i] = rect->x;
+		xs[2*i+1] = rect->x + rect->width;
+	}
+	qsort( xs, 2 * count, sizeof(int), texture_atlas_compare_int );
+
+	for ( k = 0; k + 1 < 2 * count; ++k ) {
+		if ( xs[k] == xs[k+1] ) {
+			continue;
+		}
+		for ( i = 0, n = 0; i < count; ++i ) {
+			rect = (const ivec4 *) vector_get( rects, i );
+			if ( rect->x <= xs[k] && rect->x + rect->width >= xs[k+1] ) {
+				spans[n++] = (ivec2){{rect->y, rect->y + rect->height}};
+			}
+		}
+		qsort( spans, n, sizeof(ivec2), texture_atlas_compare_int );
+		for ( j = 0, length = 0, end = INT_MIN; j < n; ++j ) {
+			if ( spans[j].y <= end ) {
+				continue;
+			}
+			length += spans[j].y - (spans[j].x > end ? spans[j].x : end);
+			end = spans[j].y;
+		}
+		area += length * (xs[k+1] - xs[k]);
+	}
+	free( xs );
+	free( spans );
+	return area;
+}
+
+
+// ------------------------------------------------ texture_atlas_get_stats ---
+texture_atlas_stats_t
+texture_atlas_get_stats( const texture_atlas_t * self ) {
+	texture_atlas_stats_t stats;
+	const ivec3 *node;
+	const ivec4 *freed;
+	size_t i, next = 1;
+
+	assert( self );
+
+	// The pages before the current one are closed, those after it are empty
+	stats.area = (self->width - 2) * (self->height - 2) * self->layers;
+	stats.used = self->used;
+	stats.free = (self->width - 2) * (self->height - 2) * (self->layers - 1 - self->layer);
+	if ( self->packer == PACKER_SKYLINE ) {
+		for ( i = 0; i < vector_size( self->nodes ); ++i ) {
+			node = (const ivec3 *) vector_get( self->nodes, i );
+			stats.free += node->z * (self->height - 1 - node->y);
+		}
+	} else if ( self->packer == PACKER_MAXRECTS ) {
+		stats.free += texture_atlas_union_area( self->rects );
+	} else {
+		for ( i = 0; i < vector_size( self->shelves ); ++i ) {
+			node = (const ivec3 *) vector_get( self->shelves, i );
+			stats.free += (self->width - 1 - node->x) * node->z;
+			next = node->y + node->z;
+		}
+		stats.free += (self->width - 2) * (self->height - 1 - next);
+	}
+	for ( i = 0; i < vector_size( self->freed ); ++i ) {
+		freed = (const ivec4 *) vector_get( self->freed, i );
+		stats.free += freed->width * freed->height;
+	}
+	stats.wasted = stats.area > stats.used + stats.free
+		? stats.area - stats.used - stats.free : 0;
+	stats.occupancy = stats.area ? stats.used / (float) stats.area : 0;
+	return stats;
+}
+
+
+// ---------------------------------------------------- texture_atlas_reuse ---
+// Best area fit among the freed regions, what is left of it on the right
+// and below is split along the shorter side and kept for later.
+static int
+texture_atlas_reuse( texture_atlas_t * self,
+					 const size_t width,
+					 const size_t height,
+					 ivec4 * region ) {
+	ivec4 *freed, best, right, below;
+	size_t i, best_index = 0, best_waste = SIZE_MAX;
+
+	for ( i = 0; i < vector_size( self->freed ); ++i ) {
+		freed = (ivec4 *) vector_get( self->freed, i );
+		if ( (size_t)freed->width >= width && (size_t)freed->height >= height &&
+			 (size_t)(freed->width * freed->height) - width * height < best_waste ) {
+			best_waste = freed->width * freed->height - width * height;
+			best_index = i;
+		}
+	}
+	if ( best_waste == SIZE_MAX ) {
+		return 0;
+	}
+
+	best = *(ivec4 *) vector_get( self->freed, best_index );
+	vector_erase( self->freed, best_index );
+
+	right.x = best.x + width;
+	right.y = best.y;
+	right.width = best.width - width;
+	below.x = best.x;
+	below.y = best.y + height;
+	below.height = best.height - height;
+	if ( right.width < below.height ) {
+		right.height = height;
+		below.width = best.width;
+	} else {
+		right.height = best.height;
+		below.width = width;
+	}
+	if ( right.width > 0 && right.height > 0 ) {
+		vector_push_back( self->freed, &right );
+	}
+	if ( below.width > 0 && below.height > 0 ) {
+		vector_push_back( self->freed, &below );
+	}
+
+	region->x = best.x;
+	region->y = best.y;
+	region->width = width;
+	region->height = height;
+	self->used += width * height;
+	return 1;
+}
+
+
+// ------------------------------------------ texture_atlas_enlarge_texture ---
+void
+texture_atlas_enlarge_texture( texture_atlas_t * self,
+							   const size_t width_new,
+							   const size_t height_new ) {
+	size_t width_old, height_old, i;
+	unsigned char *data;
+	texture_glyph_t *special;
+
 	assert( self );
+	assert( width_new >= self->width );
+	assert( height_new >= self->height );
 
-	node = (ivec3 *) (vector_get( self->nodes, index ));
-	x = node->x;
-	y = node->y;
-	width_left = width;
-	i = index;
+	// The pages would all have to be laid out again
+	if ( self->layers > 1 ) {
+		freetype_gl_error( Unimplemented_Function,
+			   "%s:%d: An atlas of several layers cannot be enlarged\n", __FILENAME__, __LINE__ );
+		return;
+	}
 
-	if ( (x + width) > (self->width-1) ) {
-		return -1;
+	if ( !texture_atlas_own_data( self ) ) {
+		return;
 	}
-	y = node->y;
-	while ( width_left > 0 ) {
-		node = (ivec3 *) (vector_get( self->nodes, i ));
-		if ( node->y > y ) {
-			y = node->y;
+
+	width_old = self->width;
+	height_old = self->height;
+	if ( width_new == width_old ) {
+		// Rows keep their place, only the new ones need clearing
+		data = realloc( self->data, width_new * height_new * self->depth );
+		if ( !data ) {
+			freetype_gl_error( Out_Of_Memory,
+				   "%s:%d: No more memory for allocating data\n", __FILENAME__, __LINE__ );
+			return;
+		}
+		memset( data + width_old * height_old * self->depth, 0,
+				width_new * (height_new - height_old) * self->depth );
+	} else {
+		data = calloc( width_new * height_new, self->depth );
+		if ( !data ) {
+			freetype_gl_error( Out_Of_Memory,
+				   "%s:%d: No more memory for allocating data\n", __FILENAME__, __LINE__ );
+			return;
 		}
-		if ( (y + height) > (self->height-1) ) {
-			return -1;
+		for ( i = 0; i < height_old; ++i ) {
+			memcpy( data + i * width_new * self->depth,
+					self->data + i * width_old * self->depth,
+					width_old * self->depth );
 		}
-		width_left -= node->z;
-		++i;
+		free( self->data );
+
+		// Widen the last node, or add one, for the space gained on the right
+		ivec3 *last = (ivec3 *) vector_back( self->nodes );
+		if ( last->y == 1 ) {
+			last->z += width_new - width_old;
+		} else {
+			ivec3 node = {{width_old - 1, 1, width_new - width_old}};
+			vector_push_back( self->nodes, &node );
+		}
+	}
+	self->data = data;
+	self->width = width_new;
+	self->height = height_new;
+	self->modified = 1;
+	// The texture has to be created again with its new size
+	vector_clear( self->dirty );
+	texture_atlas_add_dirty( self, (ivec4){{0, 0, width_new, height_new}} );
+	if ( self->packer == PACKER_MAXRECTS ) {
+		texture_atlas_enlarge_rects( self, width_old, height_old );
+	}
+
+	special = (texture_glyph_t *) self->special;
+	if ( special ) {
+		special->s0 *= (float) width_old / width_new;
+		special->s1 *= (float) width_old / width_new;
+		special->t0 *= (float) height_old / height_new;
+		special->t1 *= (float) height_old / height_new;
 	}
-	return y;
 }
 
 
-// ---------------------------------------------------- texture_atlas_merge ---
+// -------------------------------------------------- texture_atlas_enlarge ---
 void
-texture_atlas_merge( texture_atlas_t * self ) {
-	ivec3 *node, *next;
+texture_atlas_enlarge( texture_atlas_t * self,
+					   const size_t width_new,
+					   const size_t height_new ) {
+	size_t width_old = self->width, height_old = self->height, i;
+
+	texture_atlas_enlarge_texture( self, width_new, height_new );
+	if ( self->width == width_old && self->height == height_old ) {
+		return;
+	}
+	for ( i = 0; i < vector_size( self->fonts ); ++i ) {
+		texture_font_t *font = *(texture_font_t **) vector_get( self->fonts, i );
+		if ( font->scaletex ) {
+			texture_font_enlarge_glyphs( font, (float) width_old / width_new,
+										 (float) height_old / height_new );
+		}
+	}
+}
+
+
+// ----------------------------------------------------- texture_atlas_grow ---
+// Enlarges a full atlas according to its growth policy. The height grows
+// first since that keeps the data in place.
+static int
+texture_atlas_grow( texture_atlas_t * self ) {
+	size_t width = self->width, height = self->height;
+
+	if ( self->growth <= 1 || self->layers > 1 ) {
+		return 0;
+	}
+	if ( height < self->max_height ) {
+		height = height * self->growth;
+		height = height > self->max_height ? self->max_height
+			: height > self->height ? height : self->height + 1;
+	} else if ( width < self->max_width ) {
+		width = width * self->growth;
+		width = width > self->max_width ? self->max_width
+			: width > self->width ? width : self->width + 1;
+	} else {
+		return 0;
+	}
+	texture_atlas_enlarge( self, width, height );
+	return self->width == width && self->height == height;
+}
+
+
+// ----------------------------------------------- texture_atlas_next_layer ---
+// Moves the packer on to the next page, adding one as long as max_layers
+// allows it. The pages before are left as they are, only their freed
+// regions are reused.
+static int
+texture_atlas_next_layer( texture_atlas_t * self ) {
+	size_t page = self->width * self->height * self->depth;
+	ivec3 node = {{1, 1, self->width - 2}};
+	unsigned char *data;
+	packer_t packer;
+
+	if ( self->layer + 1 >= self->layers ) {
+		if ( self->layers >= self->max_layers ||
+			 !texture_atlas_own_data( self ) ) {
+			return 0;
+		}
+		data = (unsigned char *) realloc( self->data, page * (self->layers + 1) );
+		if ( !data ) {
+			freetype_gl_error( Out_Of_Memory,
+				   "%s:%d: No more memory for allocating data\n", __FILENAME__, __LINE__ );
+			return 0;
+		}
+		memset( data + page * self->layers, 0, page );
+		self->data = data;
+		self->layers++;
+		// The texture array has to be created again with its new layer
+		vector_clear( self->dirty );
+		texture_atlas_add_dirty( self, (ivec4){{0, 0, self->width,
+												self->height * self->layers}} );
+		self->modified = 1;
+	}
+	self->layer++;
+
+	// The packer starts from an empty page
+	vector_clear( self->nodes );
+	vector_push_back( self->nodes, &node );
+	packer = self->packer;
+	self->packer = PACKER_SKYLINE;
+	texture_atlas_set_packer( self, packer );
+	return 1;
+}
+
+// ------------------------------------------------- texture_atlas_add_font ---
+void
+texture_atlas_add_font( texture_atlas_t * self,
+						struct texture_font_t * font ) {
+	assert( self );
+
+	vector_push_back( self->fonts, &font );
+}
+
+
+// ---------------------------------------------- texture_atlas_remove_font ---
+void
+texture_atlas_remove_font( texture_atlas_t * self,
+						   struct texture_font_t * font ) {
 	size_t i;
 
 	assert( self );
 
-	for ( i=0; i< self->nodes->size-1; ++i ) {
-		node = (ivec3 *) (vector_get( self->nodes, i ));
-		next = (ivec3 *) (vector_get( self->nodes, i+1 ));
-	if ( node->y == next->y ) {
-		node->z += next->z;
-		vector_erase( self->nodes, i+1 );
-		--i;
-	}
+	for ( i = 0; i < vector_size( self->fonts ); ++i ) {
+		if ( *(texture_font_t **) vector_get( self->fonts, i ) == font ) {
+			vector_erase( self->fonts, i );
+			return;
+		}
 	}
 }
 
@@ -188,33 +1059,30 @@ ivec4
 texture_atlas_get_region( texture_atlas_t * self,
 						  const size_t width,
 						  const size_t height ) {
-	int y, best_index;
-	size_t best_height, best_width;
-	ivec3 *node, *prev;
 	ivec4 region = {{0,0,width,height}};
-	size_t i;
+	int found;
 
 	assert( self );
 
-	best_height = UINT_MAX;
-	best_index  = -1;
-	best_width = UINT_MAX;
-	for ( i=0; i<self->nodes->size; ++i ) {
-		y = texture_atlas_fit( self, i, width, height );
-		if ( y >= 0 ) {
-			node = (ivec3 *) vector_get( self->nodes, i );
-			if ( ( (y + height) < best_height ) ||
-					( ((y + height) == best_height) && (node->z > 0 && (size_t)node->z < best_width)) ) {
-				best_height = y + height;
-				best_index = i;
-				best_width = node->z;
-				region.x = node->x;
-				region.y = y;
-			}
-		}
+	if ( texture_atlas_reuse( self, width, height, &region ) ) {
+		return region;
 	}
-	
-	if ( best_index == -1 ) {
+
+	switch ( self->packer ) {
+	case PACKER_MAXRECTS:
+		found = texture_atlas_maxrects_region( self, width, height, &region );
+		break;
+	case PACKER_SHELF:
+		found = texture_atlas_shelf_region( self, width, height, &region );
+		break;
+	default:
+		found = texture_atlas_skyline_region( self, width, height, &region );
+		break;
+	}
+	if ( !found && (texture_atlas_grow( self ) || texture_atlas_next_layer( self )) ) {
+		return texture_atlas_get_region( self, width, height );
+	}
+	if ( !found ) {
 		region.x = -1;
 		region.y = -1;
 		region.width = 0;
@@ -222,58 +1090,322 @@ texture_atlas_get_region( texture_atlas_t * self,
 		return region;
 	}
 
-	node = (ivec3 *) malloc( sizeof(ivec3) );
-	if ( node == NULL) {
+	// The packers work within the current page
+	region.y += self->layer * self->height;
+	self->used += width * height;
+	self->modified = 1;
+	texture_atlas_add_dirty( self, region );
+	return region;
+}
+
+
+// ------------------------------------------------------- typedef & struct ---
+/* A region of a batch and its place in the batch */
+typedef struct {
+	ivec4 region;
+	size_t index;
+} batch_region_t;
+
+// --------------------------------------------------- batch_region_compare ---
+/* Highest regions first, then widest, then in batch order */
+static int
+batch_region_compare( const void *a, const void *b ) {
+	const batch_region_t *x = a, *y = b;
+
+	if ( x->region.height != y->region.height ) {
+		return x->region.height > y->region.height ? -1 : 1;
+	}
+	if ( x->region.width != y->region.width ) {
+		return x->region.width > y->region.width ? -1 : 1;
+	}
+	return x->index < y->index ? -1 : x->index > y->index;
+}
+
+
+// ---------------------------------------------- texture_atlas_get_regions ---
+size_t
+texture_atlas_get_regions( texture_atlas_t * self,
+						   ivec4 * regions,
+						   const size_t count ) {
+	batch_region_t *batch;
+	ivec4 region;
+	size_t i, missed = 0;
+
+	assert( self );
+
+	batch = (batch_region_t *) malloc( count * sizeof(batch_region_t) );
+	if ( batch == NULL && count ) {
 		freetype_gl_error( Out_Of_Memory,
 			   "%s:%d: No more memory for allocating data\n", __FILENAME__, __LINE__ );
-		return (ivec4){{-1,-1,0,0}};
-		/* exit( EXIT_FAILURE ); */ /* Never exit from a library */
+		return count;
 	}
-	node->x = region.x;
-	node->y = region.y + height;
-	node->z = width;
-	vector_insert( self->nodes, best_index, node );
-	free( node );
-
-	for (i = best_index+1; i < self->nodes->size; ++i) {
-		node = (ivec3 *) vector_get( self->nodes, i );
-		prev = (ivec3 *) vector_get( self->nodes, i-1 );
-
-		if (node->x < (prev->x + prev->z) ) {
-			int shrink = prev->x + prev->z - node->x;
-			node->x += shrink;
-			node->z -= shrink;
-			if (node->z <= 0) {
-				vector_erase( self->nodes, i );
-				--i;
-			} else {
-				break;
-			}
+	for ( i = 0; i < count; ++i ) {
+		batch[i].region = regions[i];
+		batch[i].index = i;
+	}
+	qsort( batch, count, sizeof(batch_region_t), batch_region_compare );
+
+	for ( i = 0; i < count; ++i ) {
+		if ( !batch[i].region.width || !batch[i].region.height ) {
+			continue;
+		}
+		region = texture_atlas_get_region( self, batch[i].region.width,
+										   batch[i].region.height );
+		regions[batch[i].index].x = region.x;
+		regions[batch[i].index].y = region.y;
+		missed += region.x < 0;
+	}
+	free( batch );
+	return missed;
+}
+
+
+// ---------------------------------------------- texture_atlas_merge_freed ---
+// Adds a region to the freed ones, merged with those sharing a whole side
+// with it so that the freed space does not end up in slivers.
+static void
+texture_atlas_merge_freed( texture_atlas_t * self,
+						   ivec4 region ) {
+	ivec4 *freed;
+	size_t i;
+
+	for ( i = 0; i < vector_size( self->freed ); ++i ) {
+		freed = (ivec4 *) vector_get( self->freed, i );
+		if ( freed->x == region.x && freed->width == region.width &&
+			 (freed->y + freed->height == region.y ||
+			  region.y + region.height == freed->y) ) {
+			region.height += freed->height;
+			region.y = freed->y < region.y ? freed->y : region.y;
+		} else if ( freed->y == region.y && freed->height == region.height &&
+					(freed->x + freed->width == region.x ||
+					 region.x + region.width == freed->x) ) {
+			region.width += freed->width;
+			region.x = freed->x < region.x ? freed->x : region.x;
 		} else {
-			break;
+			continue;
 		}
+		vector_erase( self->freed, i );
+		i = -1;
 	}
-	texture_atlas_merge( self );
-	self->used += width * height;
-	self->modified = 1;    
-	return region;
+	vector_push_back( self->freed, &region );
+}
+
+
+// ---------------------------------------------- texture_atlas_free_region ---
+void
+texture_atlas_free_region( texture_atlas_t * self,
+						   const ivec4 region ) {
+	size_t i;
+
+	assert( self );
+	assert( region.x > 0 && region.y > 0 );
+
+	// Without a copy of its own, the region is freed but not cleared
+	if ( texture_atlas_own_data( self ) ) {
+		for ( i = 0; i < (size_t)region.height; ++i ) {
+			memset( self->data + ((region.y + i) * self->width + region.x) * self->depth,
+					0, region.width * self->depth );
+		}
+	}
+	texture_atlas_merge_freed( self, region );
+	self->used -= region.width * region.height;
+	self->modified = 1;
+	texture_atlas_add_dirty( self, region );
 }
 
 
+// ----------------------------------------------- texture_atlas_move_glyph ---
+// Moves the texture coordinates of a glyph along with its region, which
+// may be on another page.
+static void
+texture_atlas_move_glyph( texture_atlas_t * self,
+						  texture_glyph_t * glyph,
+						  const ivec4 region ) {
+	float dx = region.x - glyph->region.x;
+	float dy = (int) (region.y % self->height) - (int) (glyph->region.y % self->height);
+
+	// Glyphs of fonts not scaling their texture coordinates are in pixels
+	if ( glyph->font == NULL || glyph->font->scaletex ) {
+		dx /= self->width;
+		dy /= self->height;
+	}
+	glyph->s0 += dx;
+	glyph->s1 += dx;
+	glyph->t0 += dy;
+	glyph->t1 += dy;
+	glyph->region = region;
+	glyph->layer = region.y / self->height;
+}
+
+
+// -------------------------------------------------- texture_atlas_compact ---
+ivec4
+texture_atlas_compact( texture_atlas_t * self ) {
+	vector_t *glyphs, *nodes, *rects, *shelves, *freed, *dirty;
+	texture_glyph_t *glyph, *special = (texture_glyph_t *) self->special;
+	ivec4 *regions, moved = {{0,0,0,0}};
+	ivec3 node = {{1, 1, self->width - 2}};
+	unsigned char *data;
+	size_t i, j, count, used, missed, row, size, layer, max_layers;
+	packer_t packer;
+	float growth;
+
+	assert( self );
+
+	// Glyphs are moved in pixels of the atlas' own
+	if ( !texture_atlas_own_data( self ) ) {
+		return (ivec4){{-1,-1,0,0}};
+	}
+
+	// The live glyphs: the special one and those of the fonts using the atlas
+	glyphs = vector_new( sizeof(texture_glyph_t *) );
+	if ( special && special->region.width > 0 ) {
+		vector_push_back( glyphs, &special );
+	}
+	for ( i = 0; i < vector_size( self->fonts ); ++i ) {
+		texture_font_t *font = *(texture_font_t **) vector_get( self->fonts, i );
+		GLYPHS_ITERATOR(j, glyph, font->glyphs) {
+			if ( glyph->region.width > 0 ) {
+				vector_push_back( glyphs, &glyph );
+			}
+		} GLYPHS_ITERATOR_END
+	}
+	count = vector_size( glyphs );
+	size = self->width * self->height * self->depth * self->layers;
+	regions = (ivec4 *) malloc( count * sizeof(ivec4) );
+	data = (unsigned char *) malloc( size );
+	if ( (regions == NULL && count) || data == NULL ) {
+		freetype_gl_error( Out_Of_Memory,
+			   "%s:%d: No more memory for allocating data\n", __FILENAME__, __LINE__ );
+		free( regions );
+		free( data );
+		vector_delete( glyphs );
+		return (ivec4){{-1,-1,0,0}};
+	}
+	for ( i = 0; i < count; ++i ) {
+		glyph = *(texture_glyph_t **) vector_get( glyphs, i );
+		regions[i] = (ivec4){{-1, -1, glyph->region.width, glyph->region.height}};
+	}
+
+	// Pack them again into an empty atlas, keeping the current layout aside
+	// should they not fit (the new one is usually much tighter, but
+	// nothing guarantees it)
+	nodes = self->nodes;
+	rects = self->rects;
+	shelves = self->shelves;
+	freed = self->freed;
+	dirty = self->dirty;
+	used = self->used;
+	growth = self->growth;
+	layer = self->layer;
+	max_layers = self->max_layers;
+	self->nodes = vector_new( sizeof(ivec3) );
+	self->rects = vector_new( sizeof(ivec4) );
+	self->shelves = vector_new( sizeof(ivec3) );
+	self->freed = vector_new( sizeof(ivec4) );
+	self->dirty = vector_new( sizeof(ivec4) );
+	self->used = 0;
+	self->growth = 0;
+	self->layer = 0;
+	self->max_layers = self->layers;
+	vector_push_back( self->nodes, &node );
+	packer = self->packer;
+	self->packer = PACKER_SKYLINE;
+	texture_atlas_set_packer( self, packer );
+
+	missed = texture_atlas_get_regions( self, regions, count );
+
+	vector_delete( self->dirty );
+	self->dirty = dirty;
+	self->growth = growth;
+	self->max_layers = max_layers;
+	if ( missed ) {
+		vector_delete( self->nodes );
+		vector_delete( self->rects );
+		vector_delete( self->shelves );
+		vector_delete( self->freed );
+		self->nodes = nodes;
+		self->rects = rects;
+		self->shelves = shelves;
+		self->freed = freed;
+		self->used = used;
+		self->layer = layer;
+		free( regions );
+		free( data );
+		vector_delete( glyphs );
+		return (ivec4){{-1,-1,0,0}};
+	}
+	vector_delete( nodes );
+	vector_delete( rects );
+	vector_delete( shelves );
+	vector_delete( freed );
+
+	// Clear every glyph moving away, then copy it from the former pixels,
+	// the new regions do not overlap
+	memcpy( data, self->data, size );
+	for ( i = 0; i < count; ++i ) {
+		glyph = *(texture_glyph_t **) vector_get( glyphs, i );
+		if ( regions[i].x == glyph->region.x && regions[i].y == glyph->region.y ) {
+			continue;
+		}
+		for ( row = 0; row < (size_t) glyph->region.height; ++row ) {
+			memset( self->data + ((glyph->region.y + row) * self->width +
+								  glyph->region.x) * self->depth,
+					0, glyph->region.width * self->depth );
+		}
+	}
+	for ( i = 0; i < count; ++i ) {
+		glyph = *(texture_glyph_t **) vector_get( glyphs, i );
+		if ( regions[i].x == glyph->region.x && regions[i].y == glyph->region.y ) {
+			continue;
+		}
+		for ( row = 0; row < (size_t) glyph->region.height; ++row ) {
+			memcpy( self->data + ((regions[i].y + row) * self->width +
+								  regions[i].x) * self->depth,
+					data + ((glyph->region.y + row) * self->width +
+							glyph->region.x) * self->depth,
+					glyph->region.width * self->depth );
+		}
+		texture_atlas_add_dirty( self, glyph->region );
+		texture_atlas_add_dirty( self, regions[i] );
+		moved = moved.width ? texture_atlas_union( &moved, &glyph->region ) : glyph->region;
+		moved = texture_atlas_union( &moved, regions + i );
+		texture_atlas_move_glyph( self, glyph, regions[i] );
+		self->modified = 1;
+	}
+
+	free( regions );
+	free( data );
+	vector_delete( glyphs );
+	return moved;
+}
+
 // ---------------------------------------------------- texture_atlas_clear ---
 void
 texture_atlas_clear( texture_atlas_t * self ) {
 	ivec3 node = {{1,1,1}};
+	packer_t packer;
 
 	assert( self );
 	assert( self->data );
 
 	vector_clear( self->nodes );
+	vector_clear( self->freed );
 	self->used = 0;
 	// We want a one pixel border around the whole atlas to avoid any artefact when
 	// sampling texture
 	node.z = self->width-2;
 
 	vector_push_back( self->nodes, &node );
-	memset( self->data, 0, self->width*self->height*self->depth );
+	if ( texture_atlas_own_data( self ) ) {
+		memset( self->data, 0, self->width*self->height*self->depth*self->layers );
+	}
+	self->layer = 0;
+	self->modified = 1;
+	texture_atlas_add_dirty( self, (ivec4){{0, 0, self->width, self->height * self->layers}} );
+
+	// Start the packer again from the empty skyline
+	packer = self->packer;
+	self->packer = PACKER_SKYLINE;
+	texture_atlas_set_packer( self, packer );
 }
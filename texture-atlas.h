@@ -46,6 +46,10 @@ namespace ftgl {
  * algorithm based on C++ sources provided by Jukka Jylänki at:
  * http://clb.demon.fi/files/RectangleBinPack/
  *
+ * The MaxRects (best short side fit) and shelf (best height fit) algorithms
+ * of the same article can be chosen instead with texture_atlas_set_packer,
+ * and texture_atlas_get_stats tells how densely each of them packs.
+ *
  *
  * Example Usage:
  * @code
@@ -70,6 +74,82 @@ namespace ftgl {
  */
 
 
+/**
+ * Algorithm used to find room for new regions
+ */
+typedef enum packer_t {
+	PACKER_SKYLINE,     /**< Skyline bottom-left (default) */
+	PACKER_MAXRECTS,    /**< Maximal free rectangles, best short side fit */
+	PACKER_SHELF        /**< Rows of fixed height, best height fit */
+} packer_t;
+
+
+/**
+ * Occupancy of a texture atlas, see texture_atlas_get_stats
+ */
+typedef struct texture_atlas_stats_t
+{
+	/**
+	 * Pixels inside the one pixel border of the atlas
+	 */
+	size_t area;
+
+	/**
+	 * Pixels of the regions handed out and not given back
+	 */
+	size_t used;
+
+	/**
+	 * Pixels still available to new regions
+	 */
+	size_t free;
+
+	/**
+	 * Pixels neither used nor available: gaps the packer cannot fill
+	 */
+	size_t wasted;
+
+	/**
+	 * Used pixels over the area
+	 */
+	float occupancy;
+
+} texture_atlas_stats_t;
+
+
+/**
+ * A file mapped in memory that atlases and fonts use in place, see
+ * texture_font_load_snapshot, and unmaps once the last of them is deleted.
+ * It may also wrap memory of the caller instead, possibly read-only, see
+ * texture_font_new_from_blob: it is never written to, atlases copy their
+ * data out of it first (see texture_atlas_own_data).
+ */
+typedef struct texture_mapping_t
+{
+	/**
+	 * First byte of the file
+	 */
+	unsigned char * base;
+
+	/**
+	 * Size of the file, in bytes
+	 */
+	size_t size;
+
+	/**
+	 * Number of atlases and fonts using the mapping
+	 */
+	size_t refs;
+
+	/**
+	 * Whether base was mapped by texture_mapping_new, wrapped memory is
+	 * left to the caller
+	 */
+	int mapped;
+
+} texture_mapping_t;
+
+
 /**
  * A texture atlas is used to pack several small regions into a single texture.
  */
@@ -100,6 +180,12 @@ typedef struct texture_atlas_t
 	 */
 	size_t used;
 
+	/**
+	 * Regions given back with texture_atlas_free_region (ivec4), reused
+	 * before new space is taken by the packer
+	 */
+	vector_t * freed;
+
 	/**
 	 * Texture identity (OpenGL)
 	 */
@@ -111,7 +197,7 @@ typedef struct texture_atlas_t
 	unsigned char * data;
 
 	/**
-	 * Atlas has been modified
+	 * Atlas has been modified, reset by texture_atlas_clear_dirty
 	 */
 	unsigned char modified;
 
@@ -121,8 +207,92 @@ typedef struct texture_atlas_t
 
 	void * special;
 
+	/**
+	 * Fonts storing their glyphs in the atlas (struct texture_font_t *),
+	 * their texture coordinates follow the atlas when it is enlarged
+	 */
+	vector_t * fonts;
+
+	/**
+	 * Factor the atlas size is multiplied by when a region does not fit,
+	 * the height first, then the width. 0 (the default) never grows it.
+	 */
+	float growth;
+
+	/**
+	 * Width the atlas can grow to
+	 */
+	size_t max_width;
+
+	/**
+	 * Height the atlas can grow to
+	 */
+	size_t max_height;
+
+	/**
+	 * Packing algorithm, changed with texture_atlas_set_packer
+	 */
+	packer_t packer;
+
+	/**
+	 * Free rectangles of the MaxRects packer (ivec4)
+	 */
+	vector_t * rects;
+
+	/**
+	 * Shelves of the shelf packer (ivec3: first free x, y, height)
+	 */
+	vector_t * shelves;
+
+	/**
+	 * Scratch of the skyline packer (size_t node indices), kept from one
+	 * allocation to the next and only grown along with the skyline
+	 */
+	vector_t * window;
+
+	/**
+	 * Rectangles of the texture changed since the last
+	 * texture_atlas_clear_dirty (ivec4), see texture_atlas_get_dirty
+	 */
+	vector_t * dirty;
+
+	/**
+	 * Number of dirty rectangles beyond which the closest ones are merged
+	 * (16 by default)
+	 */
+	size_t max_dirty;
+
+	/**
+	 * Pages of the atlas, each one width x height and stacked one after
+	 * the other in data, which is thus laid out as a texture array of that
+	 * many layers. Regions of page n have their y between n * height and
+	 * (n + 1) * height.
+	 */
+	size_t layers;
+
+	/**
+	 * Page new regions are packed into, the ones before are full
+	 */
+	size_t layer;
+
+	/**
+	 * Pages the atlas can have: when the current page is full (and growth
+	 * does not apply) the next one is added. 1 (the default) never adds
+	 * one; an atlas of several pages cannot be enlarged.
+	 */
+	size_t max_layers;
+
+	/**
+	 * Mapping data lies in when the atlas was loaded from a snapshot or
+	 * a blob, NULL when data is allocated by the atlas. Data is copied
+	 * out of it before the atlas writes to it or needs more memory.
+	 */
+	texture_mapping_t * mapping;
+
 } texture_atlas_t;
 
+struct texture_font_t;
+
 
 
 /**
@@ -156,7 +326,8 @@ typedef struct texture_atlas_t
  *  @param self   a texture atlas structure
  *  @param width  width of the region to allocate
  *  @param height height of the region to allocate
- *  @return       Coordinates of the allocated region
+ *  @return       Coordinates of the allocated region, its y counting the
+ *                rows of the pages before its own (see layers)
  *
  */
   ivec4
@@ -165,6 +336,25 @@ typedef struct texture_atlas_t
 							const size_t height );
 
 
+/**
+ *  Allocate several regions at once. They are packed from the highest to
+ *  the lowest (then from the widest to the narrowest), which packs much
+ *  tighter than allocating them in any order, so a whole set of regions is
+ *  best allocated before anything is uploaded.
+ *
+ *  @param self    a texture atlas structure
+ *  @param regions width and height of the regions to allocate, their
+ *                 coordinates on return (x and y are -1 for a region that
+ *                 did not fit, empty regions are left as they are)
+ *  @param count   number of regions
+ *  @return        number of regions that did not fit
+ */
+  size_t
+  texture_atlas_get_regions( texture_atlas_t * self,
+							 ivec4 * regions,
+							 const size_t count );
+
+
 /**
  *  Upload data to the specified atlas region.
  *
@@ -186,6 +376,186 @@ typedef struct texture_atlas_t
 							const unsigned char *data,
 							const size_t stride );
 
+/**
+ *  Mark a rectangle of the texture as changed. This is done by the atlas
+ *  for the regions it hands out, uploads, clears or frees; code writing to
+ *  atlas->data itself has to do it too. Rectangles overlapping enough are
+ *  merged, and when there are more than max_dirty of them the two whose
+ *  union adds the fewest pixels are merged.
+ *
+ *  @param self   a texture atlas structure
+ *  @param rect   rectangle changed (x, y, width, height)
+ */
+  void
+  texture_atlas_add_dirty( texture_atlas_t * self,
+						   const ivec4 rect );
+
+/**
+ *  Get the rectangles of the texture changed since the last call to
+ *  texture_atlas_clear_dirty, to upload only them with glTexSubImage2D (or
+ *  the rows they span, when GL_UNPACK_ROW_LENGTH is not available). After
+ *  the atlas has been created, cleared, enlarged or given a new page, the
+ *  whole texture is dirty and has to be created again. With several pages
+ *  a rectangle may span some of them, and has to be split at multiples of
+ *  height for glTexSubImage3D.
+ *
+ *  @param self   a texture atlas structure
+ *  @param count  set to the number of rectangles
+ *  @return       the rectangles (x, y, width, height), valid until the
+ *                atlas is changed again
+ */
+  const ivec4 *
+  texture_atlas_get_dirty( const texture_atlas_t * self,
+						   size_t * count );
+
+/**
+ *  Forget the dirty rectangles once the texture has been uploaded, and
+ *  reset the modified flag.
+ *
+ *  @param self   a texture atlas structure
+ */
+  void
+  texture_atlas_clear_dirty( texture_atlas_t * self );
+
+/**
+ *  Give a region back to the atlas: its pixels are cleared and it is reused
+ *  by the next allocations that fit in it.
+ *  @param self   a texture atlas structure
+ *  @param region a region returned by texture_atlas_get_region
+ */
+  void
+  texture_atlas_free_region( texture_atlas_t * self,
+							 const ivec4 region );
+
+/**
+ *  Increase the size of the atlas. The texture coordinates of the glyphs
+ *  of all the fonts using the atlas, and of the special glyph, are updated.
+ *  When only the height grows, the rows already there are kept in place.
+ *  Invalidates all pointers to atlas->data, and the texture must be
+ *  uploaded again with its new size.
+ *
+ *  @param self       a texture atlas structure
+ *  @param width_new  new width, bigger or equal to the current width
+ *  @param height_new new height, bigger or equal to the current height
+ */
+  void
+  texture_atlas_enlarge( texture_atlas_t * self,
+						 const size_t width_new,
+						 const size_t height_new );
+
+/**
+ *  Same as texture_atlas_enlarge, but glyphs are left untouched: only the
+ *  special glyph texture coordinates are updated.
+ *
+ *  @param self       a texture atlas structure
+ *  @param width_new  new width, bigger or equal to the current width
+ *  @param height_new new height, bigger or equal to the current height
+ */
+  void
+  texture_atlas_enlarge_texture( texture_atlas_t * self,
+								 const size_t width_new,
+								 const size_t height_new );
+
+/**
+ *  Copy the atlas data out of the mapping it lies in, if any, so that it
+ *  can be written to. The atlas does so itself before changing its pixels,
+ *  code writing to data directly must call it first.
+ *
+ *  @param self  a texture atlas structure
+ *  @return      1 on success, 0 if there is no memory for the copy
+ */
+  int
+  texture_atlas_own_data( texture_atlas_t * self );
+
+/**
+ *  Map a whole file in memory, copy on write, with a single reference.
+ *
+ *  @param filename  path of the file
+ *  @return          a new mapping, NULL if the file cannot be mapped
+ */
+  texture_mapping_t *
+  texture_mapping_new( const char * filename );
+
+/**
+ *  Wrap memory of the caller in a mapping with a single reference. The
+ *  memory is never written to nor freed, and must outlive the mapping.
+ *
+ *  @param base  first byte of the memory
+ *  @param size  size of the memory, in bytes
+ *  @return      a new mapping
+ */
+  texture_mapping_t *
+  texture_mapping_wrap( const void * base,
+						size_t size );
+
+/**
+ *  Drop a reference to a mapping, unmapping it with the last one.
+ *
+ *  @param self a texture mapping
+ */
+  void
+  texture_mapping_release( texture_mapping_t * self );
+
+/**
+ *  Register a font storing its glyphs in the atlas, done by the font
+ *  itself when it is created.
+ *
+ *  @param self a texture atlas structure
+ *  @param font a texture font
+ */
+  void
+  texture_atlas_add_font( texture_atlas_t * self,
+						  struct texture_font_t * font );
+
+/**
+ *  Unregister a font, done by the font itself when it is deleted.
+ *
+ *  @param self a texture atlas structure
+ *  @param font a texture font
+ */
+  void
+  texture_atlas_remove_font( texture_atlas_t * self,
+							 struct texture_font_t * font );
+
+/**
+ *  Select the algorithm finding room for the next regions. Regions already
+ *  handed out keep their place, the new packer starts from the space the
+ *  current one has left (only the rows past the last one in use when
+ *  leaving MaxRects or shelves), so it is best chosen right after creation.
+ *
+ *  @param self   a texture atlas structure
+ *  @param packer packing algorithm
+ */
+  void
+  texture_atlas_set_packer( texture_atlas_t * self,
+							const packer_t packer );
+
+/**
+ *  Report how much of the atlas is used, still available or wasted.
+ *
+ *  @param self   a texture atlas structure
+ *  @return       occupancy of the atlas
+ */
+  texture_atlas_stats_t
+  texture_atlas_get_stats( const texture_atlas_t * self );
+
+/**
+ *  Pack the live glyphs again into a fresh layout, reclaiming the space of
+ *  the glyphs evicted and of the fonts deleted since they were packed.
+ *  Their pixels are moved and the texture coordinates (and region) of the
+ *  glyphs of every font using the atlas, and of the special glyph, are
+ *  rewritten. Regions handed out by texture_atlas_get_region that belong
+ *  to no glyph are lost. Nothing changes if the glyphs do not all fit in
+ *  the new layout.
+ *
+ *  @param self   a texture atlas structure
+ *  @return       bounding box of the pixels that changed, which are also
+ *                added to the dirty rectangles (width 0 when no glyph
+ *                moved, x and y -1 when the atlas was left as it was)
+ */
+  ivec4
+  texture_atlas_compact( texture_atlas_t * self );
+
 /**
  *  Remove all allocated regions from the atlas.
  *
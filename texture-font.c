@@ -7,6 +7,7 @@
 #include FT_FREETYPE_H
 #include FT_SIZES_H
 #include FT_STROKER_H
+#include FT_OUTLINE_H
 // #include FT_ADVANCES_H
 #include FT_LCD_FILTER_H
 #include FT_TRUETYPE_TABLES_H
@@ -15,6 +16,9 @@
 #include <stdio.h>
 #include <assert.h>
 #include <math.h>
+#ifdef FREETYPE_GL_USE_THREADS
+#include <pthread.h>
+#endif
 #include "distance-field.h"
 #include "texture-font.h"
 #include "platform.h"
@@ -25,6 +29,10 @@
 #define HRESf 64.f
 #define DPI   72
 
+// Distance in pixels that RENDER_MSDF glyphs are padded with, and encode
+// on each side of their edges, unless the font has a distance spread
+#define MSDF_SPREAD 2
+
 #undef __FTERRORS_H__
 #define FT_ERRORDEF( e, v, s )  { e, s },
 #define FT_ERROR_START_LIST     {
@@ -40,6 +48,18 @@ const struct {
 __THREAD texture_font_library_t * freetype_gl_library = NULL;
 __THREAD font_mode_t mode_default=MODE_AUTO_CLOSE;
 
+static void
+texture_font_async_delete( struct texture_font_async_t * async );
+
+static ivec4
+texture_font_reserve( texture_font_t * self,
+					  size_t width,
+					  size_t height );
+
+static int
+texture_font_is_mapped( const texture_font_t * self,
+						const texture_glyph_t * glyph );
+
 // ------------------------------------------------------ texture_glyph_new ---
 texture_glyph_t *
 texture_glyph_new(void) {
@@ -56,7 +76,6 @@ texture_glyph_new(void) {
 	/* Attributes that can have different images for the same codepoint */
 	self->rendermode = RENDER_NORMAL;
 	self->outline_thickness = 0.0;
-	self->glyphmode = GLYPH_END;
 	/* End of attribute part */
 	self->offset_x  = 0;
 	self->offset_y  = 0;
@@ -66,7 +85,13 @@ texture_glyph_new(void) {
 	self->t0        = 0.0;
 	self->s1        = 0.0;
 	self->t1        = 0.0;
-	self->kerning   = vector_new( sizeof(float**) );
+	self->layer     = 0;
+	self->font      = NULL;
+	self->region    = (ivec4){{0,0,0,0}};
+	self->last_use  = 0;
+	self->lru_prev  = NULL;
+	self->lru_next  = NULL;
+	self->glyphmode = GLYPH_END;
 	return self;
 }
 
@@ -79,102 +104,182 @@ texture_font_default_mode(font_mode_t mode) {
 // --------------------------------------------------- texture_glyph_delete ---
 void
 texture_glyph_delete( texture_glyph_t *self ) {
-	int i;
 	assert( self );
-	for (i=0; i < self->kerning->size; i++)
-	free( *(float **) vector_get( self->kerning, i ) );
-	vector_delete( self->kerning );
 	free( self );
 }
 
+// --------------------------------------------- texture_font_query_kerning ---
+static float
+texture_font_query_kerning( texture_font_t * self,
+							uint32_t left,
+							uint32_t right ) {
+	FT_Vector kerning = { 0, 0 };
+	float value;
+
+	// A face that cannot be opened is not tried again for every pair
+	if ( self->kerning_failed )
+	return 0;
+	if ( !texture_font_load_face( self, self->size ) ) {
+	self->kerning_failed = 1;
+	return 0;
+	}
+
+	if ( FT_HAS_KERNING( self->face ) ) {
+	FT_Get_Kerning( self->face,
+					FT_Get_Char_Index( self->face, left ),
+					FT_Get_Char_Index( self->face, right ),
+					FT_KERNING_UNFITTED, &kerning );
+	}
+	value = kerning.x / (float)(HRESf*HRESf);
+
+	// Pairs without kerning are cached as well, they are the common case
+	kerning_table_set( self->kerning_table, left, right, value );
+
+	texture_font_close( self, MODE_AUTO_CLOSE, MODE_AUTO_CLOSE );
+
+	return value;
+}
+
 // ---------------------------------------------- texture_glyph_get_kerning ---
 float
 texture_glyph_get_kerning( const texture_glyph_t * self,
 						   const char * codepoint ) {
-	uint32_t ucodepoint = utf8_to_utf32( codepoint );
-	uint32_t i = ucodepoint >> 8;
-	uint32_t j = ucodepoint & 0xFF;
-	float *kern_index;
+	return texture_glyph_get_kerning_utf32( self, utf8_to_utf32( codepoint ) );
+}
+
+// ---------------------------------------- texture_glyph_get_kerning_utf32 ---
+float
+texture_glyph_get_kerning_utf32( const texture_glyph_t * self,
+								 uint32_t ucodepoint ) {
+	const kerning_pair_t *pair;
 
 	assert( self );
-	if (ucodepoint == -1)
-	return 0;
-	if (self->kerning->size <= i)
+	if (ucodepoint == (uint32_t) -1 || !self->font)
 	return 0;
 
-	kern_index = *(float **) vector_get( self->kerning, i );
+	pair = kerning_table_find( self->font->kerning_table, ucodepoint, self->codepoint );
+	if ( pair )
+	return pair->kerning;
+
+	if ( self->font->kerning_mode == KERNING_ON_DEMAND )
+	return texture_font_query_kerning( self->font, ucodepoint, self->codepoint );
 
-	if (!kern_index)
 	return 0;
-	else
-	return kern_index[j];
 }
 
-// ---------------------------------------------- texture_font_index_kerning ---
+// --------------------------------------------- texture_font_index_kerning ---
 
-void texture_font_index_kerning( texture_glyph_t * self,
-				 uint32_t codepoint,
+void texture_font_index_kerning( texture_font_t * self,
+				 uint32_t left,
+				 uint32_t right,
 				 float kerning) {
-	uint32_t i = codepoint >> 8;
-	uint32_t j = codepoint & 0xFF;
-	float ** kerning_index;
+	kerning_table_set( self->kerning_table, left, right, kerning );
+}
 
-	if (self->kerning->size <= i) {
-	vector_resize( self->kerning, i+1);
-	}
+// ------------------------------------------ texture_font_generate_kerning ---
+typedef struct {
+	texture_glyph_t *glyph;
+	FT_UInt index;
+	int loaded;
+} kerning_glyph_t;
+
+static int
+compare_codepoints( const void *a, const void *b ) {
+	uint32_t ca = *(const uint32_t *) a, cb = *(const uint32_t *) b;
+	return ca < cb ? -1 : ca > cb;
+}
+
+void
+texture_font_generate_kerning( texture_font_t *self,
+							   uint32_t *codepoints, size_t count ) {
+	size_t i, j;
+	texture_glyph_t *glyph;
+	kerning_glyph_t entry, *left, *right;
+	vector_t *glyphs;
+	FT_Vector kerning;
+
+	assert( self );
 
-	kerning_index = (float **) vector_get( self->kerning, i );
+	/* Fonts without kerning table have no pairs to look for, and on demand
+	 * kerning is looked up at first use only */
+	if ( !count || !self->face || !FT_HAS_KERNING( self->face ) ||
+		 self->kerning_mode == KERNING_ON_DEMAND )
+		return;
 
-	if (!*kerning_index) {
-	*kerning_index = calloc( 0x100, sizeof(float) );
+	qsort( codepoints, count, sizeof(uint32_t), compare_codepoints );
+
+	glyphs = vector_new( sizeof(kerning_glyph_t) );
+	GLYPHS_ITERATOR(i, glyph, self->glyphs ) {
+		entry.glyph = glyph;
+		entry.index = FT_Get_Char_Index( self->face, glyph->codepoint );
+		entry.loaded = bsearch( &glyph->codepoint, codepoints, count,
+								sizeof(uint32_t), compare_codepoints ) != NULL;
+		vector_push_back( glyphs, &entry );
 	}
+	GLYPHS_ITERATOR_END
 
-	(*kerning_index)[j] = kerning;
+	/* Only check the pairs involving at least one of the newly loaded glyphs,
+	 * each of them exactly once. */
+	for ( i = 0; i < vector_size( glyphs ); ++i ) {
+		right = (kerning_glyph_t *) vector_get( glyphs, i );
+		if ( !right->loaded )
+			continue;
+		for ( j = 0; j < vector_size( glyphs ); ++j ) {
+			left = (kerning_glyph_t *) vector_get( glyphs, j );
+			FT_Get_Kerning( self->face, left->index, right->index,
+							FT_KERNING_UNFITTED, &kerning );
+			if ( kerning.x ) {
+				texture_font_index_kerning( self,
+											left->glyph->codepoint,
+											right->glyph->codepoint,
+											kerning.x / (float)(HRESf*HRESf) );
+			}
+			// pairs between two new glyphs are found from both sides
+			if ( left->loaded )
+				continue;
+			FT_Get_Kerning( self->face, right->index, left->index,
+							FT_KERNING_UNFITTED, &kerning );
+			if ( kerning.x ) {
+				texture_font_index_kerning( self,
+											right->glyph->codepoint,
+											left->glyph->codepoint,
+											kerning.x / (float)(HRESf*HRESf) );
+			}
+		}
+	}
+	vector_delete( glyphs );
 }
 
-// ------------------------------------------ texture_font_generate_kerning ---
+// ------------------------------------------ texture_font_set_kerning_mode ---
 void
-texture_font_generate_kerning( texture_font_t *self,
-							   FT_Library *library, FT_Face *face ) {
-	size_t i, j, k;
-	FT_UInt glyph_index, prev_index;
-	texture_glyph_t *glyph, *prev_glyph;
-	FT_Vector kerning;
+texture_font_set_kerning_mode( texture_font_t *self,
+							   kerning_mode_t mode,
+							   size_t cache_size ) {
+	size_t i;
+	texture_glyph_t *glyph;
+	vector_t *loaded;
 
 	assert( self );
 
-	/* For each glyph couple combination, check if kerning is necessary */
-	/* Starts at index 1 since 0 is for the special background glyph */
+	self->kerning_mode = mode;
+	self->kerning_failed = 0;
+	kerning_table_clear( self->kerning_table );
+	self->kerning_table->max_size = mode == KERNING_ON_DEMAND ? cache_size : 0;
+
+	if ( mode != KERNING_PRECOMPUTED || !texture_font_load_face( self, self->size ) )
+	return;
+
+	/* Compute the pairs of the glyphs loaded so far */
+	loaded = vector_new( sizeof(uint32_t) );
 	GLYPHS_ITERATOR(i, glyph, self->glyphs ) {
-	glyph_index = FT_Get_Char_Index( *face, glyph->codepoint );
-//	fprintf(stderr, "Retrieving glyph %p from index %i\n", __glyphs, __i);
-//	fprintf(stderr, "Glpyh %p: Indexing %d, kerning %p\n", glyph, glyph_index, glyph->kerning);
-	for (k=0; k < glyph->kerning->size; k++)
-		free( *(float **) vector_get( glyph->kerning, k ) );
-	vector_clear( glyph->kerning );
-	
-	GLYPHS_ITERATOR(j, prev_glyph, self->glyphs ) {
-		prev_index = FT_Get_Char_Index( *face, prev_glyph->codepoint );
-		FT_Get_Kerning( *face, prev_index, glyph_index, FT_KERNING_UNFITTED, &kerning );
-		// printf("%c(%d)-%c(%d): %ld\n",
-		//       prev_glyph->codepoint, prev_glyph->codepoint,
-		//       glyph_index, glyph_index, kerning.x);
-		if ( kerning.x ) {
-		texture_font_index_kerning( glyph,
-						prev_glyph->codepoint,
-						kerning.x / (float)(HRESf*HRESf) );
-		}
-		// also insert kerning with the current added element
-		FT_Get_Kerning( *face, glyph_index, prev_index, FT_KERNING_UNFITTED, &kerning );
-		if ( kerning.x ) {
-		texture_font_index_kerning( prev_glyph,
-						glyph->codepoint,
-						kerning.x / (float)(HRESf*HRESf) );
-		}
-		}
-		GLYPHS_ITERATOR_END
+		vector_push_back( loaded, &glyph->codepoint );
 	}
 	GLYPHS_ITERATOR_END
+	texture_font_generate_kerning( self, (uint32_t *) loaded->items,
+								   vector_size( loaded ) );
+	vector_delete( loaded );
+
+	texture_font_close( self, MODE_AUTO_CLOSE, MODE_AUTO_CLOSE );
 }
 
 // -------------------------------------------------- texture_is_color_font ---
@@ -265,16 +370,15 @@ texture_font_init_size( texture_font_t * self) {
 	self->linegap = self->height - self->ascender + self->descender;
 }
 
-// ------------------------------------------------------ texture_font_init ---
-static int
-texture_font_init(texture_font_t *self) {
-	assert(self->atlas);
-	assert(self->size > 0);
-	assert((self->location == TEXTURE_FONT_FILE && self->filename)
-		|| (self->location == TEXTURE_FONT_MEMORY
-			&& self->memory.base && self->memory.size));
-
-	self->glyphs = vector_new(sizeof(texture_glyph_t *));
+// --------------------------------------------- texture_font_init_defaults ---
+/* Settings and state of a font before any glyph, shared by the fonts read
+ * from a face and those loaded from a snapshot or a blob */
+static void
+texture_font_init_defaults( texture_font_t *self ) {
+	self->glyphs = glyph_table_new();
+	self->kerning_table = kerning_table_new();
+	self->kerning_mode = KERNING_PRECOMPUTED;
+	self->kerning_failed = 0;
 	self->height = 0;
 	self->ascender = 0;
 	self->descender = 0;
@@ -285,6 +389,18 @@ texture_font_init(texture_font_t *self) {
 	self->filtering = 1;
 	self->scaletex = 1;
 	self->scale = 1.0;
+	self->threads = 1;
+	self->pack_batches = 0;
+	self->distance_mode = DISTANCE_FIELD_EDTAA3;
+	self->distance_spread = 0;
+	self->distance_oversample = 1;
+	self->placeholder = NULL;
+	self->async = NULL;
+	self->evict = 0;
+	self->use_count = 0;
+	self->lru_first = NULL;
+	self->lru_last = NULL;
+	self->evicted = vector_new( sizeof(texture_glyph_t *) );
 
 	// FT_LCD_FILTER_LIGHT   is (0x00, 0x55, 0x56, 0x55, 0x00)
 	// FT_LCD_FILTER_DEFAULT is (0x10, 0x40, 0x70, 0x40, 0x10)
@@ -293,6 +409,19 @@ texture_font_init(texture_font_t *self) {
 	self->lcd_weights[2] = 0x70;
 	self->lcd_weights[3] = 0x40;
 	self->lcd_weights[4] = 0x10;
+}
+
+// ------------------------------------------------------ texture_font_init ---
+static int
+texture_font_init(texture_font_t *self) {
+	assert(self->atlas);
+	assert(self->size > 0);
+	assert((self->location == TEXTURE_FONT_FILE && self->filename)
+		|| (self->location == TEXTURE_FONT_MEMORY
+			&& self->memory.base && self->memory.size));
+
+	texture_font_init_defaults( self );
+	texture_atlas_add_font( self->atlas, self );
 
 	if (!texture_font_load_face(self, self->size * 100.f))
 		return -1;
@@ -384,7 +513,6 @@ texture_font_new_from_memory(texture_atlas_t *atlas, float pt_size,
 texture_font_t *
 texture_font_clone( texture_font_t *old, float pt_size) {
 	texture_font_t *self;
-	FT_Error error = 0;
 	
 	self = calloc(1, sizeof(*self));
 	if (!self) {
@@ -394,31 +522,57 @@ texture_font_clone( texture_font_t *old, float pt_size) {
 	}
 
 	memcpy(self, old, sizeof(*self));
-	self->glyphs = vector_new(sizeof(texture_glyph_t *));
 
-	error = FT_New_Size( self->face, &self->ft_size );
-	if (error) {
-	freetype_error( error, "FT_Error (%s:%d, code 0x%02x) : %s\n",
-			__FILENAME__, __LINE__, FT_Errors[error].code, FT_Errors[error].message);
-	return NULL;
+	/* Nothing the old font owns is shared: the clone opens a face of its
+	 * own and starts with no glyphs nor eviction history */
+	self->glyphs = glyph_table_new();
+	self->kerning_table = kerning_table_new();
+	self->evicted = vector_new( sizeof(texture_glyph_t *) );
+	if ( self->location == TEXTURE_FONT_FILE ) {
+		self->filename = strdup( old->filename );
 	}
-
-	error = FT_Activate_Size( self->ft_size );
-	if (error) {
-	freetype_error( error, "FT_Error (%s:%d, code 0x%02x) : %s\n",
-			__FILENAME__, __LINE__, FT_Errors[error].code, FT_Errors[error].message);
-	return NULL;
+	self->face = NULL;
+	self->ft_size = NULL;
+	self->size = pt_size;
+	self->kerning_failed = 0;
+	self->placeholder = NULL;
+	self->async = NULL;
+	self->use_count = 0;
+	self->lru_first = NULL;
+	self->lru_last = NULL;
+	self->mapping = NULL;
+	self->distance_field = NULL;
+	if ( !self->glyphs || !self->kerning_table || !self->evicted ||
+		 (self->location == TEXTURE_FONT_FILE && !self->filename) ) {
+		freetype_gl_error( Out_Of_Memory,
+			   "line %d: No more memory for allocating data\n", __LINE__);
+		goto cleanup;
 	}
-	
-	if (!texture_font_set_size ( self, pt_size * 100.f ))
-	return NULL;
+	self->kerning_table->max_size = old->kerning_table->max_size;
+	texture_atlas_add_font( self->atlas, self );
+
+	if (!texture_font_load_face(self, self->size * 100.f))
+		goto cleanup_atlas;
 
 	texture_font_init_size( self );
-	
-	if (!texture_font_set_size ( self, pt_size ))
-	return NULL;
+
+	if (!texture_font_set_size(self, self->size))
+		goto cleanup_face;
 
 	return self;
+
+cleanup_face:
+	FT_Done_Size( self->ft_size );
+	texture_font_close( self, MODE_ALWAYS_OPEN, MODE_FREE_CLOSE );
+cleanup_atlas:
+	texture_atlas_remove_font( self->atlas, self );
+cleanup:
+	if ( self->glyphs ) glyph_table_delete( self->glyphs );
+	if ( self->kerning_table ) kerning_table_delete( self->kerning_table );
+	if ( self->evicted ) vector_delete( self->evicted );
+	if ( self->location == TEXTURE_FONT_FILE ) free( self->filename );
+	free( self );
+	return NULL;
 }
 // ----------------------------------------------------- texture_font_close ---
 
@@ -443,6 +597,13 @@ int
 texture_font_load_face( texture_font_t *self, float size ) {
 	FT_Error error;
 
+	if ( self->location == TEXTURE_FONT_NONE ) {
+		freetype_gl_error( Font_Unavailable,
+			   "%s:%d: The font has no face, only the glyphs it was loaded with\n",
+			   __FILENAME__, __LINE__ );
+		return 0;
+	}
+
 	if ( !self->library ) {
 		if ( !freetype_gl_library ) {
 			freetype_gl_library = texture_library_new();
@@ -480,6 +641,10 @@ texture_font_load_face( texture_font_t *self, float size ) {
 			goto cleanup_library;
 		}
 		break;
+
+	case TEXTURE_FONT_NONE:
+		/* Turned down above, before the library */
+		goto cleanup_library;
 	}
 
 	/* Select charmap */
@@ -528,50 +693,138 @@ texture_font_delete( texture_font_t *self ) {
 
 	assert( self );
 
-	error = FT_Done_Size( self->ft_size );
-	if (error) {
-		freetype_error( error, "FT_Error (%s:%d, code 0x%02x) : %s\n",
-			__FILENAME__, __LINE__, FT_Errors[error].code, FT_Errors[error].message);
+	/* The size goes along with a closed face */
+	if ( self->face ) {
+		error = FT_Done_Size( self->ft_size );
+		if (error) {
+			freetype_error( error, "FT_Error (%s:%d, code 0x%02x) : %s\n",
+				__FILENAME__, __LINE__, FT_Errors[error].code, FT_Errors[error].message);
+		}
 	}
 
 	texture_font_close( self, MODE_ALWAYS_OPEN, MODE_FREE_CLOSE );
 
 	if (self->location == TEXTURE_FONT_FILE && self->filename) free( self->filename );
 
+	/* Drop the entries standing in for missing glyphs first, the iterator
+	 * would otherwise look at them after their glyph is deleted. Borrowed
+	 * entries only hold mapped glyphs, which are not deleted. */
+	for ( i = 0; !self->glyphs->borrowed && i < self->glyphs->capacity; ++i ) {
+		glyph_entry_t *entry = self->glyphs->entries + i;
+		if ( entry->codepoint != GLYPH_TABLE_EMPTY &&
+			 entry->glyph->codepoint != entry->codepoint )
+			entry->codepoint = GLYPH_TABLE_EMPTY;
+	}
 	GLYPHS_ITERATOR(i, glyph, self->glyphs) {
-		texture_glyph_delete( glyph );
-	} GLYPHS_ITERATOR_END1
-	free( __glyphs );
-	GLYPHS_ITERATOR_END2;
+		if ( !texture_font_is_mapped( self, glyph ) )
+			texture_glyph_delete( glyph );
+	} GLYPHS_ITERATOR_END
 
-	vector_delete( self->glyphs );
+	if ( self->async ) texture_font_async_delete( self->async );
+	if ( self->atlas ) texture_atlas_remove_font( self->atlas, self );
+	if ( self->evicted ) {
+		texture_font_release_evicted( self );
+		vector_delete( self->evicted );
+	}
+	glyph_table_delete( self->glyphs );
+	if ( self->kerning_table ) kerning_table_delete( self->kerning_table );
+	if ( self->mapping ) texture_mapping_release( self->mapping );
+	if ( self->distance_field ) distance_field_delete( self->distance_field );
 	free( self );
 }
 
+// ------------------------------------------------ texture_font_find_glyph ---
 texture_glyph_t *
 texture_font_find_glyph( texture_font_t * self,
 						 const char * codepoint ) {
-	uint32_t ucodepoint = utf8_to_utf32( codepoint );
-	uint32_t i = ucodepoint >> 8;
-	uint32_t j = ucodepoint & 0xFF;
-	texture_glyph_t **glyph_index1, *glyph;
+	return texture_font_find_glyph_utf32( self, utf8_to_utf32( codepoint ) );
+}
 
-	if (ucodepoint == -1) return (texture_glyph_t *)self->atlas->special;
+// ------------------------------------------------ texture_font_lru_unlink ---
+/* Takes a glyph out of the font list of glyphs by last use, if it is in */
+static void
+texture_font_lru_unlink( texture_font_t * self,
+						 texture_glyph_t * glyph ) {
+	if ( glyph->lru_prev ) {
+		glyph->lru_prev->lru_next = glyph->lru_next;
+	} else if ( self->lru_first == glyph ) {
+		self->lru_first = glyph->lru_next;
+	} else {
+		return;
+	}
+	if ( glyph->lru_next ) {
+		glyph->lru_next->lru_prev = glyph->lru_prev;
+	} else {
+		self->lru_last = glyph->lru_prev;
+	}
+	glyph->lru_prev = glyph->lru_next = NULL;
+}
+
+// ----------------------------------------------- texture_font_touch_glyph ---
+/* Stamps the use of a glyph and moves it to the most recently used end of
+ * the list, glyphs not made by the font stay out of it */
+static void
+texture_font_touch_glyph( texture_font_t * self,
+						  texture_glyph_t * glyph ) {
+	glyph->last_use = ++self->use_count;
+	if ( glyph->font != self || self->lru_last == glyph ) {
+		return;
+	}
+	texture_font_lru_unlink( self, glyph );
+	glyph->lru_prev = self->lru_last;
+	if ( self->lru_last ) {
+		self->lru_last->lru_next = glyph;
+	} else {
+		self->lru_first = glyph;
+	}
+	self->lru_last = glyph;
+}
 
-	if (self->glyphs->size <= i) return NULL;
+// ------------------------------------------------- compare_glyph_last_use ---
+static int
+compare_glyph_last_use( const void *a, const void *b ) {
+	const texture_glyph_t *ga = *(texture_glyph_t * const *) a;
+	const texture_glyph_t *gb = *(texture_glyph_t * const *) b;
 
-	glyph_index1 = *(texture_glyph_t ***) vector_get( self->glyphs, i );
+	return ga->last_use < gb->last_use ? -1 : ga->last_use > gb->last_use;
+}
 
-	if (!glyph_index1)
-	return NULL;
-	else
-	glyph = glyph_index1[j];
+// -------------------------------------------------- texture_font_lru_link ---
+/* Links loaded glyphs in the order of their last use */
+static void
+texture_font_lru_link( texture_font_t * self,
+					   texture_glyph_t ** glyphs,
+					   size_t count ) {
+	size_t i;
+
+	if ( count > 1 ) {
+		qsort( glyphs, count, sizeof(texture_glyph_t *), compare_glyph_last_use );
+	}
+	self->lru_first = self->lru_last = NULL;
+	for ( i = 0; i < count; ++i ) {
+		glyphs[i]->lru_prev = self->lru_last;
+		glyphs[i]->lru_next = NULL;
+		if ( self->lru_last ) {
+			self->lru_last->lru_next = glyphs[i];
+		} else {
+			self->lru_first = glyphs[i];
+		}
+		self->lru_last = glyphs[i];
+	}
+}
+
+// ------------------------------------------ texture_font_find_glyph_utf32 ---
+texture_glyph_t *
+texture_font_find_glyph_utf32( texture_font_t * self,
+							   uint32_t ucodepoint ) {
+	texture_glyph_t *glyph;
+
+	if (ucodepoint == -1) return (texture_glyph_t *)self->atlas->special;
 
-	while ( glyph && // if no glyph is there, we are done here
-			(glyph->rendermode != self->rendermode ||
-			glyph->outline_thickness != self->outline_thickness) ) {
-		if ( glyph->glyphmode != GLYPH_CONT) return NULL;
-		glyph++;
+	glyph = glyph_table_get( self->glyphs, ucodepoint,
+							 self->rendermode, self->outline_thickness );
+	if ( glyph && self->evict ) {
+		texture_font_touch_glyph( self, glyph );
 	}
 	return glyph;
 }
@@ -580,92 +833,277 @@ int
 texture_font_index_glyph( texture_font_t * self,
 			  texture_glyph_t *glyph,
 			  uint32_t codepoint) {
-	uint32_t i = codepoint >> 8;
-	uint32_t j = codepoint & 0xFF;
-	texture_glyph_t ***glyph_index1, *glyph_insert;
+	if ( glyph_table_get( self->glyphs, codepoint,
+						  glyph->rendermode, glyph->outline_thickness ) ) {
+		return 1;
+	}
+	glyph_table_set( self->glyphs, codepoint,
+					 glyph->rendermode, glyph->outline_thickness, glyph );
+	if ( self->evict ) {
+		texture_font_touch_glyph( self, glyph );
+	}
+	return 0;
+}
 
-	if (self->glyphs->size <= i) {
-		vector_resize( self->glyphs, i+1);
+// ------------------------------------------------------- typedef & struct ---
+/* A glyph rendered by FreeType, not yet stored in the atlas */
+typedef struct {
+	uint32_t codepoint;
+	rendermode_t rendermode;
+	float outline_thickness;
+	FT_UInt glyph_index;
+	unsigned char *buffer;
+	size_t width, height;
+	int left, top;
+	FT_Pos advance_x, advance_y;
+	int loaded;
+	int direct;   /* may be rendered straight into the atlas */
+	ivec4 region; /* where it was, when buffer is NULL */
+} glyph_raster_t;
+
+/* Empty pixels around a glyph in its atlas region */
+typedef struct {
+	int left;
+	int top;
+	int right;
+	int bottom;
+} glyph_padding_t;
+
+// ------------------------------------------- texture_font_direct_outline ---
+/* The outline of a glyph if FT_Outline_Get_Bitmap renders it the way
+ * FreeType renders a glyph slot, NULL otherwise */
+static FT_Outline *
+texture_font_direct_outline( FT_Glyph_Format format,
+							 FT_Outline * outline ) {
+	if ( format != FT_GLYPH_FORMAT_OUTLINE ) {
+		return NULL;
+	}
+#ifdef FT_OUTLINE_OVERLAP
+	// the smooth renderer oversamples overlapping contours
+	if ( outline->flags & FT_OUTLINE_OVERLAP ) {
+		return NULL;
 	}
+#endif
+	return outline;
+}
 
-	glyph_index1 = (texture_glyph_t ***) vector_get( self->glyphs, i );
+// -------------------------------------------- texture_font_render_outline ---
+/* Reserves the atlas region of a glyph and renders its outline right into
+ * the atlas memory, the padding being left around it in the region. */
+static int
+texture_font_render_outline( texture_font_t * self,
+							 glyph_raster_t * raster,
+							 FT_Outline * outline,
+							 glyph_padding_t padding ) {
+	texture_atlas_t *atlas = self->atlas;
+	FT_BBox cbox;
+	FT_Bitmap bitmap;
+	FT_Error error;
+	FT_Pos left, bottom, right, top;
+	ivec4 region;
+	size_t i;
 
-	if (!*glyph_index1) {
-		*glyph_index1 = calloc( 0x100, sizeof(texture_glyph_t*) );
-	}
+	// same pixel box as FreeType gives the bitmap of a glyph slot
+	FT_Outline_Get_CBox( outline, &cbox );
+	left   = cbox.xMin >> 6;
+	bottom = cbox.yMin >> 6;
+	right  = (cbox.xMax + 63) >> 6;
+	top    = (cbox.yMax + 63) >> 6;
 
-	if (( glyph_insert = (*glyph_index1)[j] )) {
-		int i = 0;
-		// fprintf(stderr, "glyph already there\n");
-		while (glyph_insert[i].glyphmode != GLYPH_END) i++;
-		// fprintf(stderr, "Insert a glyph after position %d\n", i);
-		glyph_insert[i].glyphmode = GLYPH_CONT;
-		(*glyph_index1)[j] = glyph_insert = realloc( glyph_insert, sizeof(texture_glyph_t)*(i+2) );
-		memcpy( glyph_insert+(i+1), glyph, sizeof(texture_glyph_t) );
-		return 1;
-	} else {
-		(*glyph_index1)[j] = glyph;
+	raster->width  = right - left + padding.left + padding.right;
+	raster->height = top - bottom + padding.top + padding.bottom;
+	raster->left   = left;
+	raster->top    = top;
+
+	region = texture_font_reserve( self, raster->width, raster->height );
+	if ( region.x < 0 ) {
 		return 0;
 	}
-}
+	if ( !texture_atlas_own_data( atlas ) ) {
+		texture_atlas_free_region( atlas, region );
+		return 0;
+	}
+	for ( i = 0; i < raster->height; ++i ) {
+		memset( atlas->data + ((region.y + i) * atlas->width + region.x) * atlas->depth,
+				0, raster->width * atlas->depth );
+	}
 
-// ------------------------------------------------ texture_font_load_glyph ---
-int
-texture_font_load_glyph( texture_font_t * self,
-						 const char * codepoint ) {
-	size_t i, x, y;
+	memset( &bitmap, 0, sizeof(bitmap) );
+	bitmap.rows       = top - bottom;
+	bitmap.width      = right - left;
+	bitmap.pitch      = atlas->width * atlas->depth;
+	bitmap.buffer     = atlas->data
+		+ ((region.y + padding.top) * atlas->width + region.x + padding.left) * atlas->depth;
+	bitmap.pixel_mode = FT_PIXEL_MODE_GRAY;
+	bitmap.num_grays  = 256;
+
+	if ( bitmap.rows && bitmap.width ) {
+		FT_Outline_Translate( outline, -left * 64, -bottom * 64 );
+		error = FT_Outline_Get_Bitmap( self->library->library, outline, &bitmap );
+		FT_Outline_Translate( outline, left * 64, bottom * 64 );
+		if ( error ) {
+			freetype_error( error, "FT_Error (%s:%d, code 0x%02x) : %s\n",
+				__FILENAME__, __LINE__, FT_Errors[error].code, FT_Errors[error].message);
+			texture_atlas_free_region( atlas, region );
+			return 0;
+		}
+	}
 
-	FT_Error error;
-	FT_Face face;
-	FT_Glyph ft_glyph;
-	FT_GlyphSlot slot;
-	FT_Bitmap ft_bitmap;
+	raster->buffer = NULL;
+	raster->region = region;
+	return 1;
+}
 
-	FT_UInt glyph_index;
-	texture_glyph_t *glyph;
-	FT_Int32 flags = 0;
-	int ft_glyph_top = 0;
-	int ft_glyph_left = 0;
-	FT_ULong ucodepoint;
+// -------------------------------------------- texture_font_distance_field ---
+/* Distance field context of the font, created on first use, splitting the
+ * field of a glyph into as many parts as the font has threads */
+static distance_field_t *
+texture_font_distance_field( texture_font_t * self ) {
+	if ( !self->distance_field ) {
+		self->distance_field = distance_field_new( );
+	}
+	if ( self->distance_field ) {
+		self->distance_field->mode = self->distance_mode;
+		self->distance_field->spread = self->distance_spread;
+		self->distance_field->threads = self->threads;
+		self->distance_field->executor = self->executor;
+		self->distance_field->executor_data = self->executor_data;
+	}
+	return self->distance_field;
+}
 
-	ivec4 region;
-	size_t missed = 0;
+// ------------------------------------------ texture_font_distance_padding ---
+/* Pixels of padding around a distance field glyph: its spread, or 1 pixel
+ * for fields scaled to their deepest inside distance */
+static int
+texture_font_distance_padding( const texture_font_t * self ) {
+	float spread = self->distance_spread;
 
-	/* Check if codepoint has been already loaded */
-	if (texture_font_find_glyph(self, codepoint)) {
-		return 1;
+	if ( spread <= 0 ) {
+		return self->rendermode == RENDER_MSDF ? MSDF_SPREAD : 1;
 	}
+	return (int) ceilf( spread );
+}
 
-	/* codepoint NULL is special : it is used for line drawing (overline,
-	 * underline, strikethrough) and background.
-	 */
-	if ( !codepoint ) {
-		return 1;
+// ------------------------------------------ texture_font_outline_distance ---
+/* Computes the distance field of a glyph from its outline, in a buffer of
+ * the size and padding of the bitmap it replaces: straight from the
+ * contours for DISTANCE_FIELD_OUTLINE and multi-channel fields, from the
+ * outline rendered distance_oversample times larger otherwise. Offsets
+ * include the padding for a font with a distance spread and for
+ * multi-channel fields. */
+static int
+texture_font_outline_distance( texture_font_t * self,
+							   glyph_raster_t * raster,
+							   FT_Outline * outline ) {
+	FT_GlyphSlot slot = self->face->glyph;
+	int msdf = self->rendermode == RENDER_MSDF;
+	int padded = msdf || self->distance_spread > 0;
+	int pad = texture_font_distance_padding( self );
+	unsigned int factor = 1;
+	unsigned char *buffer, *field;
+	FT_BBox cbox;
+	FT_Pos left, bottom, right, top;
+
+	if ( !msdf && self->distance_mode != DISTANCE_FIELD_OUTLINE &&
+		 self->distance_oversample > 1 ) {
+		factor = self->distance_oversample;
 	}
 
-	if (!texture_font_load_face(self, self->size)) {
+	// same pixel box as FreeType gives the bitmap of a glyph slot
+	FT_Outline_Get_CBox( outline, &cbox );
+	left   = cbox.xMin >> 6;
+	bottom = cbox.yMin >> 6;
+	right  = (cbox.xMax + 63) >> 6;
+	top    = (cbox.yMax + 63) >> 6;
+
+	raster->width  = right - left + 2 * pad;
+	raster->height = top - bottom + 2 * pad;
+	buffer = calloc( raster->width * raster->height * factor * factor * (msdf ? 3 : 1), 1 );
+	if ( !buffer ) {
+		freetype_gl_error( Out_Of_Memory,
+			   "%s:%d: No more memory for allocating data\n", __FILENAME__, __LINE__ );
 		return 0;
 	}
 
-	flags = 0;
-	ft_glyph_top = 0;
-	ft_glyph_left = 0;
-	ucodepoint = (FT_ULong)utf8_to_utf32( codepoint );
-	glyph_index = FT_Get_Char_Index( self->face, ucodepoint );
-	if (!glyph_index) {
-		texture_glyph_t * glyph;
-		if ((glyph = texture_font_find_glyph(self, "\0"))) {
-			texture_font_index_glyph( self, glyph, ucodepoint );
-			texture_font_close( self, MODE_AUTO_CLOSE, MODE_AUTO_CLOSE );
-			return 1;
+	if ( !texture_font_distance_field( self ) ) {
+		field = NULL;
+	} else if ( msdf ) {
+		field = distance_field_make_msdf( self->distance_field, outline, buffer,
+										  raster->width, raster->height,
+										  left - pad, top + pad,
+										  self->distance_spread > 0 ?
+										  2 * self->distance_spread : 2 * MSDF_SPREAD );
+	} else if ( self->distance_mode == DISTANCE_FIELD_OUTLINE ) {
+		field = distance_field_make_outline( self->distance_field, outline, buffer,
+											 raster->width, raster->height,
+											 left - pad, top + pad );
+	} else {
+		// The padded box, factor times larger, from the bottom left corner
+		// of the bitmap; the outline of the slot is not used afterwards
+		FT_Matrix scale = { (FT_Fixed) factor << 16, 0, 0, (FT_Fixed) factor << 16 };
+		FT_Bitmap bitmap = { 0 };
+
+		bitmap.width      = raster->width * factor;
+		bitmap.rows       = raster->height * factor;
+		bitmap.pitch      = bitmap.width;
+		bitmap.buffer     = buffer;
+		bitmap.num_grays  = 256;
+		bitmap.pixel_mode = FT_PIXEL_MODE_GRAY;
+		FT_Outline_Translate( outline, -(left - pad) * HRES, -(bottom - pad) * HRES );
+		FT_Outline_Transform( outline, &scale );
+		if ( FT_Outline_Get_Bitmap( self->library->library, outline, &bitmap ) ) {
+			field = NULL;
+		} else {
+			field = distance_field_make_downsampled( self->distance_field, buffer,
+													 bitmap.width, bitmap.rows, factor );
 		}
 	}
+	if ( !field ) {
+		free( buffer );
+		return 0;
+	}
+
+	raster->buffer    = buffer;
+	raster->left      = padded ? left - pad : left;
+	raster->top       = padded ? top + pad : top;
+	raster->advance_x = slot->advance.x;
+	raster->advance_y = slot->advance.y;
+	return 1;
+}
+
+// ------------------------------------------------- texture_font_rasterize ---
+/* Renders a glyph with the face of the given font, the atlas is not
+ * touched: this is the part of glyph loading that can run on any thread,
+ * as long as each thread has its own face. A direct raster is the
+ * exception: its outline, if any, is rendered straight into a region it
+ * reserves in a grayscale atlas, and its buffer is left NULL. */
+static int
+texture_font_rasterize( texture_font_t * self,
+						glyph_raster_t * raster ) {
+	size_t i;
+
+	FT_Error error;
+	FT_Glyph ft_glyph;
+	FT_GlyphSlot slot;
+	FT_Bitmap ft_bitmap = { 0 };
+	FT_Outline *outline = NULL;
+
+	FT_Int32 flags = 0;
+	int ft_glyph_top = 0;
+	int ft_glyph_left = 0;
+	int direct = raster->direct && self->atlas->depth == 1 &&
+		self->rendermode != RENDER_SIGNED_DISTANCE_FIELD;
+	int from_outline = self->rendermode == RENDER_SIGNED_DISTANCE_FIELD && self->atlas->depth == 1 &&
+		(self->distance_mode == DISTANCE_FIELD_OUTLINE || self->distance_spread > 0 ||
+		 self->distance_oversample > 1);
+
 	// WARNING: We use texture-atlas depth to guess if user wants
 	//          LCD subpixel rendering
 
 	if ( self->rendermode != RENDER_NORMAL && self->rendermode != RENDER_SIGNED_DISTANCE_FIELD ) {
 		flags |= FT_LOAD_NO_BITMAP;
-	} else {
+	} else if ( !direct && !from_outline ) {
 		flags |= FT_LOAD_RENDER;
 	}
 
@@ -675,7 +1113,7 @@ texture_font_load_glyph( texture_font_t * self,
 		flags |= FT_LOAD_FORCE_AUTOHINT;
 	}
 
-	if ( self->atlas->depth == 3 ) {
+	if ( self->atlas->depth == 3 && self->rendermode != RENDER_MSDF ) {
 		FT_Library_SetLcdFilter( self->library->library, FT_LCD_FILTER_LIGHT );
 		flags |= FT_LOAD_TARGET_LCD;
 
@@ -700,16 +1138,37 @@ texture_font_load_glyph( texture_font_t * self,
 		return 0;
 	}
 
-	error = FT_Load_Glyph( self->face, glyph_index, flags );
+	error = FT_Load_Glyph( self->face, raster->glyph_index, flags );
 	if ( error ) {
 		freetype_error( error, "FT_Error (%s:%d, code 0x%02x) : %s\n",
 			__FILENAME__, __LINE__, FT_Errors[error].code, FT_Errors[error].message);
-		texture_font_close( self, MODE_AUTO_CLOSE, MODE_AUTO_CLOSE );
 		return 0;
 	}
 
+	// Multi-channel fields need the outline, and room for their channels
+	if ( self->rendermode == RENDER_MSDF ) {
+		slot = self->face->glyph;
+		if ( slot->format != FT_GLYPH_FORMAT_OUTLINE || self->atlas->depth != 3 ) {
+			freetype_gl_error( Render_Mode_Unsupported,
+				   "%s:%d: RENDER_MSDF needs an outline glyph and an atlas of depth 3\n",
+				   __FILENAME__, __LINE__ );
+			return 0;
+		}
+		return texture_font_outline_distance( self, raster, &slot->outline );
+	}
+
 	if ( self->rendermode == RENDER_NORMAL || self->rendermode == RENDER_SIGNED_DISTANCE_FIELD ) {
 		slot            = self->face->glyph;
+		if ( from_outline && slot->format == FT_GLYPH_FORMAT_OUTLINE ) {
+			return texture_font_outline_distance( self, raster, &slot->outline );
+		}
+		if ( (direct || from_outline) &&
+			 !(direct && (outline = texture_font_direct_outline( slot->format, &slot->outline ))) &&
+			 (error = FT_Render_Glyph( slot, FT_RENDER_MODE_NORMAL )) ) {
+			freetype_error( error, "FT_Error (%s:%d, code 0x%02x) : %s\n",
+				__FILENAME__, __LINE__, FT_Errors[error].code, FT_Errors[error].message);
+			return 0;
+		}
 		ft_bitmap       = slot->bitmap;
 		ft_glyph_top    = slot->bitmap_top;
 		ft_glyph_left   = slot->bitmap_left;
@@ -754,6 +1213,12 @@ texture_font_load_glyph( texture_font_t * self,
 			goto cleanup_stroker;
 		}
 
+		if ( direct &&
+			 (outline = texture_font_direct_outline( ft_glyph->format,
+					&((FT_OutlineGlyph) ft_glyph)->outline )) ) {
+			goto cleanup_stroker;
+		}
+
 	switch( self->atlas->depth ) {
 		case 1:
 			error = FT_Glyph_To_Bitmap( &ft_glyph, FT_RENDER_MODE_NORMAL, 0, 1);
@@ -781,21 +1246,30 @@ cleanup_stroker:
 		FT_Stroker_Done( stroker );
 
 		if ( error ) {
-			texture_font_close( self, MODE_AUTO_CLOSE, MODE_AUTO_CLOSE );
 			return 0;
 		}
 	}
 
-	struct {
-		int left;
-		int top;
-		int right;
-		int bottom;
-	} padding = { 0, 0, 1, 1 };
+	glyph_padding_t padding = { 0, 0, 1, 1 };
 
 	if ( self->rendermode == RENDER_SIGNED_DISTANCE_FIELD ) {
-		padding.top = 1;
-		padding.left = 1;
+		padding.top = padding.left = padding.bottom = padding.right =
+			texture_font_distance_padding( self );
+	}
+
+	if ( outline ) {
+		int rendered = texture_font_render_outline( self, raster, outline, padding );
+
+		if ( self->rendermode != RENDER_NORMAL ) {
+			FT_Done_Glyph( ft_glyph );
+		}
+		if ( !rendered ) {
+			return 0;
+		}
+		slot = self->face->glyph;
+		raster->advance_x = slot->advance.x;
+		raster->advance_y = slot->advance.y;
+		return 1;
 	}
 
 	size_t src_w = self->atlas->depth == 3 ? ft_bitmap.width/3 : ft_bitmap.width;
@@ -804,20 +1278,6 @@ cleanup_stroker:
 	size_t tgt_w = src_w + padding.left + padding.right;
 	size_t tgt_h = src_h + padding.top + padding.bottom;
 
-	region = texture_atlas_get_region( self->atlas, tgt_w, tgt_h );
-
-	if ( region.x < 0 ) {
-		freetype_gl_error( Texture_Atlas_Full,
-			   "Texture atlas is full, asked for %i*%i (%s:%d)\n",
-			   tgt_w, tgt_h,
-			   __FILENAME__, __LINE__ );
-		texture_font_close( self, MODE_AUTO_CLOSE, MODE_AUTO_CLOSE );
-		return 0;
-	}
-
-	x = region.x;
-	y = region.y;
-
 	unsigned char *buffer = calloc( tgt_w * tgt_h * self->atlas->depth, sizeof(unsigned char) );
 
 	unsigned char *dst_ptr = buffer + (padding.top * tgt_w + padding.left) * self->atlas->depth;
@@ -829,25 +1289,237 @@ cleanup_stroker:
 		src_ptr += ft_bitmap.pitch;
 	}
 
-	if ( self->rendermode == RENDER_SIGNED_DISTANCE_FIELD ) {
-		unsigned char *sdf = make_distance_mapb( buffer, tgt_w, tgt_h );
-		free( buffer );
-		buffer = sdf;
+	if ( self->rendermode != RENDER_NORMAL && self->rendermode != RENDER_SIGNED_DISTANCE_FIELD ) {
+		FT_Done_Glyph( ft_glyph );
+	}
+
+	// The distance field replaces the glyph in its buffer
+	if ( self->rendermode == RENDER_SIGNED_DISTANCE_FIELD ) {
+		if ( !texture_font_distance_field( self ) ||
+			 !distance_field_make_mapb( self->distance_field, buffer, tgt_w, tgt_h ) ) {
+			free( buffer );
+			return 0;
+		}
+	}
+
+	slot = self->face->glyph;
+	raster->buffer    = buffer;
+	raster->width     = tgt_w;
+	raster->height    = tgt_h;
+	raster->left      = ft_glyph_left;
+	raster->top       = ft_glyph_top;
+	if ( self->rendermode == RENDER_SIGNED_DISTANCE_FIELD && self->distance_spread > 0 ) {
+		raster->left -= padding.left;
+		raster->top  += padding.top;
+	}
+	raster->advance_x = slot->advance.x;
+	raster->advance_y = slot->advance.y;
+
+	return 1;
+}
+
+// ----------------------------------------------- texture_font_evict_glyph ---
+/* Removes a glyph from the font and gives its region back to the atlas, a
+ * missing glyph also takes the codepoints standing in for it along. */
+static void
+texture_font_evict_glyph( texture_font_t * self,
+						  texture_glyph_t * glyph ) {
+	vector_t *aliases;
+	size_t i;
+
+	glyph_table_remove( self->glyphs, glyph->codepoint,
+						glyph->rendermode, glyph->outline_thickness );
+	if ( glyph->codepoint == 0 ) {
+		aliases = vector_new( sizeof(uint32_t) );
+		for ( i = 0; i < self->glyphs->capacity; ++i ) {
+			glyph_entry_t *entry = self->glyphs->entries + i;
+			if ( entry->codepoint != GLYPH_TABLE_EMPTY && entry->glyph == glyph ) {
+				vector_push_back( aliases, &entry->codepoint );
+			}
+		}
+		for ( i = 0; i < vector_size( aliases ); ++i ) {
+			glyph_table_remove( self->glyphs, *(uint32_t *) vector_get( aliases, i ),
+								glyph->rendermode, glyph->outline_thickness );
+		}
+		vector_delete( aliases );
+	}
+
+	texture_font_lru_unlink( self, glyph );
+	if ( glyph->region.width > 0 ) {
+		texture_atlas_free_region( self->atlas, glyph->region );
+	}
+	vector_push_back( self->evicted, &glyph );
+}
+
+// ---------------------------------------------- texture_font_drop_kerning ---
+/* Removes the kerning pairs of evicted codepoints left without any glyph, a
+ * precomputed pair is found again when its glyphs are loaded again. Cached
+ * KERNING_ON_DEMAND pairs of codepoints never loaded are only bounded by the
+ * cache size. */
+static void
+texture_font_drop_kerning( texture_font_t * self,
+						   vector_t * gone ) {
+	vector_t *kept;
+	texture_glyph_t *glyph;
+	uint32_t *codepoints, *found;
+	char *left_over;
+	size_t i, j, count;
+
+	if ( !vector_size( gone ) || !self->kerning_table->size ) {
+		return;
+	}
+	codepoints = (uint32_t *) gone->items;
+	qsort( codepoints, vector_size( gone ), sizeof(uint32_t), compare_codepoints );
+	for ( i = 1, count = 1; i < vector_size( gone ); ++i ) {
+		if ( codepoints[i] != codepoints[count - 1] ) {
+			codepoints[count++] = codepoints[i];
+		}
+	}
+	left_over = (char *) calloc( count, 1 );
+	if ( !left_over ) {
+		return;
+	}
+
+	// A codepoint with a glyph left in another rendermode keeps its pairs
+	kept = vector_new( sizeof(uint32_t) );
+	GLYPHS_ITERATOR(i, glyph, self->glyphs) {
+		found = bsearch( &glyph->codepoint, codepoints, count,
+						 sizeof(uint32_t), compare_codepoints );
+		if ( found ) {
+			left_over[found - codepoints] = 1;
+		} else {
+			vector_push_back( kept, &glyph->codepoint );
+		}
+	} GLYPHS_ITERATOR_END
+
+	for ( i = 0; i < count; ++i ) {
+		if ( left_over[i] ) {
+			continue;
+		}
+		for ( j = 0; j < vector_size( kept ); ++j ) {
+			uint32_t other = *(uint32_t *) vector_get( kept, j );
+			kerning_table_remove( self->kerning_table, codepoints[i], other );
+			kerning_table_remove( self->kerning_table, other, codepoints[i] );
+		}
+		for ( j = 0; j < count; ++j ) {
+			if ( !left_over[j] ) {
+				kerning_table_remove( self->kerning_table, codepoints[i], codepoints[j] );
+			}
+		}
+	}
+	vector_delete( kept );
+	free( left_over );
+}
+
+// ------------------------------------------------- texture_font_lru_adopt ---
+/* Links the glyphs loaded while eviction was off, which no use has moved
+ * into the list, at its least recently used end */
+static void
+texture_font_lru_adopt( texture_font_t * self ) {
+	vector_t *glyphs = vector_new( sizeof(texture_glyph_t *) );
+	texture_glyph_t *first = self->lru_first, *last = self->lru_last;
+	size_t i;
+
+	for ( i = 0; i < self->glyphs->capacity; ++i ) {
+		glyph_entry_t *entry = self->glyphs->entries + i;
+		texture_glyph_t *glyph = entry->glyph;
+
+		// Entries standing in for missing glyphs share theirs
+		if ( entry->codepoint != GLYPH_TABLE_EMPTY && glyph->codepoint == entry->codepoint &&
+			 glyph->font == self && !glyph->lru_prev && !glyph->lru_next &&
+			 glyph != first ) {
+			vector_push_back( glyphs, &glyph );
+		}
+	}
+	if ( vector_size( glyphs ) ) {
+		texture_font_lru_link( self, (texture_glyph_t **) glyphs->items,
+							   vector_size( glyphs ) );
+		if ( first ) {
+			self->lru_last->lru_next = first;
+			first->lru_prev = self->lru_last;
+			self->lru_last = last;
+		}
+	}
+	vector_delete( glyphs );
+}
+
+// ----------------------------------------------------- texture_font_evict ---
+/* Evicts the glyphs least recently used until a region of the given size can
+ * be allocated. */
+static ivec4
+texture_font_evict( texture_font_t * self,
+					size_t width,
+					size_t height ) {
+	ivec4 region = {{-1,-1,0,0}};
+	vector_t *gone = vector_new( sizeof(uint32_t) );
+	texture_glyph_t *glyph, *next;
+
+	texture_font_lru_adopt( self );
+	for ( glyph = self->lru_first; glyph; glyph = next ) {
+		next = glyph->lru_next;
+		// The placeholder stands in for glyphs in flight, and pinned glyphs
+		// for those handed out, they stay
+		if ( glyph == self->placeholder ||
+			 (self->pinned && glyph->last_use >= self->pinned) ) {
+			continue;
+		}
+		vector_push_back( gone, &glyph->codepoint );
+		texture_font_evict_glyph( self, glyph );
+		region = texture_atlas_get_region( self->atlas, width, height );
+		if ( region.x >= 0 ) {
+			break;
+		}
+	}
+	texture_font_drop_kerning( self, gone );
+	vector_delete( gone );
+
+	return region;
+}
+
+// ------------------------------------------- texture_font_release_evicted ---
+void
+texture_font_release_evicted( texture_font_t * self ) {
+	size_t i;
+
+	assert( self );
+
+	for ( i = 0; i < vector_size( self->evicted ); ++i ) {
+		texture_glyph_t *glyph = *(texture_glyph_t **) vector_get( self->evicted, i );
+
+		if ( !texture_font_is_mapped( self, glyph ) ) {
+			texture_glyph_delete( glyph );
+		}
+	}
+	vector_clear( self->evicted );
+}
+
+// ----------------------------------------------- texture_font_store_glyph ---
+/* Uploads a rasterized glyph to its atlas region and indexes it in the
+ * font */
+static void
+texture_font_store_glyph( texture_font_t * self,
+						  const glyph_raster_t * raster,
+						  const ivec4 region ) {
+	size_t x = region.x, y = region.y % self->atlas->height;
+	size_t tgt_w = raster->width, tgt_h = raster->height;
+	texture_glyph_t *glyph;
+
+	if ( raster->buffer ) {
+		texture_atlas_set_region( self->atlas, x, region.y, tgt_w, tgt_h, raster->buffer, tgt_w * self->atlas->depth);
 	}
 
-	texture_atlas_set_region( self->atlas, x, y, tgt_w, tgt_h, buffer, tgt_w * self->atlas->depth);
-
-	free( buffer );
-
 	glyph = texture_glyph_new( );
-	glyph->codepoint = glyph_index ? utf8_to_utf32( codepoint ) : 0;
+	glyph->codepoint = raster->glyph_index ? raster->codepoint : 0;
+	glyph->font = self;
 
 	glyph->width    = tgt_w * self->scale;
 	glyph->height   = tgt_h * self->scale;
-	glyph->rendermode = self->rendermode;
-	glyph->outline_thickness = self->outline_thickness;
-	glyph->offset_x = ft_glyph_left * self->scale;
-	glyph->offset_y = ft_glyph_top * self->scale;
+	glyph->rendermode = raster->rendermode;
+	glyph->outline_thickness = raster->outline_thickness;
+	glyph->region = region;
+	glyph->layer = region.y / self->atlas->height;
+	glyph->offset_x = raster->left * self->scale;
+	glyph->offset_y = raster->top * self->scale;
 	if (self->scaletex) {
 		glyph->s0       = x/(float)self->atlas->width;
 		glyph->t0       = y/(float)self->atlas->height;
@@ -863,63 +1535,484 @@ cleanup_stroker:
 		glyph->s1       = x + tgt_w - 0.5;
 		glyph->t1       = y + tgt_h - 0.5;
 	}
-	slot = self->face->glyph;
 	if ( self->atlas->depth == 4 ) {
 		// color fonts use actual pixels, not subpixels
-		glyph->advance_x = slot->advance.x * self->scale;
-		glyph->advance_y = slot->advance.y * self->scale;
+		glyph->advance_x = raster->advance_x * self->scale;
+		glyph->advance_y = raster->advance_y * self->scale;
 	} else {
-		glyph->advance_x = slot->advance.x * self->scale / HRESf;
-		glyph->advance_y = slot->advance.y * self->scale / HRESf;
+		glyph->advance_x = raster->advance_x * self->scale / HRESf;
+		glyph->advance_y = raster->advance_y * self->scale / HRESf;
+	}
+
+	/* A missing glyph belongs to codepoint 0 and stands in for the codepoint */
+	if ( texture_font_index_glyph( self, glyph, glyph->codepoint ) ) {
+		texture_glyph_delete( glyph );
+	} else if ( glyph->codepoint != raster->codepoint ) {
+		texture_font_index_glyph( self, glyph, raster->codepoint );
 	}
+}
+
+// --------------------------------------------------- texture_font_reserve ---
+/* Allocates an atlas region for a glyph, evicting glyphs if the font does */
+static ivec4
+texture_font_reserve( texture_font_t * self,
+					  size_t width,
+					  size_t height ) {
+	ivec4 region;
 
-	int free_glyph = texture_font_index_glyph(self, glyph, ucodepoint);
-	if (!glyph_index) {
-		if (!free_glyph) {
-			texture_glyph_t *new_glyph = malloc(sizeof(texture_glyph_t));
-			memcpy(new_glyph, glyph, sizeof(texture_glyph_t));
-			glyph=new_glyph;
+	region = texture_atlas_get_region( self->atlas, width, height );
+	if ( region.x < 0 && self->evict ) {
+		region = texture_font_evict( self, width, height );
+	}
+
+	if ( region.x < 0 ) {
+		freetype_gl_error( Texture_Atlas_Full,
+			   "Texture atlas is full, asked for %i*%i (%s:%d)\n",
+			   width, height,
+			   __FILENAME__, __LINE__ );
+	}
+	return region;
+}
+
+// ------------------------------------------------ texture_font_pack_glyph ---
+/* Stores a rasterized glyph in the atlas and indexes it in the font, a
+ * glyph rendered in the atlas already has its region */
+static int
+texture_font_pack_glyph( texture_font_t * self,
+						 const glyph_raster_t * raster ) {
+	ivec4 region;
+
+	if ( raster->buffer ) {
+		region = texture_font_reserve( self, raster->width, raster->height );
+		if ( region.x < 0 ) {
+			return 0;
 		}
-		free_glyph = texture_font_index_glyph(self, glyph, 0);
+	} else {
+		region = raster->region;
 	}
-	if (free_glyph) {
-		// fprintf(stderr, "Free glyph\n");
-		free(glyph);
+
+	texture_font_store_glyph( self, raster, region );
+	return 1;
+}
+
+// --------------------------------------------- texture_font_alias_missing ---
+/* Glyphs missing from the font share the glyph of codepoint 0, once it is
+ * loaded */
+static int
+texture_font_alias_missing( texture_font_t * self,
+							const glyph_raster_t * raster ) {
+	texture_glyph_t *glyph;
+
+	if ( raster->glyph_index ||
+		 !(glyph = glyph_table_get( self->glyphs, 0, raster->rendermode,
+									raster->outline_thickness )) ) {
+		return 0;
 	}
-	
-	if ( self->rendermode != RENDER_NORMAL && self->rendermode != RENDER_SIGNED_DISTANCE_FIELD ) {
-		FT_Done_Glyph( ft_glyph );
+	texture_font_index_glyph( self, glyph, raster->codepoint );
+	return 1;
+}
+
+// --------------------------------------- texture_font_load_glyph_internal ---
+static int
+texture_font_load_glyph_internal( texture_font_t * self,
+								  uint32_t ucodepoint,
+								  int kerning ) {
+	glyph_raster_t raster;
+	int loaded;
+
+	/* Check if codepoint has been already loaded */
+	if (texture_font_find_glyph_utf32(self, ucodepoint)) {
+		return 1;
+	}
+
+	/* codepoint NULL is special : it is used for line drawing (overline,
+	 * underline, strikethrough) and background.
+	 */
+	if ( ucodepoint == (uint32_t) -1 ) {
+		return 1;
 	}
 
-	texture_font_generate_kerning( self, &self->library->library, &self->face );
+	if (!texture_font_load_face(self, self->size)) {
+		return 0;
+	}
+
+	memset( &raster, 0, sizeof(raster) );
+	raster.direct = 1;
+	raster.codepoint = ucodepoint;
+	raster.rendermode = self->rendermode;
+	raster.outline_thickness = self->outline_thickness;
+	raster.glyph_index = FT_Get_Char_Index( self->face, ucodepoint );
+	if ( texture_font_alias_missing( self, &raster ) ) {
+		texture_font_close( self, MODE_AUTO_CLOSE, MODE_AUTO_CLOSE );
+		return 1;
+	}
+
+	loaded = texture_font_rasterize( self, &raster );
+	if ( loaded ) {
+		loaded = texture_font_pack_glyph( self, &raster );
+		free( raster.buffer );
+	}
+
+	if ( loaded && kerning ) {
+		texture_font_generate_kerning( self, &ucodepoint, 1 );
+	}
 
 	texture_font_close( self, MODE_AUTO_CLOSE, MODE_AUTO_CLOSE );
 
-	return 1;
+	return loaded;
+}
+
+// ------------------------------------------------ texture_font_load_glyph ---
+int
+texture_font_load_glyph( texture_font_t * self,
+						 const char * codepoint ) {
+	return texture_font_load_glyph_internal( self, utf8_to_utf32( codepoint ), 1 );
+}
+
+// ------------------------------------------ texture_font_load_glyph_utf32 ---
+int
+texture_font_load_glyph_utf32( texture_font_t * self,
+							   uint32_t codepoint ) {
+	return texture_font_load_glyph_internal( self, codepoint, 1 );
+}
+
+// ------------------------------------------------------- typedef & struct ---
+/* A codepoint of a batch and where it is found in the batch string */
+typedef struct {
+	uint32_t codepoint;
+	size_t offset;
+} batch_item_t;
+
+// ----------------------------------------------------- batch_item_compare ---
+static int
+batch_item_compare( const void *a, const void *b ) {
+	const batch_item_t *x = a, *y = b;
+
+	if ( x->codepoint != y->codepoint ) {
+		return x->codepoint < y->codepoint ? -1 : 1;
+	}
+	return x->offset < y->offset ? -1 : x->offset > y->offset;
+}
+
+// ---------------------------------------------- batch_item_compare_offset ---
+static int
+batch_item_compare_offset( const void *a, const void *b ) {
+	const batch_item_t *x = a, *y = b;
+
+	return x->offset < y->offset ? -1 : x->offset > y->offset;
+}
+
+// ------------------------------------------------- texture_font_copy_face ---
+/* FreeType faces and libraries cannot be shared between threads: a thread
+ * rasterizes with a private copy of the font settings, and opens its own
+ * library and face on the font source with texture_font_load_face. The
+ * copy computes distance fields on its thread only, the font already
+ * splitting the work. */
+static void
+texture_font_copy_face( texture_font_t * copy,
+						const texture_font_t * self,
+						texture_font_library_t * library ) {
+	*copy = *self;
+	library->mode = MODE_ALWAYS_OPEN;
+	library->library = NULL;
+	copy->library = library;
+	copy->face = NULL;
+	copy->ft_size = NULL;
+	copy->mode = MODE_ALWAYS_OPEN;
+	copy->distance_field = NULL;
+	copy->threads = 1;
+	copy->executor = NULL;
+}
+
+// ------------------------------------------------------- typedef & struct ---
+/* A batch of glyphs shared by the rasterizing threads */
+typedef struct {
+	texture_font_t * font;
+	glyph_raster_t ** jobs;
+	size_t count;
+	size_t next;
+#ifdef FREETYPE_GL_USE_THREADS
+	pthread_mutex_t lock;
+#endif
+} raster_batch_t;
+
+// -------------------------------------------- texture_font_rasterize_part ---
+/* Rasterizes glyphs index, index + count... of the batch, a task of the
+ * font executor. Glyphs are left unloaded if the face cannot be opened. */
+static void
+texture_font_rasterize_part( void * data,
+							 size_t index, size_t count ) {
+	raster_batch_t *batch = data;
+	texture_font_library_t library;
+	texture_font_t font;
+	size_t i;
+
+	texture_font_copy_face( &font, batch->font, &library );
+	if ( !texture_font_load_face( &font, font.size ) ) {
+		return;
+	}
+	for ( i = index; i < batch->count; i += count ) {
+		batch->jobs[i]->loaded = texture_font_rasterize( &font, batch->jobs[i] );
+	}
+
+	texture_font_close( &font, MODE_ALWAYS_OPEN, MODE_ALWAYS_OPEN );
+	if ( font.distance_field ) distance_field_delete( font.distance_field );
+}
+
+#ifdef FREETYPE_GL_USE_THREADS
+// ------------------------------------------ texture_font_rasterize_worker ---
+/* Rasterizes glyphs of the batch until there are none left */
+static void *
+texture_font_rasterize_worker( void * data ) {
+	raster_batch_t *batch = data;
+	texture_font_library_t library;
+	texture_font_t font;
+	glyph_raster_t *raster;
+	size_t i;
+
+	texture_font_copy_face( &font, batch->font, &library );
+	if ( !texture_font_load_face( &font, font.size ) ) {
+		return NULL;
+	}
+
+	for ( ;; ) {
+		pthread_mutex_lock( &batch->lock );
+		i = batch->next++;
+		pthread_mutex_unlock( &batch->lock );
+		if ( i >= batch->count ) {
+			break;
+		}
+		raster = batch->jobs[i];
+		raster->loaded = texture_font_rasterize( &font, raster );
+	}
+
+	texture_font_close( &font, MODE_ALWAYS_OPEN, MODE_ALWAYS_OPEN );
+	if ( font.distance_field ) distance_field_delete( font.distance_field );
+
+	return NULL;
+}
+#endif
+
+// ------------------------------------------- texture_font_rasterize_batch ---
+/* Rasterizes the glyphs of a batch, as self->threads tasks of the font
+ * executor, or on self->threads threads when threads are available */
+static void
+texture_font_rasterize_batch( texture_font_t * self,
+							  glyph_raster_t ** jobs,
+							  size_t count ) {
+	size_t i;
+
+	if ( self->threads > 1 && self->executor && count > 1 ) {
+		raster_batch_t batch;
+
+		batch.font = self;
+		batch.jobs = jobs;
+		batch.count = count;
+		batch.next = 0;
+		self->executor( self->executor_data, texture_font_rasterize_part, &batch,
+						count < (size_t) self->threads ? count : (size_t) self->threads );
+		return;
+	}
+
+#ifdef FREETYPE_GL_USE_THREADS
+	if ( self->threads > 1 ) {
+		pthread_t *threads = malloc( ((size_t) self->threads - 1) * sizeof(pthread_t) );
+		size_t started = 0;
+		raster_batch_t batch;
+
+		batch.font = self;
+		batch.jobs = jobs;
+		batch.count = count;
+		batch.next = 0;
+		pthread_mutex_init( &batch.lock, NULL );
+		while ( threads && started + 1 < (size_t) self->threads && started + 1 < count &&
+				!pthread_create( threads + started, NULL,
+								 texture_font_rasterize_worker, &batch ) ) {
+			started++;
+		}
+		texture_font_rasterize_worker( &batch );
+		for ( i = 0; i < started; ++i ) {
+			pthread_join( threads[i], NULL );
+		}
+		pthread_mutex_destroy( &batch.lock );
+		free( threads );
+		return;
+	}
+#endif
+
+	for ( i = 0; i < count; ++i ) {
+		jobs[i]->loaded = texture_font_rasterize( self, jobs[i] );
+	}
+}
+
+// ------------------------------------------------ texture_font_pack_batch ---
+/* Glyphs are stored in string order, in regions allocated one after the
+ * other up to the first glyph that does not fit, or when the font packs
+ * batches in regions allocated all at once, sorted by size. A glyph that
+ * got no region then goes through texture_font_pack_glyph (which may
+ * evict). One that could not be rasterized is loaded again so that the
+ * error is reported on this thread. Returns the number of glyphs missed,
+ * as texture_font_load_glyphs does. */
+static size_t
+texture_font_pack_batch( texture_font_t * self,
+						 const glyph_raster_t * rasters,
+						 const batch_item_t * items,
+						 size_t count,
+						 const char * codepoints,
+						 vector_t * loaded ) {
+	ivec4 *regions = malloc( count * sizeof(ivec4) );
+	size_t i, missed = 0;
+	int ok;
+
+	if ( regions == NULL && count ) {
+		freetype_gl_error( Out_Of_Memory,
+			   "%s:%d: No more memory for allocating data\n", __FILENAME__, __LINE__ );
+		return count;
+	}
+	for ( i = 0; i < count; ++i ) {
+		regions[i] = (ivec4){{-1, -1, rasters[i].width, rasters[i].height}};
+		if ( !rasters[i].loaded ) {
+			regions[i].width = regions[i].height = 0;
+		}
+	}
+	if ( self->pack_batches ) {
+		texture_atlas_get_regions( self->atlas, regions, count );
+	}
+
+	for ( i = 0; i < count; ++i ) {
+		const glyph_raster_t *raster = rasters + i;
+
+		if ( !raster->loaded ) {
+			ok = texture_font_alias_missing( self, raster ) ||
+				texture_font_load_glyph_internal( self, raster->codepoint, 0 );
+		} else if ( regions[i].x >= 0 ) {
+			texture_font_store_glyph( self, raster, regions[i] );
+			ok = 1;
+		} else {
+			ok = texture_font_pack_glyph( self, raster );
+		}
+		if ( ok ) {
+			vector_push_back( loaded, &raster->codepoint );
+		} else if ( self->pack_batches ) {
+			missed++;
+		} else {
+			missed = utf8_strlen( codepoints + items[i].offset );
+			break;
+		}
+	}
+	free( regions );
+
+	return missed;
+}
+
+// ---------------------------------------------- texture_font_batch_missed ---
+/* Glyphs missed by texture_font_load_glyphs when none of the count items
+ * of a batch could be loaded, counted the way texture_font_pack_batch does */
+static size_t
+texture_font_batch_missed( texture_font_t * self,
+						   const batch_item_t * items,
+						   size_t count,
+						   const char * codepoints ) {
+	return self->pack_batches ? count : utf8_strlen( codepoints + items[0].offset );
 }
 
 // ----------------------------------------------- texture_font_load_glyphs ---
+/* All the glyphs are rasterized first (on several threads if allowed), so
+ * that their regions can be packed together when the font does. */
 size_t
 texture_font_load_glyphs( texture_font_t * self,
 						  const char * codepoints ) {
-	size_t i;
+	size_t i, n, length = strlen( codepoints ), count = 0, jobs = 0, missed;
+	batch_item_t *items;
+	glyph_raster_t *rasters, **batch;
+	vector_t *loaded;
+	int render_missing;
+
+	/* Codepoints not loaded yet, each one once, in string order */
+	items = malloc( (length + 1) * sizeof(batch_item_t) );
+	if ( items == NULL ) {
+		freetype_gl_error( Out_Of_Memory,
+			   "%s:%d: No more memory for allocating data\n", __FILENAME__, __LINE__ );
+		return utf8_strlen( codepoints );
+	}
+	for ( i = 0; i < length; i += utf8_surrogate_len(codepoints + i) ) {
+		items[count].codepoint = utf8_to_utf32( codepoints + i );
+		items[count].offset = i;
+		if ( !texture_font_find_glyph_utf32( self, items[count].codepoint ) ) {
+			count++;
+		}
+	}
+	qsort( items, count, sizeof(batch_item_t), batch_item_compare );
+	for ( i = n = 0; i < count; ++i ) {
+		if ( !n || items[i].codepoint != items[n - 1].codepoint ) {
+			items[n++] = items[i];
+		}
+	}
+	count = n;
+	qsort( items, count, sizeof(batch_item_t), batch_item_compare_offset );
 
+	/* The face is only opened when there is something to render */
+	if ( !count ) {
+		free( items );
+		return 0;
+	}
+	if ( !texture_font_load_face( self, self->size ) ) {
+		missed = texture_font_batch_missed( self, items, count, codepoints );
+		free( items );
+		return missed;
+	}
 	self->mode++;
 
-	/* Load each glyph */
-	for ( i = 0; i < strlen(codepoints); i += utf8_surrogate_len(codepoints + i) ) {
-		if ( !texture_font_load_glyph( self, codepoints + i ) ) {
-			self->mode--;
-			texture_font_close( self, MODE_AUTO_CLOSE, MODE_AUTO_CLOSE );
-
-			return utf8_strlen( codepoints + i );
+	/* Glyphs missing from the font all share one rendering */
+	rasters = calloc( count, sizeof(glyph_raster_t) );
+	batch = malloc( count * sizeof(glyph_raster_t *) );
+	loaded = vector_new( sizeof(uint32_t) );
+	if ( rasters == NULL || batch == NULL || loaded == NULL ) {
+		freetype_gl_error( Out_Of_Memory,
+			   "%s:%d: No more memory for allocating data\n", __FILENAME__, __LINE__ );
+		missed = texture_font_batch_missed( self, items, count, codepoints );
+		if ( loaded ) {
+			vector_delete( loaded );
+		}
+		free( batch );
+		free( rasters );
+		free( items );
+		self->mode--;
+		texture_font_close( self, MODE_AUTO_CLOSE, MODE_AUTO_CLOSE );
+		return missed;
+	}
+	render_missing = !texture_font_find_glyph_utf32( self, 0 );
+	for ( i = 0; i < count; ++i ) {
+		rasters[i].codepoint = items[i].codepoint;
+		rasters[i].rendermode = self->rendermode;
+		rasters[i].outline_thickness = self->outline_thickness;
+		rasters[i].glyph_index = FT_Get_Char_Index( self->face, items[i].codepoint );
+		if ( rasters[i].glyph_index || render_missing ) {
+			render_missing &= rasters[i].glyph_index != 0;
+			batch[jobs++] = rasters + i;
 		}
 	}
 
+	texture_font_rasterize_batch( self, batch, jobs );
+
+	/* Kerning is generated once the batch is done */
+	missed = texture_font_pack_batch( self, rasters, items, count, codepoints,
+									  loaded );
+	texture_font_generate_kerning( self, (uint32_t *) loaded->items,
+								   vector_size( loaded ) );
+
+	for ( i = 0; i < count; ++i ) {
+		free( rasters[i].buffer );
+	}
+	vector_delete( loaded );
+	free( batch );
+	free( rasters );
+	free( items );
+
 	self->mode--;
 	texture_font_close( self, MODE_AUTO_CLOSE, MODE_AUTO_CLOSE );
 
-	return 0;
+	return missed;
 }
 
 
@@ -927,25 +2020,408 @@ texture_font_load_glyphs( texture_font_t * self,
 texture_glyph_t *
 texture_font_get_glyph( texture_font_t * self,
 						const char * codepoint ) {
+	return texture_font_get_glyph_utf32( self, utf8_to_utf32( codepoint ) );
+}
+
+// ------------------------------------------- texture_font_get_glyph_utf32 ---
+texture_glyph_t *
+texture_font_get_glyph_utf32( texture_font_t * self,
+							  uint32_t codepoint ) {
 	texture_glyph_t *glyph;
 
 	assert( self );
-	assert( self->filename );
 	assert( self->atlas );
 
 	/* Check if codepoint has been already loaded */
-	if ( (glyph = texture_font_find_glyph( self, codepoint )) ) {
+	if ( (glyph = texture_font_find_glyph_utf32( self, codepoint )) ) {
 		return glyph;
 	}
 
 	/* Glyph has not been already loaded */
-	if ( texture_font_load_glyph( self, codepoint ) ) {
-		return texture_font_find_glyph( self, codepoint );
+	if ( texture_font_load_glyph_utf32( self, codepoint ) ) {
+		return texture_font_find_glyph_utf32( self, codepoint );
 	}
 
 	return NULL;
 }
 
+// ------------------------------------------ texture_font_get_glyphs_utf32 ---
+size_t
+texture_font_get_glyphs_utf32( texture_font_t * self,
+							   const uint32_t * codepoints,
+							   size_t count,
+							   texture_glyph_t ** glyphs,
+							   float * kerning ) {
+	size_t i, missed = 0, pinned;
+	vector_t *loaded = NULL;
+
+	assert( self );
+	assert( codepoints || !count );
+	assert( glyphs || !count );
+
+	/* Missing glyphs are loaded on the way, their kerning is generated once
+	 * all of them are there. Glyphs used from now on are pinned, loading
+	 * one must not evict those already handed out. */
+	pinned = self->pinned;
+	self->pinned = self->use_count + 1;
+	for ( i = 0; i < count; ++i ) {
+		if (( glyphs[i] = texture_font_find_glyph_utf32( self, codepoints[i] ) )) {
+			continue;
+		}
+		if ( !loaded ) {
+			loaded = vector_new( sizeof(uint32_t) );
+			self->mode++;
+		}
+		if ( texture_font_load_glyph_internal( self, codepoints[i], 0 ) ) {
+			vector_push_back( loaded, codepoints + i );
+			glyphs[i] = texture_font_find_glyph_utf32( self, codepoints[i] );
+		}
+		if ( !glyphs[i] ) {
+			missed++;
+		}
+	}
+
+	if ( loaded ) {
+		texture_font_generate_kerning( self, (uint32_t *) loaded->items,
+									   vector_size( loaded ) );
+		vector_delete( loaded );
+		self->mode--;
+		texture_font_close( self, MODE_AUTO_CLOSE, MODE_AUTO_CLOSE );
+	}
+	self->pinned = pinned;
+
+	if ( kerning ) {
+		for ( i = 0; i < count; ++i ) {
+			kerning[i] = 0;
+			if ( i && glyphs[i] && self->kerning ) {
+				kerning[i] = texture_glyph_get_kerning_utf32( glyphs[i], codepoints[i-1] );
+			}
+		}
+	}
+
+	return missed;
+}
+
+// ------------------------------------------------------- typedef & struct ---
+/* Font settings a glyph is rasterized with, besides the variant its raster
+ * names: those of the font when the glyph was requested */
+typedef struct {
+	int hinting;
+	int filtering;
+	unsigned char lcd_weights[5];
+	distance_field_mode_t distance_mode;
+	float distance_spread;
+	int distance_oversample;
+} glyph_settings_t;
+
+/* An asynchronous glyph request */
+typedef struct {
+	glyph_raster_t raster;
+	glyph_settings_t settings;
+} glyph_request_t;
+
+/* Glyph requests waiting for texture_font_commit */
+typedef struct texture_font_async_t {
+	/* Requested variants not committed yet, mapped to their placeholder */
+	glyph_table_t * pending;
+	/* Requests not committed yet */
+	size_t waiting;
+	/* Requests in order, as glyph_request_t */
+	vector_t * queue;
+#ifdef FREETYPE_GL_USE_THREADS
+	/* Rasterized requests in order, as glyph_request_t */
+	vector_t * done;
+	/* Copy of the font the background thread rasterizes with */
+	texture_font_t font;
+	texture_font_library_t library;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	int started;
+	int stop;
+#endif
+} texture_font_async_t;
+
+// ---------------------------------------------- texture_font_get_settings ---
+static void
+texture_font_get_settings( const texture_font_t * self,
+						   glyph_settings_t * settings ) {
+	settings->hinting = self->hinting;
+	settings->filtering = self->filtering;
+	memcpy( settings->lcd_weights, self->lcd_weights, sizeof(settings->lcd_weights) );
+	settings->distance_mode = self->distance_mode;
+	settings->distance_spread = self->distance_spread;
+	settings->distance_oversample = self->distance_oversample;
+}
+
+// ---------------------------------------------- texture_font_set_settings ---
+static void
+texture_font_set_settings( texture_font_t * self,
+						   const glyph_settings_t * settings ) {
+	self->hinting = settings->hinting;
+	self->filtering = settings->filtering;
+	memcpy( self->lcd_weights, settings->lcd_weights, sizeof(self->lcd_weights) );
+	self->distance_mode = settings->distance_mode;
+	self->distance_spread = settings->distance_spread;
+	self->distance_oversample = settings->distance_oversample;
+}
+
+#ifdef FREETYPE_GL_USE_THREADS
+// ---------------------------------------------- texture_font_async_worker ---
+/* Rasterizes the requests of a font in the background, one at a time */
+static void *
+texture_font_async_worker( void * data ) {
+	texture_font_async_t *async = data;
+	texture_font_t *font = &async->font;
+	glyph_request_t request;
+	int open;
+
+	open = texture_font_load_face( font, font->size );
+
+	pthread_mutex_lock( &async->lock );
+	for ( ;; ) {
+		while ( !async->stop && !vector_size( async->queue ) ) {
+			pthread_cond_wait( &async->wake, &async->lock );
+		}
+		if ( async->stop ) {
+			break;
+		}
+		request = *(glyph_request_t *) vector_front( async->queue );
+		vector_erase( async->queue, 0 );
+		pthread_mutex_unlock( &async->lock );
+
+		/* Not loaded requests are loaded again by texture_font_commit */
+		if ( open ) {
+			font->rendermode = request.raster.rendermode;
+			font->outline_thickness = request.raster.outline_thickness;
+			texture_font_set_settings( font, &request.settings );
+			request.raster.glyph_index = FT_Get_Char_Index( font->face,
+															request.raster.codepoint );
+			request.raster.loaded = texture_font_rasterize( font, &request.raster );
+		}
+
+		pthread_mutex_lock( &async->lock );
+		vector_push_back( async->done, &request );
+	}
+	pthread_mutex_unlock( &async->lock );
+
+	if ( open ) {
+		texture_font_close( font, MODE_ALWAYS_OPEN, MODE_ALWAYS_OPEN );
+	}
+	if ( font->distance_field ) distance_field_delete( font->distance_field );
+
+	return NULL;
+}
+#endif
+
+// ---------------------------------------------- texture_font_async_delete ---
+static void
+texture_font_async_delete( texture_font_async_t * async ) {
+	size_t i;
+
+#ifdef FREETYPE_GL_USE_THREADS
+	if ( async->started ) {
+		pthread_mutex_lock( &async->lock );
+		async->stop = 1;
+		pthread_cond_signal( &async->wake );
+		pthread_mutex_unlock( &async->lock );
+		pthread_join( async->thread, NULL );
+	}
+	pthread_cond_destroy( &async->wake );
+	pthread_mutex_destroy( &async->lock );
+
+	for ( i = 0; i < vector_size( async->done ); ++i ) {
+		free( ((glyph_request_t *) vector_get( async->done, i ))->raster.buffer );
+	}
+	vector_delete( async->done );
+#endif
+	for ( i = 0; i < vector_size( async->queue ); ++i ) {
+		free( ((glyph_request_t *) vector_get( async->queue, i ))->raster.buffer );
+	}
+	vector_delete( async->queue );
+	glyph_table_delete( async->pending );
+	free( async );
+}
+
+// ------------------------------------------------- texture_font_async_new ---
+static texture_font_async_t *
+texture_font_async_new( texture_font_t * self ) {
+	texture_font_async_t *async = calloc( 1, sizeof(texture_font_async_t) );
+
+	if ( !async ) {
+		freetype_gl_error( Out_Of_Memory,
+			   "line %d: No more memory for allocating data\n", __LINE__ );
+		return NULL;
+	}
+	async->pending = glyph_table_new( );
+	async->queue = vector_new( sizeof(glyph_request_t) );
+#ifdef FREETYPE_GL_USE_THREADS
+	async->done = vector_new( sizeof(glyph_request_t) );
+	texture_font_copy_face( &async->font, self, &async->library );
+	pthread_mutex_init( &async->lock, NULL );
+	pthread_cond_init( &async->wake, NULL );
+
+	/* Without a thread, requests are all loaded by texture_font_commit */
+	async->started = !pthread_create( &async->thread, NULL,
+									  texture_font_async_worker, async );
+#else
+	(void) self;
+#endif
+	return async;
+}
+
+// ------------------------------------------- texture_font_get_glyph_async ---
+texture_glyph_t *
+texture_font_get_glyph_async( texture_font_t * self,
+							  const char * codepoint ) {
+	return texture_font_get_glyph_async_utf32( self,
+			codepoint ? utf8_to_utf32( codepoint ) : (uint32_t) -1 );
+}
+
+// ------------------------------------- texture_font_get_glyph_async_utf32 ---
+texture_glyph_t *
+texture_font_get_glyph_async_utf32( texture_font_t * self,
+									uint32_t codepoint ) {
+	texture_glyph_t *glyph, *placeholder;
+	glyph_request_t request;
+
+	assert( self );
+
+	if ( (glyph = texture_font_find_glyph_utf32( self, codepoint )) ) {
+		return glyph;
+	}
+	if ( codepoint == (uint32_t) -1 ) {
+		return texture_font_get_glyph_utf32( self, codepoint );
+	}
+
+	placeholder = self->placeholder ? self->placeholder
+		: texture_font_find_glyph_utf32( self, -1 );
+
+	if ( !self->async && !(self->async = texture_font_async_new( self )) ) {
+		return placeholder;
+	}
+	if ( glyph_table_get( self->async->pending, codepoint, self->rendermode,
+						  self->outline_thickness ) ) {
+		return placeholder;
+	}
+	glyph_table_set( self->async->pending, codepoint, self->rendermode,
+					 self->outline_thickness, placeholder );
+
+	// The glyph is rasterized with the settings of the font at this point
+	memset( &request, 0, sizeof(request) );
+	request.raster.codepoint = codepoint;
+	request.raster.rendermode = self->rendermode;
+	request.raster.outline_thickness = self->outline_thickness;
+	texture_font_get_settings( self, &request.settings );
+	self->async->waiting++;
+
+#ifdef FREETYPE_GL_USE_THREADS
+	pthread_mutex_lock( &self->async->lock );
+	vector_push_back( self->async->queue, &request );
+	pthread_cond_signal( &self->async->wake );
+	pthread_mutex_unlock( &self->async->lock );
+#else
+	vector_push_back( self->async->queue, &request );
+#endif
+
+	return placeholder;
+}
+
+// ---------------------------------------------------- texture_font_commit ---
+size_t
+texture_font_commit( texture_font_t * self,
+					 vector_t * published ) {
+	texture_font_async_t *async = self->async;
+	vector_t *ready, *loaded;
+	rendermode_t rendermode;
+	float outline_thickness;
+	glyph_settings_t settings;
+	size_t i, count = 0;
+
+	assert( self );
+
+	if ( !async || !async->waiting ) {
+		return 0;
+	}
+
+#ifdef FREETYPE_GL_USE_THREADS
+	if ( async->started ) {
+		pthread_mutex_lock( &async->lock );
+		ready = async->done;
+		async->done = vector_new( sizeof(glyph_request_t) );
+		pthread_mutex_unlock( &async->lock );
+	} else
+#endif
+	{
+		ready = async->queue;
+		async->queue = vector_new( sizeof(glyph_request_t) );
+	}
+
+	if ( !vector_size( ready ) ) {
+		vector_delete( ready );
+		return 0;
+	}
+
+	loaded = vector_new( sizeof(uint32_t) );
+	rendermode = self->rendermode;
+	outline_thickness = self->outline_thickness;
+	texture_font_get_settings( self, &settings );
+	self->mode++;
+
+	/* Publish in request order, glyphs that could not be rasterized in the
+	 * background are loaded here */
+	for ( i = 0; i < vector_size( ready ); ++i ) {
+		glyph_request_t *request = (glyph_request_t *) vector_get( ready, i );
+		glyph_raster_t *raster = &request->raster;
+		int ok;
+
+		if ( glyph_table_get( self->glyphs, raster->codepoint,
+							  raster->rendermode, raster->outline_thickness ) ) {
+			ok = 1;
+		} else if ( raster->loaded && texture_font_alias_missing( self, raster ) ) {
+			ok = 1;
+		} else if ( raster->loaded ) {
+			ok = texture_font_pack_glyph( self, raster );
+		} else {
+			self->rendermode = raster->rendermode;
+			self->outline_thickness = raster->outline_thickness;
+			texture_font_set_settings( self, &request->settings );
+			ok = texture_font_load_glyph_internal( self, raster->codepoint, 0 );
+		}
+		free( raster->buffer );
+
+		if ( ok ) {
+			vector_push_back( loaded, &raster->codepoint );
+			if ( published ) {
+				vector_push_back( published, &raster->codepoint );
+			}
+			count++;
+		}
+	}
+	async->waiting -= vector_size( ready );
+	vector_delete( ready );
+
+	self->rendermode = rendermode;
+	self->outline_thickness = outline_thickness;
+	texture_font_set_settings( self, &settings );
+
+	if ( vector_size( loaded ) && texture_font_load_face( self, self->size ) ) {
+		texture_font_generate_kerning( self, (uint32_t *) loaded->items,
+									   vector_size( loaded ) );
+	}
+	vector_delete( loaded );
+
+	self->mode--;
+	texture_font_close( self, MODE_AUTO_CLOSE, MODE_AUTO_CLOSE );
+
+	/* Nothing is in flight, failed requests may be asked for again */
+	if ( !async->waiting ) {
+		glyph_table_clear( async->pending );
+	}
+
+	return count;
+}
+
 // ------------------------------------------  texture_font_enlarge_texture ---
 void
 texture_font_enlarge_texture( texture_font_t * self, size_t width_new,
@@ -953,31 +2429,8 @@ texture_font_enlarge_texture( texture_font_t * self, size_t width_new,
 	assert(self);
 	assert(self->atlas);
 	//ensure size increased
-	assert(width_new >= self->atlas->width);
-	assert(height_new >= self->atlas->height);
 	assert(width_new + height_new > self->atlas->width + self->atlas->height);    
-	texture_atlas_t* ta = self->atlas;
-	size_t width_old = ta->width;
-	size_t height_old = ta->height;    
-	//allocate new buffer
-	unsigned char* data_old = ta->data;
-	ta->data = calloc(1,width_new*height_new * sizeof(char)*ta->depth);    
-	//update atlas size
-	ta->width = width_new;
-	ta->height = height_new;
-	//add node reflecting the gained space on the right
-	if (width_new>width_old){
-		ivec3 node;
-		node.x = width_old - 1;
-		node.y = 1;
-		node.z = width_new - width_old;
-		vector_push_back(ta->nodes, &node);    
-	}
-	//copy over data from the old buffer, skipping first row and column because of the margin
-	size_t pixel_size = sizeof(char) * ta->depth;
-	size_t old_row_size = width_old * pixel_size;
-	texture_atlas_set_region(ta, 1, 1, width_old - 2, height_old - 2, data_old + old_row_size + pixel_size, old_row_size);
-	free(data_old);    
+	texture_atlas_enlarge_texture( self->atlas, width_new, height_new );
 }
 // -------------------------------------------- texture_font_enlarge_atlas ---
 void
@@ -996,14 +2449,912 @@ texture_font_enlarge_glyphs( texture_font_t * self, float mulw, float mulh) {
 void
 texture_font_enlarge_atlas( texture_font_t * self, size_t width_new,
 				size_t height_new) {
-	texture_atlas_t* ta = self->atlas;
-	size_t width_old = ta->width;
-	size_t height_old = ta->height;    
+	assert(self);
+	assert(self->atlas);
+
+	/* Glyphs of every font sharing the atlas follow */
+	texture_atlas_enlarge( self->atlas, width_new, height_new );
+}
+
+// ------------------------------------------------------- typedef & struct ---
+#define SNAPSHOT_VERSION    2
+#define SNAPSHOT_BYTE_ORDER 0x01020304u
+#define SNAPSHOT_ALIGN      64
+
+/* Part of a snapshot file: where it starts and how many items it holds */
+typedef struct {
+	uint64_t offset;
+	uint64_t count;
+} snapshot_section_t;
+
+/* Header of a snapshot file, its sections follow. Everything is written in
+ * the native byte order and structure layouts: a snapshot is a cache for
+ * the machine (and build) it was written by, not an interchange format. */
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint32_t layout[4];
+
+	// the font file it was made from, and the font settings
+	uint64_t font_hash;
+	uint64_t font_length;
+	float size;
+	int32_t rendermode;
+	float outline_thickness;
+	int32_t hinting;
+	int32_t filtering;
+	int32_t kerning;
+	int32_t kerning_mode;
+	int32_t scaletex;
+	int32_t evict;
+	int32_t distance_mode;
+	float distance_spread;
+	int32_t distance_oversample;
+	uint8_t lcd_weights[8];
+	float height;
+	float linegap;
+	float ascender;
+	float descender;
+	float underline_position;
+	float underline_thickness;
+	float scale;
+	uint64_t use_count;
+	uint64_t glyph_count;
+	uint64_t pair_count;
+	uint64_t pair_max_size;
+
+	// the atlas
+	uint64_t atlas_width;
+	uint64_t atlas_height;
+	uint64_t atlas_depth;
+	uint64_t atlas_layers;
+	uint64_t atlas_layer;
+	uint64_t atlas_max_layers;
+	uint64_t atlas_used;
+	uint64_t atlas_max_width;
+	uint64_t atlas_max_height;
+	uint64_t atlas_max_dirty;
+	float atlas_growth;
+	int32_t atlas_packer;
+
+	snapshot_section_t data;      /* atlas pixels, all pages */
+	snapshot_section_t special;   /* the atlas special glyph */
+	snapshot_section_t glyphs;    /* texture_glyph_t, font set to NULL */
+	snapshot_section_t entries;   /* glyph table slots, glyph as an offset */
+	snapshot_section_t pairs;     /* kerning table slots */
+	snapshot_section_t nodes;     /* packer state, see texture_atlas_t */
+	snapshot_section_t freed;
+	snapshot_section_t rects;
+	snapshot_section_t shelves;
+} snapshot_header_t;
+
+static const char snapshot_magic[8] = { 'f','t','g','l','s','n','a','p' };
+
+// ------------------------------------------------- texture_font_hash_file ---
+/* FNV-1a hash of a whole file, 0 if it cannot be read */
+static int
+texture_font_hash_file( const char * filename,
+						uint64_t * hash,
+						uint64_t * length ) {
+	unsigned char buffer[65536];
+	size_t i, count;
+	FILE *file = fopen( filename, "rb" );
+
+	if ( !file ) {
+		return 0;
+	}
+	*hash = 0xCBF29CE484222325ull;
+	*length = 0;
+	while ( (count = fread( buffer, 1, sizeof(buffer), file )) > 0 ) {
+		for ( i = 0; i < count; ++i ) {
+			*hash = (*hash ^ buffer[i]) * 0x100000001B3ull;
+		}
+		*length += count;
+	}
+	fclose( file );
+	return 1;
+}
+
+// ------------------------------------------------- texture_font_is_mapped ---
+/* Whether a glyph lies in the snapshot the font was loaded from, and thus
+ * must not be freed */
+static int
+texture_font_is_mapped( const texture_font_t * self,
+						const texture_glyph_t * glyph ) {
+	const unsigned char *p = (const unsigned char *) glyph;
+
+	return self->mapping && p >= self->mapping->base &&
+		p < self->mapping->base + self->mapping->size;
+}
+
+// --------------------------------------------------- snapshot_add_section ---
+static uint64_t
+snapshot_add_section( snapshot_section_t * section,
+					  uint64_t offset,
+					  uint64_t count,
+					  size_t item_size ) {
+	section->offset = (offset + SNAPSHOT_ALIGN - 1) & ~(uint64_t) (SNAPSHOT_ALIGN - 1);
+	section->count = count;
+	return section->offset + count * item_size;
+}
+
+// ------------------------------------------------- snapshot_write_section ---
+static int
+snapshot_write_section( FILE * file,
+						const snapshot_section_t * section,
+						const void * items,
+						size_t item_size ) {
+	static const char zeros[SNAPSHOT_ALIGN];
+	long position = ftell( file );
+
+	if ( position < 0 ||
+		 fwrite( zeros, 1, section->offset - position, file ) != section->offset - position ) {
+		return 0;
+	}
+	return !section->count ||
+		fwrite( items, item_size, section->count, file ) == section->count;
+}
+
+// --------------------------------------------- texture_font_save_snapshot ---
+int
+texture_font_save_snapshot( texture_font_t * self,
+							const char * filename ) {
+	texture_atlas_t *atlas;
+	snapshot_header_t header;
+	texture_glyph_t *glyph, *records, special;
+	glyph_entry_t *entries;
+	vector_t *glyphs;
+	uint64_t end;
+	size_t i, j, count;
+	FILE *file;
+	int saved = 0;
+
+	assert( self && self->atlas );
+	atlas = self->atlas;
+
+	memset( &header, 0, sizeof(header) );
+	if ( self->location != TEXTURE_FONT_FILE ||
+		 !texture_font_hash_file( self->filename, &header.font_hash, &header.font_length ) ) {
+		freetype_gl_error( Cannot_Load_File,
+			   "%s:%d: A snapshot needs the font file to be readable\n",
+			   __FILENAME__, __LINE__ );
+		return 0;
+	}
+
+	memcpy( header.magic, snapshot_magic, sizeof(header.magic) );
+	header.version = SNAPSHOT_VERSION;
+	header.byte_order = SNAPSHOT_BYTE_ORDER;
+	header.layout[0] = sizeof(texture_glyph_t);
+	header.layout[1] = sizeof(glyph_entry_t);
+	header.layout[2] = sizeof(kerning_pair_t);
+	header.layout[3] = sizeof(void *);
+
+	header.size = self->size;
+	header.rendermode = self->rendermode;
+	header.outline_thickness = self->outline_thickness;
+	header.hinting = self->hinting;
+	header.filtering = self->filtering;
+	header.kerning = self->kerning;
+	header.kerning_mode = self->kerning_mode;
+	header.scaletex = self->scaletex;
+	header.evict = self->evict;
+	header.distance_mode = self->distance_mode;
+	header.distance_spread = self->distance_spread;
+	header.distance_oversample = self->distance_oversample;
+	memcpy( header.lcd_weights, self->lcd_weights, sizeof(self->lcd_weights) );
+	header.height = self->height;
+	header.linegap = self->linegap;
+	header.ascender = self->ascender;
+	header.descender = self->descender;
+	header.underline_position = self->underline_position;
+	header.underline_thickness = self->underline_thickness;
+	header.scale = self->scale;
+	header.use_count = self->use_count;
+	header.glyph_count = self->glyphs->size;
+	header.pair_count = self->kerning_table->size;
+	header.pair_max_size = self->kerning_table->max_size;
+
+	header.atlas_width = atlas->width;
+	header.atlas_height = atlas->height;
+	header.atlas_depth = atlas->depth;
+	header.atlas_layers = atlas->layers;
+	header.atlas_layer = atlas->layer;
+	header.atlas_max_layers = atlas->max_layers;
+	header.atlas_used = atlas->used;
+	header.atlas_max_width = atlas->max_width;
+	header.atlas_max_height = atlas->max_height;
+	header.atlas_max_dirty = atlas->max_dirty;
+	header.atlas_growth = atlas->growth;
+	header.atlas_packer = atlas->packer;
+
+	// Glyphs are written in slot order, each once
+	glyphs = vector_new( sizeof(texture_glyph_t *) );
+	GLYPHS_ITERATOR(i, glyph, self->glyphs) {
+		vector_push_back( glyphs, &glyph );
+	} GLYPHS_ITERATOR_END
+	count = vector_size( glyphs );
+
+	end = sizeof(header);
+	end = snapshot_add_section( &header.data, end,
+		(uint64_t) atlas->width * atlas->height * atlas->depth * atlas->layers, 1 );
+	end = snapshot_add_section( &header.special, end, 1, sizeof(texture_glyph_t) );
+	end = snapshot_add_section( &header.glyphs, end, count, sizeof(texture_glyph_t) );
+	end = snapshot_add_section( &header.entries, end, self->glyphs->capacity,
+								sizeof(glyph_entry_t) );
+	end = snapshot_add_section( &header.pairs, end, self->kerning_table->capacity,
+								sizeof(kerning_pair_t) );
+	end = snapshot_add_section( &header.nodes, end, vector_size( atlas->nodes ), sizeof(ivec3) );
+	end = snapshot_add_section( &header.freed, end, vector_size( atlas->freed ), sizeof(ivec4) );
+	end = snapshot_add_section( &header.rects, end, vector_size( atlas->rects ), sizeof(ivec4) );
+	end = snapshot_add_section( &header.shelves, end, vector_size( atlas->shelves ), sizeof(ivec3) );
+
+	records = (texture_glyph_t *) malloc( (count + 1) * sizeof(texture_glyph_t) );
+	entries = (glyph_entry_t *) malloc( (self->glyphs->capacity + 1) * sizeof(glyph_entry_t) );
+	if ( !records || !entries ) {
+		freetype_gl_error( Out_Of_Memory,
+			   "%s:%d: No more memory for allocating data\n", __FILENAME__, __LINE__ );
+		goto cleanup;
+	}
+
+	special = *(texture_glyph_t *) atlas->special;
+	special.font = NULL;
+	for ( i = 0; i < count; ++i ) {
+		records[i] = **(texture_glyph_t **) vector_get( glyphs, i );
+		records[i].font = NULL;
+		records[i].lru_prev = records[i].lru_next = NULL;
+	}
+
+	// Pointers are stored as offsets in the file, relocated when loaded
+	memcpy( entries, self->glyphs->entries, self->glyphs->capacity * sizeof(glyph_entry_t) );
+	for ( i = 0, j = 0; i < self->glyphs->capacity; ++i ) {
+		glyph_entry_t *entry = entries + i;
+		size_t k = j;
+
+		if ( entry->codepoint == GLYPH_TABLE_EMPTY ) {
+			entry->glyph = NULL;
+			continue;
+		}
+		if ( entry->glyph->codepoint == entry->codepoint ) {
+			j++;
+		} else {
+			// A glyph standing in for a missing one
+			for ( k = 0; k < count; ++k ) {
+				if ( *(texture_glyph_t **) vector_get( glyphs, k ) == entry->glyph ) {
+					break;
+				}
+			}
+			assert( k < count );
+		}
+		entry->glyph = (texture_glyph_t *) (uintptr_t)
+			(header.glyphs.offset + k * sizeof(texture_glyph_t));
+	}
+
+	file = fopen( filename, "wb" );
+	if ( !file ) {
+		freetype_gl_error( Cannot_Load_File,
+			   "%s:%d: Cannot write %s\n", __FILENAME__, __LINE__, filename );
+		goto cleanup;
+	}
+	saved = fwrite( &header, sizeof(header), 1, file ) == 1 &&
+		snapshot_write_section( file, &header.data, atlas->data, 1 ) &&
+		snapshot_write_section( file, &header.special, &special, sizeof(texture_glyph_t) ) &&
+		snapshot_write_section( file, &header.glyphs, records, sizeof(texture_glyph_t) ) &&
+		snapshot_write_section( file, &header.entries, entries, sizeof(glyph_entry_t) ) &&
+		snapshot_write_section( file, &header.pairs, self->kerning_table->pairs,
+								sizeof(kerning_pair_t) ) &&
+		snapshot_write_section( file, &header.nodes, atlas->nodes->items, sizeof(ivec3) ) &&
+		snapshot_write_section( file, &header.freed, atlas->freed->items, sizeof(ivec4) ) &&
+		snapshot_write_section( file, &header.rects, atlas->rects->items, sizeof(ivec4) ) &&
+		snapshot_write_section( file, &header.shelves, atlas->shelves->items, sizeof(ivec3) );
+	saved = !fclose( file ) && saved;
+	if ( !saved ) {
+		freetype_gl_error( Cannot_Load_File,
+			   "%s:%d: Cannot write %s\n", __FILENAME__, __LINE__, filename );
+		remove( filename );
+	}
+
+cleanup:
+	free( records );
+	free( entries );
+	vector_delete( glyphs );
+	return saved;
+}
+
+// --------------------------------------------------- snapshot_table_valid ---
+/* Whether a hash table of a snapshot can be probed: its capacity is zero or
+ * a power of two, and it keeps at least one empty slot */
+static int
+snapshot_table_valid( uint64_t size,
+					  uint64_t capacity ) {
+	return capacity ? size < capacity && !(capacity & (capacity - 1)) : !size;
+}
+
+// ------------------------------------------------- snapshot_entries_valid ---
+/* Whether every glyph table slot of a snapshot points to one of its
+ * glyphs, and as many slots are used as the snapshot says */
+static int
+snapshot_entries_valid( const snapshot_header_t * header,
+						const unsigned char * base ) {
+	const glyph_entry_t *entries = (const glyph_entry_t *) (base + header->entries.offset);
+	uint64_t offset, used = 0;
+	size_t i;
+
+	for ( i = 0; i < header->entries.count; ++i ) {
+		if ( entries[i].codepoint == GLYPH_TABLE_EMPTY ) {
+			continue;
+		}
+		offset = (uintptr_t) entries[i].glyph - header->glyphs.offset;
+		if ( (uintptr_t) entries[i].glyph < header->glyphs.offset ||
+			 offset % sizeof(texture_glyph_t) ||
+			 offset / sizeof(texture_glyph_t) >= header->glyphs.count ) {
+			return 0;
+		}
+		used++;
+	}
+	return used == header->glyph_count;
+}
+
+// --------------------------------------------------- snapshot_pairs_valid ---
+/* Whether as many kerning table slots of a snapshot are used as the
+ * snapshot says */
+static int
+snapshot_pairs_valid( const snapshot_header_t * header,
+					  const unsigned char * base ) {
+	const kerning_pair_t *pairs = (const kerning_pair_t *) (base + header->pairs.offset);
+	uint64_t used = 0;
+	size_t i;
+
+	for ( i = 0; i < header->pairs.count; ++i ) {
+		used += pairs[i].left != KERNING_TABLE_EMPTY;
+	}
+	return used == header->pair_count;
+}
+
+// ----------------------------------------------- snapshot_section_in_file ---
+static int
+snapshot_section_in_file( const snapshot_section_t * section,
+						  size_t item_size,
+						  size_t size ) {
+	return section->offset <= size &&
+		section->count <= (size - section->offset) / item_size;
+}
+
+// ------------------------------------------------ snapshot_restore_vector ---
+static void
+snapshot_restore_vector( vector_t * self,
+						 const unsigned char * base,
+						 const snapshot_section_t * section ) {
+	vector_clear( self );
+	if ( section->count ) {
+		vector_push_back_data( self, base + section->offset, section->count );
+	}
+}
+
+// --------------------------------------------- texture_font_load_snapshot ---
+texture_font_t *
+texture_font_load_snapshot( const char * snapshot,
+							const char * filename,
+							float pt_size,
+							rendermode_t rendermode ) {
+	texture_mapping_t *mapping;
+	const snapshot_header_t *header;
+	texture_atlas_t *atlas;
+	texture_font_t *self;
+	glyph_entry_t *entries;
+	texture_glyph_t *glyphs, *glyph;
+	vector_t *order;
+	uint64_t hash, length;
+	size_t i;
+
+	assert( snapshot && filename );
+
+	mapping = texture_mapping_new( snapshot );
+	if ( !mapping ) {
+		freetype_gl_error( Cannot_Load_File,
+			   "%s:%d: Cannot map %s\n", __FILENAME__, __LINE__, snapshot );
+		return NULL;
+	}
+	header = (const snapshot_header_t *) mapping->base;
+
+	// Snapshots of another version, build or font, or made with other
+	// settings, are stale
+	if ( mapping->size < sizeof(*header) ||
+		 memcmp( header->magic, snapshot_magic, sizeof(header->magic) ) ||
+		 header->version != SNAPSHOT_VERSION ||
+		 header->byte_order != SNAPSHOT_BYTE_ORDER ||
+		 header->layout[0] != sizeof(texture_glyph_t) ||
+		 header->layout[1] != sizeof(glyph_entry_t) ||
+		 header->layout[2] != sizeof(kerning_pair_t) ||
+		 header->layout[3] != sizeof(void *) ||
+		 header->size != pt_size ||
+		 header->rendermode != (int32_t) rendermode ||
+		 header->distance_mode < DISTANCE_FIELD_EDTAA3 ||
+		 header->distance_mode > DISTANCE_FIELD_OUTLINE ||
+		 !(header->distance_spread >= 0) || header->distance_oversample < 1 ||
+		 !texture_font_hash_file( filename, &hash, &length ) ||
+		 header->font_hash != hash || header->font_length != length ||
+		 !header->atlas_layers ||
+		 header->data.count != header->atlas_width * header->atlas_height *
+			 header->atlas_depth * header->atlas_layers ||
+		 header->special.count != 1 ||
+		 !snapshot_table_valid( header->glyph_count, header->entries.count ) ||
+		 !snapshot_table_valid( header->pair_count, header->pairs.count ) ||
+		 !snapshot_section_in_file( &header->data, 1, mapping->size ) ||
+		 !snapshot_section_in_file( &header->special, sizeof(texture_glyph_t), mapping->size ) ||
+		 !snapshot_section_in_file( &header->glyphs, sizeof(texture_glyph_t), mapping->size ) ||
+		 !snapshot_section_in_file( &header->entries, sizeof(glyph_entry_t), mapping->size ) ||
+		 !snapshot_section_in_file( &header->pairs, sizeof(kerning_pair_t), mapping->size ) ||
+		 !snapshot_section_in_file( &header->nodes, sizeof(ivec3), mapping->size ) ||
+		 !snapshot_section_in_file( &header->freed, sizeof(ivec4), mapping->size ) ||
+		 !snapshot_section_in_file( &header->rects, sizeof(ivec4), mapping->size ) ||
+		 !snapshot_section_in_file( &header->shelves, sizeof(ivec3), mapping->size ) ||
+		 !snapshot_entries_valid( header, mapping->base ) ||
+		 !snapshot_pairs_valid( header, mapping->base ) ) {
+		freetype_gl_error( Snapshot_Mismatch,
+			   "%s:%d: %s is not a snapshot of %s at this size and rendermode\n",
+			   __FILENAME__, __LINE__, snapshot, filename );
+		texture_mapping_release( mapping );
+		return NULL;
+	}
+
+	atlas = texture_atlas_new( header->atlas_width, header->atlas_height,
+							   header->atlas_depth );
+	self = (texture_font_t *) calloc( 1, sizeof(*self) );
+	if ( !atlas || !self ) {
+		freetype_gl_error( Out_Of_Memory,
+			   "%s:%d: No more memory for allocating data\n", __FILENAME__, __LINE__ );
+		if ( atlas ) texture_atlas_delete( atlas );
+		free( self );
+		texture_mapping_release( mapping );
+		return NULL;
+	}
+
+	texture_font_init_defaults( self );
+
+	// The atlas pixels are used in place
+	free( atlas->data );
+	atlas->data = mapping->base + header->data.offset;
+	atlas->mapping = mapping;
+	atlas->layers = header->atlas_layers;
+	atlas->layer = header->atlas_layer;
+	atlas->max_layers = header->atlas_max_layers;
+	atlas->used = header->atlas_used;
+	atlas->max_width = header->atlas_max_width;
+	atlas->max_height = header->atlas_max_height;
+	atlas->max_dirty = header->atlas_max_dirty;
+	atlas->growth = header->atlas_growth;
+	atlas->packer = (packer_t) header->atlas_packer;
+	snapshot_restore_vector( atlas->nodes, mapping->base, &header->nodes );
+	snapshot_restore_vector( atlas->freed, mapping->base, &header->freed );
+	snapshot_restore_vector( atlas->rects, mapping->base, &header->rects );
+	snapshot_restore_vector( atlas->shelves, mapping->base, &header->shelves );
+	*(texture_glyph_t *) atlas->special =
+		*(const texture_glyph_t *) (mapping->base + header->special.offset);
+	vector_clear( atlas->dirty );
+	texture_atlas_add_dirty( atlas, (ivec4){{0, 0, atlas->width,
+											 atlas->height * atlas->layers}} );
+
+	self->atlas = atlas;
+	self->size = pt_size;
+	self->location = TEXTURE_FONT_FILE;
+	self->filename = strdup( filename );
+	self->mode = mode_default;
+	self->rendermode = rendermode;
+	self->outline_thickness = header->outline_thickness;
+	self->hinting = header->hinting;
+	self->filtering = header->filtering;
+	self->kerning = header->kerning;
+	self->kerning_mode = (kerning_mode_t) header->kerning_mode;
+	self->scaletex = header->scaletex;
+	self->evict = header->evict;
+	self->distance_mode = (distance_field_mode_t) header->distance_mode;
+	self->distance_spread = header->distance_spread;
+	self->distance_oversample = header->distance_oversample;
+	memcpy( self->lcd_weights, header->lcd_weights, sizeof(self->lcd_weights) );
+	self->height = header->height;
+	self->linegap = header->linegap;
+	self->ascender = header->ascender;
+	self->descender = header->descender;
+	self->underline_position = header->underline_position;
+	self->underline_thickness = header->underline_thickness;
+	self->scale = header->scale;
+	self->use_count = header->use_count;
+	self->mapping = mapping;
+	mapping->refs++;
+
+	// The glyphs and their table are used in place as well, only the
+	// pointers need relocating
+	glyphs = (texture_glyph_t *) (mapping->base + header->glyphs.offset);
+	order = vector_new( sizeof(texture_glyph_t *) );
+	for ( i = 0; i < header->glyphs.count; ++i ) {
+		glyph = glyphs + i;
+		glyph->font = self;
+		vector_push_back( order, &glyph );
+	}
+	texture_font_lru_link( self, (texture_glyph_t **) order->items,
+						   vector_size( order ) );
+	vector_delete( order );
+	entries = (glyph_entry_t *) (mapping->base + header->entries.offset);
+	for ( i = 0; i < header->entries.count; ++i ) {
+		if ( entries[i].codepoint != GLYPH_TABLE_EMPTY ) {
+			entries[i].glyph = (texture_glyph_t *)
+				(mapping->base + (uintptr_t) entries[i].glyph);
+		}
+	}
+	self->glyphs->entries = header->entries.count ? entries : NULL;
+	self->glyphs->capacity = header->entries.count;
+	self->glyphs->size = header->glyph_count;
+	self->glyphs->borrowed = 1;
+
+	self->kerning_table->pairs = header->pairs.count ?
+		(kerning_pair_t *) (mapping->base + header->pairs.offset) : NULL;
+	self->kerning_table->capacity = header->pairs.count;
+	self->kerning_table->size = header->pair_count;
+	self->kerning_table->max_size = header->pair_max_size;
+	self->kerning_table->borrowed = 1;
+
+	texture_atlas_add_font( atlas, self );
+	return self;
+}
+
+// ------------------------------------------------------- typedef & struct ---
+#define BLOB_VERSION 2
+
+/* Part of a blob: where it starts and how many items it holds */
+typedef struct {
+	uint32_t offset;
+	uint32_t count;
+} blob_section_t;
+
+/* A glyph in a blob: no pointers nor size_t, so that the layout does not
+ * depend on the build */
+typedef struct {
+	uint32_t codepoint;
+	int32_t rendermode;
+	float outline_thickness;
+	uint32_t width;
+	uint32_t height;
+	int32_t offset_x;
+	int32_t offset_y;
+	float advance_x;
+	float advance_y;
+	float s0;
+	float t0;
+	float s1;
+	float t1;
+	uint32_t layer;
+	int32_t region[4];
+} blob_glyph_t;
+
+/* A codepoint a blob glyph stands in for (e.g. the missing glyph) */
+typedef struct {
+	uint32_t codepoint;
+	uint32_t glyph;
+} blob_alias_t;
+
+/* Header of a blob, its sections follow. All fields are 4 bytes wide, and
+ * so is the alignment the blob needs. */
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+
+	float size;
+	int32_t rendermode;
+	float outline_thickness;
+	int32_t scaletex;
+	int32_t kerning;
+	float height;
+	float linegap;
+	float ascender;
+	float descender;
+	float underline_position;
+	float underline_thickness;
+	float scale;
+
+	uint32_t atlas_width;
+	uint32_t atlas_height;
+	uint32_t atlas_depth;
+	uint32_t atlas_layers;
+
+	blob_section_t data;      /* atlas pixels, all pages */
+	blob_section_t special;   /* the atlas special glyph */
+	blob_section_t glyphs;    /* blob_glyph_t */
+	blob_section_t aliases;   /* blob_alias_t */
+	blob_section_t pairs;     /* kerning_pair_t, without empty slots */
+} blob_header_t;
+
+static const char blob_magic[8] = { 'f','t','g','l','b','l','o','b' };
+
+// ------------------------------------------------------ blob_add_section ---
+static uint32_t
+blob_add_section( blob_section_t * section,
+				  uint32_t offset,
+				  uint32_t count,
+				  size_t item_size ) {
+	section->offset = (offset + 3) & ~3u;
+	section->count = count;
+	return section->offset + count * item_size;
+}
+
+// --------------------------------------------------------- blob_put_glyph ---
+static void
+blob_put_glyph( blob_glyph_t * record,
+				const texture_glyph_t * glyph ) {
+	record->codepoint = glyph->codepoint;
+	record->rendermode = glyph->rendermode;
+	record->outline_thickness = glyph->outline_thickness;
+	record->width = glyph->width;
+	record->height = glyph->height;
+	record->offset_x = glyph->offset_x;
+	record->offset_y = glyph->offset_y;
+	record->advance_x = glyph->advance_x;
+	record->advance_y = glyph->advance_y;
+	record->s0 = glyph->s0;
+	record->t0 = glyph->t0;
+	record->s1 = glyph->s1;
+	record->t1 = glyph->t1;
+	record->layer = glyph->layer;
+	memcpy( record->region, glyph->region.data, sizeof(record->region) );
+}
+
+// --------------------------------------------------------- blob_get_glyph ---
+static void
+blob_get_glyph( texture_glyph_t * glyph,
+				const blob_glyph_t * record ) {
+	glyph->codepoint = record->codepoint;
+	glyph->rendermode = (rendermode_t) record->rendermode;
+	glyph->outline_thickness = record->outline_thickness;
+	glyph->width = record->width;
+	glyph->height = record->height;
+	glyph->offset_x = record->offset_x;
+	glyph->offset_y = record->offset_y;
+	glyph->advance_x = record->advance_x;
+	glyph->advance_y = record->advance_y;
+	glyph->s0 = record->s0;
+	glyph->t0 = record->t0;
+	glyph->s1 = record->s1;
+	glyph->t1 = record->t1;
+	glyph->layer = record->layer;
+	memcpy( glyph->region.data, record->region, sizeof(record->region) );
+}
+
+// -------------------------------------------------- texture_font_make_blob ---
+void *
+texture_font_make_blob( texture_font_t * self,
+						size_t * size ) {
+	texture_atlas_t *atlas;
+	blob_header_t header;
+	texture_glyph_t *glyph;
+	vector_t *glyphs, *aliases;
+	unsigned char *blob;
+	uint32_t end;
+	size_t i, j;
+
+	assert( self && self->atlas && size );
+	atlas = self->atlas;
+
+	glyphs = vector_new( sizeof(texture_glyph_t *) );
+	aliases = vector_new( sizeof(blob_alias_t) );
+	GLYPHS_ITERATOR(i, glyph, self->glyphs) {
+		vector_push_back( glyphs, &glyph );
+	} GLYPHS_ITERATOR_END
+	for ( i = 0; i < self->glyphs->capacity; ++i ) {
+		const glyph_entry_t *entry = self->glyphs->entries + i;
+		blob_alias_t alias;
+
+		if ( entry->codepoint == GLYPH_TABLE_EMPTY ||
+			 entry->glyph->codepoint == entry->codepoint ) {
+			continue;
+		}
+		for ( j = 0; *(texture_glyph_t **) vector_get( glyphs, j ) != entry->glyph; ++j ) {
+		}
+		alias.codepoint = entry->codepoint;
+		alias.glyph = j;
+		vector_push_back( aliases, &alias );
+	}
+
+	memset( &header, 0, sizeof(header) );
+	memcpy( header.magic, blob_magic, sizeof(header.magic) );
+	header.version = BLOB_VERSION;
+	header.byte_order = SNAPSHOT_BYTE_ORDER;
+	header.size = self->size;
+	header.rendermode = self->rendermode;
+	header.outline_thickness = self->outline_thickness;
+	header.scaletex = self->scaletex;
+	header.kerning = self->kerning;
+	header.height = self->height;
+	header.linegap = self->linegap;
+	header.ascender = self->ascender;
+	header.descender = self->descender;
+	header.underline_position = self->underline_position;
+	header.underline_thickness = self->underline_thickness;
+	header.scale = self->scale;
+	header.atlas_width = atlas->width;
+	header.atlas_height = atlas->height;
+	header.atlas_depth = atlas->depth;
+	header.atlas_layers = atlas->layers;
+
+	end = sizeof(header);
+	end = blob_add_section( &header.data, end,
+							atlas->width * atlas->height * atlas->depth * atlas->layers, 1 );
+	end = blob_add_section( &header.special, end, 1, sizeof(blob_glyph_t) );
+	end = blob_add_section( &header.glyphs, end, vector_size( glyphs ), sizeof(blob_glyph_t) );
+	end = blob_add_section( &header.aliases, end, vector_size( aliases ), sizeof(blob_alias_t) );
+	end = blob_add_section( &header.pairs, end, self->kerning_table->size,
+							sizeof(kerning_pair_t) );
+	end = (end + 3) & ~3u;
+
+	blob = (unsigned char *) calloc( end, 1 );
+	if ( !blob ) {
+		freetype_gl_error( Out_Of_Memory,
+			   "%s:%d: No more memory for allocating data\n", __FILENAME__, __LINE__ );
+		vector_delete( glyphs );
+		vector_delete( aliases );
+		return NULL;
+	}
+	memcpy( blob, &header, sizeof(header) );
+	memcpy( blob + header.data.offset, atlas->data, header.data.count );
+	blob_put_glyph( (blob_glyph_t *) (blob + header.special.offset), atlas->special );
+	for ( i = 0; i < vector_size( glyphs ); ++i ) {
+		blob_put_glyph( (blob_glyph_t *) (blob + header.glyphs.offset) + i,
+						*(texture_glyph_t **) vector_get( glyphs, i ) );
+	}
+	if ( vector_size( aliases ) ) {
+		memcpy( blob + header.aliases.offset, aliases->items,
+				vector_size( aliases ) * sizeof(blob_alias_t) );
+	}
+	for ( i = 0, j = 0; i < self->kerning_table->capacity; ++i ) {
+		const kerning_pair_t *pair = self->kerning_table->pairs + i;
+
+		if ( pair->left != KERNING_TABLE_EMPTY ) {
+			((kerning_pair_t *) (blob + header.pairs.offset))[j++] = *pair;
+		}
+	}
 
-	texture_font_enlarge_texture( self, width_new, height_new);
-	if ( self->scaletex ) {
-		float mulw = (float)width_old / width_new;
-		float mulh = (float)height_old / height_new;
-		texture_font_enlarge_glyphs( self, mulw, mulh );
+	vector_delete( glyphs );
+	vector_delete( aliases );
+	*size = end;
+	return blob;
+}
+
+// ---------------------------------------------- texture_font_new_from_blob ---
+texture_font_t *
+texture_font_new_from_blob( const void * blob,
+							size_t size ) {
+	const blob_header_t *header = (const blob_header_t *) blob;
+	const unsigned char *base = (const unsigned char *) blob;
+	const blob_glyph_t *records;
+	const blob_alias_t *aliases;
+	const kerning_pair_t *pairs;
+	texture_mapping_t *mapping;
+	texture_atlas_t *atlas;
+	texture_font_t *self;
+	texture_glyph_t **glyphs;
+	size_t i;
+
+	assert( blob );
+
+	if ( (uintptr_t) blob % 4 || size < sizeof(*header) ||
+		 memcmp( header->magic, blob_magic, sizeof(header->magic) ) ||
+		 header->version != BLOB_VERSION ||
+		 header->byte_order != SNAPSHOT_BYTE_ORDER ||
+		 !header->atlas_layers ||
+		 header->data.count != header->atlas_width * header->atlas_height *
+			 header->atlas_depth * header->atlas_layers ||
+		 header->special.count != 1 ||
+		 header->data.offset > size ||
+		 header->data.count > size - header->data.offset ||
+		 header->special.offset > size ||
+		 header->special.count > (size - header->special.offset) / sizeof(blob_glyph_t) ||
+		 header->glyphs.offset > size ||
+		 header->glyphs.count > (size - header->glyphs.offset) / sizeof(blob_glyph_t) ||
+		 header->aliases.offset > size ||
+		 header->aliases.count > (size - header->aliases.offset) / sizeof(blob_alias_t) ||
+		 header->pairs.offset > size ||
+		 header->pairs.count > (size - header->pairs.offset) / sizeof(kerning_pair_t) ) {
+		freetype_gl_error( Snapshot_Mismatch,
+			   "%s:%d: Not a font blob of this version, or misaligned\n",
+			   __FILENAME__, __LINE__ );
+		return NULL;
 	}
+	records = (const blob_glyph_t *) (base + header->glyphs.offset);
+	aliases = (const blob_alias_t *) (base + header->aliases.offset);
+	for ( i = 0; i < header->aliases.count; ++i ) {
+		if ( aliases[i].glyph >= header->glyphs.count ) {
+			freetype_gl_error( Snapshot_Mismatch,
+				   "%s:%d: Invalid font blob\n", __FILENAME__, __LINE__ );
+			return NULL;
+		}
+	}
+	pairs = (const kerning_pair_t *) (base + header->pairs.offset);
+	for ( i = 0; i < header->pairs.count; ++i ) {
+		if ( pairs[i].left == KERNING_TABLE_EMPTY ) {
+			freetype_gl_error( Snapshot_Mismatch,
+				   "%s:%d: Invalid font blob\n", __FILENAME__, __LINE__ );
+			return NULL;
+		}
+	}
+
+	mapping = texture_mapping_wrap( blob, size );
+	atlas = texture_atlas_new( header->atlas_width, header->atlas_height,
+							   header->atlas_depth );
+	self = (texture_font_t *) calloc( 1, sizeof(*self) );
+	// Glyphs have pointers, they are the only part not used in place
+	glyphs = (texture_glyph_t **) calloc( header->glyphs.count + 1, sizeof(texture_glyph_t *) );
+	if ( !mapping || !atlas || !self || !glyphs ) {
+		freetype_gl_error( Out_Of_Memory,
+			   "%s:%d: No more memory for allocating data\n", __FILENAME__, __LINE__ );
+		if ( mapping ) texture_mapping_release( mapping );
+		if ( atlas ) texture_atlas_delete( atlas );
+		free( self );
+		free( glyphs );
+		return NULL;
+	}
+
+	texture_font_init_defaults( self );
+
+	free( atlas->data );
+	atlas->data = mapping->base + header->data.offset;
+	atlas->mapping = mapping;
+	atlas->layers = header->atlas_layers;
+	atlas->max_layers = header->atlas_layers;
+	blob_get_glyph( atlas->special, (const blob_glyph_t *) (base + header->special.offset) );
+	vector_clear( atlas->dirty );
+	texture_atlas_add_dirty( atlas, (ivec4){{0, 0, atlas->width,
+											 atlas->height * atlas->layers}} );
+
+	// There is no face, the font cannot render glyphs
+	self->atlas = atlas;
+	self->size = header->size;
+	self->location = TEXTURE_FONT_NONE;
+	self->mode = mode_default;
+	self->rendermode = (rendermode_t) header->rendermode;
+	self->outline_thickness = header->outline_thickness;
+	self->scaletex = header->scaletex;
+	self->kerning = header->kerning;
+	self->height = header->height;
+	self->linegap = header->linegap;
+	self->ascender = header->ascender;
+	self->descender = header->descender;
+	self->underline_position = header->underline_position;
+	self->underline_thickness = header->underline_thickness;
+	self->scale = header->scale;
+
+	for ( i = 0; i < header->glyphs.count; ++i ) {
+		texture_glyph_t *glyph = texture_glyph_new( );
+
+		if ( !glyph ) {
+			free( glyphs );
+			texture_font_delete( self );
+			texture_atlas_delete( atlas );
+			return NULL;
+		}
+		blob_get_glyph( glyph, records + i );
+		glyph->font = self;
+		glyph_table_set( self->glyphs, glyph->codepoint, glyph->rendermode,
+						 glyph->outline_thickness, glyph );
+		glyphs[i] = glyph;
+	}
+	for ( i = 0; i < header->aliases.count; ++i ) {
+		texture_glyph_t *glyph = glyphs[aliases[i].glyph];
+
+		glyph_table_set( self->glyphs, aliases[i].codepoint, glyph->rendermode,
+						 glyph->outline_thickness, glyph );
+	}
+	texture_font_lru_link( self, glyphs, header->glyphs.count );
+	free( glyphs );
+
+	for ( i = 0; i < header->pairs.count; ++i ) {
+		if ( kerning_table_set( self->kerning_table, pairs[i].left, pairs[i].right,
+								pairs[i].kerning ) ) {
+			texture_font_delete( self );
+			texture_atlas_delete( atlas );
+			return NULL;
+		}
+	}
+
+	texture_atlas_add_font( atlas, self );
+	return self;
 }
@@ -14,7 +14,10 @@ extern "C" {
 #endif
 
 #include "vector.h"
+#include "kerning-table.h"
+#include "glyph-table.h"
 #include "texture-atlas.h"
+#include "distance-field.h"
 
 #ifndef __THREAD
 #if defined(__GNUC__) || defined(__clang__)
@@ -61,11 +64,23 @@ typedef enum rendermode_t
 	RENDER_OUTLINE_EDGE,
 	RENDER_OUTLINE_POSITIVE,
 	RENDER_OUTLINE_NEGATIVE,
-	RENDER_SIGNED_DISTANCE_FIELD
+	RENDER_SIGNED_DISTANCE_FIELD,
+
+	/**
+	 * Multi-channel signed distance field computed from the glyph outline
+	 * (see distance_field_make_msdf), for an atlas of depth 3 and
+	 * shaders/msdf.frag. The glyphs are padded with the pixels of distance
+	 * each side of their edges the field encodes, the distance_spread of
+	 * the font or 2 by default, and their offsets include the padding.
+	 */
+	RENDER_MSDF
 } rendermode_t;
 
 /**
  * Glyph array end mark type
+ *
+ * @deprecated  Glyphs are stored in a hash table and chained no more, the
+ *              mark is kept for code that sets or reads it.
  */
 typedef enum glyphmode_t
 {
@@ -174,9 +189,16 @@ typedef struct texture_glyph_t
 	float t1;
 
 	/**
-	 * A vector of kerning pairs relative to this glyph.
+	 * Layer of the atlas texture array holding the glyph, that is the page
+	 * of the atlas it is in (always 0 for an atlas of a single page)
+	 */
+	size_t layer;
+
+	/**
+	 * Font this glyph belongs to, where its kerning pairs are stored.
+	 * NULL for glyphs that have no kerning (e.g. the atlas special glyph).
 	 */
-	vector_t * kerning;
+	struct texture_font_t * font;
 
 	/**
 	 * Mode this glyph was rendered
@@ -188,8 +210,33 @@ typedef struct texture_glyph_t
 	 */
 	float outline_thickness;
 
+	/**
+	 * Atlas region holding the glyph, in pixels. Its y counts the rows of
+	 * the atlas pages before its own.
+	 */
+	ivec4 region;
+
+	/**
+	 * Value of the font use counter when the glyph was last looked up.
+	 */
+	size_t last_use;
+
+	/**
+	 * Previous glyph in the font list of glyphs by last use, NULL for the
+	 * glyph least recently used.
+	 */
+	struct texture_glyph_t * lru_prev;
+
+	/**
+	 * Next glyph in the font list of glyphs by last use, NULL for the glyph
+	 * most recently used.
+	 */
+	struct texture_glyph_t * lru_next;
+
 	/**
 	 * Glyph scan end mark
+	 *
+	 * @deprecated  Always GLYPH_END, nothing reads it anymore
 	 */
 	glyphmode_t glyphmode;
 
@@ -200,7 +247,8 @@ typedef struct texture_glyph_t
  */
 typedef enum font_location_t {
 	TEXTURE_FONT_FILE = 0,
-	TEXTURE_FONT_MEMORY
+	TEXTURE_FONT_MEMORY,
+	TEXTURE_FONT_NONE      /* no face, only the glyphs it holds */
 } font_location_t;
 
 /**
@@ -214,6 +262,16 @@ typedef enum font_mode_t {
 	MODE_ALWAYS_OPEN
 } font_mode_t;
 
+/**
+ * Enum type for kerning lookups
+ */
+typedef enum kerning_mode_t {
+	/** Pairs of loaded glyphs are computed when the glyphs are loaded */
+	KERNING_PRECOMPUTED = 0,
+	/** Pairs are queried on first use and kept in a bounded cache */
+	KERNING_ON_DEMAND
+} kerning_mode_t;
+
 /**
  * default mode for fonts
  */
@@ -256,10 +314,11 @@ typedef struct texture_font_library_t
 typedef struct texture_font_t
 {
 	/**
-	 * Vector of glyphs contained in this font.
-	 * This is actually a two-stage table, indexing into 256 glyphs each
+	 * Glyphs contained in this font, keyed by codepoint, rendermode and
+	 * outline thickness. Glyphs are never moved: pointers stay valid for the
+	 * lifetime of the font.
 	 */
-	vector_t * glyphs;
+	glyph_table_t * glyphs;
 
 	/**
 	 * Atlas structure to store glyphs data.
@@ -327,6 +386,24 @@ typedef struct texture_font_t
 	 */
 	int kerning;
 
+	/**
+	 * How kerning pairs are looked up
+	 */
+	kerning_mode_t kerning_mode;
+
+	/**
+	 * Whether the face could not be opened for a KERNING_ON_DEMAND lookup,
+	 * the pairs not cached then having no kerning until the kerning mode
+	 * is set again
+	 */
+	int kerning_failed;
+
+	/**
+	 * Kerning pairs of the loaded glyphs, keyed by (left, right) codepoints.
+	 * With KERNING_ON_DEMAND, this is the cache of the pairs used so far.
+	 */
+	kerning_table_t * kerning_table;
+
 
 	/**
 	 * This field is simply used to compute a default line spacing (i.e., the
@@ -401,6 +478,131 @@ typedef struct texture_font_t
 	 * factor to scale font coordinates
 	 */
 	float scale;
+
+	/**
+	 * Number of threads rasterizing the glyphs of texture_font_load_glyphs,
+	 * each with its own FreeType face. Packing stays on the calling thread,
+	 * so the atlas layout does not depend on it. The distance field of a
+	 * glyph loaded on its own is split into as many parts (see
+	 * distance_field_t). Needs a build with FREETYPE_GL_USE_THREADS or an
+	 * executor, 1 otherwise.
+	 */
+	int threads;
+
+	/**
+	 * Whether texture_font_load_glyphs packs the regions of a batch
+	 * together, highest first, which packs tighter and loads every glyph
+	 * that fits. Otherwise (the default) glyphs are packed one after the
+	 * other in string order, up to the first one that does not fit.
+	 */
+	int pack_batches;
+
+	/**
+	 * Runs the threads above as tasks of a job system instead, NULL for
+	 * threads of the font: texture_font_load_glyphs then rasterizes its
+	 * glyphs as up to threads tasks, which need not be run concurrently.
+	 * Despite its type, it schedules more than distance fields: a task of a
+	 * batch rasterizes whole glyphs (outline, bitmap and distance field),
+	 * while a glyph loaded on its own hands it to its distance field
+	 * context, which splits only the field.
+	 */
+	distance_field_executor_t executor;
+
+	/**
+	 * User data of the executor
+	 */
+	void * executor_data;
+
+	/**
+	 * Glyph returned by texture_font_get_glyph_async while the requested
+	 * glyph is being rasterized. NULL means the atlas special glyph. A
+	 * glyph of the font is never evicted while it is the placeholder.
+	 */
+	texture_glyph_t * placeholder;
+
+	/**
+	 * Asynchronous glyph requests, NULL until the first one.
+	 */
+	struct texture_font_async_t * async;
+
+	/**
+	 * Whether the glyphs least recently looked up are evicted when the atlas
+	 * is full, their regions being reused for new glyphs along with the
+	 * kerning pairs of their codepoints. Otherwise a full atlas makes glyph
+	 * loading fail. Lookups only record their use while it is set (they
+	 * write to the font then), glyphs loaded before count as the least
+	 * recently used.
+	 */
+	int evict;
+
+	/**
+	 * Number of glyph lookups, used to stamp glyph last use.
+	 */
+	size_t use_count;
+
+	/**
+	 * Glyph of the font least recently looked up, the first one evicted.
+	 */
+	texture_glyph_t * lru_first;
+
+	/**
+	 * Glyph of the font most recently looked up.
+	 */
+	texture_glyph_t * lru_last;
+
+	/**
+	 * Use count from which glyphs are not evicted, 0 for none: glyphs
+	 * looked up or loaded by a texture_font_get_glyphs_utf32 call in
+	 * progress, which hands out pointers to them.
+	 */
+	size_t pinned;
+
+	/**
+	 * Glyphs evicted from the atlas since the last call to
+	 * texture_font_release_evicted. They are not found in the font anymore
+	 * but stay allocated, so that text still pointing to them can be found
+	 * and laid out again.
+	 */
+	vector_t * evicted;
+
+	/**
+	 * Snapshot the font was loaded from (see texture_font_load_snapshot),
+	 * its glyphs and kerning pairs lie in it. NULL for other fonts.
+	 */
+	texture_mapping_t * mapping;
+
+	/**
+	 * Scratch buffers of RENDER_SIGNED_DISTANCE_FIELD rendering, created
+	 * with the first glyph rendered in that mode and kept for the next.
+	 */
+	distance_field_t * distance_field;
+
+	/**
+	 * Distance transform of RENDER_SIGNED_DISTANCE_FIELD glyphs,
+	 * DISTANCE_FIELD_EDTAA3 by default (see distance_field_mode_t).
+	 */
+	distance_field_mode_t distance_mode;
+
+	/**
+	 * Distance in pixels each side of the edges that the distance field
+	 * of a glyph encodes, the edge being at 127.5 (see
+	 * distance_field_t::spread): all glyphs then share a scale, and one
+	 * shader threshold works for them all. The glyphs are padded with as
+	 * many pixels, which their offsets include. 0 (the default) scales
+	 * each glyph to its deepest inside distance instead, with 1 pixel of
+	 * padding left out of the offsets.
+	 */
+	float distance_spread;
+
+	/**
+	 * Number of times larger than the glyph the outline of a
+	 * RENDER_SIGNED_DISTANCE_FIELD glyph is rendered before its distance
+	 * field is computed then downsampled (see
+	 * distance_field_make_downsampled), for smooth edges out of small atlas
+	 * cells. 1 (the default) for none; DISTANCE_FIELD_OUTLINE fields,
+	 * exact already, ignore it.
+	 */
+	int distance_oversample;
 } texture_font_t;
 
 /**
@@ -459,7 +661,9 @@ typedef struct texture_font_t
 								size_t memory_size );
 
 /**
- * Clone the freetype-gl font and set a different size
+ * Clone the freetype-gl font and set a different size. The clone keeps the
+ * settings of the font, but opens a face of its own and starts without
+ * glyphs, so that either can be deleted first.
  *
  * @param self         a valid texture font
  * @param size         the new size of the font
@@ -514,6 +718,107 @@ typedef struct texture_font_t
   texture_font_get_glyph( texture_font_t * self,
 						  const char * codepoint );
 
+/**
+ * Same as texture_font_get_glyph, for an UTF-32 codepoint.
+ *
+ * @param self      A valid texture font
+ * @param codepoint Character codepoint, -1 for the special glyph used for
+ *                  line drawing.
+ *
+ * @return A pointer on the glyph or 0 if the texture atlas is not big
+ *         enough
+ */
+  texture_glyph_t *
+  texture_font_get_glyph_utf32( texture_font_t * self,
+								uint32_t codepoint );
+
+/**
+ * Request the glyphs of a whole string of codepoints, along with the kerning
+ * to apply before each of them. Missing glyphs are loaded, their kerning
+ * pairs are looked up once the whole string is loaded. When the font evicts
+ * glyphs, those of the string are pinned during the call, so that loading
+ * the later ones never evicts the earlier ones: a string that does not fit
+ * in the atlas misses glyphs instead.
+ *
+ * @param self       A valid texture font
+ * @param codepoints Character codepoints
+ * @param count      Number of codepoints
+ * @param glyphs     Array of count glyph pointers to fill, with NULL for the
+ *                   glyphs that could not be loaded
+ * @param kerning    Array of count kerning values to fill (the first one is
+ *                   0, as are all values if the font kerning is disabled),
+ *                   may be NULL
+ *
+ * @return Number of glyphs that could not be loaded.
+ */
+  size_t
+  texture_font_get_glyphs_utf32( texture_font_t * self,
+								 const uint32_t * codepoints,
+								 size_t count,
+								 texture_glyph_t ** glyphs,
+								 float * kerning );
+
+/**
+ * Request a glyph without waiting for it to be rasterized. A glyph that is
+ * not loaded yet is queued for rasterization on a background thread (when
+ * built with FREETYPE_GL_USE_THREADS), and the font placeholder is returned
+ * in the meantime. The glyph is added to the font by the next call to
+ * texture_font_commit after it is ready. It is rasterized with the settings
+ * of the font at the time of the request (render mode, hinting, filtering,
+ * distance fields), whatever they are when it is committed.
+ *
+ * @param self      A valid texture font
+ * @param codepoint Character codepoint to be loaded in UTF-8 encoding.
+ *
+ * @return The glyph if it is loaded, the font placeholder (the special glyph
+ *         if there is none) otherwise
+ */
+  texture_glyph_t *
+  texture_font_get_glyph_async( texture_font_t * self,
+								const char * codepoint );
+
+/**
+ * Same as texture_font_get_glyph_async, for an UTF-32 codepoint.
+ *
+ * @param self      A valid texture font
+ * @param codepoint Character codepoint
+ *
+ * @return The glyph if it is loaded, the font placeholder otherwise
+ */
+  texture_glyph_t *
+  texture_font_get_glyph_async_utf32( texture_font_t * self,
+									  uint32_t codepoint );
+
+/**
+ * Add the glyphs rasterized since the last call to the font: they are packed
+ * in the atlas, in request order, and their kerning is looked up. This is the
+ * only place asynchronous requests touch the atlas and the glyphs of the
+ * font, call it from the thread using the font, e.g. once per frame before
+ * uploading the atlas. Requests that could not be rasterized in the
+ * background are loaded here.
+ *
+ * Text laid out with a placeholder for one of the published codepoints
+ * needs a new layout.
+ *
+ * @param self      A valid texture font
+ * @param published Vector of uint32_t the published codepoints are appended
+ *                  to, may be NULL
+ *
+ * @return Number of glyphs published
+ */
+  size_t
+  texture_font_commit( texture_font_t * self,
+					   vector_t * published );
+
+/**
+ * Delete the glyphs evicted from the atlas so far. Call it once the text
+ * using them has been laid out again.
+ *
+ * @param self A valid texture font
+ */
+  void
+  texture_font_release_evicted( texture_font_t * self );
+
 /** 
  * Request an already loaded glyph from the font. 
  * 
@@ -525,15 +830,31 @@ typedef struct texture_font_t
  texture_glyph_t *
  texture_font_find_glyph( texture_font_t * self,
 						  const char * codepoint );
+
+/**
+ * Same as texture_font_find_glyph, for an UTF-32 codepoint.
+ *
+ * @param self      A valid texture font
+ * @param codepoint Character codepoint, -1 for the special glyph.
+ *
+ * @return A pointer on the glyph or 0 if the glyph is not loaded
+ */
+ texture_glyph_t *
+ texture_font_find_glyph_utf32( texture_font_t * self,
+								uint32_t codepoint );
 	
 /** 
- * Index a glyph in a font
+ * Index a glyph in a font, under the glyph rendermode and outline
+ * thickness. The font owns the glyphs indexed with their own codepoint, a
+ * glyph indexed with another codepoint stands in for it (e.g. the missing
+ * glyph) and is not deleted twice.
  * 
  * @param self      A valid texture font
  * @param glyph     The glyph to index in the font
  * @param codepoint The codepoint to insert into
  *
- * @return          1 if glyph was copied, 0 if it was inserted
+ * @return          1 if a glyph is already indexed there (glyph is not
+ *                  inserted), 0 if it was inserted
  */
 int
 texture_font_index_glyph( texture_font_t * self,
@@ -553,22 +874,126 @@ texture_font_index_glyph( texture_font_t * self,
 						   const char * codepoint );
 
 /**
- * Request the loading of several glyphs at once.
+ * Same as texture_font_load_glyph, for an UTF-32 codepoint.
+ *
+ * @param self       A valid texture font
+ * @param codepoint  Character codepoint to be loaded.
+ *
+ * @return One if the glyph could be loaded, zero if not.
+ */
+  int
+  texture_font_load_glyph_utf32( texture_font_t * self,
+								 uint32_t codepoint );
+
+/**
+ * Request the loading of several glyphs at once. All of them are rendered
+ * before they are packed in the atlas, in string order, or together and
+ * highest first when the font packs batches (see texture_font_t::
+ * pack_batches). Kerning pairs for the new glyphs are looked up once, after
+ * the whole batch has been loaded.
  *
  * @param self       A valid texture font
  * @param codepoints Character codepoints to be loaded in UTF-8 encoding. May
  *                   contain duplicates.
  *
  * @return Number of missed glyph if the texture is not big enough to hold
- *         every glyphs.
+ *         every glyphs: the characters left from the first glyph that did
+ *         not fit on, or when the font packs batches the glyphs that did
+ *         not fit (each codepoint counts once).
  */
   size_t
   texture_font_load_glyphs( texture_font_t * self,
 							const char * codepoints );
+/**
+ * Save a font and its atlas to a snapshot file: the atlas pixels and
+ * packing state, the glyphs, the kerning pairs, the font metrics and the
+ * settings glyphs are rendered with (distance field settings included), so
+ * that texture_font_load_snapshot gets them back without opening the face
+ * nor rendering anything. The font must have been created from a file,
+ * which the snapshot records the hash of.
+ *
+ * Glyphs of other fonts sharing the atlas are part of its pixels, but not
+ * of the snapshot. The file is only meant to be read by the same build on
+ * the same machine, as a cache.
+ *
+ * @param self      A valid texture font
+ * @param filename  Path of the snapshot file to write
+ *
+ * @return 1 on success, 0 on error
+ */
+  int
+  texture_font_save_snapshot( texture_font_t * self,
+							  const char * filename );
+
+/**
+ * Load a font saved with texture_font_save_snapshot, along with a new atlas
+ * (font->atlas, to be deleted by the caller). The snapshot is mapped in
+ * memory and used in place: the atlas data points into it and the glyphs,
+ * the glyph table and the kerning pairs are read from it without being
+ * copied (only the glyph pointers are relocated). The font and the atlas
+ * can go on loading glyphs, the face being opened and the atlas data
+ * copied out of the snapshot on the first one; the file is never changed.
+ *
+ * A snapshot is rejected (Snapshot_Mismatch) when it was made by another
+ * version of the library, from a font file whose content differs from
+ * filename, or at another size or rendermode.
+ *
+ * @param snapshot   Path of the snapshot file
+ * @param filename   Font filename the snapshot was made from
+ * @param pt_size    Size of the font (in points)
+ * @param rendermode Rendermode of the font
+ *
+ * @return The font, NULL if the snapshot is missing, invalid or stale
+ */
+  texture_font_t *
+  texture_font_load_snapshot( const char * snapshot,
+							  const char * filename,
+							  float pt_size,
+							  rendermode_t rendermode );
+
+/**
+ * Pack a font and its atlas into a blob that texture_font_new_from_blob
+ * loads: the atlas pixels, used in place, the glyphs, the list of kerning
+ * pairs and the font metrics. Unlike a snapshot, the blob holds neither
+ * pointers nor packing state and does not depend on the font file, so that
+ * it can be shipped along with a program, embedded with #embed or incbin,
+ * or as a plain array (see makefont --format). It is meant for the byte
+ * order it was made with.
+ *
+ * @param self  A valid texture font
+ * @param size  Where to store the size of the blob, in bytes
+ *
+ * @return The blob, to be freed by the caller, NULL on error
+ */
+  void *
+  texture_font_make_blob( texture_font_t * self,
+						  size_t * size );
+
+/**
+ * Create a font from a blob made with texture_font_make_blob, along with a
+ * new atlas (font->atlas, to be deleted by the caller). The atlas data
+ * points into the blob, the glyphs and the kerning pairs are copied out of
+ * it, so the blob must be aligned on 4 bytes and outlive the atlas. It can
+ * be read-only memory: the atlas copies its data out of the blob before it
+ * first writes to it (see texture_atlas_own_data).
+ *
+ * The font has no face (TEXTURE_FONT_NONE): texture_font_get_glyph returns
+ * the glyphs it holds, and NULL with a Font_Unavailable error for others.
+ *
+ * @param blob  A blob made by texture_font_make_blob
+ * @param size  Size of the blob, in bytes
+ *
+ * @return The font, NULL if the blob is invalid (Snapshot_Mismatch)
+ */
+  texture_font_t *
+  texture_font_new_from_blob( const void * blob,
+							  size_t size );
+
 /**
  * Increases the size of a fonts texture atlas
  * Invalidates all pointers to font->atlas->data
- * Changes the UV Coordinates of existing glyphs in the font
+ * Changes the UV Coordinates of existing glyphs in all the fonts sharing the
+ * atlas (see texture_atlas_enlarge)
  *
  * @param self A valid texture font
  * @param width_new Width of the texture atlas after resizing (must be bigger or equal to current width)
@@ -583,6 +1008,27 @@ texture_font_enlarge_glyphs( texture_font_t * self, float mulw, float mulh);
 void
 texture_font_enlarge_texture( texture_font_t * self, size_t width_new,
 				size_t height_new);
+/**
+ * Select how kerning pairs are looked up. The pairs known so far are
+ * discarded.
+ *
+ * With KERNING_ON_DEMAND, no pair is computed when glyphs are loaded: the
+ * kerning of a pair is read from the font the first time it is requested
+ * and cached. The face is opened and closed according to the font mode, a
+ * font that keeps its face open (MODE_ALWAYS_OPEN, MODE_MANUAL_CLOSE, ...)
+ * never reopens it for a lookup.
+ *
+ * @param self        A valid texture font
+ * @param mode        Kerning mode
+ * @param cache_size  Maximum number of cached pairs for KERNING_ON_DEMAND,
+ *                    0 for no limit. A full cache drops a pair for each new
+ *                    one.
+ */
+void
+texture_font_set_kerning_mode( texture_font_t * self,
+							   kerning_mode_t mode,
+							   size_t cache_size );
+
 /**
  * Get the kerning between two horizontal glyphs.
  *
@@ -595,6 +1041,18 @@ float
 texture_glyph_get_kerning( const texture_glyph_t * self,
 						   const char * codepoint );
 
+/**
+ * Same as texture_glyph_get_kerning, for an UTF-32 codepoint.
+ *
+ * @param self      A valid texture glyph
+ * @param codepoint Character codepoint of the preceding character.
+ *
+ * @return x kerning value
+ */
+float
+texture_glyph_get_kerning_utf32( const texture_glyph_t * self,
+								 uint32_t codepoint );
+
 
 /**
  * Creates a new empty glyph
@@ -614,17 +1072,29 @@ texture_glyph_delete( texture_glyph_t * );
 
 /** @} */
 
-#define GLYPHS_ITERATOR1(index, name, glyph) \
-	for ( index = 0; index < vector_size ( glyph ); index++ ) { \
-		texture_glyph_t ** __glyphs;
-#define GLYPHS_ITERATOR2(index, name, glyph) \
-	if (( __glyphs = *(texture_glyph_t *** ) vector_get ( glyph, index ) )) { \
-		int __i;							\
-		for ( __i = 0; __i < 0x100; __i++ ) {			\
-			if (( name = __glyphs[__i] ))
-#define GLYPHS_ITERATOR(index, name, glyph) \
-	GLYPHS_ITERATOR1(index, name, glyph)		\
-	GLYPHS_ITERATOR2(index, name, glyph)
+/*
+ * Iterate over the glyphs of a glyph table, each glyph once: entries where a
+ * glyph stands for another codepoint (missing glyphs) are skipped.
+ *
+ * The two stages of the former index of pages of 0x100 glyphs are kept:
+ * GLYPHS_ITERATOR1 now makes a single pass, whose index is 0, and
+ * GLYPHS_ITERATOR2 scans the table, __glyphs being the table itself. A
+ * GLYPHS_ITERATOR is closed by GLYPHS_ITERATOR_END, or by
+ * GLYPHS_ITERATOR_END1 then GLYPHS_ITERATOR_END2.
+ */
+#define GLYPHS_ITERATOR1(index, name, glyphs) \
+	for ( index = 0; index < 1; index++ ) { \
+		const glyph_table_t * __glyphs = (glyphs);
+#define GLYPHS_ITERATOR2(index, name, glyphs) \
+	if ( __glyphs ) { \
+		size_t __i; \
+		for ( __i = 0; __i < __glyphs->capacity; __i++ ) { \
+			const glyph_entry_t * __entry = __glyphs->entries + __i; \
+			if ( __entry->codepoint != GLYPH_TABLE_EMPTY && \
+				 ( name = __entry->glyph )->codepoint == __entry->codepoint )
+#define GLYPHS_ITERATOR(index, name, glyphs) \
+	GLYPHS_ITERATOR1(index, name, glyphs) \
+	GLYPHS_ITERATOR2(index, name, glyphs)
 
 #define GLYPHS_ITERATOR_END1 }
 #define GLYPHS_ITERATOR_END2 } }